@@ -0,0 +1,2349 @@
+#ifndef LIBTRADING_FAST_CODEC_H
+#define LIBTRADING_FAST_CODEC_H
+
+#include "libtrading/proto/fast_message.h"
+#include "libtrading/buffer.h"
+#include "libtrading/types.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <endian.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Field codecs shared by the template interpreter and by the decoders that
+ * tools/fast/fast_codegen generates. The operator, presence and pmap bit are
+ * explicit arguments: the interpreter passes them from the field while
+ * generated code passes constants, so the compiler folds every codec down
+ * to the single path that the template needs.
+ */
+
+/* Operator, presence and pmap bit arguments of the interpreted field codecs */
+#define	FAST_FIELD_ARGS(field)		(field)->op, field_is_mandatory(field), (field)->pmap_bit
+
+/* ...and of a decimal whose exponent and mantissa have their own operators */
+#define	FAST_DECIMAL_PARTS_ARGS(field)					\
+	FAST_FIELD_ARGS(&field_decimal_parts(field)->exponent),		\
+	field_decimal_parts(field)->mantissa.op,			\
+	field_decimal_parts(field)->mantissa.pmap_bit
+
+/* An integer never takes more than nine stop bit encoded bytes */
+#define	FAST_INT_MAX_BYTES		9
+
+/*
+ * Strings are scanned for their stop bit 16 bytes at a time. The first few
+ * bytes are still looked at one by one: most strings are short and a
+ * predicted branch lets the CPU start on the next field before the stop
+ * bit is found, which the 16 byte scan does not.
+ */
+#define	FAST_STOP_BIT_BYTES		16
+#define	FAST_STOP_BIT_SHORT		4
+
+struct fast_template_codec {
+	u64			tid;
+	u64			signature;	/* see fast_message_signature() */
+
+	int			(*decode)(struct buffer *, struct fast_pmap *, struct fast_message *);
+	int			(*encode)(struct buffer *, struct fast_pmap *, struct fast_message *);
+	int			(*visit)(struct buffer *, struct fast_pmap *, struct fast_message *);
+};
+
+u64 fast_message_signature(struct fast_message *msg);
+int fast_message_attach(struct fast_message *msg, const struct fast_template_codec *codec);
+
+/*
+ * Mandatory constants take no pmap bit and never change, so generated
+ * decoders leave them out and fast_message_attach() sets them once.
+ */
+static inline bool fast_field_is_fixed(struct fast_field *field)
+{
+	if (field->op != FAST_OP_CONSTANT || !field_is_mandatory(field) || field->slot)
+		return false;
+
+	return field->type == FAST_TYPE_INT || field->type == FAST_TYPE_UINT || field->type == FAST_TYPE_STRING;
+}
+
+/*
+ * The parsers below refill the buffer from the session socket when a field
+ * straddles the end of it.
+ */
+int fast_parse_uint(struct buffer *buffer, u64 *value);
+int fast_parse_int(struct buffer *buffer, i64 *value);
+int fast_parse_string(struct buffer *buffer, char *value, unsigned long size);
+int fast_parse_bytes(struct buffer *buffer, char *value, int len);
+int fast_parse_pmap(struct buffer *buffer, struct fast_pmap *pmap);
+
+/*
+ * Returns the index of the first of the 16 bytes at @p that carries the
+ * stop bit, or 16 if none of them does.
+ */
+static inline int fast_stop_bit(const u8 *p)
+{
+#ifdef __SSE2__
+	unsigned int mask;
+
+	mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) p));
+	if (!mask)
+		return 16;
+
+	return __builtin_ctz(mask);
+#else
+	u64 lo, hi;
+
+	memcpy(&lo, p, sizeof(lo));
+	memcpy(&hi, p + 8, sizeof(hi));
+
+	lo = le64toh(lo) & 0x8080808080808080ULL;
+	if (lo)
+		return __builtin_ctzll(lo) / 8;
+
+	hi = le64toh(hi) & 0x8080808080808080ULL;
+	if (hi)
+		return 8 + __builtin_ctzll(hi) / 8;
+
+	return 16;
+#endif
+}
+
+static inline int fast_get_uint(struct buffer *buffer, u64 *value)
+{
+	const u8 *p;
+	u64 result;
+	int i;
+
+	if (unlikely(buffer_size(buffer) < FAST_INT_MAX_BYTES))
+		return fast_parse_uint(buffer, value);
+
+	p = (const u8 *) buffer_start(buffer);
+	result = 0;
+
+	for (i = 0; i < FAST_INT_MAX_BYTES; i++) {
+		if (p[i] & 0x80) {
+			*value = (result << 7) | (p[i] & 0x7F);
+			buffer_advance(buffer, i + 1);
+
+			return 0;
+		}
+
+		result = (result << 7) | p[i];
+	}
+
+	return FAST_MSG_STATE_GARBLED;
+}
+
+static inline int fast_get_int(struct buffer *buffer, i64 *value)
+{
+	const u8 *p;
+	i64 result;
+	int i;
+
+	if (unlikely(buffer_size(buffer) < FAST_INT_MAX_BYTES))
+		return fast_parse_int(buffer, value);
+
+	p = (const u8 *) buffer_start(buffer);
+	result = (p[0] & 0x40) ? -1 : 0;
+
+	for (i = 0; i < FAST_INT_MAX_BYTES; i++) {
+		if (p[i] & 0x80) {
+			*value = (result << 7) | (p[i] & 0x7F);
+			buffer_advance(buffer, i + 1);
+
+			return 0;
+		}
+
+		result = (result << 7) | p[i];
+	}
+
+	return FAST_MSG_STATE_GARBLED;
+}
+
+/*
+ * Presence maps are one to three bytes long and keep their length from one
+ * message of a template to the next, so the byte loop below is a predicted
+ * branch or two. Finding the stop bit with fast_stop_bit() or with one
+ * 8 byte mask and copying the map in one go was measured slower at every
+ * length: the buffer cannot advance before the mask is ready.
+ */
+static inline int fast_get_pmap(struct buffer *buffer, struct fast_pmap *pmap)
+{
+	const u8 *p;
+	int i;
+
+	if (unlikely(buffer_size(buffer) < FAST_PMAP_MAX_BYTES))
+		return fast_parse_pmap(buffer, pmap);
+
+	p = (const u8 *) buffer_start(buffer);
+
+	for (i = 0; i < FAST_PMAP_MAX_BYTES; i++) {
+		pmap->bytes[i] = p[i];
+
+		if (p[i] & 0x80) {
+			pmap->nr_bytes = i + 1;
+			buffer_advance(buffer, i + 1);
+
+			return 0;
+		}
+	}
+
+	return FAST_MSG_STATE_GARBLED;
+}
+
+static inline int fast_get_string(struct buffer *buffer, char *value, unsigned long size)
+{
+	unsigned long end = buffer_size(buffer);
+	const u8 *p;
+	int stop;
+	int len;
+
+	if (end > size - 1)
+		end = size - 1;
+
+	p = (const u8 *) buffer_start(buffer);
+
+	if (end >= FAST_STOP_BIT_BYTES) {
+		for (len = 0; len < FAST_STOP_BIT_SHORT; len++) {
+			if (p[len] & 0x80) {
+				value[len] = p[len] & 0x7F;
+				value[len + 1] = '\0';
+				buffer_advance(buffer, len + 1);
+
+				return len + 1;
+			}
+
+			value[len] = p[len];
+		}
+	}
+
+	for (len = 0; len + FAST_STOP_BIT_BYTES <= end; len += FAST_STOP_BIT_BYTES) {
+		stop = fast_stop_bit(p + len);
+
+		memcpy(value + len, p + len, FAST_STOP_BIT_BYTES);
+
+		if (stop < FAST_STOP_BIT_BYTES) {
+			len += stop;
+
+			value[len] = p[len] & 0x7F;
+			value[len + 1] = '\0';
+			buffer_advance(buffer, len + 1);
+
+			return len + 1;
+		}
+	}
+
+	for (; len < end; len++) {
+		if (p[len] & 0x80) {
+			value[len] = p[len] & 0x7F;
+			value[len + 1] = '\0';
+			buffer_advance(buffer, len + 1);
+
+			return len + 1;
+		}
+
+		value[len] = p[len];
+	}
+
+	return fast_parse_string(buffer, value, size);
+}
+
+static __always_inline int fast_decode_uint(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	int ret = 0;
+	i64 tmp;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		ret = fast_get_uint(buffer, &field->uint_value);
+
+		if (ret)
+			goto fail;
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (mandatory)
+			break;
+
+		if (!field->uint_value)
+			field->state = FAST_STATE_EMPTY;
+		else
+			field->uint_value--;
+
+		break;
+	case FAST_OP_COPY:
+		if (!pmap_is_set(pmap, bit)) {
+			switch (field->state) {
+			case FAST_STATE_UNDEFINED:
+				if (field_has_reset_value(field)) {
+					field->state = FAST_STATE_ASSIGNED;
+					field->uint_value = field->uint_reset;
+				} else {
+					if (mandatory) {
+						ret = FAST_MSG_STATE_GARBLED;
+						goto fail;
+					} else
+						field->state = FAST_STATE_EMPTY;
+				}
+
+				break;
+			case FAST_STATE_ASSIGNED:
+				break;
+			case FAST_STATE_EMPTY:
+				if (mandatory) {
+					ret = FAST_MSG_STATE_GARBLED;
+					goto fail;
+				}
+
+				break;
+			default:
+				break;
+			}
+		} else {
+			ret = fast_get_uint(buffer, &field->uint_value);
+
+			if (ret)
+				goto fail;
+
+			field->state = FAST_STATE_ASSIGNED;
+
+			if (mandatory)
+				break;
+
+			if (!field->uint_value)
+				field->state = FAST_STATE_EMPTY;
+			else
+				field->uint_value--;
+		}
+
+		break;
+	case FAST_OP_INCR:
+		if (!pmap_is_set(pmap, bit)) {
+			switch (field->state) {
+			case FAST_STATE_UNDEFINED:
+				if (field_has_reset_value(field)) {
+					field->state = FAST_STATE_ASSIGNED;
+					field->uint_value = field->uint_reset;
+				} else {
+					if (mandatory) {
+						ret = FAST_MSG_STATE_GARBLED;
+						goto fail;
+					} else
+						field->state = FAST_STATE_EMPTY;
+				}
+
+				break;
+			case FAST_STATE_ASSIGNED:
+				field->uint_value++;
+
+				break;
+			case FAST_STATE_EMPTY:
+				if (mandatory) {
+					ret = FAST_MSG_STATE_GARBLED;
+					goto fail;
+				}
+
+				break;
+			default:
+				break;
+			}
+		} else {
+			ret = fast_get_uint(buffer, &field->uint_value);
+
+			if (ret)
+				goto fail;
+
+			field->state = FAST_STATE_ASSIGNED;
+
+			if (mandatory)
+				break;
+
+			if (!field->uint_value)
+				field->state = FAST_STATE_EMPTY;
+			else
+				field->uint_value--;
+		}
+
+		break;
+	case FAST_OP_DELTA:
+		ret = fast_get_int(buffer, &tmp);
+
+		if (ret)
+			goto fail;
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (tmp < 0)
+			field->uint_value -= (-tmp);
+		else
+			field->uint_value += tmp;
+
+		if (mandatory)
+			break;
+
+		if (!tmp)
+			field->state = FAST_STATE_EMPTY;
+		else if (tmp > 0)
+			field->uint_value--;
+
+		break;
+	case FAST_OP_CONSTANT:
+		if (field->state != FAST_STATE_ASSIGNED)
+			field->uint_value = field->uint_reset;
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (mandatory)
+			break;
+
+		if (!pmap_is_set(pmap, bit))
+			field->state = FAST_STATE_EMPTY;
+
+		break;
+	case FAST_OP_TAIL:
+	default:
+		return FAST_MSG_STATE_GARBLED;
+	};
+
+	return 0;
+
+fail:
+	return ret;
+}
+
+static __always_inline int fast_decode_int(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	int ret = 0;
+	i64 tmp;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		ret = fast_get_int(buffer, &field->int_value);
+
+		if (ret)
+			goto fail;
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (mandatory)
+			break;
+
+		if (!field->int_value)
+			field->state = FAST_STATE_EMPTY;
+		else if (field->int_value > 0)
+			field->int_value--;
+
+		break;
+	case FAST_OP_COPY:
+		if (!pmap_is_set(pmap, bit)) {
+			switch (field->state) {
+			case FAST_STATE_UNDEFINED:
+				if (field_has_reset_value(field)) {
+					field->state = FAST_STATE_ASSIGNED;
+					field->int_value = field->int_reset;
+				} else {
+					if (mandatory) {
+						ret = FAST_MSG_STATE_GARBLED;
+						goto fail;
+					} else
+						field->state = FAST_STATE_EMPTY;
+				}
+
+				break;
+			case FAST_STATE_ASSIGNED:
+				break;
+			case FAST_STATE_EMPTY:
+				if (mandatory) {
+					ret = FAST_MSG_STATE_GARBLED;
+					goto fail;
+				}
+
+				break;
+			default:
+				break;
+			}
+		} else {
+			ret = fast_get_int(buffer, &field->int_value);
+
+			if (ret)
+				goto fail;
+
+			field->state = FAST_STATE_ASSIGNED;
+
+			if (mandatory)
+				break;
+
+			if (!field->int_value)
+				field->state = FAST_STATE_EMPTY;
+			else if (field->int_value > 0)
+				field->int_value--;
+		}
+
+		break;
+	case FAST_OP_INCR:
+		if (!pmap_is_set(pmap, bit)) {
+			switch (field->state) {
+			case FAST_STATE_UNDEFINED:
+				if (field_has_reset_value(field)) {
+					field->state = FAST_STATE_ASSIGNED;
+					field->int_value = field->int_reset;
+				} else {
+					if (mandatory) {
+						ret = FAST_MSG_STATE_GARBLED;
+						goto fail;
+					} else
+						field->state = FAST_STATE_EMPTY;
+				}
+
+				break;
+			case FAST_STATE_ASSIGNED:
+				field->int_value++;
+
+				break;
+			case FAST_STATE_EMPTY:
+				if (mandatory) {
+					ret = FAST_MSG_STATE_GARBLED;
+					goto fail;
+				}
+
+				break;
+			default:
+				break;
+			}
+		} else {
+			ret = fast_get_int(buffer, &field->int_value);
+
+			if (ret)
+				goto fail;
+
+			field->state = FAST_STATE_ASSIGNED;
+
+			if (mandatory)
+				break;
+
+			if (!field->int_value)
+				field->state = FAST_STATE_EMPTY;
+			else if (field->int_value > 0)
+				field->int_value--;
+		}
+
+		break;
+	case FAST_OP_DELTA:
+		ret = fast_get_int(buffer, &tmp);
+
+		if (ret)
+			goto fail;
+
+		field->state = FAST_STATE_ASSIGNED;
+		field->int_value += tmp;
+
+		if (mandatory)
+			break;
+
+		if (!tmp)
+			field->state = FAST_STATE_EMPTY;
+		else if (tmp > 0)
+			field->int_value--;
+
+		break;
+	case FAST_OP_CONSTANT:
+		if (field->state != FAST_STATE_ASSIGNED)
+			field->int_value = field->int_reset;
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (mandatory)
+			break;
+
+		if (!pmap_is_set(pmap, bit))
+			field->state = FAST_STATE_EMPTY;
+
+		break;
+	case FAST_OP_TAIL:
+	default:
+		return FAST_MSG_STATE_GARBLED;
+	}
+
+	return 0;
+
+fail:
+	return ret;
+}
+
+static inline int fast_get_bytes(struct buffer *buffer, char *value, unsigned long len)
+{
+	if (unlikely(buffer_size(buffer) < len))
+		return fast_parse_bytes(buffer, value, len);
+
+	memcpy(value, buffer_start(buffer), len);
+	buffer_advance(buffer, len);
+
+	return 0;
+}
+
+static __always_inline int fast_read_reset(struct fast_field *field, bool mandatory)
+{
+	if (field_has_reset_value(field)) {
+		field->state = FAST_STATE_ASSIGNED;
+		field->string_len = strlen(field->string_reset);
+		field->string_value = field->string_buf;
+		memcpy(field->string_value, field->string_reset, field->string_len + 1);
+	} else {
+		if (mandatory)
+			return FAST_MSG_STATE_GARBLED;
+
+		field->state = FAST_STATE_EMPTY;
+	}
+
+	return 0;
+}
+
+/*
+ * Reads a length-prefixed unicode string or byte vector. Values that do
+ * not need to outlive the message are left in a datagram and the field
+ * only points at them, stream buffers move as they are refilled so the
+ * value is copied to the field's buffer.
+ */
+static __always_inline int fast_read_bytes(struct buffer *buffer, struct fast_field *field, bool mandatory, bool view)
+{
+	u64 len;
+	int ret;
+
+	ret = fast_get_uint(buffer, &len);
+	if (ret)
+		return ret;
+
+	field->state = FAST_STATE_ASSIGNED;
+
+	if (!mandatory) {
+		if (!len) {
+			field->state = FAST_STATE_EMPTY;
+			return 0;
+		} else
+			len--;
+	}
+
+	if (len >= field->string_size)
+		return FAST_MSG_STATE_GARBLED;
+
+	if (view && !buffer_get_ptr(buffer) && buffer_size(buffer) >= len) {
+		field->string_value = buffer_start(buffer);
+		buffer_advance(buffer, len);
+	} else {
+		ret = fast_get_bytes(buffer, field->string_buf, len);
+		if (ret)
+			return ret;
+
+		field->string_value = field->string_buf;
+		field->string_value[len] = '\0';
+	}
+
+	field->string_len = len;
+
+	return 0;
+}
+
+/*
+ * A lone 0x80 is the empty string, or NULL if the field is optional, in
+ * which case the empty string is sent as 0x00 0x80. The leading zero of
+ * such overlong strings is not part of the value.
+ */
+static __always_inline int fast_read_ascii(struct buffer *buffer, struct fast_field *field, bool mandatory)
+{
+	char *value = field->string_buf;
+	int ret;
+
+	ret = fast_get_string(buffer, value, field->string_size);
+	if (ret < 0)
+		return ret;
+
+	field->state = FAST_STATE_ASSIGNED;
+	field->string_value = value;
+
+	if (unlikely(!value[0])) {
+		if (mandatory)
+			ret -= 1;
+		else if (ret > 1)
+			ret -= 2;
+		else {
+			field->state = FAST_STATE_EMPTY;
+			ret = 0;
+		}
+
+		value[ret] = '\0';
+	}
+
+	field->string_len = ret;
+
+	return 0;
+}
+
+/*
+ * Delta and tail operators change the value in the field's buffer, which a
+ * unicode string that was left in a datagram is copied to first.
+ */
+static __always_inline void fast_string_own(struct fast_field *field)
+{
+	if (field->string_value == field->string_buf)
+		return;
+
+	memcpy(field->string_buf, field->string_value, field->string_len);
+	field->string_buf[field->string_len] = '\0';
+	field->string_value = field->string_buf;
+}
+
+/* The base of a tail when there is no previous value */
+static __always_inline void fast_string_initial(struct fast_field *field)
+{
+	field->string_value = field->string_buf;
+
+	if (field_has_reset_value(field)) {
+		field->string_len = strlen(field->string_reset);
+		memcpy(field->string_buf, field->string_reset, field->string_len + 1);
+	} else {
+		field->string_len = 0;
+		field->string_buf[0] = '\0';
+	}
+}
+
+/*
+ * Reads an ascii string to value like fast_read_ascii() does, with its
+ * length in len or -1 if it is NULL.
+ */
+static __always_inline int fast_get_ascii(struct buffer *buffer, char *value, unsigned long size, bool mandatory, long *len)
+{
+	int ret;
+
+	ret = fast_get_string(buffer, value, size);
+	if (ret < 0)
+		return ret;
+
+	if (unlikely(!value[0])) {
+		if (mandatory)
+			ret -= 1;
+		else if (ret > 1)
+			ret -= 2;
+		else
+			ret = -1;
+
+		if (ret >= 0)
+			value[ret] = '\0';
+	}
+
+	*len = ret;
+
+	return 0;
+}
+
+/*
+ * Finds the end of an ascii string among the first size bytes of the
+ * buffer without reading it, so that it can be copied right to where it
+ * goes. Returns the number of bytes the string takes up, and its length
+ * in len as fast_get_ascii() has it, or zero if the string is not there.
+ */
+static __always_inline unsigned long fast_peek_ascii(struct buffer *buffer, unsigned long size, bool mandatory, long *len)
+{
+	unsigned long end = buffer_size(buffer);
+	unsigned long n;
+	const u8 *p;
+	int stop;
+
+	if (end > size)
+		end = size;
+
+	p = (const u8 *) buffer_start(buffer);
+
+	for (n = 0; n + FAST_STOP_BIT_BYTES <= end; n += FAST_STOP_BIT_BYTES) {
+		stop = fast_stop_bit(p + n);
+		if (stop < FAST_STOP_BIT_BYTES) {
+			n += stop;
+			goto found;
+		}
+	}
+
+	for (; n < end; n++) {
+		if (p[n] & 0x80)
+			goto found;
+	}
+
+	return 0;
+
+found:
+	n++;
+
+	*len = n;
+
+	if (unlikely(!(p[0] & 0x7f))) {
+		if (mandatory)
+			*len = n - 1;
+		else if (n > 1)
+			*len = n - 2;
+		else
+			*len = -1;
+	}
+
+	return n;
+}
+
+/* Copies a string that fast_peek_ascii() found and consumes it */
+static __always_inline void fast_take_ascii(struct buffer *buffer, char *value, unsigned long n, long len)
+{
+	memcpy(value, buffer_start(buffer), len);
+
+	if ((unsigned long) len == n)
+		value[len - 1] &= 0x7f;
+
+	buffer_advance(buffer, n);
+}
+
+/*
+ * A string delta is a subtraction length, NULL if the field is optional
+ * and absent, and a string that is never NULL. A length that is not
+ * negative removes that many characters from the back of the previous
+ * value and the string is appended, otherwise one less than its magnitude
+ * is removed from the front and the string prepended. The string is read
+ * straight into place in the field's buffer, the kept characters only
+ * move when a prepend changes the length.
+ */
+static __always_inline int fast_read_delta(struct buffer *buffer, struct fast_field *field, bool mandatory, bool unicode)
+{
+	char delta[FAST_STRING_MAX_BYTES + 1];
+	char *value = field->string_buf;
+	unsigned long keep, drop = 0;
+	unsigned long n = 0;
+	char *dst;
+	u64 size;
+	long len;
+	i64 sub;
+	int ret;
+
+	ret = fast_get_int(buffer, &sub);
+	if (ret)
+		return ret;
+
+	if (!mandatory) {
+		if (!sub) {
+			field->state = FAST_STATE_EMPTY;
+			return 0;
+		} else if (sub > 0)
+			sub--;
+	}
+
+	fast_string_own(field);
+
+	if (sub >= 0) {
+		if ((u64) sub > field->string_len)
+			return FAST_MSG_STATE_GARBLED;
+
+		keep = field->string_len - sub;
+	} else {
+		drop = -(sub + 1);
+
+		if (drop > field->string_len)
+			return FAST_MSG_STATE_GARBLED;
+
+		keep = field->string_len - drop;
+	}
+
+	if (unicode) {
+		ret = fast_get_uint(buffer, &size);
+		if (ret)
+			return ret;
+
+		if (size >= field->string_size - keep)
+			return FAST_MSG_STATE_GARBLED;
+
+		len = size;
+	} else {
+		n = fast_peek_ascii(buffer, field->string_size + 1, true, &len);
+		if (unlikely(!n)) {
+			ret = fast_get_ascii(buffer, delta, sizeof(delta), true, &len);
+			if (ret)
+				return ret;
+		}
+
+		if ((unsigned long) len >= field->string_size - keep)
+			return FAST_MSG_STATE_GARBLED;
+	}
+
+	if (sub >= 0)
+		dst = value + keep;
+	else {
+		if ((unsigned long) len != drop)
+			memmove(value + len, value + drop, keep);
+
+		dst = value;
+	}
+
+	if (unicode) {
+		ret = fast_get_bytes(buffer, dst, len);
+		if (ret)
+			return ret;
+	} else if (likely(n))
+		fast_take_ascii(buffer, dst, n, len);
+	else
+		memcpy(dst, delta, len);
+
+	field->string_len = keep + len;
+	value[field->string_len] = '\0';
+
+	field->state = FAST_STATE_ASSIGNED;
+
+	return 0;
+}
+
+/*
+ * A tail replaces as many characters at the back of the previous value,
+ * or of the initial one if there is no previous value, or all of it if it
+ * is longer. Like deltas, tails are read right into place.
+ */
+static __always_inline int fast_read_tail(struct buffer *buffer, struct fast_field *field, bool mandatory, bool unicode)
+{
+	char tail[FAST_STRING_MAX_BYTES + 1];
+	char *value = field->string_buf;
+	unsigned long offset, n = 0;
+	u64 size;
+	long len;
+	int ret;
+
+	if (unicode) {
+		ret = fast_get_uint(buffer, &size);
+		if (ret)
+			return ret;
+
+		if (!mandatory) {
+			if (!size) {
+				field->state = FAST_STATE_EMPTY;
+				return 0;
+			}
+
+			size--;
+		}
+
+		if (size >= field->string_size)
+			return FAST_MSG_STATE_GARBLED;
+
+		len = size;
+	} else {
+		n = fast_peek_ascii(buffer, field->string_size + 1, mandatory, &len);
+		if (unlikely(!n)) {
+			ret = fast_get_ascii(buffer, tail, sizeof(tail), mandatory, &len);
+			if (ret)
+				return ret;
+		}
+
+		if (len < 0) {
+			buffer_advance(buffer, n);
+			field->state = FAST_STATE_EMPTY;
+			return 0;
+		}
+
+		if ((unsigned long) len >= field->string_size)
+			return FAST_MSG_STATE_GARBLED;
+	}
+
+	if (field->state == FAST_STATE_ASSIGNED)
+		fast_string_own(field);
+	else
+		fast_string_initial(field);
+
+	if ((unsigned long) len < field->string_len)
+		offset = field->string_len - len;
+	else {
+		offset = 0;
+		field->string_len = len;
+	}
+
+	if (unicode) {
+		ret = fast_get_bytes(buffer, value + offset, len);
+		if (ret)
+			return ret;
+	} else if (likely(n))
+		fast_take_ascii(buffer, value + offset, n, len);
+	else
+		memcpy(value + offset, tail, len);
+
+	value[field->string_len] = '\0';
+
+	field->state = FAST_STATE_ASSIGNED;
+
+	return 0;
+}
+
+/* Without a tail the value stays what it was, as with the copy operator */
+static __always_inline int fast_keep_string(struct fast_field *field, bool mandatory)
+{
+	switch (field->state) {
+	case FAST_STATE_UNDEFINED:
+		return fast_read_reset(field, mandatory);
+	case FAST_STATE_ASSIGNED:
+		break;
+	case FAST_STATE_EMPTY:
+		if (mandatory)
+			return FAST_MSG_STATE_GARBLED;
+
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static __always_inline int fast_decode_unicode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	int ret;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		ret = fast_read_bytes(buffer, field, mandatory, true);
+		if (ret)
+			goto fail;
+
+		break;
+	case FAST_OP_COPY:
+		if (!pmap_is_set(pmap, bit)) {
+			switch (field->state) {
+			case FAST_STATE_UNDEFINED:
+				ret = fast_read_reset(field, mandatory);
+				if (ret)
+					goto fail;
+
+				break;
+			case FAST_STATE_ASSIGNED:
+				break;
+			case FAST_STATE_EMPTY:
+				if (mandatory) {
+					ret = FAST_MSG_STATE_GARBLED;
+					goto fail;
+				}
+
+				break;
+			default:
+				break;
+			}
+		} else {
+			/* The value is needed again when the bit is not set */
+			ret = fast_read_bytes(buffer, field, mandatory, false);
+			if (ret)
+				goto fail;
+		}
+
+		break;
+	case FAST_OP_INCR:
+			ret = FAST_MSG_STATE_GARBLED;
+			goto fail;
+	case FAST_OP_DELTA:
+		ret = fast_read_delta(buffer, field, mandatory, true);
+		if (ret)
+			goto fail;
+
+		break;
+	case FAST_OP_TAIL:
+		if (!pmap_is_set(pmap, bit))
+			ret = fast_keep_string(field, mandatory);
+		else
+			ret = fast_read_tail(buffer, field, mandatory, true);
+
+		if (ret)
+			goto fail;
+
+		break;
+	case FAST_OP_CONSTANT:
+		if (field->state != FAST_STATE_ASSIGNED)
+			fast_read_reset(field, true);
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (mandatory)
+			break;
+
+		if (!pmap_is_set(pmap, bit))
+			field->state = FAST_STATE_EMPTY;
+
+		break;
+	default:
+		return FAST_MSG_STATE_GARBLED;
+	}
+
+	return 0;
+
+fail:
+	return ret;
+}
+
+static __always_inline int fast_decode_ascii(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	int ret;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		ret = fast_read_ascii(buffer, field, mandatory);
+		if (ret)
+			goto fail;
+
+		break;
+	case FAST_OP_COPY:
+		if (!pmap_is_set(pmap, bit)) {
+			switch (field->state) {
+			case FAST_STATE_UNDEFINED:
+				ret = fast_read_reset(field, mandatory);
+				if (ret)
+					goto fail;
+
+				break;
+			case FAST_STATE_ASSIGNED:
+				break;
+			case FAST_STATE_EMPTY:
+				if (mandatory) {
+					ret = FAST_MSG_STATE_GARBLED;
+					goto fail;
+				}
+
+				break;
+			default:
+				break;
+			}
+		} else {
+			ret = fast_read_ascii(buffer, field, mandatory);
+			if (ret)
+				goto fail;
+		}
+
+		break;
+	case FAST_OP_INCR:
+			ret = FAST_MSG_STATE_GARBLED;
+			goto fail;
+	case FAST_OP_DELTA:
+		ret = fast_read_delta(buffer, field, mandatory, false);
+		if (ret)
+			goto fail;
+
+		break;
+	case FAST_OP_TAIL:
+		if (!pmap_is_set(pmap, bit))
+			ret = fast_keep_string(field, mandatory);
+		else
+			ret = fast_read_tail(buffer, field, mandatory, false);
+
+		if (ret)
+			goto fail;
+
+		break;
+	case FAST_OP_CONSTANT:
+		if (field->state != FAST_STATE_ASSIGNED)
+			fast_read_reset(field, true);
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (mandatory)
+			break;
+
+		if (!pmap_is_set(pmap, bit))
+			field->state = FAST_STATE_EMPTY;
+
+		break;
+	default:
+		return FAST_MSG_STATE_GARBLED;
+	}
+
+	return 0;
+
+fail:
+	return ret;
+}
+
+static __always_inline int fast_decode_string(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE))
+		return fast_decode_unicode(buffer, pmap, field, op, mandatory, bit);
+	else
+		return fast_decode_ascii(buffer, pmap, field, op, mandatory, bit);
+}
+
+static __always_inline int fast_decode_decimal(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	int ret = 0;
+	i64 exp, mnt;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		ret = fast_get_int(buffer, &exp);
+
+		if (ret)
+			goto fail;
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (!mandatory) {
+			if (!exp) {
+				field->state = FAST_STATE_EMPTY;
+				break;
+			} else if (exp > 0)
+				exp--;
+		}
+
+		if (exp > 63 || exp < -63) {
+			ret = FAST_MSG_STATE_GARBLED;
+			goto fail;
+		}
+
+		ret = fast_get_int(buffer, &mnt);
+
+		if (ret)
+			goto fail;
+
+		field->decimal_value.exp = exp;
+		field->decimal_value.mnt = mnt;
+
+		break;
+	case FAST_OP_COPY:
+		if (!pmap_is_set(pmap, bit)) {
+			switch (field->state) {
+			case FAST_STATE_UNDEFINED:
+				if (field_has_reset_value(field)) {
+					field->state = FAST_STATE_ASSIGNED;
+					field->decimal_value.exp = field->decimal_reset.exp;
+					field->decimal_value.mnt = field->decimal_reset.mnt;
+				} else {
+					if (mandatory) {
+						ret = FAST_MSG_STATE_GARBLED;
+						goto fail;
+					} else
+						field->state = FAST_STATE_EMPTY;
+				}
+
+				break;
+			case FAST_STATE_ASSIGNED:
+				break;
+			case FAST_STATE_EMPTY:
+				if (mandatory) {
+					ret = FAST_MSG_STATE_GARBLED;
+					goto fail;
+				}
+
+				break;
+			default:
+				break;
+			}
+		} else {
+			ret = fast_get_int(buffer, &exp);
+
+			if (ret)
+				goto fail;
+
+			field->state = FAST_STATE_ASSIGNED;
+
+			if (!mandatory) {
+				if (!exp) {
+					field->state = FAST_STATE_EMPTY;
+					break;
+				} else if (exp > 0)
+					exp--;
+			}
+
+			if (exp > 63 || exp < -63) {
+				ret = FAST_MSG_STATE_GARBLED;
+				goto fail;
+			}
+
+			ret = fast_get_int(buffer, &mnt);
+
+			if (ret)
+				goto fail;
+
+			field->decimal_value.exp = exp;
+			field->decimal_value.mnt = mnt;
+		}
+
+		break;
+	case FAST_OP_INCR:
+		/* Do not applicable to decimal */
+		ret = FAST_MSG_STATE_GARBLED;
+		goto fail;
+	case FAST_OP_DELTA:
+		ret = fast_get_int(buffer, &exp);
+
+		if (ret)
+			goto fail;
+
+		field->state = FAST_STATE_ASSIGNED;
+		field->decimal_value.exp += exp;
+
+		if (!mandatory) {
+			if (!exp) {
+				field->state = FAST_STATE_EMPTY;
+				break;
+			} else if (exp > 0)
+				field->decimal_value.exp--;
+		}
+
+		if (field->decimal_value.exp > 63 ||
+			field->decimal_value.exp < -63) {
+			ret = FAST_MSG_STATE_GARBLED;
+			goto fail;
+		}
+
+		ret = fast_get_int(buffer, &mnt);
+
+		if (ret)
+			goto fail;
+
+		field->decimal_value.mnt += mnt;
+
+		break;
+	case FAST_OP_CONSTANT:
+		if (field->state != FAST_STATE_ASSIGNED) {
+			field->decimal_value.exp = field->decimal_reset.exp;
+			field->decimal_value.mnt = field->decimal_reset.mnt;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		if (mandatory)
+			break;
+
+		if (!pmap_is_set(pmap, bit))
+			field->state = FAST_STATE_EMPTY;
+
+		break;
+	case FAST_OP_TAIL:
+	default:
+		return FAST_MSG_STATE_GARBLED;
+	}
+
+	return 0;
+
+fail:
+	return ret;
+}
+
+/*
+ * The exponent and the mantissa are decoded like the integer fields they
+ * are coded as and make up the decimal's value.
+ */
+static __always_inline int fast_decode_decimal_parts(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+						 enum fast_op exp_op, bool mandatory, unsigned long exp_bit,
+						 enum fast_op mnt_op, unsigned long mnt_bit)
+{
+	struct fast_decimal_parts *parts = field_decimal_parts(field);
+	int ret;
+
+	ret = fast_decode_int(buffer, pmap, &parts->exponent, exp_op, mandatory, exp_bit);
+	if (ret)
+		return ret;
+
+	if (field_state_empty(&parts->exponent)) {
+		field->state = FAST_STATE_EMPTY;
+		return 0;
+	}
+
+	if (parts->exponent.int_value > 63 || parts->exponent.int_value < -63)
+		return FAST_MSG_STATE_GARBLED;
+
+	ret = fast_decode_int(buffer, pmap, &parts->mantissa, mnt_op, true, mnt_bit);
+	if (ret)
+		return ret;
+
+	field->state			= FAST_STATE_ASSIGNED;
+	field->decimal_value.exp	= parts->exponent.int_value;
+	field->decimal_value.mnt	= parts->mantissa.int_value;
+
+	return 0;
+}
+
+/*
+ * The pmap precedes the fields it covers but is only known once they are
+ * encoded, so room is left for the longest one. A message at the start of
+ * the buffer gets its pmap right in front of the fields and the buffer
+ * starts where the pmap does, otherwise the fields are moved back over
+ * the room that is not used.
+ */
+static inline int fast_pmap_reserve(struct buffer *buffer, struct fast_pmap *pmap, unsigned long *offset)
+{
+	if (buffer_remaining(buffer) < FAST_PMAP_MAX_BYTES)
+		return -1;
+
+	*offset = buffer->end;
+	buffer->end += FAST_PMAP_MAX_BYTES;
+
+	pmap->nr_bytes = FAST_PMAP_MAX_BYTES;
+	memset(pmap->bytes, 0, FAST_PMAP_MAX_BYTES);
+
+	return 0;
+}
+
+static inline void fast_pmap_commit(struct buffer *buffer, struct fast_pmap *pmap, unsigned long offset)
+{
+	unsigned long nr_bytes = FAST_PMAP_MAX_BYTES;
+	unsigned long unused;
+	unsigned long i;
+	char *p;
+
+	while (nr_bytes > 1 && !pmap->bytes[nr_bytes - 1])
+		nr_bytes--;
+
+	unused = FAST_PMAP_MAX_BYTES - nr_bytes;
+
+	if (offset == buffer->start) {
+		buffer->start += unused;
+		p = buffer->data + buffer->start;
+	} else {
+		p = buffer->data + offset;
+
+		memmove(p + nr_bytes, p + FAST_PMAP_MAX_BYTES, buffer->end - offset - FAST_PMAP_MAX_BYTES);
+		buffer->end -= unused;
+	}
+
+	for (i = 0; i < nr_bytes; i++)
+		p[i] = pmap->bytes[i] & 0x7F;
+
+	p[nr_bytes - 1] |= 0x80;
+}
+
+/* Whatever a visitor returns to stop, decoding fails the same way */
+static __always_inline int fast_visitor_stop(int ret)
+{
+	return ret ? FAST_MSG_STATE_STOPPED : 0;
+}
+
+static __always_inline int fast_visit_empty(struct fast_message *msg, unsigned long i)
+{
+	const struct fast_visitor *visitor = msg->visitor;
+
+	if (!visitor->on_empty)
+		return 0;
+
+	return fast_visitor_stop(visitor->on_empty(msg->visitor_data, i));
+}
+
+static __always_inline int fast_visit_int(struct fast_message *msg, unsigned long i, struct fast_field *field)
+{
+	const struct fast_visitor *visitor = msg->visitor;
+
+	if (field_state_empty(field))
+		return fast_visit_empty(msg, i);
+
+	if (!visitor->on_int)
+		return 0;
+
+	return fast_visitor_stop(visitor->on_int(msg->visitor_data, i, field->int_value));
+}
+
+static __always_inline int fast_visit_uint(struct fast_message *msg, unsigned long i, struct fast_field *field)
+{
+	const struct fast_visitor *visitor = msg->visitor;
+
+	if (field_state_empty(field))
+		return fast_visit_empty(msg, i);
+
+	if (!visitor->on_uint)
+		return 0;
+
+	return fast_visitor_stop(visitor->on_uint(msg->visitor_data, i, field->uint_value));
+}
+
+static __always_inline int fast_visit_decimal(struct fast_message *msg, unsigned long i, struct fast_field *field)
+{
+	const struct fast_visitor *visitor = msg->visitor;
+
+	if (field_state_empty(field))
+		return fast_visit_empty(msg, i);
+
+	if (!visitor->on_decimal)
+		return 0;
+
+	return fast_visitor_stop(visitor->on_decimal(msg->visitor_data, i, field->decimal_value.exp, field->decimal_value.mnt));
+}
+
+static __always_inline int fast_visit_string(struct fast_message *msg, unsigned long i, struct fast_field *field)
+{
+	const struct fast_visitor *visitor = msg->visitor;
+
+	if (field_state_empty(field))
+		return fast_visit_empty(msg, i);
+
+	if (!visitor->on_string)
+		return 0;
+
+	return fast_visitor_stop(visitor->on_string(msg->visitor_data, i, field->string_value, field->string_len));
+}
+
+static __always_inline int fast_visit_sequence_begin(struct fast_message *msg, unsigned long i, unsigned long length)
+{
+	const struct fast_visitor *visitor = msg->visitor;
+
+	if (!visitor->on_sequence_begin)
+		return 0;
+
+	return fast_visitor_stop(visitor->on_sequence_begin(msg->visitor_data, i, length));
+}
+
+static __always_inline int fast_visit_sequence_end(struct fast_message *msg, unsigned long i)
+{
+	const struct fast_visitor *visitor = msg->visitor;
+
+	if (!visitor->on_sequence_end)
+		return 0;
+
+	return fast_visitor_stop(visitor->on_sequence_end(msg->visitor_data, i));
+}
+
+/*
+ * Spreads the low 56 bits of value over eight bytes, seven bits a byte, in
+ * three steps: halves, quarters and then bytes of seven bits each.
+ */
+static __always_inline u64 fast_stop_bit_spread(u64 value)
+{
+	value = (value & 0x000000000fffffffULL) | ((value << 4) & 0x0fffffff00000000ULL);
+	value = (value & 0x00003fff00003fffULL) | ((value << 2) & 0x3fff00003fff0000ULL);
+	value = (value & 0x007f007f007f007fULL) | ((value << 1) & 0x7f007f007f007f00ULL);
+
+	return value;
+}
+
+/*
+ * Writes the size low seven bit groups of value, the most significant one
+ * first and the stop bit on the last, with a single eight byte store when
+ * the buffer has room to spare.
+ */
+static __always_inline int fast_put_stop_bit(struct buffer *buffer, u64 value, int size)
+{
+	u64 word;
+
+	if (size == FAST_INT_MAX_BYTES) {
+		if (buffer_remaining(buffer) < FAST_INT_MAX_BYTES)
+			return -1;
+
+		buffer_put(buffer, (value >> 56) & 0x7F);
+		size--;
+	}
+
+	word = __builtin_bswap64(fast_stop_bit_spread(value) | 0x80) >> (8 * (8 - size));
+	word = htole64(word);
+
+	if (likely(buffer_remaining(buffer) >= sizeof(word)))
+		memcpy(buffer_end(buffer), &word, sizeof(word));
+	else if (buffer_remaining(buffer) >= size)
+		memcpy(buffer_end(buffer), &word, size);
+	else
+		return -1;
+
+	buffer->end += size;
+
+	return 0;
+}
+
+static inline int transfer_int(struct buffer *buffer, i64 tmp)
+{
+	return fast_put_stop_bit(buffer, tmp, transfer_size_int(tmp));
+}
+
+static __always_inline int fast_encode_int(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	i64 tmp = field->int_value;
+	bool pset = true;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		pset = false;
+
+		if (!mandatory) {
+			tmp = tmp >= 0 ? tmp + 1 : tmp;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		goto transfer;
+	case FAST_OP_COPY:
+		if (!mandatory) {
+			tmp = tmp >= 0 ? tmp + 1 : tmp;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		switch (field->state) {
+		case FAST_STATE_UNDEFINED:
+			field->state = FAST_STATE_ASSIGNED;
+			goto transfer;
+		case FAST_STATE_ASSIGNED:
+			if (!field_state_assigned_previous(field))
+				goto transfer;
+
+			if (field->int_value != field->int_previous)
+				goto transfer;
+
+			break;
+		case FAST_STATE_EMPTY:
+			goto fail;
+		default:
+			goto fail;
+		}
+
+		break;
+	case FAST_OP_INCR:
+		if (!mandatory) {
+			tmp = tmp >= 0 ? tmp + 1 : tmp;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		switch (field->state) {
+		case FAST_STATE_UNDEFINED:
+			field->state = FAST_STATE_ASSIGNED;
+			goto transfer;
+		case FAST_STATE_ASSIGNED:
+			if (!field_state_assigned_previous(field))
+				goto transfer;
+
+			if (field->int_value != field->int_previous + 1)
+				goto transfer;
+
+			field->int_previous++;
+
+			break;
+		case FAST_STATE_EMPTY:
+			goto fail;
+		default:
+			goto fail;
+		}
+
+		break;
+	case FAST_OP_DELTA:
+		tmp = field->int_value - field->int_previous;
+		pset = false;
+
+		if (!mandatory) {
+			tmp = tmp >= 0 ? tmp + 1 : tmp;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		goto transfer;
+	case FAST_OP_CONSTANT:
+		if (!mandatory) {
+			if (!field_state_empty(field))
+				pmap_set(pmap, bit);
+			else
+				break;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		break;
+	case FAST_OP_TAIL:
+	default:
+		goto fail;
+	};
+
+	return 0;
+
+empty:
+	tmp = 0;
+	field->int_value = field->int_previous;
+
+transfer:
+	field->int_previous = field->int_value;
+	field->state_previous = field->state;
+
+	if (transfer_int(buffer, tmp))
+		goto fail;
+
+	if (pset)
+		pmap_set(pmap, bit);
+
+	return 0;
+
+fail:
+	return -1;
+}
+
+static inline int transfer_uint(struct buffer *buffer, u64 tmp)
+{
+	return fast_put_stop_bit(buffer, tmp, transfer_size_uint(tmp));
+}
+
+static __always_inline int fast_encode_uint(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	u64 tmp = field->uint_value;
+	bool pset = true;
+	i64 delta = 0;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		pset = false;
+
+		if (!mandatory) {
+			tmp += 1;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		goto transfer;
+	case FAST_OP_COPY:
+		if (!mandatory) {
+			tmp += 1;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		switch (field->state) {
+		case FAST_STATE_UNDEFINED:
+			field->state = FAST_STATE_ASSIGNED;
+			goto transfer;
+		case FAST_STATE_ASSIGNED:
+			if (!field_state_assigned_previous(field))
+				goto transfer;
+
+			if (field->uint_value != field->uint_previous)
+				goto transfer;
+
+			break;
+		case FAST_STATE_EMPTY:
+			goto fail;
+		default:
+			goto fail;
+		}
+
+		break;
+	case FAST_OP_INCR:
+		if (!mandatory) {
+			tmp += 1;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		switch (field->state) {
+		case FAST_STATE_UNDEFINED:
+			field->state = FAST_STATE_ASSIGNED;
+			goto transfer;
+		case FAST_STATE_ASSIGNED:
+			if (!field_state_assigned_previous(field))
+				goto transfer;
+
+			if (field->uint_value != field->uint_previous + 1)
+				goto transfer;
+
+			field->uint_previous++;
+
+			break;
+		case FAST_STATE_EMPTY:
+			goto fail;
+		default:
+			goto fail;
+		}
+
+		break;
+	case FAST_OP_DELTA:
+		delta = field->uint_value - field->uint_previous;
+		pset = false;
+
+		if (!mandatory) {
+			delta = delta >= 0 ? delta + 1 : delta;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+		tmp = delta;
+
+		goto transfer;
+	case FAST_OP_CONSTANT:
+		if (!mandatory) {
+			if (!field_state_empty(field))
+				pmap_set(pmap, bit);
+			else
+				break;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		break;
+	case FAST_OP_TAIL:
+	default:
+		goto fail;
+	};
+
+	return 0;
+
+empty:
+	tmp = 0;
+	field->uint_value = field->uint_previous;
+
+transfer:
+	field->uint_previous = field->uint_value;
+	field->state_previous = field->state;
+
+	if (op != FAST_OP_DELTA) {
+		if (transfer_uint(buffer, tmp))
+			goto fail;
+	} else {
+		if (transfer_int(buffer, tmp))
+			goto fail;
+	}
+
+	if (pset)
+		pmap_set(pmap, bit);
+
+	return 0;
+
+fail:
+	return -1;
+}
+
+/* The last character carries the stop bit, see fast_read_ascii() */
+static inline int transfer_string(struct buffer *buffer, const char *value, unsigned long len, bool mandatory)
+{
+	if (!value)
+		goto null;
+
+	if (!len) {
+		if (mandatory)
+			goto null;
+
+		if (buffer_remaining(buffer) < 1)
+			goto fail;
+
+		buffer_put(buffer, 0x00);
+
+		goto null;
+	}
+
+	if (buffer_remaining(buffer) < len)
+		goto fail;
+
+	memcpy(buffer_end(buffer), value, len);
+	buffer->end += len;
+
+	buffer->data[buffer->end - 1] |= 0x80;
+
+	return 0;
+
+null:
+	if (buffer_remaining(buffer) < 1)
+		goto fail;
+
+	buffer_put(buffer, 0x80);
+
+	return 0;
+
+fail:
+	return -1;
+}
+
+static inline int transfer_bytes(struct buffer *buffer, const char *value, unsigned long len, bool mandatory)
+{
+	if (!value)
+		return transfer_uint(buffer, 0);
+
+	if (transfer_uint(buffer, mandatory ? len : len + 1))
+		return -1;
+
+	if (buffer_remaining(buffer) < len)
+		return -1;
+
+	memcpy(buffer_end(buffer), value, len);
+	buffer->end += len;
+
+	return 0;
+}
+
+static inline unsigned long fast_common_prefix(const char *a, const char *b, unsigned long len)
+{
+	unsigned long i;
+
+	for (i = 0; i < len && a[i] == b[i]; i++)
+		;
+
+	return i;
+}
+
+static inline unsigned long fast_common_suffix(const char *a, unsigned long a_len, const char *b, unsigned long b_len)
+{
+	unsigned long len = a_len < b_len ? a_len : b_len;
+	unsigned long i;
+
+	for (i = 0; i < len && a[a_len - 1 - i] == b[b_len - 1 - i]; i++)
+		;
+
+	return i;
+}
+
+/*
+ * Sends whichever of the deltas at the back and at the front of the
+ * previous value is shorter, see fast_read_delta(), and only copies the
+ * characters that changed to the previous value.
+ */
+static __always_inline int fast_encode_delta(struct buffer *buffer, struct fast_field *field, bool mandatory)
+{
+	const char *value = field->string_value;
+	unsigned long len = field->string_len;
+	char *previous = field->string_previous;
+	unsigned long previous_len = field->string_previous_len;
+	unsigned long prefix, suffix;
+	i64 sub;
+	int ret;
+
+	if (!mandatory && field_state_empty(field)) {
+		field->state_previous = field->state;
+
+		return transfer_int(buffer, 0);
+	}
+
+	if (len >= field->string_size)
+		return -1;
+
+	prefix = fast_common_prefix(value, previous, len < previous_len ? len : previous_len);
+	suffix = fast_common_suffix(value, len, previous, previous_len);
+
+	if (suffix > prefix)
+		sub = -(i64) (previous_len - suffix) - 1;
+	else
+		sub = previous_len - prefix;
+
+	if (!mandatory && sub >= 0)
+		sub++;
+
+	if (transfer_int(buffer, sub))
+		return -1;
+
+	if (suffix > prefix) {
+		if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE))
+			ret = transfer_bytes(buffer, value, len - suffix, true);
+		else
+			ret = transfer_string(buffer, value, len - suffix, true);
+
+		memcpy(previous, value, len);
+	} else {
+		if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE))
+			ret = transfer_bytes(buffer, value + prefix, len - prefix, true);
+		else
+			ret = transfer_string(buffer, value + prefix, len - prefix, true);
+
+		memcpy(previous + prefix, value + prefix, len - prefix);
+	}
+
+	previous[len] = '\0';
+	field->string_previous_len = len;
+
+	field->state = FAST_STATE_ASSIGNED;
+	field->state_previous = field->state;
+
+	return ret;
+}
+
+/*
+ * Sends what differs at the back of the value, or all of it if it is
+ * longer than the previous one. A tail cannot make the value shorter.
+ */
+static __always_inline int fast_encode_tail(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					    bool mandatory, unsigned long bit)
+{
+	const char *value = field->string_value;
+	unsigned long len = field->string_len;
+	char *previous = field->string_previous;
+	unsigned long prefix = 0;
+	unsigned long base_len;
+	const char *base;
+	int ret;
+
+	if (!mandatory && field_state_empty(field)) {
+		value = NULL;
+		len = 0;
+		goto transfer;
+	}
+
+	if (len >= field->string_size)
+		return -1;
+
+	if (field_state_assigned_previous(field)) {
+		base = previous;
+		base_len = field->string_previous_len;
+	} else {
+		base = field_has_reset_value(field) ? field->string_reset : "";
+		base_len = strlen(base);
+	}
+
+	if (len < base_len)
+		return -1;
+
+	if (len == base_len) {
+		prefix = fast_common_prefix(value, base, len);
+
+		if (prefix == len && field_state_assigned_previous(field)) {
+			field->state = FAST_STATE_ASSIGNED;
+			return 0;
+		}
+	}
+
+	if (base == previous)
+		memcpy(previous + prefix, value + prefix, len - prefix);
+	else
+		memcpy(previous, value, len);
+
+	previous[len] = '\0';
+	field->string_previous_len = len;
+
+	field->state = FAST_STATE_ASSIGNED;
+
+transfer:
+	field->state_previous = field->state;
+
+	if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE))
+		ret = transfer_bytes(buffer, value ? value + prefix : NULL, len - prefix, mandatory);
+	else
+		ret = transfer_string(buffer, value ? value + prefix : NULL, len - prefix, mandatory);
+
+	if (ret)
+		return -1;
+
+	pmap_set(pmap, bit);
+
+	return 0;
+}
+
+static __always_inline int fast_encode_string(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	const char *value = field->string_value;
+	unsigned long len = field->string_len;
+	bool pset = true;
+	int ret;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		pset = false;
+
+		if (!mandatory) {
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		goto transfer;
+	case FAST_OP_COPY:
+		if (!mandatory) {
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		switch (field->state) {
+		case FAST_STATE_UNDEFINED:
+			field->state = FAST_STATE_ASSIGNED;
+			goto transfer;
+		case FAST_STATE_ASSIGNED:
+			if (!field_state_assigned_previous(field))
+				goto transfer;
+
+			if (len != field->string_previous_len ||
+			    memcmp(value, field->string_previous, len))
+				goto transfer;
+
+			break;
+		case FAST_STATE_EMPTY:
+			goto fail;
+		default:
+			goto fail;
+		}
+
+		break;
+	case FAST_OP_INCR:
+		goto fail;
+	case FAST_OP_DELTA:
+		return fast_encode_delta(buffer, field, mandatory);
+	case FAST_OP_TAIL:
+		return fast_encode_tail(buffer, pmap, field, mandatory, bit);
+	case FAST_OP_CONSTANT:
+		if (!mandatory) {
+			if (!field_state_empty(field))
+				pmap_set(pmap, bit);
+			else
+				break;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		break;
+	default:
+		goto fail;
+	};
+
+	return 0;
+
+empty:
+	value = NULL;
+	len = 0;
+
+transfer:
+	/* Only the copy operator looks at the previous value */
+	if (op == FAST_OP_COPY && value) {
+		if (len >= field->string_size)
+			goto fail;
+
+		memcpy(field->string_previous, value, len);
+		field->string_previous[len] = '\0';
+		field->string_previous_len = len;
+	}
+
+	field->state_previous = field->state;
+
+	if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE))
+		ret = transfer_bytes(buffer, value, len, mandatory);
+	else
+		ret = transfer_string(buffer, value, len, mandatory);
+
+	if (ret)
+		goto fail;
+
+	if (pset)
+		pmap_set(pmap, bit);
+
+	return 0;
+
+fail:
+	return -1;
+}
+
+static __always_inline int fast_encode_decimal(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+					   enum fast_op op, bool mandatory, unsigned long bit)
+{
+	i64 exp = field->decimal_value.exp;
+	i64 mnt = field->decimal_value.mnt;
+
+	bool pset = true;
+	bool empty = false;
+
+	switch (op) {
+	case FAST_OP_NONE:
+		pset = false;
+
+		if (!mandatory) {
+			exp = exp >= 0 ? exp + 1 : exp;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		goto transfer;
+	case FAST_OP_COPY:
+		if (!mandatory) {
+			exp = exp >= 0 ? exp + 1 : exp;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		switch (field->state) {
+		case FAST_STATE_UNDEFINED:
+			field->state = FAST_STATE_ASSIGNED;
+			goto transfer;
+		case FAST_STATE_ASSIGNED:
+			if (!field_state_assigned_previous(field))
+				goto transfer;
+
+			if ((field->decimal_value.exp != field->decimal_previous.exp) ||
+				(field->decimal_value.mnt != field->decimal_previous.mnt))
+				goto transfer;
+
+			break;
+		case FAST_STATE_EMPTY:
+			goto fail;
+		default:
+			goto fail;
+		}
+
+		break;
+	case FAST_OP_INCR:
+		/* Not applicable to decimal */
+		break;
+	case FAST_OP_DELTA:
+		exp = field->decimal_value.exp - field->decimal_previous.exp;
+		mnt = field->decimal_value.mnt - field->decimal_previous.mnt;
+		pset = false;
+
+		if (!mandatory) {
+			exp = exp >= 0 ? exp + 1 : exp;
+
+			if (field_state_empty(field))
+				goto empty;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		goto transfer;
+	case FAST_OP_CONSTANT:
+		if (!mandatory) {
+			if (!field_state_empty(field))
+				pmap_set(pmap, bit);
+			else
+				break;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+
+		break;
+	case FAST_OP_TAIL:
+	default:
+		goto fail;
+	};
+
+	return 0;
+
+empty:
+	exp = 0;
+	empty = true;
+
+transfer:
+	if (!empty) {
+		field->decimal_previous.exp = field->decimal_value.exp;
+		field->decimal_previous.mnt = field->decimal_value.mnt;
+	}
+	field->state_previous = field->state;
+
+	if (transfer_int(buffer, exp))
+		goto fail;
+
+	if (!empty && transfer_int(buffer, mnt))
+		goto fail;
+
+	if (pset)
+		pmap_set(pmap, bit);
+
+	return 0;
+
+fail:
+	return -1;
+}
+
+static __always_inline int fast_encode_decimal_parts(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field,
+						 enum fast_op exp_op, bool mandatory, unsigned long exp_bit,
+						 enum fast_op mnt_op, unsigned long mnt_bit)
+{
+	struct fast_decimal_parts *parts = field_decimal_parts(field);
+
+	parts->exponent.state		= field->state;
+	parts->exponent.int_value	= field->decimal_value.exp;
+
+	if (fast_encode_int(buffer, pmap, &parts->exponent, exp_op, mandatory, exp_bit))
+		return -1;
+
+	if (field_state_empty(field))
+		return 0;
+
+	parts->mantissa.state		= FAST_STATE_ASSIGNED;
+	parts->mantissa.int_value	= field->decimal_value.mnt;
+
+	return fast_encode_int(buffer, pmap, &parts->mantissa, mnt_op, true, mnt_bit);
+}
+
+/*
+ * A field that shares its dictionary entry takes the entry's state and
+ * value before its operator runs and puts them back after it. Decoders
+ * keep their dictionary in the field's value, encoders in the previous
+ * value, see struct fast_field.
+ */
+static __always_inline struct fast_dict_entry *fast_dict_entry(struct fast_dictionary *dict, struct fast_field *field)
+{
+	return dict->entries + field->slot;
+}
+
+static __always_inline int fast_dict_load(struct fast_dictionary *dict, struct fast_field *field)
+{
+	struct fast_dict_entry *entry = fast_dict_entry(dict, field);
+
+	field->state = entry->state;
+
+	if (field->type != FAST_TYPE_STRING) {
+		field->decimal_value = entry->decimal_value;
+		return 0;
+	}
+
+	if (entry->string_len >= field->string_size)
+		return FAST_MSG_STATE_GARBLED;
+
+	memcpy(field->string_buf, entry->string_value, entry->string_len + 1);
+
+	field->string_value	= field->string_buf;
+	field->string_len	= entry->string_len;
+
+	return 0;
+}
+
+static __always_inline void fast_dict_store(struct fast_dictionary *dict, struct fast_field *field)
+{
+	struct fast_dict_entry *entry = fast_dict_entry(dict, field);
+
+	entry->state = field->state;
+
+	if (field->type != FAST_TYPE_STRING) {
+		entry->decimal_value = field->decimal_value;
+		return;
+	}
+
+	/* Unicode values may be views, which are not NUL terminated */
+	memcpy(entry->string_value, field->string_value, field->string_len);
+	entry->string_value[field->string_len] = '\0';
+	entry->string_len = field->string_len;
+}
+
+static __always_inline int fast_dict_load_previous(struct fast_dictionary *dict, struct fast_field *field)
+{
+	struct fast_dict_entry *entry = fast_dict_entry(dict, field);
+
+	field->state_previous = entry->state;
+
+	if (field->type != FAST_TYPE_STRING) {
+		field->decimal_previous = entry->decimal_value;
+		return 0;
+	}
+
+	if (entry->string_len >= field->string_size)
+		return -1;
+
+	memcpy(field->string_previous, entry->string_value, entry->string_len + 1);
+	field->string_previous_len = entry->string_len;
+
+	return 0;
+}
+
+static __always_inline void fast_dict_store_previous(struct fast_dictionary *dict, struct fast_field *field)
+{
+	struct fast_dict_entry *entry = fast_dict_entry(dict, field);
+
+	entry->state = field->state_previous;
+
+	if (field->type != FAST_TYPE_STRING) {
+		entry->decimal_value = field->decimal_previous;
+		return;
+	}
+
+	memcpy(entry->string_value, field->string_previous, field->string_previous_len + 1);
+	entry->string_len = field->string_previous_len;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef LIBTRADING_FAST_DECIMAL_H
+#define LIBTRADING_FAST_DECIMAL_H
+
+#include "libtrading/proto/fast_message.h"
+#include "libtrading/types.h"
+
+/*
+ * Conversions of FAST decimals, mnt * 10^exp, to the fixed point and
+ * floating point prices that market data handlers keep. Powers of ten
+ * come from tables rather than pow().
+ */
+
+/* 10^19 is the largest power of ten that fits in a u64 */
+#define	FAST_POW10_MAX			19
+
+/* Powers of ten up to 10^22 are exact doubles */
+#define	FAST_POW10_DOUBLE_MAX		22
+
+/* Largest mantissa that converts to a double without rounding */
+#define	FAST_DOUBLE_MANTISSA_MAX	(1LL << 53)
+
+extern const u64 fast_pow10[FAST_POW10_MAX + 1];
+extern const double fast_pow10_double[FAST_POW10_DOUBLE_MAX + 1];
+
+double fast_decimal_to_double_slow(const struct fast_decimal *decimal);
+
+/*
+ * Rescales the decimal to a fixed point value in units of 10^exp, the
+ * tick of an instrument. Fails if the value does not fit in an i64 or has
+ * digits below the tick.
+ */
+static inline int fast_decimal_to_fixed(const struct fast_decimal *decimal, i64 exp, i64 *value)
+{
+	i64 mnt = decimal->mnt;
+	i64 shift = decimal->exp - exp;
+	i64 pow;
+
+	if (!shift) {
+		*value = mnt;
+		return 0;
+	}
+
+	if (!mnt) {
+		*value = 0;
+		return 0;
+	}
+
+	if (shift > 0) {
+		if (shift >= FAST_POW10_MAX)
+			return -1;
+
+		if (__builtin_mul_overflow(mnt, (i64) fast_pow10[shift], value))
+			return -1;
+
+		return 0;
+	}
+
+	if (-shift >= FAST_POW10_MAX)
+		return -1;
+
+	pow = fast_pow10[-shift];
+
+	if (mnt % pow)
+		return -1;
+
+	*value = mnt / pow;
+
+	return 0;
+}
+
+/*
+ * Rounds the decimal to the nearest double. A mantissa below 2^53 and a
+ * power of ten up to 10^22 are both exact doubles, so one multiplication
+ * or division rounds correctly. Anything else goes through strtod().
+ */
+static inline double fast_decimal_to_double(const struct fast_decimal *decimal)
+{
+	i64 mnt = decimal->mnt;
+	i64 exp = decimal->exp;
+
+	if (likely(mnt <= FAST_DOUBLE_MANTISSA_MAX && mnt >= -FAST_DOUBLE_MANTISSA_MAX)) {
+		if (exp >= 0 && exp <= FAST_POW10_DOUBLE_MAX)
+			return (double) mnt * fast_pow10_double[exp];
+
+		if (exp < 0 && exp >= -FAST_POW10_DOUBLE_MAX)
+			return (double) mnt / fast_pow10_double[-exp];
+	}
+
+	return fast_decimal_to_double_slow(decimal);
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef LIBTRADING_FAST_FEED_H
+#define LIBTRADING_FAST_FEED_H
+
+#include "libtrading/types.h"
+
+#include <stdbool.h>
+
+struct fast_session;
+struct fast_message;
+struct fast_feed_packet;
+struct mmsghdr;
+
+/* Datagrams read from a line with one recvmmsg() */
+#define	FAST_FEED_BATCH			32
+#define	FAST_FEED_PACKET_SIZE		2048
+
+/* Every packet starts with a little endian 32-bit sequence number */
+#define	FAST_FEED_SEQ_SIZE		4
+
+/* How far behind a line may lag before going back is taken for a restart */
+#define	FAST_FEED_SEQ_WINDOW		(1UL << 16)
+
+/* Reset the dictionaries at the start of every packet */
+#define	FAST_FEED_FLAGS_PACKET_RESET	0x00000001
+
+enum fast_feed_line {
+	FAST_FEED_LINE_A,
+	FAST_FEED_LINE_B,
+
+	FAST_FEED_LINES,
+};
+
+struct fast_feed_stats {
+	unsigned long			nr_packets[FAST_FEED_LINES];
+	unsigned long			nr_wins[FAST_FEED_LINES];	/* sequence number seen first on the line */
+	unsigned long			nr_duplicates;			/* already seen on the other line */
+	unsigned long			nr_gaps;
+	unsigned long			nr_lost;			/* missing from both lines */
+	unsigned long			nr_messages;
+	unsigned long			nr_errors;			/* truncated or garbled packets */
+	unsigned long			nr_oversized;			/* cut off by the receive buffer */
+	unsigned long			nr_restarts;			/* sequence numbers started over */
+};
+
+/*
+ * Receives a FAST feed that is published twice, on the A and B multicast
+ * lines. Packets are arbitrated by their sequence number: the first copy to
+ * arrive is decoded with the session's templates and handed to the handler,
+ * later copies are dropped. A publisher that restarts, or whose sequence
+ * numbers wrap around, starts the arbitration and the dictionaries over.
+ */
+struct fast_feed {
+	struct fast_session		*session;
+	int				sockfd[FAST_FEED_LINES];
+	int				flags;
+
+	/* Next expected sequence number, zero until the first packet */
+	u64				next_seq;
+
+	/* Last sequence number seen on each line */
+	u64				line_seq[FAST_FEED_LINES];
+
+	int				(*handler)(struct fast_feed *, struct fast_message *);
+	void				*data;
+
+	struct fast_feed_stats		stats;
+
+	struct mmsghdr			*mmsg;
+	struct fast_feed_packet		*packets;
+	struct fast_feed_packet		**order;
+};
+
+struct fast_feed *fast_feed_new(struct fast_session *session);
+void fast_feed_free(struct fast_feed *self);
+int fast_feed_join(struct fast_feed *self, enum fast_feed_line line, const char *group, int port, const char *ifaddr);
+int fast_feed_poll(struct fast_feed *self, int timeout);
+int fast_feed_process(struct fast_feed *self, enum fast_feed_line line, const char *data, unsigned long len);
+
+#endif
@@ -4,24 +4,37 @@
 #include <libtrading/types.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #define	FAST_PMAP_MAX_BYTES		8
 #define	FAST_FIELD_MAX_NUMBER		128
 #define	FAST_STRING_MAX_BYTES		256
 #define	FAST_MESSAGE_MAX_SIZE		2048
 
-#define	FAST_TEMPLATE_MAX_NUMBER	128
+/* Ids below this or twice the number of templates are indexed directly */
+#define	FAST_TID_DIRECT_MIN		256
 
-#define	FAST_SEQUENCE_ELEMENTS		32
+/* Initial number of a sequence's element values, it grows on demand */
+#define	FAST_SEQUENCE_ELEMENTS		8
+
+/* Longer sequences are taken as garbled rather than allocated */
+#define	FAST_SEQUENCE_MAX_ELEMENTS	65536
 
 #define	FAST_MSG_STATE_GARBLED	(-1)
+#define	FAST_MSG_STATE_TRUNCATED	(-2)
+/* A visitor stopped decoding, the stream is fine */
+#define	FAST_MSG_STATE_STOPPED	(-3)
 
 #define	FAST_MSG_FLAGS_RESET			0x00000001
 
 #define	FAST_FIELD_FLAGS_UNICODE		0x00000001
 #define	FAST_FIELD_FLAGS_PMAPREQ		0x00000002
+/* A decimal whose exponent and mantissa have operators of their own */
+#define	FAST_FIELD_FLAGS_DECIMAL_PARTS		0x00000004
 
+struct fast_message;
 struct buffer;
 
 enum fast_type {
@@ -38,6 +51,7 @@ enum fast_op {
 	FAST_OP_INCR,
 	FAST_OP_DELTA,
 	FAST_OP_CONSTANT,
+	FAST_OP_TAIL,
 };
 
 enum fast_presence {
@@ -61,32 +75,51 @@ struct fast_decimal {
 	i64			mnt;
 };
 
+/*
+ * Fields are kept small so that a template's dictionary stays in a few
+ * cache lines. String values live in the template's string arena and the
+ * field only points at them. A string value is string_len bytes long and
+ * NUL terminated when it is in the arena; unicode strings and byte vectors
+ * decoded from a datagram point straight into it instead and are not.
+ */
 struct fast_field {
 	enum fast_presence	presence;
 	enum fast_type		type;
 	enum fast_op		op;
 
-	unsigned long		pmap_bit;
-
 	enum fast_state		state;
 	enum fast_state		state_previous;
 
-	bool			has_reset;
 	int			flags;
+	unsigned int		pmap_bit;
+
+	/* Size of each string buffer, including the terminating NUL */
+	unsigned int		string_size;
+	unsigned int		string_len;
+
+	/* Dictionary entry shared with other fields, zero if there is none */
+	unsigned int		slot;
+
+	bool			has_reset;
 
 	union {
 		i64			int_value;
 		u64			uint_value;
 		void			*ptr_value;
-		char			string_value[FAST_STRING_MAX_BYTES];
 		struct fast_decimal	decimal_value;
+
+		struct {
+			char		*string_value;
+			/* The field's own buffer in the arena */
+			char		*string_buf;
+		};
 	};
 
 	union {
 		i64			int_reset;
 		u64			uint_reset;
 		void			*ptr_reset;
-		char			string_reset[FAST_STRING_MAX_BYTES];
+		char			*string_reset;
 		struct fast_decimal	decimal_reset;
 	};
 
@@ -94,9 +127,78 @@ struct fast_field {
 		i64			int_previous;
 		u64			uint_previous;
 		void			*ptr_previous;
-		char			string_previous[FAST_STRING_MAX_BYTES];
 		struct fast_decimal	decimal_previous;
+
+		struct {
+			char		*string_previous;
+			unsigned long	string_previous_len;
+		};
+	};
+};
+
+/*
+ * The exponent of a decimal with FAST_FIELD_FLAGS_DECIMAL_PARTS is coded
+ * as an int32 field that is NULL when the decimal is, the mantissa as an
+ * int64 field that only follows an exponent that is not. The two keep
+ * their own operators, pmap bits and dictionaries in the fields below,
+ * which the decimal's ptr_reset points to.
+ */
+struct fast_decimal_parts {
+	struct fast_field	exponent;
+	struct fast_field	mantissa;
+};
+
+static inline struct fast_decimal_parts *field_decimal_parts(struct fast_field *field)
+{
+	return field->ptr_reset;
+}
+
+/*
+ * Dictionary entries that fields share by their key, in the global, the
+ * template, the type or a named dictionary. Fields are resolved to a slot
+ * of the flat entry array when the templates are loaded. A field whose key
+ * no other field has keeps its dictionary to itself, so slot zero is never
+ * used.
+ */
+struct fast_dict_entry {
+	enum fast_type		type;
+	enum fast_state		state;
+
+	unsigned int		string_size;
+	unsigned int		string_len;
+
+	u64			generation;
+
+	union {
+		i64			int_value;
+		u64			uint_value;
+		struct fast_decimal	decimal_value;
 	};
+
+	char			*string_value;
+};
+
+struct fast_dictionary {
+	/* Moves on to reset every template's dictionary */
+	u64			generation;
+
+	unsigned long		nr_slots;
+	struct fast_dict_entry	*entries;
+	char			*strings;
+};
+
+/*
+ * The dictionary values of a template as they were before the message that
+ * is being decoded, which are put back if it fails. Fields that share an
+ * entry have the entry saved instead.
+ */
+struct fast_shadow {
+	unsigned long		nr_fields;
+	unsigned long		nr_scalars;	/* first */
+	unsigned long		nr_strings;	/* next, and the shared entries last */
+	struct fast_field	**fields;
+	struct fast_dict_entry	*values;
+	char			*strings;
 };
 
 static inline bool field_state_empty(struct fast_field *field)
@@ -109,6 +211,12 @@ static inline bool field_state_empty_previous(struct fast_field *field)
 	return field->state_previous == FAST_STATE_EMPTY;
 }
 
+/* Nothing to compare against when the previous value was never sent */
+static inline bool field_state_assigned_previous(struct fast_field *field)
+{
+	return field->state_previous == FAST_STATE_ASSIGNED;
+}
+
 static inline void field_set_empty(struct fast_field *field)
 {
 	field->state = FAST_STATE_EMPTY;
@@ -116,6 +224,56 @@ static inline void field_set_empty(struct fast_field *field)
 	return;
 }
 
+static inline int field_set_string(struct fast_field *field, const char *value, unsigned long len)
+{
+	if (len >= field->string_size)
+		return -1;
+
+	memcpy(field->string_buf, value, len);
+	field->string_buf[len] = '\0';
+
+	field->string_value	= field->string_buf;
+	field->string_len	= len;
+	field->state		= FAST_STATE_ASSIGNED;
+
+	return 0;
+}
+
+/* Views into a datagram stay valid for as long as the message does */
+static inline void field_copy_string(struct fast_field *dst, struct fast_field *src)
+{
+	if (src->string_value == src->string_buf) {
+		memcpy(dst->string_buf, src->string_value, src->string_len + 1);
+		dst->string_value = dst->string_buf;
+	} else
+		dst->string_value = src->string_value;
+
+	dst->string_len = src->string_len;
+}
+
+static inline void field_copy_value(struct fast_field *dst, struct fast_field *src)
+{
+	switch (src->type) {
+	case FAST_TYPE_INT:
+		dst->int_value = src->int_value;
+		break;
+	case FAST_TYPE_UINT:
+		dst->uint_value = src->uint_value;
+		break;
+	case FAST_TYPE_STRING:
+		field_copy_string(dst, src);
+		break;
+	case FAST_TYPE_DECIMAL:
+		dst->decimal_value = src->decimal_value;
+		break;
+	case FAST_TYPE_SEQUENCE:
+	default:
+		break;
+	}
+
+	dst->state = src->state;
+}
+
 static inline bool field_is_mandatory(struct fast_field *field)
 {
 	return field->presence == FAST_PRESENCE_MANDATORY;
@@ -152,6 +310,32 @@ static inline int field_has_flags(struct fast_field *field, int flags)
 	return field->flags & flags;
 }
 
+/*
+ * Streaming decode. A template with a visitor hands every value to it as
+ * soon as the value is decoded, so that the application can fill in its
+ * own structures. Fields are numbered by their position in the template,
+ * or in the sequence element between on_sequence_begin and on_sequence_end,
+ * and absent optional fields go to on_empty. String values are only valid
+ * during the callback. Sequence elements are not stored in the message.
+ * Any callback may be NULL, a non-zero return value stops decoding, which
+ * then fails with FAST_MSG_STATE_STOPPED. The message is left half decoded
+ * and is not rolled back, whatever the visitor needs to know why it stopped
+ * is up to its data.
+ */
+struct fast_visitor {
+	int			(*on_message)(void *data, struct fast_message *msg);
+	int			(*on_message_end)(void *data, struct fast_message *msg);
+
+	int			(*on_int)(void *data, unsigned long field, i64 value);
+	int			(*on_uint)(void *data, unsigned long field, u64 value);
+	int			(*on_decimal)(void *data, unsigned long field, i64 exp, i64 mnt);
+	int			(*on_string)(void *data, unsigned long field, const char *value, unsigned long len);
+	int			(*on_empty)(void *data, unsigned long field);
+
+	int			(*on_sequence_begin)(void *data, unsigned long field, unsigned long length);
+	int			(*on_sequence_end)(void *data, unsigned long field);
+};
+
 struct fast_message {
 	unsigned long		nr_fields;
 	struct fast_field	*fields;
@@ -161,8 +345,25 @@ struct fast_message {
 	int			flags;
 	unsigned long		tid;
 
-	struct buffer		*pmap_buf;
 	struct buffer		*msg_buf;
+
+	/* Backing store of the string fields' values */
+	char			*strings;
+
+	/* Generated field codecs, NULL when the template is interpreted */
+	int			(*decode)(struct buffer *, struct fast_pmap *, struct fast_message *);
+	int			(*encode)(struct buffer *, struct fast_pmap *, struct fast_message *);
+	int			(*visit)(struct buffer *, struct fast_pmap *, struct fast_message *);
+
+	const struct fast_visitor *visitor;
+	void			*visitor_data;
+
+	/* The template's dictionary is stale when this lags behind the session's */
+	u64			generation;
+	struct fast_dictionary	*dictionary;
+
+	/* Built the first time the template is decoded */
+	struct fast_shadow	shadow;
 };
 
 static inline void fast_msg_set_flags(struct fast_message *msg, int flags)
@@ -191,11 +392,74 @@ static inline int fast_msg_has_flags(struct fast_message *msg, int flags)
 	return msg->flags & flags;
 }
 
+/*
+ * Resetting a session only moves the generation of its dictionary on, a
+ * template resets its dictionary the first time it is used after that.
+ */
+static inline bool fast_message_stale(struct fast_message *msg)
+{
+	return msg->dictionary && msg->generation != msg->dictionary->generation;
+}
+
+/*
+ * Template id to template lookup. Dense ids index an array directly and
+ * the sparse rest goes to an open addressing hash table.
+ */
+struct fast_tid_map {
+	unsigned long		nr_direct;
+	struct fast_message	**direct;
+
+	unsigned long		hash_bits;
+	struct fast_message	**hash;
+};
+
+static inline unsigned long fast_tid_hash(u64 tid, unsigned long bits)
+{
+	return (tid * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+}
+
+static inline struct fast_message *fast_tid_lookup(struct fast_tid_map *map, u64 tid)
+{
+	struct fast_message *msg;
+	unsigned long mask;
+	unsigned long i;
+
+	if (likely(tid < map->nr_direct))
+		return map->direct[tid];
+
+	if (!map->hash)
+		return NULL;
+
+	mask = (1UL << map->hash_bits) - 1;
+
+	for (i = fast_tid_hash(tid, map->hash_bits); (msg = map->hash[i]) != NULL; i = (i + 1) & mask) {
+		if (msg->tid == tid)
+			return msg;
+	}
+
+	return NULL;
+}
+
+/*
+ * Elements are decoded and encoded through a single element template whose
+ * fields hold the operators' dictionary. The values of the elements of the
+ * last message are kept in a growable array, nr_fields fields per element,
+ * and their strings in an arena next to it.
+ */
 struct fast_sequence {
-	struct fast_field length;
-	struct fast_message elements[FAST_SEQUENCE_ELEMENTS];
+	struct fast_field	length;
+	struct fast_message	element;
+
+	unsigned long		max_elements;
+	struct fast_field	*values;
+	char			*strings;
 };
 
+static inline struct fast_field *fast_sequence_element(struct fast_sequence *seq, unsigned long i)
+{
+	return seq->values + i * seq->element.nr_fields;
+}
+
 static inline bool pmap_is_set(struct fast_pmap *pmap, unsigned long bit)
 {
 	if ((bit / 7) >= pmap->nr_bytes)
@@ -225,6 +489,7 @@ static inline int pmap_required(struct fast_field *field)
 		break;
 	case FAST_OP_COPY:
 	case FAST_OP_INCR:
+	case FAST_OP_TAIL:
 		ret = 1;
 		break;
 	case FAST_OP_NONE:
@@ -237,57 +502,60 @@ static inline int pmap_required(struct fast_field *field)
 	return ret;
 }
 
+/* Stop bit encoded integers take seven bits a byte, the sign included */
 static inline int transfer_size_int(i64 data)
 {
-	i64 tmp = data >= 0 ? data : ~data;
-
-	if (!(tmp >> 6))
-		return 1;
-	else if (!(tmp >> 13))
-		return 2;
-	else if (!(tmp >> 20))
-		return 3;
-	else if (!(tmp >> 27))
-		return 4;
-	else if (!(tmp >> 34))
-		return 5;
-	else if (!(tmp >> 41))
-		return 6;
-	else if (!(tmp >> 48))
-		return 7;
-	else if (!(tmp >> 55))
-		return 8;
-	else
-		return 9;
+	u64 tmp = data >= 0 ? data : ~data;
+	int size = (71 - __builtin_clzll(tmp | 1)) / 7;
+
+	return size < 9 ? size : 9;
 }
 
 static inline int transfer_size_uint(u64 data)
 {
-	if (!(data >> 7))
-		return 1;
-	else if (!(data >> 14))
-		return 2;
-	else if (!(data >> 21))
-		return 3;
-	else if (!(data >> 28))
-		return 4;
-	else if (!(data >> 35))
-		return 5;
-	else if (!(data >> 42))
-		return 6;
-	else if (!(data >> 49))
-		return 7;
-	else if (!(data >> 56))
-		return 8;
-	else
-		return 9;
+	int size = (70 - __builtin_clzll(data | 1)) / 7;
+
+	return size < 9 ? size : 9;
+}
+
+/*
+ * A complete datagram, such as one read with recvmmsg(). The messages are
+ * decoded from it in place with fast_packet_decode().
+ */
+struct fast_packet {
+	const char		*data;
+	unsigned long		len;
+	unsigned long		offset;
+	u64			last_tid;
+};
+
+static inline void fast_packet_init(struct fast_packet *packet, const void *data, unsigned long len)
+{
+	packet->data		= data;
+	packet->len		= len;
+	packet->offset		= 0;
+	packet->last_tid	= 0;
+}
+
+static inline bool fast_packet_empty(struct fast_packet *packet)
+{
+	return packet->offset >= packet->len;
 }
 
 struct fast_message *fast_message_new(int nr_messages);
 void fast_fields_free(struct fast_message *self);
 void fast_message_free(struct fast_message *self, int nr_messages);
+int fast_message_clone(struct fast_message *dst, struct fast_message *src, struct fast_dictionary *dict);
 void fast_message_reset(struct fast_message *msg);
-struct fast_message *fast_message_decode(struct fast_message *msgs, struct buffer *buffer, u64 last_tid);
+void fast_message_reset_dictionary(struct fast_message *msg);
+int fast_sequence_reserve(struct fast_sequence *seq, unsigned long nr_elements);
+int fast_tid_map_build(struct fast_tid_map *map, struct fast_message *msgs, unsigned long nr_messages);
+void fast_tid_map_free(struct fast_tid_map *map);
+int fast_dictionary_build(struct fast_dictionary *dict, struct fast_message *msgs, unsigned long nr_messages);
+void fast_dictionary_free(struct fast_dictionary *dict);
+int fast_dictionary_clone(struct fast_dictionary *dst, struct fast_dictionary *src);
+struct fast_message *fast_message_decode(struct fast_tid_map *map, struct buffer *buffer, u64 last_tid);
+int fast_packet_decode(struct fast_tid_map *map, struct fast_packet *packet, struct fast_message **msg);
 int fast_message_send(struct fast_message *self, int sockfd, int flags);
 int fast_message_encode(struct fast_message *msg);
 
@@ -0,0 +1,55 @@
+#ifndef LIBTRADING_FAST_PUBLISHER_H
+#define LIBTRADING_FAST_PUBLISHER_H
+
+#include "libtrading/types.h"
+
+struct fast_session;
+struct fast_message;
+struct buffer;
+
+/* Start every packet with a sequence number, as struct fast_feed expects */
+#define	FAST_PUBLISHER_FLAGS_SEQ		0x00000001
+
+/* Reset the dictionaries at the start of every packet */
+#define	FAST_PUBLISHER_FLAGS_PACKET_RESET	0x00000002
+
+struct fast_publisher_stats {
+	unsigned long			nr_packets;
+	unsigned long			nr_messages;
+	unsigned long			nr_bytes;
+	unsigned long			nr_resets;	/* reset messages sent */
+};
+
+/*
+ * Packs FAST messages encoded with the session's templates into packets of
+ * at most packet_size bytes and writes every packet to the session's socket
+ * with one write(), which makes a datagram on a connected UDP socket. The
+ * dictionaries are only ever reset at a packet boundary, so every packet
+ * decodes on its own once the receiver has reset its dictionaries too.
+ */
+struct fast_publisher {
+	struct fast_session		*session;
+	int				flags;
+	unsigned long			packet_size;
+
+	/* Sequence number of the next packet */
+	u64				next_seq;
+
+	/* A template with reset="T" that starts every reset_interval-th packet */
+	struct fast_message		*reset_msg;
+	unsigned long			reset_interval;
+
+	/* Messages in the packet that is being built, zero if none */
+	unsigned long			nr_pending;
+	struct buffer			*packet;
+
+	struct fast_publisher_stats	stats;
+};
+
+struct fast_publisher *fast_publisher_new(struct fast_session *session, unsigned long packet_size);
+void fast_publisher_free(struct fast_publisher *self);
+int fast_publisher_set_reset(struct fast_publisher *self, u64 tid, unsigned long reset_interval);
+int fast_publisher_add(struct fast_publisher *self, struct fast_message *msg);
+int fast_publisher_flush(struct fast_publisher *self);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef LIBTRADING_FAST_RECOVERY_H
+#define LIBTRADING_FAST_RECOVERY_H
+
+#include "libtrading/types.h"
+
+#include <stdbool.h>
+
+struct fast_recovery_entry;
+struct fast_message;
+struct fast_field;
+
+#define	FAST_RECOVERY_SYMBOL_LEN	32
+
+/* Initial size of the instrument table, always a power of two */
+#define	FAST_RECOVERY_INSTRUMENT_NUMBER	64
+
+#define	FAST_RECOVERY_MAX_TEMPLATES	16
+
+enum fast_instrument_state {
+	FAST_INSTRUMENT_EMPTY,		/* waiting for the first snapshot */
+	FAST_INSTRUMENT_LIVE,
+	FAST_INSTRUMENT_STALE,		/* RptSeq gap, waiting for a snapshot */
+};
+
+/*
+ * An instrument's place in the feed. Updates that cannot be applied yet
+ * are queued in the recovery's ring, oldest first, and linked through it.
+ */
+struct fast_instrument {
+	char				symbol[FAST_RECOVERY_SYMBOL_LEN];
+	enum fast_instrument_state	state;
+
+	/* RptSeq of the last update applied and of the last one received */
+	i64				rpt_seq;
+	i64				last_seen;
+
+	long				head;
+	long				tail;
+	unsigned long			nr_queued;
+
+	/* The application's book */
+	void				*data;
+};
+
+/*
+ * Where the symbol and the RptSeq are in the messages of a template, or in
+ * each element of the sequence of updates if there is one.
+ */
+struct fast_recovery_template {
+	u64				tid;
+	bool				snapshot;
+
+	long				entries;	/* -1 if the message is an update */
+	unsigned long			symbol;
+	unsigned long			rpt_seq;
+};
+
+struct fast_recovery_stats {
+	unsigned long			nr_updates;	/* applied */
+	unsigned long			nr_queued;
+	unsigned long			nr_duplicates;	/* RptSeq already received */
+	unsigned long			nr_gaps;
+	unsigned long			nr_overruns;	/* queued updates dropped from a full ring */
+	unsigned long			nr_snapshots;	/* applied */
+	unsigned long			nr_ignored;	/* snapshots no newer than the book */
+	unsigned long			nr_recovered;
+	unsigned long			nr_errors;	/* no symbol or RptSeq */
+};
+
+/*
+ * Recovers instruments of a feed that sends incremental updates on one
+ * channel and snapshots of every instrument in turn on another, as the
+ * MICEX ones do. Updates of an instrument that is not live are queued
+ * until a snapshot arrives, which the updates queued after it are then
+ * applied on top of by their RptSeq. Instruments go live one by one as
+ * soon as that leaves no gap.
+ */
+struct fast_recovery {
+	unsigned long			nr_instruments;
+	unsigned long			max_instruments;
+	struct fast_instrument		**instruments;
+	unsigned long			nr_live;
+
+	unsigned long			nr_templates;
+	struct fast_recovery_template	templates[FAST_RECOVERY_MAX_TEMPLATES];
+
+	/* Queued updates, copied with their strings */
+	unsigned long			ring_size;
+	unsigned long			ring_head;
+	unsigned long			ring_len;
+	struct fast_recovery_entry	*ring;
+	unsigned long			max_fields;
+	unsigned long			strings_size;
+	struct fast_field		*ring_fields;
+	char				*ring_strings;
+
+	int				(*on_snapshot)(struct fast_recovery *, struct fast_instrument *, struct fast_message *);
+	int				(*on_update)(struct fast_recovery *, struct fast_instrument *, u64 tid, struct fast_field *);
+	void				*data;
+
+	struct fast_recovery_stats	stats;
+};
+
+static inline bool fast_instrument_is_live(struct fast_instrument *instrument)
+{
+	return instrument->state == FAST_INSTRUMENT_LIVE;
+}
+
+static inline bool fast_recovery_is_done(struct fast_recovery *self)
+{
+	return self->nr_live == self->nr_instruments;
+}
+
+struct fast_recovery *fast_recovery_new(unsigned long ring_size);
+void fast_recovery_free(struct fast_recovery *self);
+int fast_recovery_add_updates(struct fast_recovery *self, struct fast_message *msg, long entries, unsigned long symbol, unsigned long rpt_seq);
+int fast_recovery_add_snapshot(struct fast_recovery *self, struct fast_message *msg, unsigned long symbol, unsigned long rpt_seq);
+int fast_recovery_process(struct fast_recovery *self, struct fast_message *msg);
+struct fast_instrument *fast_recovery_instrument(struct fast_recovery *self, const char *symbol);
+
+#endif
@@ -8,26 +8,59 @@
 #define	FAST_RECV_BUFFER_SIZE	(2 * FAST_MESSAGE_MAX_SIZE)
 #define	FAST_TX_BUFFER_SIZE	(2 * FAST_MESSAGE_MAX_SIZE)
 
+struct fast_template_codec;
+struct fast_visitor;
 struct fast_message;
 
+/*
+ * Templates that sessions share. They are parsed once and only read from
+ * after that: every session that uses them has values and dictionaries of
+ * its own, and holds a reference until it is freed.
+ */
+struct fast_templates {
+	unsigned long		refcount;
+
+	int			nr_messages;
+	struct fast_message	*messages;
+	struct fast_dictionary	dictionary;
+};
+
 struct fast_session {
 	u64			last_tid;
 	int			sockfd;
 
 	struct buffer		*rx_buffer;
-	struct buffer		*tx_pmap_buffer;
 	struct buffer		*tx_message_buffer;
 
 	int			nr_messages;
+	int			max_messages;
 	struct fast_message	*rx_messages;
+	struct fast_tid_map	rx_map;
+
+	/* Entries that the templates share, see fast_dictionary_build() */
+	struct fast_dictionary	dictionary;
+
+	/* Where the templates came from if they are shared, or NULL */
+	struct fast_templates	*templates;
 };
 
 int fast_session_send(struct fast_session *self, struct fast_message *msg, int flags);
 struct fast_message *fast_session_recv(struct fast_session *self, int flags);
 int fast_micex_template(struct fast_session *self, const char *xml);
 int fast_suite_template(struct fast_session *self, const char *xml);
+int fast_template_save(struct fast_session *self, const char *xml, const char *cache);
+int fast_template_load(struct fast_session *self, const char *xml, const char *cache);
+int fast_cached_template(struct fast_session *self, const char *xml, const char *cache);
 struct fast_session *fast_session_new(int sockfd);
 void fast_session_free(struct fast_session *self);
 void fast_session_reset(struct fast_session *self);
+int fast_session_reserve(struct fast_session *self, int nr_messages);
+unsigned long fast_session_attach(struct fast_session *self, const struct fast_template_codec *codecs, unsigned long nr_codecs);
+int fast_session_set_visitor(struct fast_session *self, u64 tid, const struct fast_visitor *visitor, void *data);
+int fast_session_use_templates(struct fast_session *self, struct fast_templates *templates);
+struct fast_templates *fast_templates_new(const char *xml, const char *cache);
+struct fast_templates *fast_templates_get(struct fast_templates *self);
+void fast_templates_put(struct fast_templates *self);
+unsigned long fast_templates_attach(struct fast_templates *self, const struct fast_template_codec *codecs, unsigned long nr_codecs);
 
 #endif
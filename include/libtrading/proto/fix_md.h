@@ -0,0 +1,94 @@
+#ifndef LIBTRADING_FIX_MD_H
+#define LIBTRADING_FIX_MD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct fix_message;
+
+#define FIX_MD_SYMBOL_LEN	32
+#define FIX_MD_DEFAULT_DEPTH	10
+
+/* Initial size of the symbol table, always a power of two */
+#define FIX_MD_BOOK_NUMBER	64
+
+enum fix_book_state {
+	FIX_BOOK_STATE_EMPTY,		/* waiting for the first snapshot */
+	FIX_BOOK_STATE_SYNCED,
+	FIX_BOOK_STATE_STALE,		/* RptSeq gap, waiting for a snapshot */
+};
+
+enum fix_book_side {
+	FIX_BOOK_BID,
+	FIX_BOOK_OFFER,
+
+	FIX_BOOK_SIDES,
+};
+
+enum fix_md_update_action {
+	FIX_MD_UPDATE_ACTION_NEW	= '0',
+	FIX_MD_UPDATE_ACTION_CHANGE	= '1',
+	FIX_MD_UPDATE_ACTION_DELETE	= '2',
+};
+
+struct fix_price_level {
+	double				price;
+	double				size;
+	unsigned long			nr_orders;
+};
+
+/*
+ * A price-level book of one symbol. Levels are ordered best price first:
+ * descending for bids and ascending for offers.
+ */
+struct fix_book {
+	char				symbol[FIX_MD_SYMBOL_LEN];
+	enum fix_book_state		state;
+	unsigned long			rpt_seq;
+
+	unsigned long			nr_levels[FIX_BOOK_SIDES];
+	struct fix_price_level		*levels[FIX_BOOK_SIDES];
+};
+
+struct fix_md_stats {
+	unsigned long			nr_messages;
+	unsigned long			nr_entries;
+	unsigned long			nr_ignored;	/* entry types other than bid and offer */
+	unsigned long			nr_dropped;	/* stale RptSeq or book not synced */
+	unsigned long			nr_bad_symbols;	/* symbol missing or too long for a book */
+	unsigned long			nr_gaps;
+};
+
+/*
+ * Market data handler that applies MarketDataSnapshotFullRefresh (35=W) and
+ * MarketDataIncrementalRefresh (35=X) messages to per-symbol books.
+ */
+struct fix_md {
+	unsigned long			depth;
+
+	unsigned long			nr_books;
+	unsigned long			max_books;
+	struct fix_book			**books;
+
+	struct fix_md_stats		stats;
+};
+
+static inline struct fix_price_level *fix_book_level(struct fix_book *book, enum fix_book_side side, unsigned long idx)
+{
+	if (idx >= book->nr_levels[side])
+		return NULL;
+
+	return &book->levels[side][idx];
+}
+
+static inline bool fix_book_is_synced(struct fix_book *book)
+{
+	return book->state == FIX_BOOK_STATE_SYNCED;
+}
+
+struct fix_md *fix_md_new(unsigned long depth);
+void fix_md_free(struct fix_md *self);
+int fix_md_process(struct fix_md *self, struct fix_message *msg);
+struct fix_book *fix_md_book(struct fix_md *self, const char *symbol);
+
+#endif
@@ -10,15 +10,107 @@ struct buffer;
  * Message types:
  */
 enum fix_msg_type {
-	FIX_MSG_TYPE_HEARTBEAT		= 0,
-	FIX_MSG_TYPE_TEST_REQUEST	= 1,
-	FIX_MSG_TYPE_RESEND_REQUEST	= 2,
-	FIX_MSG_TYPE_REJECT		= 3,
-	FIX_MSG_TYPE_SEQUENCE_RESET	= 4,
-	FIX_MSG_TYPE_LOGOUT		= 5,
-	FIX_MSG_TYPE_EXECUTION_REPORT	= 6,
-	FIX_MSG_TYPE_LOGON		= 7,
-	FIX_MSG_TYPE_NEW_ORDER_SINGLE	= 8,
+	FIX_MSG_TYPE_HEARTBEAT				= 0,
+	FIX_MSG_TYPE_TEST_REQUEST			= 1,
+	FIX_MSG_TYPE_RESEND_REQUEST			= 2,
+	FIX_MSG_TYPE_REJECT				= 3,
+	FIX_MSG_TYPE_SEQUENCE_RESET			= 4,
+	FIX_MSG_TYPE_LOGOUT				= 5,
+	FIX_MSG_TYPE_EXECUTION_REPORT			= 6,
+	FIX_MSG_TYPE_LOGON				= 7,
+	FIX_MSG_TYPE_NEW_ORDER_SINGLE			= 8,
+	FIX_MSG_TYPE_IOI				= 9,
+	FIX_MSG_TYPE_ADVERTISEMENT			= 10,
+	FIX_MSG_TYPE_ORDER_CANCEL_REJECT		= 11,
+	FIX_MSG_TYPE_NEWS				= 12,
+	FIX_MSG_TYPE_EMAIL				= 13,
+	FIX_MSG_TYPE_NEW_ORDER_LIST			= 14,
+	FIX_MSG_TYPE_ORDER_CANCEL_REQUEST		= 15,
+	FIX_MSG_TYPE_ORDER_CANCEL_REPLACE_REQUEST	= 16,
+	FIX_MSG_TYPE_ORDER_STATUS_REQUEST		= 17,
+	FIX_MSG_TYPE_ALLOCATION_INSTRUCTION		= 18,
+	FIX_MSG_TYPE_LIST_CANCEL_REQUEST		= 19,
+	FIX_MSG_TYPE_LIST_EXECUTE			= 20,
+	FIX_MSG_TYPE_LIST_STATUS_REQUEST		= 21,
+	FIX_MSG_TYPE_LIST_STATUS			= 22,
+	FIX_MSG_TYPE_ALLOCATION_INSTRUCTION_ACK		= 23,
+	FIX_MSG_TYPE_DONT_KNOW_TRADE			= 24,
+	FIX_MSG_TYPE_QUOTE_REQUEST			= 25,
+	FIX_MSG_TYPE_QUOTE				= 26,
+	FIX_MSG_TYPE_SETTLEMENT_INSTRUCTIONS		= 27,
+	FIX_MSG_TYPE_MARKET_DATA_REQUEST		= 28,
+	FIX_MSG_TYPE_MARKET_DATA_SNAPSHOT_FULL_REFRESH	= 29,
+	FIX_MSG_TYPE_MARKET_DATA_INCREMENTAL_REFRESH	= 30,
+	FIX_MSG_TYPE_MARKET_DATA_REQUEST_REJECT		= 31,
+	FIX_MSG_TYPE_QUOTE_CANCEL			= 32,
+	FIX_MSG_TYPE_QUOTE_STATUS_REQUEST		= 33,
+	FIX_MSG_TYPE_MASS_QUOTE_ACKNOWLEDGEMENT		= 34,
+	FIX_MSG_TYPE_SECURITY_DEFINITION_REQUEST	= 35,
+	FIX_MSG_TYPE_SECURITY_DEFINITION		= 36,
+	FIX_MSG_TYPE_SECURITY_STATUS_REQUEST		= 37,
+	FIX_MSG_TYPE_SECURITY_STATUS			= 38,
+	FIX_MSG_TYPE_TRADING_SESSION_STATUS_REQUEST	= 39,
+	FIX_MSG_TYPE_TRADING_SESSION_STATUS		= 40,
+	FIX_MSG_TYPE_MASS_QUOTE				= 41,
+	FIX_MSG_TYPE_BUSINESS_MESSAGE_REJECT		= 42,
+	FIX_MSG_TYPE_BID_REQUEST			= 43,
+	FIX_MSG_TYPE_BID_RESPONSE			= 44,
+	FIX_MSG_TYPE_LIST_STRIKE_PRICE			= 45,
+	FIX_MSG_TYPE_XML_NON_FIX			= 46,
+	FIX_MSG_TYPE_REGISTRATION_INSTRUCTIONS		= 47,
+	FIX_MSG_TYPE_REGISTRATION_INSTRUCTIONS_RESPONSE	= 48,
+	FIX_MSG_TYPE_ORDER_MASS_CANCEL_REQUEST		= 49,
+	FIX_MSG_TYPE_ORDER_MASS_CANCEL_REPORT		= 50,
+	FIX_MSG_TYPE_NEW_ORDER_CROSS			= 51,
+	FIX_MSG_TYPE_CROSS_ORDER_CANCEL_REPLACE_REQUEST	= 52,
+	FIX_MSG_TYPE_CROSS_ORDER_CANCEL_REQUEST		= 53,
+	FIX_MSG_TYPE_SECURITY_TYPE_REQUEST		= 54,
+	FIX_MSG_TYPE_SECURITY_TYPES			= 55,
+	FIX_MSG_TYPE_SECURITY_LIST_REQUEST		= 56,
+	FIX_MSG_TYPE_SECURITY_LIST			= 57,
+	FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST_REQUEST	= 58,
+	FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST		= 59,
+	FIX_MSG_TYPE_NEW_ORDER_MULTILEG			= 60,
+	FIX_MSG_TYPE_MULTILEG_ORDER_CANCEL_REPLACE	= 61,
+	FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_REQUEST	= 62,
+	FIX_MSG_TYPE_TRADE_CAPTURE_REPORT		= 63,
+	FIX_MSG_TYPE_ORDER_MASS_STATUS_REQUEST		= 64,
+	FIX_MSG_TYPE_QUOTE_REQUEST_REJECT		= 65,
+	FIX_MSG_TYPE_RFQ_REQUEST			= 66,
+	FIX_MSG_TYPE_QUOTE_STATUS_REPORT		= 67,
+	FIX_MSG_TYPE_QUOTE_RESPONSE			= 68,
+	FIX_MSG_TYPE_CONFIRMATION			= 69,
+	FIX_MSG_TYPE_POSITION_MAINTENANCE_REQUEST	= 70,
+	FIX_MSG_TYPE_POSITION_MAINTENANCE_REPORT	= 71,
+	FIX_MSG_TYPE_REQUEST_FOR_POSITIONS		= 72,
+	FIX_MSG_TYPE_REQUEST_FOR_POSITIONS_ACK		= 73,
+	FIX_MSG_TYPE_POSITION_REPORT			= 74,
+	FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_REQUEST_ACK	= 75,
+	FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_ACK		= 76,
+	FIX_MSG_TYPE_ALLOCATION_REPORT			= 77,
+	FIX_MSG_TYPE_ALLOCATION_REPORT_ACK		= 78,
+	FIX_MSG_TYPE_CONFIRMATION_ACK			= 79,
+	FIX_MSG_TYPE_SETTLEMENT_INSTRUCTION_REQUEST	= 80,
+	FIX_MSG_TYPE_ASSIGNMENT_REPORT			= 81,
+	FIX_MSG_TYPE_COLLATERAL_REQUEST			= 82,
+	FIX_MSG_TYPE_COLLATERAL_ASSIGNMENT		= 83,
+	FIX_MSG_TYPE_COLLATERAL_RESPONSE		= 84,
+	FIX_MSG_TYPE_COLLATERAL_REPORT			= 85,
+	FIX_MSG_TYPE_COLLATERAL_INQUIRY			= 86,
+	FIX_MSG_TYPE_NETWORK_STATUS_REQUEST		= 87,
+	FIX_MSG_TYPE_NETWORK_STATUS_RESPONSE		= 88,
+	FIX_MSG_TYPE_USER_REQUEST			= 89,
+	FIX_MSG_TYPE_USER_RESPONSE			= 90,
+	FIX_MSG_TYPE_COLLATERAL_INQUIRY_ACK		= 91,
+	FIX_MSG_TYPE_CONFIRMATION_REQUEST		= 92,
+	FIX_MSG_TYPE_TRADING_SESSION_LIST_REQUEST	= 93,
+	FIX_MSG_TYPE_TRADING_SESSION_LIST		= 94,
+	FIX_MSG_TYPE_SECURITY_LIST_UPDATE_REPORT	= 95,
+	FIX_MSG_TYPE_ADJUSTED_POSITION_REPORT		= 96,
+	FIX_MSG_TYPE_ALLOCATION_INSTRUCTION_ALERT	= 97,
+	FIX_MSG_TYPE_EXECUTION_ACKNOWLEDGEMENT		= 98,
+	FIX_MSG_TYPE_CONTRARY_INTENTION_REPORT		= 99,
+	FIX_MSG_TYPE_SECURITY_DEFINITION_UPDATE_REPORT	= 100,
 
 	FIX_MSG_TYPE_MAX,		/* non-API */
 
@@ -29,21 +121,37 @@ enum fix_msg_type {
  * Maximum FIX message size
  */
 #define FIX_MAX_HEAD_LEN	64UL
-#define FIX_MAX_BODY_LEN	256UL
+#define FIX_MAX_BODY_LEN	8192UL
 #define FIX_MAX_MESSAGE_SIZE	(FIX_MAX_HEAD_LEN + FIX_MAX_BODY_LEN)
 
-/* Total number of elements of fix_tag type*/
+/* Initial number of elements of fix_tag type, the arena grows on demand */
 #define FIX_MAX_FIELD_NUMBER	32
 
+/* Initial number of repeating groups and group entries per message */
+#define FIX_MAX_GROUP_NUMBER	4
+#define FIX_MAX_ENTRY_NUMBER	128
+
 #define	FIX_MSG_STATE_PARTIAL	1
 #define	FIX_MSG_STATE_GARBLED	2
 
+/* Fields are converted on first lookup instead of at parse time */
+#define	FIX_MSG_FLAGS_LAZY	0x00000001
+
+/*
+ * Application fields are not parsed at all: only the header up to MsgSeqNum
+ * and SendingTime is. Consumers walk the raw body between msg_type and
+ * check_sum instead.
+ */
+#define	FIX_MSG_FLAGS_SKIP_BODY	0x00000002
+
 enum fix_type {
 	FIX_TYPE_INT,
 	FIX_TYPE_FLOAT,
 	FIX_TYPE_CHAR,
 	FIX_TYPE_STRING,
 	FIX_TYPE_CHECKSUM,
+	FIX_TYPE_RAW,		/* not yet converted, see FIX_MSG_FLAGS_LAZY */
+	FIX_TYPE_UTC_TIMESTAMP,
 };
 
 enum fix_tag {
@@ -72,6 +180,10 @@ enum fix_tag {
 	Symbol			= 55,
 	TargetCompID		= 56,
 	TransactTime		= 60,
+	NoAllocs		= 78,
+	AllocAccount		= 79,
+	AllocQty		= 80,
+	RptSeq			= 83,
 	EncryptMethod		= 98,
 	HeartBtInt		= 108,
 	TestReqID		= 112,
@@ -79,6 +191,20 @@ enum fix_tag {
 	ResetSeqNumFlag		= 141,
 	ExecType		= 150,
 	LeavesQty		= 151,
+	MDReqID			= 262,
+	NoMDEntries		= 268,
+	MDEntryType		= 269,
+	MDEntryPx		= 270,
+	MDEntrySize		= 271,
+	MDEntryID		= 278,
+	MDUpdateAction		= 279,
+	NumberOfOrders		= 346,
+	AllocPrice		= 366,
+	PartyIDSource		= 447,
+	PartyID			= 448,
+	PartyRole		= 452,
+	NoPartyIDs		= 453,
+	MDPriceLevel		= 1023,
 };
 
 struct fix_field {
@@ -90,6 +216,7 @@ struct fix_field {
 		double			float_value;
 		char			char_value;
 		const char		*string_value;
+		int64_t			timestamp_value;	/* nanoseconds since the epoch */
 	};
 };
 
@@ -114,6 +241,12 @@ struct fix_field {
 		{ .float_value  = v },			\
 	}
 
+#define FIX_UTC_TIMESTAMP_FIELD(t, v)			\
+	(struct fix_field) {				\
+		.tag		= t,			\
+		.type		= FIX_TYPE_UTC_TIMESTAMP, \
+		{ .timestamp_value = v },		\
+	}
 #define FIX_CHECKSUM_FIELD(t, v)			\
 	(struct fix_field) {				\
 		.tag		= t,			\
@@ -121,8 +254,21 @@ struct fix_field {
 		{ .int_value	= v },			\
 	}
 
+/*
+ * Repeating group. Entry 'i' spans fields from entries[entry + i] up to
+ * entries[entry + i + 1] of the message it belongs to.
+ */
+struct fix_group {
+	enum fix_tag			tag;		/* NoXXX field */
+	enum fix_tag			delim;		/* first field of each entry */
+
+	unsigned long			nr_entries;
+	unsigned long			entry;
+};
+
 struct fix_message {
 	enum fix_msg_type		type;
+	int				flags;
 
 	/*
 	 * These are required fields.
@@ -133,7 +279,7 @@ struct fix_message {
 	const char			*sender_comp_id;
 	const char			*target_comp_id;
 	unsigned long			msg_seq_num;
-	/* XXX: SendingTime */
+	int64_t				sending_time;	/* nanoseconds since the epoch, 0 if absent */
 	const char			*check_sum;
 
 	/*
@@ -144,8 +290,47 @@ struct fix_message {
 
 	unsigned long			nr_fields;
 	struct fix_field		*fields;
+
+	/*
+	 * Parsed messages own the field array above and grow it on demand.
+	 * Repeating groups are ranges of it: group entry offsets are kept in
+	 * the entries array and both arrays are reused between messages.
+	 */
+	unsigned long			max_fields;
+
+	unsigned long			nr_groups;
+	unsigned long			max_groups;
+	struct fix_group		*groups;
+
+	unsigned long			nr_entries;
+	unsigned long			max_entries;
+	unsigned long			*entries;
 };
 
+static inline void fix_msg_add_flags(struct fix_message *msg, int flags)
+{
+	msg->flags |= flags;
+
+	return;
+}
+
+static inline void fix_msg_clear_flags(struct fix_message *msg, int flags)
+{
+	msg->flags &= ~flags;
+
+	return;
+}
+
+static inline int fix_msg_has_flags(struct fix_message *msg, int flags)
+{
+	return msg->flags & flags;
+}
+
+static inline unsigned long fix_group_nr_entries(struct fix_group *group)
+{
+	return group->nr_entries;
+}
+
 bool fix_field_unparse(struct fix_field *self, struct buffer *buffer);
 
 struct fix_message *fix_message_new(void);
@@ -155,10 +340,20 @@ void fix_message_add_field(struct fix_message *msg, struct fix_field *field);
 
 int fix_message_parse(struct fix_message *self, struct buffer *buffer);
 struct fix_field *fix_get_field(struct fix_message *self, int tag);
+struct fix_field *fix_field_decode(struct fix_field *field);
+bool fix_get_int(struct fix_message *self, int tag, int64_t *value);
+bool fix_get_float(struct fix_message *self, int tag, double *value);
+bool fix_get_timestamp(struct fix_message *self, int tag, int64_t *value);
+struct fix_group *fix_get_group(struct fix_message *self, int tag);
+unsigned long fix_group_entry(struct fix_message *self, struct fix_group *group, unsigned long idx, struct fix_field **fields);
+struct fix_field *fix_group_get_field(struct fix_message *self, struct fix_group *group, unsigned long idx, int tag);
 const char *fix_get_string(struct fix_field *field, char *buffer, unsigned long len);
 void fix_message_validate(struct fix_message *self);
 int fix_message_send(struct fix_message *self, int sockfd, int flags);
 
+bool fix_utc_timestamp_parse(const char *s, unsigned long len, int64_t *value);
+int fix_utc_timestamp_format(int64_t value, char *buf, unsigned long len);
+
 enum fix_msg_type fix_msg_type_parse(const char *s);
 bool fix_message_type_is(struct fix_message *self, enum fix_msg_type type);
 
@@ -7,7 +7,7 @@
 
 #include <stdbool.h>
 
-#define RECV_BUFFER_SIZE	4096UL
+#define RECV_BUFFER_SIZE	(4 * FIX_MAX_MESSAGE_SIZE)
 #define FIX_TX_HEAD_BUFFER_SIZE	FIX_MAX_HEAD_LEN
 #define FIX_TX_BODY_BUFFER_SIZE	FIX_MAX_BODY_LEN
 
@@ -31,4 +31,11 @@ typedef uint64_t bitwise be64;
 
 #define packed __attribute__ ((packed))
 
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+
+#ifndef __always_inline
+#define __always_inline	inline __attribute__ ((always_inline))
+#endif
+
 #endif /* LIBTRADING_TYPES_H */
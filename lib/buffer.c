@@ -20,6 +20,7 @@ struct buffer *buffer_new(unsigned long capacity)
 	buf->capacity	= capacity;
 	buf->start	= 0;
 	buf->end	= 0;
+	buf->ptr	= NULL;
 
 	return buf;
 }
@@ -75,17 +76,17 @@ bool buffer_printf(struct buffer *buf, const char *format, ...)
 
 char *buffer_find(struct buffer *buf, char c)
 {
-	while (true) {
-		if (!buffer_size(buf))
-			return NULL;
+	char *ptr;
 
-		if (buffer_first_char(buf) == c)
-			break;
-
-		buffer_advance(buf, 1);
+	ptr = memchr(buffer_start(buf), c, buffer_size(buf));
+	if (!ptr) {
+		buf->start = buf->end;
+		return NULL;
 	}
 
-	return buffer_start(buf);
+	buf->start = ptr - buf->data;
+
+	return ptr;
 }
 
 ssize_t buffer_read(struct buffer *buf, int fd)
@@ -0,0 +1,44 @@
+#include "libtrading/proto/fast_decimal.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+const u64 fast_pow10[FAST_POW10_MAX + 1] = {
+	1ULL,
+	10ULL,
+	100ULL,
+	1000ULL,
+	10000ULL,
+	100000ULL,
+	1000000ULL,
+	10000000ULL,
+	100000000ULL,
+	1000000000ULL,
+	10000000000ULL,
+	100000000000ULL,
+	1000000000000ULL,
+	10000000000000ULL,
+	100000000000000ULL,
+	1000000000000000ULL,
+	10000000000000000ULL,
+	100000000000000000ULL,
+	1000000000000000000ULL,
+	10000000000000000000ULL,
+};
+
+const double fast_pow10_double[FAST_POW10_DOUBLE_MAX + 1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+	1e20, 1e21, 1e22,
+};
+
+/* strtod() rounds correctly whatever the mantissa and exponent are */
+double fast_decimal_to_double_slow(const struct fast_decimal *decimal)
+{
+	char buf[64];
+
+	snprintf(buf, sizeof(buf), "%" PRId64 "e%" PRId64, decimal->mnt, decimal->exp);
+
+	return strtod(buf, NULL);
+}
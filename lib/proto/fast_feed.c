@@ -0,0 +1,421 @@
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_message.h"
+#include "libtrading/proto/fast_feed.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <endian.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+struct fast_feed_packet {
+	enum fast_feed_line		line;
+	u64				seq;
+	u64				stamp;		/* kernel receive time in ns, zero if unknown */
+	unsigned long			epoch;		/* restarts before it on its line in the batch */
+	unsigned long			len;
+
+	struct iovec			iov;
+	char				control[CMSG_SPACE(sizeof(struct timespec))];
+	char				data[FAST_FEED_PACKET_SIZE];
+};
+
+#define	FAST_FEED_NR_PACKETS		(FAST_FEED_LINES * FAST_FEED_BATCH)
+
+struct fast_feed *fast_feed_new(struct fast_session *session)
+{
+	struct fast_feed *self = calloc(1, sizeof *self);
+	struct fast_feed_packet *pkt;
+	int i;
+
+	if (!self)
+		return NULL;
+
+	self->mmsg = calloc(FAST_FEED_NR_PACKETS, sizeof(struct mmsghdr));
+	if (!self->mmsg)
+		goto fail;
+
+	self->packets = calloc(FAST_FEED_NR_PACKETS, sizeof(struct fast_feed_packet));
+	if (!self->packets)
+		goto fail;
+
+	self->order = calloc(FAST_FEED_NR_PACKETS, sizeof(struct fast_feed_packet *));
+	if (!self->order)
+		goto fail;
+
+	for (i = 0; i < FAST_FEED_NR_PACKETS; i++) {
+		pkt = self->packets + i;
+
+		pkt->line		= i / FAST_FEED_BATCH;
+		pkt->iov.iov_base	= pkt->data;
+		pkt->iov.iov_len	= FAST_FEED_PACKET_SIZE;
+
+		self->mmsg[i].msg_hdr.msg_iov		= &pkt->iov;
+		self->mmsg[i].msg_hdr.msg_iovlen	= 1;
+		self->mmsg[i].msg_hdr.msg_control	= pkt->control;
+	}
+
+	for (i = 0; i < FAST_FEED_LINES; i++)
+		self->sockfd[i] = -1;
+
+	self->session = session;
+
+	return self;
+
+fail:
+	fast_feed_free(self);
+
+	return NULL;
+}
+
+void fast_feed_free(struct fast_feed *self)
+{
+	int i;
+
+	if (!self)
+		return;
+
+	for (i = 0; i < FAST_FEED_LINES; i++) {
+		if (self->sockfd[i] >= 0)
+			close(self->sockfd[i]);
+	}
+
+	free(self->order);
+	free(self->packets);
+	free(self->mmsg);
+	free(self);
+}
+
+static int socket_setopt(int sockfd, int level, int optname, int optval)
+{
+	return setsockopt(sockfd, level, optname, (void *) &optval, sizeof(optval));
+}
+
+/*
+ * Joins the multicast group of a line on the interface with the address
+ * ifaddr, or on the default one if it is NULL. A unicast address is just
+ * bound to, which is handy for feeding the line by hand.
+ */
+int fast_feed_join(struct fast_feed *self, enum fast_feed_line line, const char *group, int port, const char *ifaddr)
+{
+	struct sockaddr_in sa;
+	struct ip_mreq mreq;
+	int sockfd;
+
+	if (line >= FAST_FEED_LINES || self->sockfd[line] >= 0)
+		return -1;
+
+	sa = (struct sockaddr_in) {
+		.sin_family		= AF_INET,
+		.sin_port		= htons(port),
+	};
+
+	if (!inet_aton(group, &sa.sin_addr))
+		return -1;
+
+	sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sockfd < 0)
+		return -1;
+
+	if (socket_setopt(sockfd, SOL_SOCKET, SO_REUSEADDR, 1) < 0)
+		goto fail;
+
+	/* Arbitration falls back to the line order without timestamps */
+	socket_setopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, 1);
+
+	if (bind(sockfd, (const struct sockaddr *) &sa, sizeof(sa)) < 0)
+		goto fail;
+
+	if (IN_MULTICAST(ntohl(sa.sin_addr.s_addr))) {
+		mreq.imr_multiaddr		= sa.sin_addr;
+		mreq.imr_interface.s_addr	= htonl(INADDR_ANY);
+
+		if (ifaddr && !inet_aton(ifaddr, &mreq.imr_interface))
+			goto fail;
+
+		if (setsockopt(sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+			goto fail;
+	}
+
+	self->sockfd[line] = sockfd;
+
+	return 0;
+
+fail:
+	close(sockfd);
+
+	return -1;
+}
+
+/* True if a line that was at sequence number last goes back to seq for good */
+static bool seq_went_back(u64 last, u64 seq)
+{
+	if (seq >= last)
+		return false;
+
+	return seq == 1 || last - seq > FAST_FEED_SEQ_WINDOW;
+}
+
+/*
+ * The sequence numbers start over when the publisher restarts or they wrap
+ * around. Either the line itself goes back to the first packet, or the
+ * sequence number is further behind than any line lags. Copies of the new
+ * packets on the other lines are then duplicates as usual.
+ */
+static bool fast_feed_restarted(struct fast_feed *self, enum fast_feed_line line, u32 seq)
+{
+	if (seq >= self->next_seq)
+		return false;
+
+	if (seq == 1 && self->line_seq[line] > 1)
+		return true;
+
+	return self->next_seq - seq > FAST_FEED_SEQ_WINDOW;
+}
+
+/*
+ * Arbitrates and decodes one packet. Packets must be fed in the order they
+ * arrived: a sequence number that was already seen is a duplicate and one
+ * that skips ahead is a gap, the packets in between are counted as lost.
+ * A message that fails to decode drops the rest of its packet and resets
+ * the dictionaries, so that the feed picks up again with the next packet.
+ * Decoding errors only show up in the stats, the return value is the first
+ * non-zero one of the handler, which should return a negative value to stop,
+ * or FAST_MSG_STATE_STOPPED when a visitor stops decoding.
+ */
+int fast_feed_process(struct fast_feed *self, enum fast_feed_line line, const char *data, unsigned long len)
+{
+	struct fast_session *session = self->session;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	u32 seq;
+	int ret;
+
+	self->stats.nr_packets[line]++;
+
+	if (len < FAST_FEED_SEQ_SIZE) {
+		self->stats.nr_errors++;
+		return 0;
+	}
+
+	memcpy(&seq, data, sizeof(seq));
+	seq = le32toh(seq);
+
+	if (fast_feed_restarted(self, line, seq)) {
+		self->stats.nr_restarts++;
+		fast_session_reset(session);
+
+		memset(self->line_seq, 0, sizeof(self->line_seq));
+		self->next_seq = 0;
+	}
+
+	self->line_seq[line] = seq;
+
+	if (self->next_seq) {
+		if (seq < self->next_seq) {
+			self->stats.nr_duplicates++;
+			return 0;
+		}
+
+		if (seq > self->next_seq) {
+			self->stats.nr_gaps++;
+			self->stats.nr_lost += seq - self->next_seq;
+		}
+	}
+
+	self->next_seq = (u64) seq + 1;
+	self->stats.nr_wins[line]++;
+
+	if (self->flags & FAST_FEED_FLAGS_PACKET_RESET)
+		fast_session_reset(session);
+
+	fast_packet_init(&packet, data + FAST_FEED_SEQ_SIZE, len - FAST_FEED_SEQ_SIZE);
+
+	while (!fast_packet_empty(&packet)) {
+		ret = fast_packet_decode(&session->rx_map, &packet, &msg);
+		if (ret == FAST_MSG_STATE_STOPPED)
+			return ret;
+
+		/*
+		 * Whatever is left of the packet cannot be found the start of,
+		 * and the publisher's dictionaries moved on with it.
+		 */
+		if (ret) {
+			self->stats.nr_errors++;
+			fast_session_reset(session);
+			break;
+		}
+
+		self->stats.nr_messages++;
+
+		if (fast_msg_has_flags(msg, FAST_MSG_FLAGS_RESET)) {
+			fast_session_reset(session);
+			continue;
+		}
+
+		if (!self->handler)
+			continue;
+
+		ret = self->handler(self, msg);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static u64 packet_stamp(struct msghdr *hdr)
+{
+	struct cmsghdr *cmsg;
+	struct timespec ts;
+
+	for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS)
+			continue;
+
+		memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+
+		return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+	return 0;
+}
+
+/*
+ * Reads a batch from a line and queues its packets after the nr ones that
+ * are queued already. Returns the number of packets read, those that were
+ * too big for the receive buffer included, which are counted and dropped.
+ * Every time the line's sequence numbers start over the packets after it
+ * go to the next epoch, so that ordering does not move them ahead of the
+ * ones from before the restart.
+ */
+static int fast_feed_recv(struct fast_feed *self, enum fast_feed_line line, unsigned long *nr)
+{
+	struct mmsghdr *mmsg = self->mmsg + line * FAST_FEED_BATCH;
+	u64 last = self->line_seq[line];
+	struct fast_feed_packet *pkt;
+	unsigned long epoch = 0;
+	u32 seq;
+	int ret;
+	int i;
+
+	for (i = 0; i < FAST_FEED_BATCH; i++)
+		mmsg[i].msg_hdr.msg_controllen = sizeof(pkt->control);
+
+	ret = recvmmsg(self->sockfd[line], mmsg, FAST_FEED_BATCH, MSG_DONTWAIT, NULL);
+	if (ret < 0)
+		return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+
+	for (i = 0; i < ret; i++) {
+		pkt = self->packets + line * FAST_FEED_BATCH + i;
+
+		/* Whatever the packet held past the buffer is gone */
+		if (mmsg[i].msg_hdr.msg_flags & MSG_TRUNC) {
+			self->stats.nr_packets[line]++;
+			self->stats.nr_oversized++;
+			continue;
+		}
+
+		pkt->len	= mmsg[i].msg_len;
+		pkt->stamp	= packet_stamp(&mmsg[i].msg_hdr);
+		pkt->seq	= 0;
+
+		if (pkt->len >= FAST_FEED_SEQ_SIZE) {
+			memcpy(&seq, pkt->data, sizeof(seq));
+			pkt->seq = le32toh(seq);
+
+			if (last && seq_went_back(last, pkt->seq))
+				epoch++;
+
+			last = pkt->seq;
+		}
+
+		pkt->epoch = epoch;
+
+		self->order[(*nr)++] = pkt;
+	}
+
+	return ret;
+}
+
+static bool packet_before(struct fast_feed_packet *a, struct fast_feed_packet *b)
+{
+	if (a->epoch != b->epoch)
+		return a->epoch < b->epoch;
+
+	if (a->seq != b->seq)
+		return a->seq < b->seq;
+
+	return a->stamp < b->stamp;
+}
+
+/*
+ * Reads a batch from every line that has data and arbitrates the packets
+ * in sequence number order, so that a packet lost on one line but present
+ * in the other line's batch is not mistaken for a gap. Copies of the same
+ * packet are ordered by their arrival time, and packets from after a
+ * restart come after all of those from before it. Returns the number of packets
+ * read, zero on timeout, or a negative value on error or when the handler
+ * fails.
+ */
+int fast_feed_poll(struct fast_feed *self, int timeout)
+{
+	struct pollfd pfd[FAST_FEED_LINES];
+	struct fast_feed_packet *pkt;
+	unsigned long nr_fds = 0;
+	unsigned long nr_read = 0;
+	unsigned long nr = 0;
+	unsigned long i, j;
+	int ret;
+
+	for (i = 0; i < FAST_FEED_LINES; i++) {
+		if (self->sockfd[i] < 0)
+			continue;
+
+		pfd[nr_fds++] = (struct pollfd) {
+			.fd		= self->sockfd[i],
+			.events		= POLLIN,
+		};
+	}
+
+	ret = poll(pfd, nr_fds, timeout);
+	if (ret < 0)
+		return errno == EINTR ? 0 : -1;
+
+	for (i = 0; i < FAST_FEED_LINES; i++) {
+		if (self->sockfd[i] < 0)
+			continue;
+
+		ret = fast_feed_recv(self, i, &nr);
+		if (ret < 0)
+			return -1;
+
+		nr_read += ret;
+	}
+
+	/* Batches are small and nearly sorted already */
+	for (i = 1; i < nr; i++) {
+		pkt = self->order[i];
+
+		for (j = i; j > 0 && packet_before(pkt, self->order[j - 1]); j--)
+			self->order[j] = self->order[j - 1];
+
+		self->order[j] = pkt;
+	}
+
+	for (i = 0; i < nr; i++) {
+		pkt = self->order[i];
+
+		ret = fast_feed_process(self, pkt->line, pkt->data, pkt->len);
+		if (ret)
+			return ret;
+	}
+
+	return nr_read;
+}
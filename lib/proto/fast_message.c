@@ -1,8 +1,8 @@
+#include "libtrading/proto/fast_codec.h"
 #include "libtrading/proto/fast_message.h"
 
 #include "libtrading/read-write.h"
 #include "libtrading/buffer.h"
-#include "libtrading/array.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -10,26 +10,26 @@
 static ssize_t data_read(struct buffer *buffer)
 {
 	ssize_t nr = 0;
-	size_t size;
 	int *fd;
 
 	fd = buffer_get_ptr(buffer);
 
-	size = buffer_remaining(buffer);
-	if (size <= FAST_MESSAGE_MAX_SIZE)
-		buffer_compact(buffer);
+	/* Datagrams are complete, there is nothing more to read */
+	if (!fd)
+		return 0;
 
 	/*
-	 * If buffer's capacity is at least
-	 * 2 times FAST_MESSAGE_MAX_SIZE then,
-	 * remaining > FAST_MESSAGE_MAX_SIZE
+	 * The buffer is compacted before each message rather than here, so
+	 * that a message that fails can be decoded again from its start.
+	 * There is room for the rest of it as long as the buffer's capacity
+	 * is at least 2 times FAST_MESSAGE_MAX_SIZE.
 	 */
 	nr = buffer_nread(buffer, *fd, FAST_MESSAGE_MAX_SIZE);
 
 	return nr;
 }
 
-static int parse_uint(struct buffer *buffer, u64 *value)
+int fast_parse_uint(struct buffer *buffer, u64 *value)
 {
 	const int bytes = 9;
 	u64 result;
@@ -56,7 +56,6 @@ retry:
 		result = (result << 7) | c;
 	}
 
-fail:
 	return FAST_MSG_STATE_GARBLED;
 
 partial:
@@ -64,11 +63,11 @@ partial:
 
 	if (data_read(buffer) > 0)
 		goto retry;
-	else
-		goto fail;
+
+	return FAST_MSG_STATE_TRUNCATED;
 }
 
-static int parse_int(struct buffer *buffer, i64 *value)
+int fast_parse_int(struct buffer *buffer, i64 *value)
 {
 	const int bytes = 9;
 	i64 result;
@@ -102,7 +101,6 @@ retry:
 		result = (result << 7) | c;
 	}
 
-fail:
 	return FAST_MSG_STATE_GARBLED;
 
 partial:
@@ -110,8 +108,8 @@ partial:
 
 	if (data_read(buffer) > 0)
 		goto retry;
-	else
-		goto fail;
+
+	return FAST_MSG_STATE_TRUNCATED;
 }
 
 /*
@@ -120,8 +118,10 @@ partial:
  * returns the number of bytes read. Negative return value
  * indicates an error. If the return value is equal to 1 and
  * the string is nullable, it means that the string is NULL.
+ * Strings that do not fit in @size bytes, including the
+ * terminating NUL, are rejected.
  */
-static int parse_string(struct buffer *buffer, char *value)
+int fast_parse_string(struct buffer *buffer, char *value, unsigned long size)
 {
 	int len;
 	u8 c;
@@ -129,7 +129,7 @@ static int parse_string(struct buffer *buffer, char *value)
 retry:
 	len = 0;
 
-	while (len < FAST_STRING_MAX_BYTES - 1) {
+	while (len < size - 1) {
 		if (!buffer_size(buffer))
 			goto partial;
 
@@ -145,7 +145,6 @@ retry:
 			value[len++] = c;
 	}
 
-fail:
 	return FAST_MSG_STATE_GARBLED;
 
 partial:
@@ -153,11 +152,11 @@ partial:
 
 	if (data_read(buffer) > 0)
 		goto retry;
-	else
-		goto fail;
+
+	return FAST_MSG_STATE_TRUNCATED;
 }
 
-static int parse_bytes(struct buffer *buffer, char *value, int len)
+int fast_parse_bytes(struct buffer *buffer, char *value, int len)
 {
 	int i;
 	u8 c;
@@ -175,17 +174,14 @@ retry:
 
 	return 0;
 
-fail:
-	return FAST_MSG_STATE_GARBLED;
-
 partial:
 	if (data_read(buffer) > 0)
 		goto retry;
-	else
-		goto fail;
+
+	return FAST_MSG_STATE_TRUNCATED;
 }
 
-static int parse_pmap(struct buffer *buffer, struct fast_pmap *pmap)
+int fast_parse_pmap(struct buffer *buffer, struct fast_pmap *pmap)
 {
 	char c;
 
@@ -205,7 +201,6 @@ retry:
 			return 0;
 	}
 
-fail:
 	return FAST_MSG_STATE_GARBLED;
 
 partial:
@@ -213,1602 +208,1632 @@ partial:
 
 	if (data_read(buffer) > 0)
 		goto retry;
-	else
-		goto fail;
+
+	return FAST_MSG_STATE_TRUNCATED;
+}
+
+/* Fields that share a dictionary entry work from it rather than their own */
+static int fast_decode_field(struct buffer *buffer, struct fast_pmap *pmap, struct fast_dictionary *dict,
+			     struct fast_field *field)
+{
+	int ret;
+
+	if (field->slot) {
+		ret = fast_dict_load(dict, field);
+		if (ret)
+			return ret;
+	}
+
+	switch (field->type) {
+	case FAST_TYPE_INT:
+		ret = fast_decode_int(buffer, pmap, field, FAST_FIELD_ARGS(field));
+		break;
+	case FAST_TYPE_UINT:
+		ret = fast_decode_uint(buffer, pmap, field, FAST_FIELD_ARGS(field));
+		break;
+	case FAST_TYPE_STRING:
+		ret = fast_decode_string(buffer, pmap, field, FAST_FIELD_ARGS(field));
+		break;
+	case FAST_TYPE_DECIMAL:
+		if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS))
+			ret = fast_decode_decimal_parts(buffer, pmap, field, FAST_DECIMAL_PARTS_ARGS(field));
+		else
+			ret = fast_decode_decimal(buffer, pmap, field, FAST_FIELD_ARGS(field));
+		break;
+	case FAST_TYPE_SEQUENCE:
+		/* At the moment we do no support nested sequences */
+	default:
+		return FAST_MSG_STATE_GARBLED;
+	}
+
+	if (ret)
+		return ret;
+
+	if (field->slot)
+		fast_dict_store(dict, field);
+
+	return 0;
 }
 
-static int fast_decode_uint(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+static int fast_decode_sequence(struct buffer *buffer, struct fast_pmap *pmap, struct fast_dictionary *dict,
+				struct fast_field *field)
 {
+	struct fast_sequence *seq;
+	struct fast_message *elem;
+	struct fast_pmap spmap;
+	struct fast_field *cur;
+	unsigned long i, j;
+	int pmap_req;
 	int ret = 0;
-	i64 tmp;
 
-	switch (field->op) {
-	case FAST_OP_NONE:
-		ret = parse_uint(buffer, &field->uint_value);
+	seq = field->ptr_value;
+	elem = &seq->element;
 
-		if (ret)
-			goto fail;
+	ret = fast_decode_uint(buffer, pmap, &seq->length, FAST_FIELD_ARGS(&seq->length));
 
-		field->state = FAST_STATE_ASSIGNED;
+	if (ret)
+		goto exit;
 
+	if (field_state_empty(&seq->length)) {
 		if (field_is_mandatory(field))
-			break;
+			ret = FAST_MSG_STATE_GARBLED;
 
-		if (!field->uint_value)
-			field->state = FAST_STATE_EMPTY;
-		else
-			field->uint_value--;
+		goto exit;
+	}
 
-		break;
-	case FAST_OP_COPY:
-		if (!pmap_is_set(pmap, field->pmap_bit)) {
-			switch (field->state) {
-			case FAST_STATE_UNDEFINED:
-				if (field_has_reset_value(field)) {
-					field->state = FAST_STATE_ASSIGNED;
-					field->uint_value = field->uint_reset;
-				} else {
-					if (field_is_mandatory(field)) {
-						ret = FAST_MSG_STATE_GARBLED;
-						goto fail;
-					} else
-						field->state = FAST_STATE_EMPTY;
-				}
+	if (fast_sequence_reserve(seq, seq->length.uint_value)) {
+		ret = FAST_MSG_STATE_GARBLED;
+		goto exit;
+	}
 
-				break;
-			case FAST_STATE_ASSIGNED:
-				break;
-			case FAST_STATE_EMPTY:
-				if (field_is_mandatory(field)) {
-					ret = FAST_MSG_STATE_GARBLED;
-					goto fail;
-				}
+	pmap_req = field_has_flags(field, FAST_FIELD_FLAGS_PMAPREQ);
+	spmap.nr_bytes = 0;
 
-				break;
-			default:
-				break;
-			}
-		} else {
-			ret = parse_uint(buffer, &field->uint_value);
+	for (i = 0; i < seq->length.uint_value; i++) {
+		if (pmap_req) {
+			ret = fast_get_pmap(buffer, &spmap);
 
 			if (ret)
-				goto fail;
+				goto exit;
+		}
 
-			field->state = FAST_STATE_ASSIGNED;
+		cur = fast_sequence_element(seq, i);
 
-			if (field_is_mandatory(field))
-				break;
+		for (j = 0; j < elem->nr_fields; j++) {
+			field = elem->fields + j;
 
-			if (!field->uint_value)
-				field->state = FAST_STATE_EMPTY;
-			else
-				field->uint_value--;
+			ret = fast_decode_field(buffer, &spmap, dict, field);
+			if (ret)
+				goto exit;
+
+			field_copy_value(cur + j, field);
 		}
+	}
 
-		break;
-	case FAST_OP_INCR:
-		if (!pmap_is_set(pmap, field->pmap_bit)) {
-			switch (field->state) {
-			case FAST_STATE_UNDEFINED:
-				if (field_has_reset_value(field)) {
-					field->state = FAST_STATE_ASSIGNED;
-					field->uint_value = field->uint_reset;
-				} else {
-					if (field_is_mandatory(field)) {
-						ret = FAST_MSG_STATE_GARBLED;
-						goto fail;
-					} else
-						field->state = FAST_STATE_EMPTY;
-				}
+exit:
+	return ret;
+}
 
-				break;
-			case FAST_STATE_ASSIGNED:
-				field->uint_value++;
+/*
+ * Makes room for the values of nr_elements elements. They move, so strings
+ * that were in the old arena are pointed into the new one.
+ */
+int fast_sequence_reserve(struct fast_sequence *seq, unsigned long nr_elements)
+{
+	struct fast_message *elem = &seq->element;
+	unsigned long nr_fields = elem->nr_fields;
+	unsigned long strings_size = 0;
+	struct fast_field *values;
+	unsigned long max_elements;
+	struct fast_field *field;
+	struct fast_field *old;
+	char *strings = NULL;
+	unsigned long offset;
+	unsigned long i, j;
 
-				break;
-			case FAST_STATE_EMPTY:
-				if (field_is_mandatory(field)) {
-					ret = FAST_MSG_STATE_GARBLED;
-					goto fail;
-				}
+	if (nr_elements <= seq->max_elements)
+		return 0;
 
-				break;
-			default:
-				break;
-			}
-		} else {
-			ret = parse_uint(buffer, &field->uint_value);
+	if (nr_elements > FAST_SEQUENCE_MAX_ELEMENTS)
+		return -1;
 
-			if (ret)
-				goto fail;
+	max_elements = seq->max_elements ? seq->max_elements : FAST_SEQUENCE_ELEMENTS;
+	while (max_elements < nr_elements)
+		max_elements *= 2;
 
-			field->state = FAST_STATE_ASSIGNED;
+	/* Elements only need room for their values */
+	for (j = 0; j < nr_fields; j++) {
+		if (elem->fields[j].type == FAST_TYPE_STRING)
+			strings_size += elem->fields[j].string_size;
+	}
 
-			if (field_is_mandatory(field))
-				break;
+	values = calloc(max_elements * nr_fields, sizeof(struct fast_field));
+	if (!values)
+		return -1;
 
-			if (!field->uint_value)
-				field->state = FAST_STATE_EMPTY;
-			else
-				field->uint_value--;
+	if (strings_size) {
+		strings = calloc(max_elements, strings_size);
+		if (!strings) {
+			free(values);
+			return -1;
 		}
 
-		break;
-	case FAST_OP_DELTA:
-		ret = parse_int(buffer, &tmp);
+		if (seq->strings)
+			memcpy(strings, seq->strings, seq->max_elements * strings_size);
+	}
 
-		if (ret)
-			goto fail;
+	for (i = 0; i < max_elements; i++) {
+		offset = i * strings_size;
 
-		field->state = FAST_STATE_ASSIGNED;
+		for (j = 0; j < nr_fields; j++) {
+			field = values + i * nr_fields + j;
 
-		if (tmp < 0)
-			field->uint_value -= (-tmp);
-		else
-			field->uint_value += tmp;
+			if (i < seq->max_elements) {
+				old = seq->values + i * nr_fields + j;
+				*field = *old;
+			} else {
+				old = NULL;
+				*field = elem->fields[j];
+				field->state = FAST_STATE_UNDEFINED;
+			}
 
-		if (field_is_mandatory(field))
-			break;
+			if (field->type != FAST_TYPE_STRING)
+				continue;
 
-		if (!tmp)
-			field->state = FAST_STATE_EMPTY;
-		else if (tmp > 0)
-			field->uint_value--;
+			field->string_buf = strings + offset;
+			offset += field->string_size;
 
-		break;
-	case FAST_OP_CONSTANT:
-		if (field->state != FAST_STATE_ASSIGNED)
-			field->uint_value = field->uint_reset;
+			if (!old) {
+				field->string_value = field->string_buf;
+				field->string_len = 0;
+			} else if (old->string_value == old->string_buf)
+				field->string_value = field->string_buf;
+		}
+	}
 
-		field->state = FAST_STATE_ASSIGNED;
+	free(seq->values);
+	free(seq->strings);
 
-		if (field_is_mandatory(field))
-			break;
+	seq->max_elements	= max_elements;
+	seq->values		= values;
+	seq->strings		= strings;
 
-		if (!pmap_is_set(pmap, field->pmap_bit))
-			field->state = FAST_STATE_EMPTY;
+	return 0;
+}
+
+static int fast_encode_field(struct buffer *buffer, struct fast_pmap *pmap, struct fast_dictionary *dict,
+			     struct fast_field *field)
+{
+	int ret;
+
+	if (field->slot && fast_dict_load_previous(dict, field))
+		return -1;
 
+	switch (field->type) {
+	case FAST_TYPE_INT:
+		ret = fast_encode_int(buffer, pmap, field, FAST_FIELD_ARGS(field));
+		break;
+	case FAST_TYPE_UINT:
+		ret = fast_encode_uint(buffer, pmap, field, FAST_FIELD_ARGS(field));
 		break;
+	case FAST_TYPE_STRING:
+		ret = fast_encode_string(buffer, pmap, field, FAST_FIELD_ARGS(field));
+		break;
+	case FAST_TYPE_DECIMAL:
+		if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS))
+			ret = fast_encode_decimal_parts(buffer, pmap, field, FAST_DECIMAL_PARTS_ARGS(field));
+		else
+			ret = fast_encode_decimal(buffer, pmap, field, FAST_FIELD_ARGS(field));
+		break;
+	case FAST_TYPE_SEQUENCE:
 	default:
-		return FAST_MSG_STATE_GARBLED;
-	};
+		return -1;
+	}
 
-	return 0;
+	if (ret)
+		return -1;
 
-fail:
-	return ret;
+	if (field->slot)
+		fast_dict_store_previous(dict, field);
+
+	return 0;
 }
 
-static int fast_decode_int(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+static int fast_encode_sequence(struct buffer *buffer, struct fast_pmap *pmap, struct fast_dictionary *dict,
+				struct fast_field *field)
 {
-	int ret = 0;
-	i64 tmp;
-
-	switch (field->op) {
-	case FAST_OP_NONE:
-		ret = parse_int(buffer, &field->int_value);
-
-		if (ret)
-			goto fail;
+	struct fast_sequence *seq;
+	struct fast_message *elem;
+	struct fast_pmap spmap;
+	struct fast_field *cur;
+	unsigned long offset = 0;
+	unsigned long i, j;
+	int pmap_req;
 
-		field->state = FAST_STATE_ASSIGNED;
+	seq = field->ptr_value;
+	elem = &seq->element;
 
-		if (field_is_mandatory(field))
-			break;
+	if (fast_encode_uint(buffer, pmap, &seq->length, FAST_FIELD_ARGS(&seq->length)))
+		return -1;
 
-		if (!field->int_value)
-			field->state = FAST_STATE_EMPTY;
-		else if (field->int_value > 0)
-			field->int_value--;
+	if (field_state_empty(&seq->length))
+		return field_is_mandatory(field) ? -1 : 0;
 
-		break;
-	case FAST_OP_COPY:
-		if (!pmap_is_set(pmap, field->pmap_bit)) {
-			switch (field->state) {
-			case FAST_STATE_UNDEFINED:
-				if (field_has_reset_value(field)) {
-					field->state = FAST_STATE_ASSIGNED;
-					field->int_value = field->int_reset;
-				} else {
-					if (field_is_mandatory(field)) {
-						ret = FAST_MSG_STATE_GARBLED;
-						goto fail;
-					} else
-						field->state = FAST_STATE_EMPTY;
-				}
+	if (seq->length.uint_value > seq->max_elements)
+		return -1;
 
-				break;
-			case FAST_STATE_ASSIGNED:
-				break;
-			case FAST_STATE_EMPTY:
-				if (field_is_mandatory(field)) {
-					ret = FAST_MSG_STATE_GARBLED;
-					goto fail;
-				}
+	pmap_req = field_has_flags(field, FAST_FIELD_FLAGS_PMAPREQ);
+	spmap.nr_bytes = 0;
 
-				break;
-			default:
-				break;
-			}
-		} else {
-			ret = parse_int(buffer, &field->int_value);
+	for (i = 0; i < seq->length.uint_value; i++) {
+		if (pmap_req) {
+			if (fast_pmap_reserve(buffer, &spmap, &offset))
+				return -1;
+		}
 
-			if (ret)
-				goto fail;
+		cur = fast_sequence_element(seq, i);
 
-			field->state = FAST_STATE_ASSIGNED;
+		for (j = 0; j < elem->nr_fields; j++) {
+			field = elem->fields + j;
 
-			if (field_is_mandatory(field))
-				break;
+			field_copy_value(field, cur + j);
 
-			if (!field->int_value)
-				field->state = FAST_STATE_EMPTY;
-			else if (field->int_value > 0)
-				field->int_value--;
+			if (fast_encode_field(buffer, &spmap, dict, field))
+				return -1;
 		}
 
-		break;
-	case FAST_OP_INCR:
-		if (!pmap_is_set(pmap, field->pmap_bit)) {
-			switch (field->state) {
-			case FAST_STATE_UNDEFINED:
-				if (field_has_reset_value(field)) {
-					field->state = FAST_STATE_ASSIGNED;
-					field->int_value = field->int_reset;
-				} else {
-					if (field_is_mandatory(field)) {
-						ret = FAST_MSG_STATE_GARBLED;
-						goto fail;
-					} else
-						field->state = FAST_STATE_EMPTY;
-				}
+		if (pmap_req)
+			fast_pmap_commit(buffer, &spmap, offset);
+	}
 
-				break;
-			case FAST_STATE_ASSIGNED:
-				field->int_value++;
+	return 0;
+}
 
-				break;
-			case FAST_STATE_EMPTY:
-				if (field_is_mandatory(field)) {
-					ret = FAST_MSG_STATE_GARBLED;
-					goto fail;
-				}
+void fast_tid_map_free(struct fast_tid_map *map)
+{
+	free(map->direct);
+	free(map->hash);
 
-				break;
-			default:
-				break;
-			}
-		} else {
-			ret = parse_int(buffer, &field->int_value);
+	map->nr_direct = 0;
+	map->direct = NULL;
 
-			if (ret)
-				goto fail;
+	map->hash_bits = 0;
+	map->hash = NULL;
+}
 
-			field->state = FAST_STATE_ASSIGNED;
+int fast_tid_map_build(struct fast_tid_map *map, struct fast_message *msgs, unsigned long nr_messages)
+{
+	unsigned long nr_direct = 0;
+	unsigned long nr_hashed = 0;
+	struct fast_message *msg;
+	unsigned long bound;
+	unsigned long mask;
+	unsigned long i, j;
 
-			if (field_is_mandatory(field))
-				break;
+	fast_tid_map_free(map);
 
-			if (!field->int_value)
-				field->state = FAST_STATE_EMPTY;
-			else if (field->int_value > 0)
-				field->int_value--;
-		}
+	bound = 2 * nr_messages;
+	if (bound < FAST_TID_DIRECT_MIN)
+		bound = FAST_TID_DIRECT_MIN;
 
-		break;
-	case FAST_OP_DELTA:
-		ret = parse_int(buffer, &tmp);
+	for (i = 0; i < nr_messages; i++) {
+		msg = msgs + i;
 
-		if (ret)
+		if (msg->tid < bound) {
+			if (msg->tid >= nr_direct)
+				nr_direct = msg->tid + 1;
+		} else
+			nr_hashed++;
+	}
+
+	if (nr_direct) {
+		map->direct = calloc(nr_direct, sizeof(struct fast_message *));
+		if (!map->direct)
 			goto fail;
 
-		field->state = FAST_STATE_ASSIGNED;
-		field->int_value += tmp;
+		map->nr_direct = nr_direct;
+	}
 
-		if (field_is_mandatory(field))
-			break;
+	if (nr_hashed) {
+		/* Keep the table at most half full */
+		map->hash_bits = 1;
+		while ((1UL << map->hash_bits) < 2 * nr_hashed)
+			map->hash_bits++;
 
-		if (!tmp)
-			field->state = FAST_STATE_EMPTY;
-		else if (tmp > 0)
-			field->int_value--;
+		map->hash = calloc(1UL << map->hash_bits, sizeof(struct fast_message *));
+		if (!map->hash)
+			goto fail;
+	}
 
-		break;
-	case FAST_OP_CONSTANT:
-		if (field->state != FAST_STATE_ASSIGNED)
-			field->int_value = field->int_reset;
+	mask = (1UL << map->hash_bits) - 1;
 
-		field->state = FAST_STATE_ASSIGNED;
+	/* The first template wins when ids are duplicated */
+	for (i = nr_messages; i > 0; i--) {
+		msg = msgs + i - 1;
 
-		if (field_is_mandatory(field))
-			break;
+		if (msg->tid < map->nr_direct) {
+			map->direct[msg->tid] = msg;
+			continue;
+		}
 
-		if (!pmap_is_set(pmap, field->pmap_bit))
-			field->state = FAST_STATE_EMPTY;
+		for (j = fast_tid_hash(msg->tid, map->hash_bits); map->hash[j]; j = (j + 1) & mask) {
+			if (map->hash[j]->tid == msg->tid)
+				break;
+		}
 
-		break;
-	default:
-		return FAST_MSG_STATE_GARBLED;
+		map->hash[j] = msg;
 	}
 
 	return 0;
 
 fail:
-	return ret;
+	fast_tid_map_free(map);
+
+	return -1;
 }
 
-static int fast_decode_unicode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+static unsigned long fields_max_slot(struct fast_message *msg, unsigned long max)
 {
-	int ret;
-	u64 len;
+	struct fast_field *field;
+	unsigned long i;
 
-	switch (field->op) {
-	case FAST_OP_NONE:
-		ret = parse_uint(buffer, &len);
-		if (ret)
-			goto fail;
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-		field->state = FAST_STATE_ASSIGNED;
+		if (field->type == FAST_TYPE_SEQUENCE)
+			max = fields_max_slot(&((struct fast_sequence *) field->ptr_value)->element, max);
+		else if (field->slot > max)
+			max = field->slot;
+	}
 
-		if (!field_is_mandatory(field)) {
-			if (!len) {
-				field->state = FAST_STATE_EMPTY;
-				break;
-			} else
-				len--;
-		}
+	return max;
+}
 
-		ret = parse_bytes(buffer, field->string_value, len);
-		if (ret)
-			goto fail;
+/*
+ * Counts the fields of every key and checks that they agree on the type of
+ * the value, the first field of a key stands for the rest in @first.
+ */
+static int fields_count_slots(struct fast_message *msg, struct fast_field **first, unsigned long *counts)
+{
+	struct fast_field *field;
+	unsigned long i;
 
-		memset(field->string_value + len, 0, sizeof(u64));
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-		break;
-	case FAST_OP_COPY:
-		if (!pmap_is_set(pmap, field->pmap_bit)) {
-			switch (field->state) {
-			case FAST_STATE_UNDEFINED:
-				if (field_has_reset_value(field)) {
-					field->state = FAST_STATE_ASSIGNED;
-					memcpy(field->string_value, field->string_reset,
-								strlen(field->string_reset) + 1);
-				} else {
-					if (field_is_mandatory(field)) {
-						ret = FAST_MSG_STATE_GARBLED;
-						goto fail;
-					} else
-						field->state = FAST_STATE_EMPTY;
-				}
+		if (field->type == FAST_TYPE_SEQUENCE) {
+			if (fields_count_slots(&((struct fast_sequence *) field->ptr_value)->element, first, counts))
+				return -1;
 
-				break;
-			case FAST_STATE_ASSIGNED:
-				break;
-			case FAST_STATE_EMPTY:
-				if (field_is_mandatory(field)) {
-					ret = FAST_MSG_STATE_GARBLED;
-					goto fail;
-				}
+			continue;
+		}
 
-				break;
-			default:
-				break;
-			}
-		} else {
-			ret = parse_uint(buffer, &len);
+		if (!field->slot)
+			continue;
 
-			if (ret)
-				goto fail;
+		if (!counts[field->slot]++) {
+			first[field->slot] = field;
+			continue;
+		}
 
-			field->state = FAST_STATE_ASSIGNED;
+		if (field->type != first[field->slot]->type)
+			return -1;
 
-			if (!field_is_mandatory(field)) {
-				if (!len) {
-					field->state = FAST_STATE_EMPTY;
-					break;
-				} else
-					len--;
-			}
+		if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE) !=
+		    field_has_flags(first[field->slot], FAST_FIELD_FLAGS_UNICODE))
+			return -1;
 
-			ret = parse_bytes(buffer, field->string_value, len);
-			if (ret)
-				goto fail;
+		if (field->string_size > first[field->slot]->string_size)
+			first[field->slot] = field;
+	}
 
-			memset(field->string_value + len, 0, sizeof(u64));
-		}
+	return 0;
+}
 
-		break;
-	case FAST_OP_INCR:
-			ret = FAST_MSG_STATE_GARBLED;
-			goto fail;
-	case FAST_OP_DELTA:
-			ret = FAST_MSG_STATE_GARBLED;
-			goto fail;
-	case FAST_OP_CONSTANT:
-		if (field->state != FAST_STATE_ASSIGNED)
-			memcpy(field->string_value, field->string_reset,
-						strlen(field->string_reset) + 1);
+static void fields_map_slots(struct fast_message *msg, unsigned long *map)
+{
+	struct fast_field *field;
+	unsigned long i;
 
-		field->state = FAST_STATE_ASSIGNED;
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-		if (field_is_mandatory(field))
-			break;
+		if (field->type == FAST_TYPE_SEQUENCE)
+			fields_map_slots(&((struct fast_sequence *) field->ptr_value)->element, map);
+		else
+			field->slot = map[field->slot];
+	}
+}
 
-		if (!pmap_is_set(pmap, field->pmap_bit))
-			field->state = FAST_STATE_EMPTY;
+static void fast_dict_entry_reset(struct fast_dict_entry *entry, struct fast_field *field)
+{
+	switch (field->type) {
+	case FAST_TYPE_INT:
+		entry->int_value = field->has_reset ? field->int_reset : 0;
+		break;
+	case FAST_TYPE_UINT:
+		entry->uint_value = field->has_reset ? field->uint_reset : 0;
+		break;
+	case FAST_TYPE_STRING:
+		if (field->has_reset)
+			strcpy(entry->string_value, field->string_reset);
+		else
+			entry->string_value[0] = 0;
 
+		entry->string_len = strlen(entry->string_value);
 		break;
+	case FAST_TYPE_DECIMAL:
+		if (field->has_reset)
+			entry->decimal_value = field->decimal_reset;
+		else
+			entry->decimal_value = (struct fast_decimal) { 0, 0 };
+
+		break;
+	case FAST_TYPE_SEQUENCE:
 	default:
-		return FAST_MSG_STATE_GARBLED;
+		break;
 	}
-
-	return 0;
-
-fail:
-	return ret;
 }
 
-static int fast_decode_ascii(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+/*
+ * Resets the entries of the message's keys that nobody has used since the
+ * dictionary generation moved on. Like fast_message_reset(), the values go
+ * back to the initial values of the fields and the states are left alone.
+ */
+static void fast_dictionary_catch_up(struct fast_dictionary *dict, struct fast_message *msg)
 {
-	int ret;
+	struct fast_dict_entry *entry;
+	struct fast_field *field;
+	unsigned long i;
 
-	switch (field->op) {
-	case FAST_OP_NONE:
-		ret = parse_string(buffer, field->string_value);
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-		if (ret < 0)
-			goto fail;
+		if (field->type == FAST_TYPE_SEQUENCE) {
+			fast_dictionary_catch_up(dict, &((struct fast_sequence *) field->ptr_value)->element);
+			continue;
+		}
 
-		field->state = FAST_STATE_ASSIGNED;
+		if (!field->slot)
+			continue;
 
-		if (field_is_mandatory(field))
-			break;
+		entry = dict->entries + field->slot;
+		if (entry->generation == dict->generation)
+			continue;
 
-		if (ret == 1)
-			field->state = FAST_STATE_EMPTY;
+		fast_dict_entry_reset(entry, field);
+		entry->generation = dict->generation;
+	}
+}
 
-		break;
-	case FAST_OP_COPY:
-		if (!pmap_is_set(pmap, field->pmap_bit)) {
-			switch (field->state) {
-			case FAST_STATE_UNDEFINED:
-				if (field_has_reset_value(field)) {
-					field->state = FAST_STATE_ASSIGNED;
-					memcpy(field->string_value, field->string_reset,
-								strlen(field->string_reset) + 1);
-				} else {
-					if (field_is_mandatory(field)) {
-						ret = FAST_MSG_STATE_GARBLED;
-						goto fail;
-					} else
-						field->state = FAST_STATE_EMPTY;
-				}
+void fast_dictionary_free(struct fast_dictionary *dict)
+{
+	free(dict->entries);
+	free(dict->strings);
 
-				break;
-			case FAST_STATE_ASSIGNED:
-				break;
-			case FAST_STATE_EMPTY:
-				if (field_is_mandatory(field)) {
-					ret = FAST_MSG_STATE_GARBLED;
-					goto fail;
-				}
+	dict->nr_slots = 0;
+	dict->entries = NULL;
+	dict->strings = NULL;
+}
 
-				break;
-			default:
-				break;
-			}
-		} else {
-			ret = parse_string(buffer, field->string_value);
+/* Copies the entries and their strings, as they are, for another session */
+int fast_dictionary_clone(struct fast_dictionary *dst, struct fast_dictionary *src)
+{
+	unsigned long strings_size = 0;
+	struct fast_dict_entry *entry;
+	unsigned long i;
+	char *strings;
 
-			if (ret < 0)
-				goto fail;
+	fast_dictionary_free(dst);
 
-			field->state = FAST_STATE_ASSIGNED;
+	dst->generation = src->generation;
 
-			if (field_is_mandatory(field))
-				break;
+	if (!src->entries)
+		return 0;
 
-			if (ret == 1)
-				field->state = FAST_STATE_EMPTY;
-		}
+	for (i = 1; i <= src->nr_slots; i++) {
+		if (src->entries[i].type == FAST_TYPE_STRING)
+			strings_size += src->entries[i].string_size;
+	}
 
-		break;
-	case FAST_OP_INCR:
-			ret = FAST_MSG_STATE_GARBLED;
-			goto fail;
-	case FAST_OP_DELTA:
-			ret = FAST_MSG_STATE_GARBLED;
+	dst->entries = malloc((src->nr_slots + 1) * sizeof(struct fast_dict_entry));
+	if (!dst->entries)
+		goto fail;
+
+	memcpy(dst->entries, src->entries, (src->nr_slots + 1) * sizeof(struct fast_dict_entry));
+
+	if (strings_size) {
+		dst->strings = malloc(strings_size);
+		if (!dst->strings)
 			goto fail;
-	case FAST_OP_CONSTANT:
-		if (field->state != FAST_STATE_ASSIGNED)
-			memcpy(field->string_value, field->string_reset,
-						strlen(field->string_reset) + 1);
 
-		field->state = FAST_STATE_ASSIGNED;
+		memcpy(dst->strings, src->strings, strings_size);
+	}
+
+	dst->nr_slots = src->nr_slots;
 
-		if (field_is_mandatory(field))
-			break;
+	for (i = 1, strings = dst->strings; i <= dst->nr_slots; i++) {
+		entry = dst->entries + i;
 
-		if (!pmap_is_set(pmap, field->pmap_bit))
-			field->state = FAST_STATE_EMPTY;
+		if (entry->type != FAST_TYPE_STRING)
+			continue;
 
-		break;
-	default:
-		return FAST_MSG_STATE_GARBLED;
+		entry->string_value = strings;
+		strings += entry->string_size;
 	}
 
 	return 0;
 
 fail:
-	return ret;
-}
+	fast_dictionary_free(dst);
 
-static int fast_decode_string(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
-{
-	if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE))
-		return fast_decode_unicode(buffer, pmap, field);
-	else
-		return fast_decode_ascii(buffer, pmap, field);
+	return -1;
 }
 
-static int fast_decode_decimal(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+/*
+ * Turns the keys that the template parser numbered the fields with into
+ * dictionary entries. A key that only one field has is of no use to share,
+ * so such a field goes back to its own dictionary and the others are
+ * numbered again from one. Fields of a key that disagree on the type of
+ * their value are an error.
+ */
+int fast_dictionary_build(struct fast_dictionary *dict, struct fast_message *msgs, unsigned long nr_messages)
 {
-	int ret = 0;
-	i64 exp, mnt;
+	struct fast_field **first = NULL;
+	unsigned long *counts = NULL;
+	unsigned long strings_size = 0;
+	struct fast_dict_entry *entry;
+	unsigned long nr_keys = 0;
+	unsigned long nr_slots;
+	unsigned long offset;
+	unsigned long i;
+	int ret = -1;
 
-	switch (field->op) {
-	case FAST_OP_NONE:
-		ret = parse_int(buffer, &exp);
+	fast_dictionary_free(dict);
 
-		if (ret)
-			goto fail;
+	for (i = 0; i < nr_messages; i++)
+		nr_keys = fields_max_slot(msgs + i, nr_keys);
 
-		field->state = FAST_STATE_ASSIGNED;
+	first = calloc(nr_keys + 1, sizeof(*first));
+	counts = calloc(nr_keys + 1, sizeof(*counts));
+	if (!first || !counts)
+		goto exit;
 
-		if (!field_is_mandatory(field)) {
-			if (!exp) {
-				field->state = FAST_STATE_EMPTY;
-				break;
-			} else if (exp > 0)
-				exp--;
-		}
+	for (i = 0; i < nr_messages; i++) {
+		if (fields_count_slots(msgs + i, first, counts))
+			goto exit;
+	}
 
-		if (exp > 63 || exp < -63) {
-			ret = FAST_MSG_STATE_GARBLED;
-			goto fail;
+	/* The counts become the new slots */
+	nr_slots = 0;
+
+	for (i = 1; i <= nr_keys; i++) {
+		if (counts[i] < 2) {
+			counts[i] = 0;
+			continue;
 		}
 
-		ret = parse_int(buffer, &mnt);
+		counts[i] = ++nr_slots;
+		first[nr_slots] = first[i];
 
-		if (ret)
-			goto fail;
+		if (first[i]->type == FAST_TYPE_STRING)
+			strings_size += first[i]->string_size;
+	}
 
-		field->decimal_value.exp = exp;
-		field->decimal_value.mnt = mnt;
+	dict->entries = calloc(nr_slots + 1, sizeof(struct fast_dict_entry));
+	if (!dict->entries)
+		goto exit;
 
-		break;
-	case FAST_OP_COPY:
-		if (!pmap_is_set(pmap, field->pmap_bit)) {
-			switch (field->state) {
-			case FAST_STATE_UNDEFINED:
-				if (field_has_reset_value(field)) {
-					field->state = FAST_STATE_ASSIGNED;
-					field->decimal_value.exp = field->decimal_reset.exp;
-					field->decimal_value.mnt = field->decimal_reset.mnt;
-				} else {
-					if (field_is_mandatory(field)) {
-						ret = FAST_MSG_STATE_GARBLED;
-						goto fail;
-					} else
-						field->state = FAST_STATE_EMPTY;
-				}
+	if (strings_size) {
+		dict->strings = calloc(1, strings_size);
+		if (!dict->strings)
+			goto exit;
+	}
 
-				break;
-			case FAST_STATE_ASSIGNED:
-				break;
-			case FAST_STATE_EMPTY:
-				if (field_is_mandatory(field)) {
-					ret = FAST_MSG_STATE_GARBLED;
-					goto fail;
-				}
+	dict->nr_slots = nr_slots;
 
-				break;
-			default:
-				break;
-			}
-		} else {
-			ret = parse_int(buffer, &exp);
+	for (i = 0, offset = 0; i < nr_messages; i++) {
+		fields_map_slots(msgs + i, counts);
 
-			if (ret)
-				goto fail;
+		msgs[i].dictionary = dict;
+		msgs[i].generation = dict->generation;
+	}
 
-			field->state = FAST_STATE_ASSIGNED;
+	for (i = 1; i <= nr_slots; i++) {
+		entry = dict->entries + i;
 
-			if (!field_is_mandatory(field)) {
-				if (!exp) {
-					field->state = FAST_STATE_EMPTY;
-					break;
-				} else if (exp > 0)
-					exp--;
-			}
+		entry->type		= first[i]->type;
+		entry->state		= FAST_STATE_UNDEFINED;
+		entry->generation	= dict->generation;
 
-			if (exp > 63 || exp < -63) {
-				ret = FAST_MSG_STATE_GARBLED;
-				goto fail;
-			}
+		if (entry->type == FAST_TYPE_STRING) {
+			entry->string_size	= first[i]->string_size;
+			entry->string_value	= dict->strings + offset;
 
-			ret = parse_int(buffer, &mnt);
+			offset += entry->string_size;
+		}
 
-			if (ret)
-				goto fail;
+		fast_dict_entry_reset(entry, first[i]);
+	}
 
-			field->decimal_value.exp = exp;
-			field->decimal_value.mnt = mnt;
-		}
+	ret = 0;
 
-		break;
+exit:
+	if (ret)
+		fast_dictionary_free(dict);
+
+	free(counts);
+	free(first);
+
+	return ret;
+}
+
+static bool field_has_previous(struct fast_field *field)
+{
+	switch (field->op) {
+	case FAST_OP_COPY:
 	case FAST_OP_INCR:
-		/* Do not applicable to decimal */
-		ret = FAST_MSG_STATE_GARBLED;
-		goto fail;
 	case FAST_OP_DELTA:
-		ret = parse_int(buffer, &exp);
+	case FAST_OP_TAIL:
+		return true;
+	case FAST_OP_NONE:
+	case FAST_OP_CONSTANT:
+	default:
+		break;
+	}
 
-		if (ret)
-			goto fail;
+	return false;
+}
 
-		field->state = FAST_STATE_ASSIGNED;
-		field->decimal_value.exp += exp;
+#define	SHADOW_SHORT_STRING	16
 
-		if (!field_is_mandatory(field)) {
-			if (!exp) {
-				field->state = FAST_STATE_EMPTY;
-				break;
-			} else if (exp > 0)
-				field->decimal_value.exp--;
-		}
+/* Fields are saved by kind so that saving them does not branch on it */
+enum shadow_kind {
+	SHADOW_SCALAR,
+	SHADOW_STRING,
+	SHADOW_ENTRY,
+	SHADOW_NONE,
+};
 
-		if (field->decimal_value.exp > 63 ||
-			field->decimal_value.exp < -63) {
-			ret = FAST_MSG_STATE_GARBLED;
-			goto fail;
-		}
+static enum shadow_kind shadow_kind(struct fast_field *field)
+{
+	if (field->slot)
+		return SHADOW_ENTRY;
 
-		ret = parse_int(buffer, &mnt);
+	if (!field_has_previous(field))
+		return SHADOW_NONE;
 
-		if (ret)
-			goto fail;
+	if (field->type == FAST_TYPE_STRING)
+		return SHADOW_STRING;
+
+	return SHADOW_SCALAR;
+}
 
-		field->decimal_value.mnt += mnt;
+static unsigned long shadow_add(struct fast_field *field, enum shadow_kind kind, struct fast_field **fields, unsigned long nr)
+{
+	if (shadow_kind(field) != kind)
+		return nr;
 
-		break;
-	case FAST_OP_CONSTANT:
-		if (field->state != FAST_STATE_ASSIGNED) {
-			field->decimal_value.exp = field->decimal_reset.exp;
-			field->decimal_value.mnt = field->decimal_reset.mnt;
-		}
+	if (fields)
+		fields[nr] = field;
 
-		field->state = FAST_STATE_ASSIGNED;
+	return nr + 1;
+}
 
-		if (field_is_mandatory(field))
-			break;
+/* Counts the fields of a kind, and lists them if fields is not NULL */
+static unsigned long fields_shadow(struct fast_message *msg, enum shadow_kind kind, struct fast_field **fields, unsigned long nr)
+{
+	struct fast_decimal_parts *parts;
+	struct fast_sequence *seq;
+	struct fast_field *field;
+	unsigned long i;
 
-		if (!pmap_is_set(pmap, field->pmap_bit))
-			field->state = FAST_STATE_EMPTY;
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-		break;
-	default:
-		return FAST_MSG_STATE_GARBLED;
+		if (field->type == FAST_TYPE_SEQUENCE) {
+			seq = field->ptr_value;
+
+			nr = shadow_add(&seq->length, kind, fields, nr);
+			nr = fields_shadow(&seq->element, kind, fields, nr);
+			continue;
+		}
+
+		if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS)) {
+			parts = field_decimal_parts(field);
+
+			nr = shadow_add(&parts->exponent, kind, fields, nr);
+			nr = shadow_add(&parts->mantissa, kind, fields, nr);
+		}
+
+		nr = shadow_add(field, kind, fields, nr);
 	}
 
-	return 0;
+	return nr;
+}
 
-fail:
-	return ret;
+static void fast_shadow_free(struct fast_shadow *shadow)
+{
+	free(shadow->strings);
+	free(shadow->values);
+	free(shadow->fields);
+
+	memset(shadow, 0, sizeof(*shadow));
 }
 
-static int fast_decode_sequence(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+static int fast_shadow_build(struct fast_message *msg)
 {
-	struct fast_sequence *seq;
-	unsigned long nr_fields;
-	struct fast_pmap spmap;
-	struct fast_field *cur;
-	int pmap_req;
-	int ret = 0;
-	int i, j;
+	struct fast_shadow *shadow = &msg->shadow;
+	unsigned long strings_size = 0;
+	struct fast_dict_entry *value;
+	struct fast_field *field;
+	unsigned long nr, i;
+	char *strings;
 
-	seq = field->ptr_value;
+	shadow->nr_scalars = fields_shadow(msg, SHADOW_SCALAR, NULL, 0);
+	shadow->nr_strings = fields_shadow(msg, SHADOW_STRING, NULL, 0);
 
-	ret = fast_decode_uint(buffer, pmap, &seq->length);
+	nr = fields_shadow(msg, SHADOW_ENTRY, NULL, shadow->nr_scalars + shadow->nr_strings);
 
-	if (ret)
-		goto exit;
+	/* Templates that do not use the dictionary are built all the same */
+	shadow->fields = calloc(nr + 1, sizeof(struct fast_field *));
+	shadow->values = calloc(nr + 1, sizeof(struct fast_dict_entry));
+	if (!shadow->fields || !shadow->values)
+		goto fail;
 
-	if (field_state_empty(&seq->length)) {
-		if (field_is_mandatory(field))
-			ret = FAST_MSG_STATE_GARBLED;
+	fields_shadow(msg, SHADOW_SCALAR, shadow->fields, 0);
+	fields_shadow(msg, SHADOW_STRING, shadow->fields, shadow->nr_scalars);
+	fields_shadow(msg, SHADOW_ENTRY, shadow->fields, shadow->nr_scalars + shadow->nr_strings);
 
-		goto exit;
-	}
+	for (i = 0; i < nr; i++) {
+		field = shadow->fields[i];
+		value = shadow->values + i;
 
-	if (seq->length.uint_value >= FAST_SEQUENCE_ELEMENTS) {
-		ret = FAST_MSG_STATE_GARBLED;
-		goto exit;
+		value->type = field->type;
+
+		if (field->slot)
+			value->string_size = fast_dict_entry(msg->dictionary, field)->string_size;
+		else if (field->type == FAST_TYPE_STRING)
+			value->string_size = field->string_size;
+
+		strings_size += value->string_size;
 	}
 
-	pmap_req = field_has_flags(field, FAST_FIELD_FLAGS_PMAPREQ);
+	if (strings_size) {
+		shadow->strings = malloc(strings_size);
+		if (!shadow->strings)
+			goto fail;
+	}
 
-	for (i = 1; i <= seq->length.uint_value; i++) {
-		if (pmap_req) {
-			ret = parse_pmap(buffer, &spmap);
+	for (i = 0, strings = shadow->strings; i < nr; i++) {
+		value = shadow->values + i;
 
-			if (ret)
-				goto exit;
-		}
+		if (value->type != FAST_TYPE_STRING)
+			continue;
 
-		nr_fields = seq->elements->nr_fields;
+		value->string_value = strings;
+		strings += value->string_size;
+	}
 
-		for (j = 0; j < nr_fields; j++) {
-			cur = (seq->elements + i)->fields + j;
-			field = seq->elements->fields + j;
+	shadow->nr_fields = nr;
 
-			switch (field->type) {
-			case FAST_TYPE_INT:
-				ret = fast_decode_int(buffer, &spmap, field);
-				if (ret)
-					goto exit;
+	return 0;
 
-				cur->int_value = field->int_value;
-				cur->state = field->state;
-				break;
-			case FAST_TYPE_UINT:
-				ret = fast_decode_uint(buffer, &spmap, field);
-				if (ret)
-					goto exit;
+fail:
+	fast_shadow_free(shadow);
 
-				cur->uint_value = field->uint_value;
-				cur->state = field->state;
-				break;
-			case FAST_TYPE_STRING:
-				ret = fast_decode_string(buffer, &spmap, field);
-				if (ret)
-					goto exit;
+	return -1;
+}
 
-				strcpy(cur->string_value, field->string_value);
-				cur->state = field->state;
-				break;
-			case FAST_TYPE_DECIMAL:
-				ret = fast_decode_decimal(buffer, &spmap, field);
-				if (ret)
-					goto exit;
-
-				cur->decimal_value.exp = field->decimal_value.exp;
-				cur->decimal_value.mnt = field->decimal_value.mnt;
-				cur->state = field->state;
-				break;
-			case FAST_TYPE_SEQUENCE:
-				/* At the moment we do no support nested sequences */
-				ret = FAST_MSG_STATE_GARBLED;
+static void fast_dict_entry_copy(struct fast_dict_entry *dst, struct fast_dict_entry *src)
+{
+	dst->state		= src->state;
+	dst->generation		= src->generation;
 
-				if (ret)
-					goto exit;
-				break;
-			default:
-				ret = FAST_MSG_STATE_GARBLED;
-				goto exit;
-			}
-		}
+	if (src->type != FAST_TYPE_STRING) {
+		dst->decimal_value = src->decimal_value;
+		return;
 	}
 
-exit:
-	return ret;
+	memcpy(dst->string_value, src->string_value, src->string_len + 1);
+	dst->string_len = src->string_len;
 }
 
-static inline struct fast_message *fast_get_msg(struct fast_message *msgs, int tid)
+static void fast_shadow_save(struct fast_message *msg)
 {
-	int i;
+	struct fast_shadow *shadow = &msg->shadow;
+	struct fast_dict_entry *value;
+	struct fast_field *field;
+	unsigned long i;
+
+	for (i = 0; i < shadow->nr_scalars; i++) {
+		field = shadow->fields[i];
+		value = shadow->values + i;
 
-	for (i = 0; i < FAST_TEMPLATE_MAX_NUMBER; i++) {
-		if (msgs[i].tid == tid)
-			return &msgs[i];
+		value->state		= field->state;
+		value->decimal_value	= field->decimal_value;
 	}
 
-	return NULL;
+	for (; i < shadow->nr_scalars + shadow->nr_strings; i++) {
+		field = shadow->fields[i];
+		value = shadow->values + i;
+
+		/*
+		 * Short values are copied a word at a time with room to spare.
+		 * Unicode values may be views, which are not NUL terminated and
+		 * have no room after them.
+		 */
+		if (field->string_len < SHADOW_SHORT_STRING && field->string_size >= SHADOW_SHORT_STRING &&
+		    field->string_value == field->string_buf)
+			memcpy(value->string_value, field->string_value, SHADOW_SHORT_STRING);
+		else
+			memcpy(value->string_value, field->string_value, field->string_len);
+
+		value->state		= field->state;
+		value->string_len	= field->string_len;
+	}
+
+	for (; i < shadow->nr_fields; i++)
+		fast_dict_entry_copy(shadow->values + i, fast_dict_entry(msg->dictionary, shadow->fields[i]));
 }
 
-struct fast_message *fast_message_decode(struct fast_message *msgs, struct buffer *buffer, u64 last_tid)
+static void fast_shadow_restore(struct fast_message *msg)
 {
-	struct fast_message *msg;
+	struct fast_shadow *shadow = &msg->shadow;
+	struct fast_dict_entry *value;
 	struct fast_field *field;
-	struct fast_pmap pmap;
 	unsigned long i;
-	int ret;
-	u64 tid;
 
-	ret = parse_pmap(buffer, &pmap);
-	if (ret)
-		goto fail;
+	for (i = 0; i < shadow->nr_scalars; i++) {
+		field = shadow->fields[i];
+		value = shadow->values + i;
 
-	if (pmap_is_set(&pmap, 0)) {
-		ret = parse_uint(buffer, &tid);
-		if (ret)
-			goto fail;
-	} else
-		tid = last_tid;
+		field->state		= value->state;
+		field->decimal_value	= value->decimal_value;
+	}
 
-	msg = fast_get_msg(msgs, tid);
+	for (; i < shadow->nr_scalars + shadow->nr_strings; i++) {
+		field = shadow->fields[i];
+		value = shadow->values + i;
 
-	if (!msg)
-		goto fail;
+		memcpy(field->string_buf, value->string_value, value->string_len);
+		field->string_buf[value->string_len] = '\0';
 
-	msg->pmap = &pmap;
+		field->state		= value->state;
+		field->string_value	= field->string_buf;
+		field->string_len	= value->string_len;
+	}
 
-	for (i = 0; i < msg->nr_fields; i++) {
-		field = msg->fields + i;
+	for (; i < shadow->nr_fields; i++)
+		fast_dict_entry_copy(fast_dict_entry(msg->dictionary, shadow->fields[i]), shadow->values + i);
+}
 
-		switch (field->type) {
-		case FAST_TYPE_INT:
-			ret = fast_decode_int(buffer, msg->pmap, field);
-			if (ret)
-				goto fail;
-			break;
-		case FAST_TYPE_UINT:
-			ret = fast_decode_uint(buffer, msg->pmap, field);
-			if (ret)
-				goto fail;
-			break;
-		case FAST_TYPE_STRING:
-			ret = fast_decode_string(buffer, msg->pmap, field);
-			if (ret)
-				goto fail;
-			break;
-		case FAST_TYPE_DECIMAL:
-			ret = fast_decode_decimal(buffer, msg->pmap, field);
-			if (ret)
-				goto fail;
-			break;
-		case FAST_TYPE_SEQUENCE:
-			ret = fast_decode_sequence(buffer, msg->pmap, field);
-			if (ret)
-				goto fail;
-			break;
-		default:
-			ret = FAST_MSG_STATE_GARBLED;
-			goto fail;
-		}
-	}
-
-	return msg;
-
-fail:
-	return NULL;
-}
-
-struct fast_message *fast_message_new(int nr_messages)
+static int fast_visit_field(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg,
+			    unsigned long i, struct fast_field *field)
 {
-	struct fast_message *self = calloc(nr_messages, sizeof *self);
+	int ret;
 
-	if (!self)
-		return NULL;
+	ret = fast_decode_field(buffer, pmap, msg->dictionary, field);
+	if (ret)
+		return ret;
+
+	switch (field->type) {
+	case FAST_TYPE_INT:
+		return fast_visit_int(msg, i, field);
+	case FAST_TYPE_UINT:
+		return fast_visit_uint(msg, i, field);
+	case FAST_TYPE_STRING:
+		return fast_visit_string(msg, i, field);
+	case FAST_TYPE_DECIMAL:
+		return fast_visit_decimal(msg, i, field);
+	case FAST_TYPE_SEQUENCE:
+	default:
+		break;
+	}
 
-	return self;
+	return FAST_MSG_STATE_GARBLED;
 }
 
-void fast_fields_free(struct fast_message *self)
+/* Elements go through the element template's fields, which hold the dictionary */
+static int fast_visit_sequence(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg, unsigned long idx)
 {
-	struct fast_sequence *seq;
-	struct fast_field *field;
-	int i, j;
-
-	if (!self)
-		return;
-
-	for (i = 0; i < self->nr_fields; i++) {
-		field = self->fields + i;
+	struct fast_field *field = msg->fields + idx;
+	struct fast_sequence *seq = field->ptr_value;
+	struct fast_message *elem = &seq->element;
+	struct fast_pmap spmap;
+	unsigned long i, j;
+	int ret;
 
-		if (field->type == FAST_TYPE_SEQUENCE) {
-			seq = field->ptr_value;
+	ret = fast_decode_uint(buffer, pmap, &seq->length, FAST_FIELD_ARGS(&seq->length));
+	if (ret)
+		return ret;
 
-			for (j = 0; j < FAST_SEQUENCE_ELEMENTS; j++)
-				free((seq->elements + j)->fields);
+	if (field_state_empty(&seq->length)) {
+		if (field_is_mandatory(field))
+			return FAST_MSG_STATE_GARBLED;
 
-			free(field->ptr_value);
-		}
+		return fast_visit_empty(msg, idx);
 	}
 
-	free(self->fields);
-}
-
-void fast_message_free(struct fast_message *self, int nr_messages)
-{
-	int i;
+	ret = fast_visit_sequence_begin(msg, idx, seq->length.uint_value);
+	if (ret)
+		return ret;
 
-	if (!self)
-		return;
+	spmap.nr_bytes = 0;
 
-	for (i = 0; i < nr_messages; i++)
-		fast_fields_free(self + i);
+	for (i = 0; i < seq->length.uint_value; i++) {
+		if (field_has_flags(field, FAST_FIELD_FLAGS_PMAPREQ)) {
+			ret = fast_get_pmap(buffer, &spmap);
+			if (ret)
+				return ret;
+		}
 
-	free(self);
+		for (j = 0; j < elem->nr_fields; j++) {
+			ret = fast_visit_field(buffer, &spmap, msg, j, elem->fields + j);
+			if (ret)
+				return ret;
+		}
+	}
 
-	return;
+	return fast_visit_sequence_end(msg, idx);
 }
 
-void fast_message_reset(struct fast_message *msg)
+static int fast_visit_fields(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
 {
-	struct fast_sequence *seq;
 	struct fast_field *field;
-	int i;
+	unsigned long i;
+	int ret;
 
 	for (i = 0; i < msg->nr_fields; i++) {
 		field = msg->fields + i;
 
-		switch (field->type) {
-		case FAST_TYPE_INT:
-			if (field->has_reset) {
-				field->int_value = field->int_reset;
-				field->int_previous = field->int_reset;
-			} else {
-				field->int_value = 0;
-				field->int_previous = 0;
-			}
-
-			break;
-		case FAST_TYPE_UINT:
-			if (field->has_reset) {
-				field->uint_value = field->uint_reset;
-				field->uint_previous = field->uint_reset;
-			} else {
-				field->uint_value = 0;
-				field->uint_previous = 0;
-			}
-
-			break;
-		case FAST_TYPE_STRING:
-			if (field->has_reset) {
-				strcpy(field->string_value, field->string_reset);
-				strcpy(field->string_previous, field->string_reset);
-			} else {
-				field->string_value[0] = 0;
-				field->string_previous[0] = 0;
-			}
-
-			break;
-		case FAST_TYPE_DECIMAL:
-			if (field->has_reset) {
-				field->decimal_value.exp = field->decimal_reset.exp;
-				field->decimal_value.mnt = field->decimal_reset.mnt;
-				field->decimal_previous.exp = field->decimal_reset.exp;
-				field->decimal_previous.mnt = field->decimal_reset.mnt;
-			} else {
-				field->decimal_value.exp = 0;
-				field->decimal_value.mnt = 0;
-				field->decimal_previous.exp = 0;
-				field->decimal_previous.mnt = 0;
-			}
-
-			break;
-		case FAST_TYPE_SEQUENCE:
-			seq = field->ptr_value;
+		if (field->type == FAST_TYPE_SEQUENCE)
+			ret = fast_visit_sequence(buffer, pmap, msg, i);
+		else
+			ret = fast_visit_field(buffer, pmap, msg, i, field);
 
-			fast_message_reset(seq->elements);
-			break;
-		default:
-			break;
-		}
+		if (ret)
+			return ret;
 	}
 
-	return;
-}
-
-static int transfer_int(struct buffer *buffer, i64 tmp)
-{
-	int size = transfer_size_int(tmp);
-
-	if (buffer_remaining(buffer) < size)
-		return -1;
-
-	switch (size) {
-	case 9:
-		buffer_put(buffer, (tmp >> 56) & 0x7F);
-	case 8:
-		buffer_put(buffer, (tmp >> 49) & 0x7F);
-	case 7:
-		buffer_put(buffer, (tmp >> 42) & 0x7F);
-	case 6:
-		buffer_put(buffer, (tmp >> 35) & 0x7F);
-	case 5:
-		buffer_put(buffer, (tmp >> 28) & 0x7F);
-	case 4:
-		buffer_put(buffer, (tmp >> 21) & 0x7F);
-	case 3:
-		buffer_put(buffer, (tmp >> 14) & 0x7F);
-	case 2:
-		buffer_put(buffer, (tmp >> 7) & 0x7F);
-	case 1:
-		buffer_put(buffer, (tmp & 0x7F) | 0x80);
-		break;
-	default:
-		return -1;
-	};
-
 	return 0;
 }
 
-static int fast_encode_int(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+static int fast_visit_message(struct buffer *buffer, struct fast_message *msg)
 {
-	i64 tmp = field->int_value;
-	bool pset = true;
-
-	switch (field->op) {
-	case FAST_OP_NONE:
-		pset = false;
+	const struct fast_visitor *visitor = msg->visitor;
+	int ret;
 
-		if (!field_is_mandatory(field)) {
-			tmp = tmp >= 0 ? tmp + 1 : tmp;
+	if (visitor->on_message) {
+		ret = visitor->on_message(msg->visitor_data, msg);
+		if (ret)
+			return FAST_MSG_STATE_STOPPED;
+	}
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+	if (msg->visit)
+		ret = msg->visit(buffer, msg->pmap, msg);
+	else
+		ret = fast_visit_fields(buffer, msg->pmap, msg);
 
-		field->state = FAST_STATE_ASSIGNED;
+	if (ret)
+		return ret;
 
-		goto transfer;
-	case FAST_OP_COPY:
-		if (!field_is_mandatory(field)) {
-			tmp = tmp >= 0 ? tmp + 1 : tmp;
+	if (visitor->on_message_end)
+		return fast_visitor_stop(visitor->on_message_end(msg->visitor_data, msg));
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+	return 0;
+}
 
-		switch (field->state) {
-		case FAST_STATE_UNDEFINED:
-			field->state = FAST_STATE_ASSIGNED;
-			goto transfer;
-		case FAST_STATE_ASSIGNED:
-			if (field_state_empty_previous(field))
-				goto transfer;
+/*
+ * Decodes a message as a whole or not at all. The dictionary values that
+ * the template had are saved in its shadow before the message is decoded,
+ * and should it fail they are put back and the buffer is left where the
+ * message starts. Values that were handed to a visitor stay handed, and
+ * a visitor that stops decoding on purpose leaves the message as it is.
+ */
+static int fast_decode_message(struct fast_tid_map *map, struct buffer *buffer, u64 last_tid, struct fast_message **msgp)
+{
+	unsigned long start = buffer->start;
+	struct fast_message *msg;
+	struct fast_field *field;
+	struct fast_pmap pmap;
+	unsigned long i;
+	int ret;
+	u64 tid;
 
-			if (field->int_value != field->int_previous)
-				goto transfer;
+	ret = fast_get_pmap(buffer, &pmap);
+	if (ret)
+		goto fail;
 
-			break;
-		case FAST_STATE_EMPTY:
-			goto fail;
-		default:
+	if (pmap_is_set(&pmap, 0)) {
+		ret = fast_get_uint(buffer, &tid);
+		if (ret)
 			goto fail;
-		}
+	} else
+		tid = last_tid;
 
-		break;
-	case FAST_OP_INCR:
-		if (!field_is_mandatory(field)) {
-			tmp = tmp >= 0 ? tmp + 1 : tmp;
+	msg = fast_tid_lookup(map, tid);
 
-			if (field_state_empty(field))
-				goto empty;
-		}
-
-		switch (field->state) {
-		case FAST_STATE_UNDEFINED:
-			field->state = FAST_STATE_ASSIGNED;
-			goto transfer;
-		case FAST_STATE_ASSIGNED:
-			if (field_state_empty_previous(field))
-				goto transfer;
+	if (!msg) {
+		ret = FAST_MSG_STATE_GARBLED;
+		goto fail;
+	}
 
-			if (field->int_value != field->int_previous + 1)
-				goto transfer;
+	/* The decoder's dictionary is in the values themselves */
+	if (fast_message_stale(msg)) {
+		fast_message_reset(msg);
+		fast_dictionary_catch_up(msg->dictionary, msg);
+		msg->generation = msg->dictionary->generation;
+	}
 
-			field->int_previous++;
+	if (unlikely(!msg->shadow.fields) && fast_shadow_build(msg)) {
+		ret = FAST_MSG_STATE_GARBLED;
+		goto fail;
+	}
 
-			break;
-		case FAST_STATE_EMPTY:
-			goto fail;
-		default:
-			goto fail;
-		}
+	fast_shadow_save(msg);
 
-		break;
-	case FAST_OP_DELTA:
-		tmp = field->int_value - field->int_previous;
-		pset = false;
+	msg->pmap = &pmap;
 
-		if (!field_is_mandatory(field)) {
-			tmp = tmp >= 0 ? tmp + 1 : tmp;
+	if (msg->visitor) {
+		ret = fast_visit_message(buffer, msg);
+		if (ret == FAST_MSG_STATE_STOPPED)
+			return ret;
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+		if (ret)
+			goto rollback;
 
-		field->state = FAST_STATE_ASSIGNED;
+		*msgp = msg;
 
-		goto transfer;
-	case FAST_OP_CONSTANT:
-		if (!field_is_mandatory(field)) {
-			if (!field_state_empty(field))
-				pmap_set(pmap, field->pmap_bit);
-			else
-				break;
-		}
+		return 0;
+	}
 
-		field->state = FAST_STATE_ASSIGNED;
+	if (msg->decode) {
+		ret = msg->decode(buffer, msg->pmap, msg);
+		if (ret)
+			goto rollback;
 
-		break;
-	default:
-		goto fail;
-	};
+		*msgp = msg;
 
-	return 0;
+		return 0;
+	}
 
-empty:
-	tmp = 0;
-	field->int_value = field->int_previous;
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-transfer:
-	field->int_previous = field->int_value;
-	field->state_previous = field->state;
+		if (field->type == FAST_TYPE_SEQUENCE)
+			ret = fast_decode_sequence(buffer, msg->pmap, msg->dictionary, field);
+		else
+			ret = fast_decode_field(buffer, msg->pmap, msg->dictionary, field);
 
-	if (transfer_int(buffer, tmp))
-		goto fail;
+		if (ret)
+			goto rollback;
+	}
 
-	if (pset)
-		pmap_set(pmap, field->pmap_bit);
+	*msgp = msg;
 
 	return 0;
 
+rollback:
+	fast_shadow_restore(msg);
+
 fail:
-	return -1;
+	buffer->start = start;
+
+	return ret;
 }
 
-static int transfer_uint(struct buffer *buffer, u64 tmp)
+/*
+ * Decodes the next message of a stream. A message that fails is not
+ * consumed, so one that was cut short can be decoded once the rest of it
+ * has been read.
+ */
+struct fast_message *fast_message_decode(struct fast_tid_map *map, struct buffer *buffer, u64 last_tid)
 {
-	int size = transfer_size_uint(tmp);
+	struct fast_message *msg;
 
-	if (buffer_remaining(buffer) < size)
-		return -1;
+	if (buffer_get_ptr(buffer) && buffer_remaining(buffer) <= FAST_MESSAGE_MAX_SIZE)
+		buffer_compact(buffer);
 
-	switch (size) {
-	case 9:
-		buffer_put(buffer, (tmp >> 56) & 0x7F);
-	case 8:
-		buffer_put(buffer, (tmp >> 49) & 0x7F);
-	case 7:
-		buffer_put(buffer, (tmp >> 42) & 0x7F);
-	case 6:
-		buffer_put(buffer, (tmp >> 35) & 0x7F);
-	case 5:
-		buffer_put(buffer, (tmp >> 28) & 0x7F);
-	case 4:
-		buffer_put(buffer, (tmp >> 21) & 0x7F);
-	case 3:
-		buffer_put(buffer, (tmp >> 14) & 0x7F);
-	case 2:
-		buffer_put(buffer, (tmp >> 7) & 0x7F);
-	case 1:
-		buffer_put(buffer, (tmp & 0x7F) | 0x80);
-		break;
-	default:
-		return -1;
-	};
+	if (fast_decode_message(map, buffer, last_tid, &msg))
+		return NULL;
 
-	return 0;
+	return msg;
 }
 
-static int fast_encode_uint(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+/*
+ * Decodes the next message of a complete datagram. Nothing is ever read
+ * from a socket: a message that runs past the end of the datagram fails
+ * with FAST_MSG_STATE_TRUNCATED and leaves the packet where it was.
+ */
+int fast_packet_decode(struct fast_tid_map *map, struct fast_packet *packet, struct fast_message **msg)
 {
-	u64 tmp = field->uint_value;
-	bool pset = true;
-	i64 delta = 0;
-
-	switch (field->op) {
-	case FAST_OP_NONE:
-		pset = false;
-
-		if (!field_is_mandatory(field)) {
-			tmp += 1;
-
-			if (field_state_empty(field))
-				goto empty;
-		}
-
-		field->state = FAST_STATE_ASSIGNED;
-
-		goto transfer;
-	case FAST_OP_COPY:
-		if (!field_is_mandatory(field)) {
-			tmp += 1;
-
-			if (field_state_empty(field))
-				goto empty;
-		}
-
-		switch (field->state) {
-		case FAST_STATE_UNDEFINED:
-			field->state = FAST_STATE_ASSIGNED;
-			goto transfer;
-		case FAST_STATE_ASSIGNED:
-			if (field_state_empty_previous(field))
-				goto transfer;
-
-			if (field->uint_value != field->uint_previous)
-				goto transfer;
-
-			break;
-		case FAST_STATE_EMPTY:
-			goto fail;
-		default:
-			goto fail;
-		}
+	struct buffer buffer = {
+		.start		= packet->offset,
+		.end		= packet->len,
+		.capacity	= packet->len,
+		.data		= (char *) packet->data,
+		.ptr		= NULL,
+	};
+	int ret;
 
-		break;
-	case FAST_OP_INCR:
-		if (!field_is_mandatory(field)) {
-			tmp += 1;
+	ret = fast_decode_message(map, &buffer, packet->last_tid, msg);
+	if (ret)
+		return ret;
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+	packet->offset		= buffer.start;
+	packet->last_tid	= (*msg)->tid;
 
-		switch (field->state) {
-		case FAST_STATE_UNDEFINED:
-			field->state = FAST_STATE_ASSIGNED;
-			goto transfer;
-		case FAST_STATE_ASSIGNED:
-			if (field_state_empty_previous(field))
-				goto transfer;
+	return 0;
+}
 
-			if (field->uint_value != field->uint_previous + 1)
-				goto transfer;
+#define FNV_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
 
-			field->uint_previous++;
+static u64 signature_add(u64 hash, u64 value)
+{
+	int i;
 
-			break;
-		case FAST_STATE_EMPTY:
-			goto fail;
-		default:
-			goto fail;
-		}
+	for (i = 0; i < sizeof(value); i++) {
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= FNV_PRIME;
+	}
 
-		break;
-	case FAST_OP_DELTA:
-		delta = field->uint_value - field->uint_previous;
-		pset = false;
+	return hash;
+}
 
-		if (!field_is_mandatory(field)) {
-			delta = delta >= 0 ? delta + 1 : delta;
+static u64 field_signature(u64 hash, struct fast_field *field)
+{
+	hash = signature_add(hash, field->op);
+	hash = signature_add(hash, field->presence);
+	hash = signature_add(hash, field->pmap_bit);
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+	return hash;
+}
 
-		field->state = FAST_STATE_ASSIGNED;
-		tmp = delta;
+static u64 fields_signature(u64 hash, struct fast_message *msg)
+{
+	struct fast_decimal_parts *parts;
+	struct fast_sequence *seq;
+	struct fast_field *field;
+	unsigned long i;
 
-		goto transfer;
-	case FAST_OP_CONSTANT:
-		if (!field_is_mandatory(field)) {
-			if (!field_state_empty(field))
-				pmap_set(pmap, field->pmap_bit);
-			else
-				break;
-		}
+	hash = signature_add(hash, msg->nr_fields);
 
-		field->state = FAST_STATE_ASSIGNED;
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-		break;
-	default:
-		goto fail;
-	};
+		hash = signature_add(hash, field->type);
+		hash = signature_add(hash, field->op);
+		hash = signature_add(hash, field->presence);
+		hash = signature_add(hash, field->pmap_bit);
+		hash = signature_add(hash, field->has_reset);
+		hash = signature_add(hash, field->flags);
+		hash = signature_add(hash, field->slot != 0);
 
-	return 0;
+		if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS)) {
+			parts = field_decimal_parts(field);
 
-empty:
-	tmp = 0;
-	field->uint_value = field->uint_previous;
+			hash = field_signature(hash, &parts->exponent);
+			hash = field_signature(hash, &parts->mantissa);
+		}
 
-transfer:
-	field->uint_previous = field->uint_value;
-	field->state_previous = field->state;
+		if (field->type != FAST_TYPE_SEQUENCE)
+			continue;
 
-	if (field->op != FAST_OP_DELTA) {
-		if (transfer_uint(buffer, tmp))
-			goto fail;
-	} else {
-		if (transfer_int(buffer, tmp))
-			goto fail;
-	}
+		seq = field->ptr_value;
 
-	if (pset)
-		pmap_set(pmap, field->pmap_bit);
+		hash = field_signature(hash, &seq->length);
+		hash = fields_signature(hash, &seq->element);
+	}
 
-	return 0;
+	return hash;
+}
 
-fail:
-	return -1;
+/*
+ * Hash of everything a generated codec bakes in at compile time. A codec is
+ * only attached to a template with the same signature, so a stale codec
+ * never runs against a template that has changed since it was generated.
+ */
+u64 fast_message_signature(struct fast_message *msg)
+{
+	return fields_signature(signature_add(FNV_OFFSET_BASIS, msg->tid), msg);
 }
 
-static int transfer_string(struct buffer *buffer, char *tmp)
+/*
+ * Sets the mandatory constants that generated decoders leave out, the way
+ * the interpreter does when it first comes across them.
+ */
+static void fast_message_fix(struct fast_message *msg)
 {
-	int size;
+	struct fast_sequence *seq;
+	struct fast_field *field;
 	int i;
 
-	if (!tmp)
-		goto null;
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-	size = strlen(tmp);
+		if (field->type == FAST_TYPE_SEQUENCE) {
+			seq = field->ptr_value;
 
-	if (!size)
-		size = 1;
+			if (fast_field_is_fixed(&seq->length))
+				fast_decode_field(NULL, NULL, msg->dictionary, &seq->length);
 
-	if (buffer_remaining(buffer) < size)
-		goto fail;
+			fast_message_fix(&seq->element);
+		} else if (fast_field_is_fixed(field))
+			fast_decode_field(NULL, NULL, msg->dictionary, field);
+	}
+}
 
-	for (i = 0; i < size; i++)
-		buffer_put(buffer, tmp[i]);
+int fast_message_attach(struct fast_message *msg, const struct fast_template_codec *codec)
+{
+	if (codec->tid != msg->tid)
+		return -1;
 
-null:
-	if (buffer_remaining(buffer) < 1)
-		goto fail;
+	if (codec->signature != fast_message_signature(msg))
+		return -1;
 
-	buffer_put(buffer, 0x80);
+	fast_message_fix(msg);
 
-	return 0;
+	msg->decode = codec->decode;
+	msg->encode = codec->encode;
+	msg->visit = codec->visit;
 
-fail:
-	return -1;
+	return 0;
 }
 
-static int fast_encode_string(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+struct fast_message *fast_message_new(int nr_messages)
 {
-	char *tmp = field->string_value;
-	bool pset = true;
+	struct fast_message *self = calloc(nr_messages, sizeof *self);
 
-	switch (field->op) {
-	case FAST_OP_NONE:
-		pset = false;
+	if (!self)
+		return NULL;
 
-		if (!field_is_mandatory(field)) {
-			if (field_state_empty(field))
-				goto empty;
-		}
+	return self;
+}
 
-		field->state = FAST_STATE_ASSIGNED;
+void fast_fields_free(struct fast_message *self)
+{
+	struct fast_sequence *seq;
+	struct fast_field *field;
+	int i;
 
-		goto transfer;
-	case FAST_OP_COPY:
-		if (!field_is_mandatory(field)) {
-			if (field_state_empty(field))
-				goto empty;
-		}
+	if (!self)
+		return;
 
-		switch (field->state) {
-		case FAST_STATE_UNDEFINED:
-			field->state = FAST_STATE_ASSIGNED;
-			goto transfer;
-		case FAST_STATE_ASSIGNED:
-			if (field_state_empty_previous(field))
-				goto transfer;
+	for (i = 0; i < self->nr_fields; i++) {
+		field = self->fields + i;
 
-			if (strcmp(field->string_value, field->string_previous))
-				goto transfer;
+		if (field->type == FAST_TYPE_SEQUENCE) {
+			seq = field->ptr_value;
+			if (!seq)
+				continue;
 
-			break;
-		case FAST_STATE_EMPTY:
-			goto fail;
-		default:
-			goto fail;
-		}
+			fast_fields_free(&seq->element);
+			free(seq->strings);
+			free(seq->values);
 
-		break;
-	case FAST_OP_INCR:
-		goto fail;
-	case FAST_OP_DELTA:
-		goto fail;
-	case FAST_OP_CONSTANT:
-		if (!field_is_mandatory(field)) {
-			if (!field_state_empty(field))
-				pmap_set(pmap, field->pmap_bit);
-			else
-				break;
-		}
+			free(field->ptr_value);
+		} else if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS))
+			free(field->ptr_reset);
+	}
 
-		field->state = FAST_STATE_ASSIGNED;
+	fast_shadow_free(&self->shadow);
+	free(self->strings);
+	free(self->fields);
+}
 
-		break;
-	default:
-		goto fail;
-	};
+void fast_message_free(struct fast_message *self, int nr_messages)
+{
+	int i;
 
-	return 0;
+	if (!self)
+		return;
 
-empty:
-	tmp = NULL;
-	memcpy(field->string_value, field->string_previous, strlen(field->string_previous) + 1);
+	for (i = 0; i < nr_messages; i++)
+		fast_fields_free(self + i);
 
-transfer:
-	memcpy(field->string_previous, field->string_value, strlen(field->string_value) + 1);
-	field->state_previous = field->state;
+	free(self);
 
-	if (transfer_string(buffer, tmp))
-		goto fail;
+	return;
+}
 
-	if (pset)
-		pmap_set(pmap, field->pmap_bit);
+static unsigned long fields_clone_strings_size(struct fast_message *msg)
+{
+	unsigned long size = 0;
+	int i;
 
-	return 0;
+	for (i = 0; i < msg->nr_fields; i++) {
+		if (msg->fields[i].type == FAST_TYPE_STRING)
+			size += 2 * msg->fields[i].string_size;
+	}
 
-fail:
-	return -1;
+	return size;
 }
 
-static int fast_encode_decimal(struct buffer *buffer, struct fast_pmap *pmap, struct fast_field *field)
+/*
+ * Copies the fields of a template for a session of its own. The copy gets
+ * buffers for its values and previous values but reads the initial values
+ * from the template, which must outlive it and is never written to.
+ * Sequence elements are allocated as the copy first decodes them.
+ */
+int fast_message_clone(struct fast_message *dst, struct fast_message *src, struct fast_dictionary *dict)
 {
-	i64 exp = field->decimal_value.exp;
-	i64 mnt = field->decimal_value.mnt;
-
-	bool pset = true;
-	bool empty = false;
+	struct fast_sequence *dst_seq;
+	struct fast_sequence *src_seq;
+	struct fast_field *field;
+	unsigned long size;
+	char *strings;
+	int i;
 
-	switch (field->op) {
-	case FAST_OP_NONE:
-		pset = false;
+	*dst = *src;
 
-		if (!field_is_mandatory(field)) {
-			exp = exp >= 0 ? exp + 1 : exp;
+	dst->nr_fields	= 0;
+	dst->fields	= NULL;
+	dst->strings	= NULL;
+	dst->msg_buf	= NULL;
+	dst->pmap	= NULL;
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+	memset(&dst->shadow, 0, sizeof(dst->shadow));
 
-		field->state = FAST_STATE_ASSIGNED;
+	/* Sequence elements use the dictionary of their message */
+	if (src->dictionary) {
+		dst->dictionary	= dict;
+		dst->generation	= dict->generation;
+	}
 
-		goto transfer;
-	case FAST_OP_COPY:
-		if (!field_is_mandatory(field)) {
-			exp = exp >= 0 ? exp + 1 : exp;
+	dst->fields = malloc(src->nr_fields * sizeof(struct fast_field));
+	if (!dst->fields)
+		goto fail;
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+	memcpy(dst->fields, src->fields, src->nr_fields * sizeof(struct fast_field));
+	dst->nr_fields = src->nr_fields;
 
-		switch (field->state) {
-		case FAST_STATE_UNDEFINED:
-			field->state = FAST_STATE_ASSIGNED;
-			goto transfer;
-		case FAST_STATE_ASSIGNED:
-			if (field_state_empty_previous(field))
-				goto transfer;
+	/* Nothing that the copy owns is freed until it is set up */
+	for (i = 0; i < src->nr_fields; i++) {
+		field = dst->fields + i;
 
-			if ((field->decimal_value.exp != field->decimal_previous.exp) ||
-				(field->decimal_value.mnt != field->decimal_previous.mnt))
-				goto transfer;
+		if (field->type == FAST_TYPE_SEQUENCE)
+			field->ptr_value = NULL;
+		else if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS))
+			field->ptr_reset = NULL;
+	}
 
-			break;
-		case FAST_STATE_EMPTY:
-			goto fail;
-		default:
+	size = fields_clone_strings_size(src);
+	if (size) {
+		dst->strings = malloc(size);
+		if (!dst->strings)
 			goto fail;
-		}
-
-		break;
-	case FAST_OP_INCR:
-		/* Not applicable to decimal */
-		break;
-	case FAST_OP_DELTA:
-		exp = field->decimal_value.exp - field->decimal_previous.exp;
-		mnt = field->decimal_value.mnt - field->decimal_previous.mnt;
-		pset = false;
+	}
 
-		if (!field_is_mandatory(field)) {
-			exp = exp >= 0 ? exp + 1 : exp;
+	strings = dst->strings;
 
-			if (field_state_empty(field))
-				goto empty;
-		}
+	for (i = 0; i < src->nr_fields; i++) {
+		field = dst->fields + i;
 
-		field->state = FAST_STATE_ASSIGNED;
+		switch (field->type) {
+		case FAST_TYPE_STRING:
+			size = field->string_size;
 
-		goto transfer;
-	case FAST_OP_CONSTANT:
-		if (!field_is_mandatory(field)) {
-			if (!field_state_empty(field))
-				pmap_set(pmap, field->pmap_bit);
-			else
-				break;
-		}
+			memcpy(strings, src->fields[i].string_buf, size);
+			memcpy(strings + size, src->fields[i].string_previous, size);
 
-		field->state = FAST_STATE_ASSIGNED;
+			field->string_buf	= strings;
+			field->string_value	= strings;
+			field->string_previous	= strings + size;
 
-		break;
-	default:
-		goto fail;
-	};
+			strings += 2 * size;
+			break;
+		case FAST_TYPE_SEQUENCE:
+			src_seq = src->fields[i].ptr_value;
 
-	return 0;
+			dst_seq = calloc(1, sizeof(struct fast_sequence));
+			if (!dst_seq)
+				goto fail;
 
-empty:
-	exp = 0;
-	empty = true;
+			field->ptr_value = dst_seq;
+			dst_seq->length = src_seq->length;
 
-transfer:
-	if (!empty) {
-		field->decimal_previous.exp = field->decimal_value.exp;
-		field->decimal_previous.mnt = field->decimal_value.mnt;
-	}
-	field->state_previous = field->state;
+			if (fast_message_clone(&dst_seq->element, &src_seq->element, dict))
+				goto fail;
 
-	if (transfer_int(buffer, exp))
-		goto fail;
+			break;
+		case FAST_TYPE_DECIMAL:
+			if (!field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS))
+				break;
 
-	if (!empty && transfer_int(buffer, mnt))
-		goto fail;
+			field->ptr_reset = malloc(sizeof(struct fast_decimal_parts));
+			if (!field->ptr_reset)
+				goto fail;
 
-	if (pset)
-		pmap_set(pmap, field->pmap_bit);
+			memcpy(field->ptr_reset, src->fields[i].ptr_reset, sizeof(struct fast_decimal_parts));
+			break;
+		case FAST_TYPE_INT:
+		case FAST_TYPE_UINT:
+		default:
+			break;
+		}
+	}
 
 	return 0;
 
 fail:
+	fast_fields_free(dst);
+
+	dst->fields	= NULL;
+	dst->strings	= NULL;
+	dst->nr_fields	= 0;
+
 	return -1;
 }
 
-int fast_message_encode(struct fast_message *msg)
+static i64 field_int_reset(struct fast_field *field)
+{
+	return field->has_reset ? field->int_reset : 0;
+}
+
+/*
+ * Resets the previous values that the operators work from but leaves the
+ * values of the fields alone, which an encoder may already have filled in.
+ */
+void fast_message_reset_dictionary(struct fast_message *msg)
 {
+	struct fast_decimal_parts *parts;
 	struct fast_field *field;
-	struct fast_pmap pmap;
 	int i;
 
-	pmap.nr_bytes = FAST_PMAP_MAX_BYTES;
-	memset(pmap.bytes, 0, pmap.nr_bytes);
-	pmap_set(&pmap, 0);
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
 
-	msg->pmap = &pmap;
+		switch (field->type) {
+		case FAST_TYPE_INT:
+			field->int_previous = field->has_reset ? field->int_reset : 0;
+			break;
+		case FAST_TYPE_UINT:
+			field->uint_previous = field->has_reset ? field->uint_reset : 0;
+			break;
+		case FAST_TYPE_STRING:
+			if (field->has_reset)
+				strcpy(field->string_previous, field->string_reset);
+			else
+				field->string_previous[0] = 0;
 
-	if (transfer_uint(msg->msg_buf, msg->tid))
-		goto fail;
+			field->string_previous_len = strlen(field->string_previous);
+			break;
+		case FAST_TYPE_DECIMAL:
+			if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS)) {
+				parts = field_decimal_parts(field);
+
+				parts->exponent.int_previous = field_int_reset(&parts->exponent);
+				parts->mantissa.int_previous = field_int_reset(&parts->mantissa);
+			} else if (field->has_reset) {
+				field->decimal_previous.exp = field->decimal_reset.exp;
+				field->decimal_previous.mnt = field->decimal_reset.mnt;
+			} else {
+				field->decimal_previous.exp = 0;
+				field->decimal_previous.mnt = 0;
+			}
+
+			break;
+		case FAST_TYPE_SEQUENCE:
+			fast_message_reset_dictionary(&((struct fast_sequence *) field->ptr_value)->element);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void fast_message_reset(struct fast_message *msg)
+{
+	struct fast_decimal_parts *parts;
+	struct fast_sequence *seq;
+	struct fast_field *field;
+	int i;
 
 	for (i = 0; i < msg->nr_fields; i++) {
 		field = msg->fields + i;
 
 		switch (field->type) {
 		case FAST_TYPE_INT:
-			if (fast_encode_int(msg->msg_buf, msg->pmap, field))
-				goto fail;
+			field->int_value = field->has_reset ? field->int_reset : 0;
 			break;
 		case FAST_TYPE_UINT:
-			if (fast_encode_uint(msg->msg_buf, msg->pmap, field))
-				goto fail;
+			field->uint_value = field->has_reset ? field->uint_reset : 0;
 			break;
 		case FAST_TYPE_STRING:
-			if (fast_encode_string(msg->msg_buf, msg->pmap, field))
-				goto fail;
+			field->string_value = field->string_buf;
+
+			if (field->has_reset) {
+				field->string_len = strlen(field->string_reset);
+				strcpy(field->string_value, field->string_reset);
+			} else {
+				field->string_len = 0;
+				field->string_value[0] = 0;
+			}
+
 			break;
 		case FAST_TYPE_DECIMAL:
-			if (fast_encode_decimal(msg->msg_buf, msg->pmap, field))
-				goto fail;
+			if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS)) {
+				parts = field_decimal_parts(field);
+
+				parts->exponent.int_value = field_int_reset(&parts->exponent);
+				parts->mantissa.int_value = field_int_reset(&parts->mantissa);
+			}
+
+			if (field->has_reset) {
+				field->decimal_value.exp = field->decimal_reset.exp;
+				field->decimal_value.mnt = field->decimal_reset.mnt;
+			} else {
+				field->decimal_value.exp = 0;
+				field->decimal_value.mnt = 0;
+			}
+
 			break;
 		case FAST_TYPE_SEQUENCE:
-			goto fail;
+			seq = field->ptr_value;
+
+			fast_message_reset(&seq->element);
+			break;
 		default:
-			goto fail;
-		};
+			break;
+		}
 	}
 
-	for (i = FAST_PMAP_MAX_BYTES; i > 0; i--) {
-		if (pmap.bytes[i - 1])
-			break;
+	fast_message_reset_dictionary(msg);
+}
+
+/*
+ * Encodes the message at the end of msg_buf, pmap and all, so that it is
+ * one contiguous span. When msg_buf is empty the span starts at the pmap
+ * rather than at the start of the buffer, see fast_pmap_commit().
+ */
+int fast_message_encode(struct fast_message *msg)
+{
+	struct fast_field *field;
+	struct fast_pmap pmap;
+	unsigned long offset;
+	int ret;
+	int i;
 
-		pmap.nr_bytes--;
+	/* Keep the values that are about to be encoded */
+	if (fast_message_stale(msg)) {
+		fast_message_reset_dictionary(msg);
+		fast_dictionary_catch_up(msg->dictionary, msg);
+		msg->generation = msg->dictionary->generation;
 	}
 
-	if (buffer_remaining(msg->pmap_buf) < pmap.nr_bytes)
+	if (fast_pmap_reserve(msg->msg_buf, &pmap, &offset))
+		goto fail;
+
+	pmap_set(&pmap, 0);
+
+	msg->pmap = &pmap;
+
+	if (transfer_uint(msg->msg_buf, msg->tid))
 		goto fail;
 
-	for (i = 0; i < pmap.nr_bytes - 1; i++)
-		buffer_put(msg->pmap_buf, pmap.bytes[i] & 0x7F);
+	if (msg->encode) {
+		if (msg->encode(msg->msg_buf, msg->pmap, msg))
+			goto fail;
+
+		goto pmap;
+	}
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
+
+		if (field->type == FAST_TYPE_SEQUENCE)
+			ret = fast_encode_sequence(msg->msg_buf, msg->pmap, msg->dictionary, field);
+		else
+			ret = fast_encode_field(msg->msg_buf, msg->pmap, msg->dictionary, field);
+
+		if (ret)
+			goto fail;
+	}
 
-	buffer_put(msg->pmap_buf, pmap.bytes[pmap.nr_bytes - 1] | 0x80);
+pmap:
+	fast_pmap_commit(msg->msg_buf, &pmap, offset);
 
 	return 0;
 
@@ -1818,23 +1843,19 @@ fail:
 
 int fast_message_send(struct fast_message *self, int sockfd, int flags)
 {
-	struct iovec iov[2];
 	int ret = 0;
 
 	ret = fast_message_encode(self);
 	if (ret)
 		goto exit;
 
-	buffer_to_iovec(self->pmap_buf, &iov[0]);
-	buffer_to_iovec(self->msg_buf, &iov[1]);
-
-	if (xwritev(sockfd, iov, ARRAY_SIZE(iov)) < 0) {
+	if (xwrite(sockfd, buffer_start(self->msg_buf), buffer_size(self->msg_buf)) < 0) {
 		ret = -1;
 		goto exit;
 	}
 
 exit:
-	self->pmap_buf = self->msg_buf = NULL;
+	self->msg_buf = NULL;
 
 	return ret;
 }
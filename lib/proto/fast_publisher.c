@@ -0,0 +1,224 @@
+#include "libtrading/proto/fast_publisher.h"
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_message.h"
+#include "libtrading/proto/fast_feed.h"
+
+#include "libtrading/read-write.h"
+#include "libtrading/buffer.h"
+
+#include <endian.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct fast_publisher *fast_publisher_new(struct fast_session *session, unsigned long packet_size)
+{
+	struct fast_publisher *self;
+
+	if (packet_size <= FAST_FEED_SEQ_SIZE)
+		return NULL;
+
+	self = calloc(1, sizeof *self);
+	if (!self)
+		return NULL;
+
+	/* A message that does not fit is encoded before it is moved on */
+	self->packet = buffer_new(packet_size + FAST_MESSAGE_MAX_SIZE);
+	if (!self->packet) {
+		fast_publisher_free(self);
+		return NULL;
+	}
+
+	self->session		= session;
+	self->packet_size	= packet_size;
+	self->next_seq		= 1;
+
+	return self;
+}
+
+void fast_publisher_free(struct fast_publisher *self)
+{
+	if (!self)
+		return;
+
+	buffer_delete(self->packet);
+	free(self);
+}
+
+/*
+ * Starts every reset_interval-th packet, the first one included, with a
+ * message of template tid, which must have been declared with reset="T".
+ * An interval of zero stops sending reset messages.
+ */
+int fast_publisher_set_reset(struct fast_publisher *self, u64 tid, unsigned long reset_interval)
+{
+	struct fast_message *msg;
+
+	if (!reset_interval) {
+		self->reset_msg		= NULL;
+		self->reset_interval	= 0;
+
+		return 0;
+	}
+
+	msg = fast_tid_lookup(&self->session->rx_map, tid);
+	if (!msg || !fast_msg_has_flags(msg, FAST_MSG_FLAGS_RESET))
+		return -1;
+
+	self->reset_msg		= msg;
+	self->reset_interval	= reset_interval;
+
+	return 0;
+}
+
+/*
+ * Encodes the message at the end of the packet. A message that fails
+ * leaves none of its bytes behind, the pmap that was reserved for it
+ * included.
+ */
+static int fast_publisher_encode(struct buffer *packet, struct fast_message *msg)
+{
+	unsigned long start = packet->start;
+	unsigned long end = packet->end;
+
+	msg->msg_buf = packet;
+
+	if (!fast_message_encode(msg))
+		return 0;
+
+	packet->start	= start;
+	packet->end	= end;
+
+	return -1;
+}
+
+static bool fast_publisher_resets(struct fast_publisher *self)
+{
+	if (self->flags & FAST_PUBLISHER_FLAGS_PACKET_RESET)
+		return true;
+
+	return self->reset_msg && !(self->stats.nr_packets % self->reset_interval);
+}
+
+static int fast_publisher_begin(struct fast_publisher *self)
+{
+	struct buffer *packet = self->packet;
+	u32 seq;
+
+	buffer_reset(packet);
+
+	if (self->flags & FAST_PUBLISHER_FLAGS_SEQ) {
+		seq = htole32(self->next_seq);
+
+		memcpy(buffer_end(packet), &seq, sizeof(seq));
+		packet->end += FAST_FEED_SEQ_SIZE;
+	}
+
+	if (!fast_publisher_resets(self))
+		return 0;
+
+	fast_session_reset(self->session);
+
+	if (!self->reset_msg || self->stats.nr_packets % self->reset_interval)
+		return 0;
+
+	if (fast_publisher_encode(packet, self->reset_msg))
+		return -1;
+
+	self->nr_pending++;
+	self->stats.nr_resets++;
+
+	return 0;
+}
+
+/*
+ * Encodes the message at the end of the packet. If that takes the packet
+ * over its size the packet is sent without it and the message starts the
+ * next one: its bytes are moved there as they are when the dictionaries
+ * carry on, or it is encoded again from the reset dictionaries. A message
+ * that is too big for an empty packet or that fails to encode is taken
+ * out of the packet again, but leaves the dictionaries out of step with
+ * the receivers' until the next reset.
+ */
+int fast_publisher_add(struct fast_publisher *self, struct fast_message *msg)
+{
+	struct buffer *packet = self->packet;
+	unsigned long start, from, len;
+	bool reset;
+
+	if (!self->nr_pending && fast_publisher_begin(self))
+		return -1;
+
+	start = packet->end;
+
+	if (fast_publisher_encode(packet, msg))
+		return -1;
+
+	if (buffer_size(packet) <= self->packet_size)
+		goto done;
+
+	len = packet->end - start;
+	from = start;
+
+	packet->end = start;
+
+	if (!self->nr_pending)
+		return -1;
+
+	if (fast_publisher_flush(self))
+		return -1;
+
+	reset = fast_publisher_resets(self);
+
+	if (fast_publisher_begin(self))
+		return -1;
+
+	start = packet->end;
+
+	if (reset) {
+		if (fast_publisher_encode(packet, msg))
+			return -1;
+	} else {
+		memmove(buffer_end(packet), packet->data + from, len);
+		packet->end += len;
+	}
+
+	if (buffer_size(packet) > self->packet_size) {
+		packet->end = start;
+		return -1;
+	}
+
+done:
+	self->nr_pending++;
+	self->stats.nr_messages++;
+
+	return 0;
+}
+
+/* Sends the packet that is being built, if there is one */
+int fast_publisher_flush(struct fast_publisher *self)
+{
+	struct buffer *packet = self->packet;
+	int sockfd = self->session->sockfd;
+	ssize_t nr;
+
+	if (!self->nr_pending)
+		return 0;
+
+	self->stats.nr_packets++;
+	self->stats.nr_bytes += buffer_size(packet);
+
+	self->nr_pending = 0;
+	self->next_seq++;
+
+	/* A stream socket may take the packet in pieces */
+	while (buffer_size(packet)) {
+		nr = xwrite(sockfd, buffer_start(packet), buffer_size(packet));
+		if (nr < 0)
+			return -1;
+
+		packet->start += nr;
+	}
+
+	return 0;
+}
@@ -0,0 +1,616 @@
+#include "libtrading/proto/fast_recovery.h"
+
+#include "libtrading/proto/fast_message.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * An update in the ring. Applied and dropped updates stay in place, with
+ * no instrument, until the ring moves past them.
+ */
+struct fast_recovery_entry {
+	struct fast_instrument		*instrument;
+	struct fast_recovery_template	*template;
+	i64				rpt_seq;
+	long				next;
+};
+
+/* FNV-1a */
+static unsigned long recovery_hash(const char *symbol, unsigned long len)
+{
+	uint32_t hash = 2166136261U;
+	unsigned long i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t) symbol[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static struct fast_instrument **recovery_slot(struct fast_recovery *self, const char *symbol, unsigned long len)
+{
+	unsigned long mask = self->max_instruments - 1;
+	unsigned long idx = recovery_hash(symbol, len) & mask;
+	struct fast_instrument *instrument;
+
+	for (;;) {
+		instrument = self->instruments[idx];
+
+		if (!instrument)
+			break;
+
+		if (!memcmp(instrument->symbol, symbol, len) && !instrument->symbol[len])
+			break;
+
+		idx = (idx + 1) & mask;
+	}
+
+	return &self->instruments[idx];
+}
+
+static bool recovery_grow(struct fast_recovery *self)
+{
+	unsigned long max_instruments = self->max_instruments;
+	struct fast_instrument **instruments = self->instruments;
+	struct fast_instrument *instrument;
+	unsigned long i;
+
+	self->instruments = calloc(2 * max_instruments, sizeof(struct fast_instrument *));
+	if (!self->instruments) {
+		self->instruments = instruments;
+		return false;
+	}
+
+	self->max_instruments = 2 * max_instruments;
+
+	for (i = 0; i < max_instruments; i++) {
+		instrument = instruments[i];
+		if (!instrument)
+			continue;
+
+		*recovery_slot(self, instrument->symbol, strlen(instrument->symbol)) = instrument;
+	}
+
+	free(instruments);
+
+	return true;
+}
+
+/*
+ * Looks up the instrument of a symbol and creates one that waits for its
+ * first snapshot when there is none yet.
+ */
+static struct fast_instrument *recovery_instrument(struct fast_recovery *self, const char *symbol, unsigned long len)
+{
+	struct fast_instrument **slot;
+	struct fast_instrument *instrument;
+
+	if (!len || len >= FAST_RECOVERY_SYMBOL_LEN)
+		return NULL;
+
+	slot = recovery_slot(self, symbol, len);
+	if (*slot)
+		return *slot;
+
+	/* Keep the load factor below one half */
+	if (2 * (self->nr_instruments + 1) > self->max_instruments) {
+		if (!recovery_grow(self))
+			return NULL;
+
+		slot = recovery_slot(self, symbol, len);
+	}
+
+	instrument = calloc(1, sizeof(*instrument));
+	if (!instrument)
+		return NULL;
+
+	memcpy(instrument->symbol, symbol, len);
+
+	instrument->state	= FAST_INSTRUMENT_EMPTY;
+	instrument->head	= -1;
+	instrument->tail	= -1;
+
+	*slot = instrument;
+
+	self->nr_instruments++;
+
+	return instrument;
+}
+
+static struct fast_field *entry_fields(struct fast_recovery *self, long idx)
+{
+	return self->ring_fields + idx * self->max_fields;
+}
+
+/* The fields that the template's updates take up in a message */
+static struct fast_message *template_updates(struct fast_message *msg, long entries)
+{
+	if (entries < 0)
+		return msg;
+
+	return &((struct fast_sequence *) msg->fields[entries].ptr_value)->element;
+}
+
+static unsigned long fields_strings_size(struct fast_message *msg)
+{
+	unsigned long size = 0;
+	unsigned long i;
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		if (msg->fields[i].type == FAST_TYPE_STRING)
+			size += msg->fields[i].string_size;
+	}
+
+	return size;
+}
+
+/* Makes room in every ring entry for the updates of msg */
+static int recovery_reserve(struct fast_recovery *self, struct fast_message *msg)
+{
+	unsigned long strings_size = fields_strings_size(msg);
+	struct fast_field *fields;
+	char *strings = NULL;
+
+	if (msg->nr_fields <= self->max_fields && strings_size <= self->strings_size)
+		return 0;
+
+	/* Queued updates would not move along */
+	if (self->ring_len)
+		return -1;
+
+	if (msg->nr_fields > self->max_fields)
+		self->max_fields = msg->nr_fields;
+
+	if (strings_size > self->strings_size)
+		self->strings_size = strings_size;
+
+	fields = calloc(self->ring_size * self->max_fields, sizeof(struct fast_field));
+	if (!fields)
+		return -1;
+
+	if (self->strings_size) {
+		strings = calloc(self->ring_size, self->strings_size);
+		if (!strings) {
+			free(fields);
+			return -1;
+		}
+	}
+
+	free(self->ring_fields);
+	free(self->ring_strings);
+
+	self->ring_fields	= fields;
+	self->ring_strings	= strings;
+
+	return 0;
+}
+
+static int recovery_add(struct fast_recovery *self, struct fast_message *msg, bool snapshot, long entries, unsigned long symbol, unsigned long rpt_seq)
+{
+	struct fast_recovery_template *template;
+	struct fast_message *updates;
+	struct fast_field *field;
+
+	if (self->nr_templates == FAST_RECOVERY_MAX_TEMPLATES)
+		return -1;
+
+	if (entries >= 0) {
+		if ((unsigned long) entries >= msg->nr_fields || msg->fields[entries].type != FAST_TYPE_SEQUENCE)
+			return -1;
+	}
+
+	updates = template_updates(msg, entries);
+
+	if (symbol >= updates->nr_fields || rpt_seq >= updates->nr_fields)
+		return -1;
+
+	if (updates->fields[symbol].type != FAST_TYPE_STRING)
+		return -1;
+
+	field = updates->fields + rpt_seq;
+	if (field->type != FAST_TYPE_INT && field->type != FAST_TYPE_UINT)
+		return -1;
+
+	if (!snapshot && recovery_reserve(self, updates))
+		return -1;
+
+	template = self->templates + self->nr_templates++;
+
+	template->tid		= msg->tid;
+	template->snapshot	= snapshot;
+	template->entries	= entries;
+	template->symbol	= symbol;
+	template->rpt_seq	= rpt_seq;
+
+	return 0;
+}
+
+/*
+ * Messages of msg's template carry updates, one per element of the
+ * sequence field entries or, if that is -1, one per message.
+ */
+int fast_recovery_add_updates(struct fast_recovery *self, struct fast_message *msg, long entries, unsigned long symbol, unsigned long rpt_seq)
+{
+	return recovery_add(self, msg, false, entries, symbol, rpt_seq);
+}
+
+/* Messages of msg's template are snapshots of one instrument each */
+int fast_recovery_add_snapshot(struct fast_recovery *self, struct fast_message *msg, unsigned long symbol, unsigned long rpt_seq)
+{
+	return recovery_add(self, msg, true, -1, symbol, rpt_seq);
+}
+
+static struct fast_recovery_template *recovery_template(struct fast_recovery *self, u64 tid)
+{
+	unsigned long i;
+
+	for (i = 0; i < self->nr_templates; i++) {
+		if (self->templates[i].tid == tid)
+			return self->templates + i;
+	}
+
+	return NULL;
+}
+
+static bool field_rpt_seq(struct fast_field *field, i64 *rpt_seq)
+{
+	if (field->state != FAST_STATE_ASSIGNED)
+		return false;
+
+	if (field->type == FAST_TYPE_INT)
+		*rpt_seq = field->int_value;
+	else
+		*rpt_seq = field->uint_value;
+
+	return true;
+}
+
+static struct fast_instrument *fields_instrument(struct fast_recovery *self, struct fast_recovery_template *template, struct fast_field *fields, i64 *rpt_seq)
+{
+	struct fast_field *symbol = fields + template->symbol;
+
+	if (symbol->state != FAST_STATE_ASSIGNED)
+		return NULL;
+
+	if (!field_rpt_seq(fields + template->rpt_seq, rpt_seq))
+		return NULL;
+
+	return recovery_instrument(self, symbol->string_value, symbol->string_len);
+}
+
+/* Drops the oldest entry of the ring, and the update in it if it has one */
+static void ring_drop(struct fast_recovery *self)
+{
+	struct fast_recovery_entry *entry = self->ring + self->ring_head;
+	struct fast_instrument *instrument = entry->instrument;
+
+	/* The oldest update of the ring is the oldest of its instrument */
+	if (instrument) {
+		instrument->head = entry->next;
+		if (instrument->head < 0)
+			instrument->tail = -1;
+
+		instrument->nr_queued--;
+
+		self->stats.nr_overruns++;
+	}
+
+	entry->instrument = NULL;
+
+	self->ring_head = (self->ring_head + 1) % self->ring_size;
+	self->ring_len--;
+}
+
+/*
+ * Copies the update to the end of the ring. Strings are copied as well,
+ * nested sequences are not.
+ */
+static void ring_push(struct fast_recovery *self, struct fast_instrument *instrument, struct fast_recovery_template *template,
+		      struct fast_field *fields, unsigned long nr_fields, i64 rpt_seq)
+{
+	struct fast_recovery_entry *entry;
+	struct fast_field *dst;
+	unsigned long len;
+	unsigned long i;
+	char *strings;
+	long idx;
+
+	while (self->ring_len && !self->ring[self->ring_head].instrument)
+		ring_drop(self);
+
+	if (self->ring_len == self->ring_size)
+		ring_drop(self);
+
+	idx = (self->ring_head + self->ring_len++) % self->ring_size;
+
+	entry = self->ring + idx;
+
+	entry->instrument	= instrument;
+	entry->template		= template;
+	entry->rpt_seq		= rpt_seq;
+	entry->next		= -1;
+
+	dst = entry_fields(self, idx);
+	strings = self->ring_strings + idx * self->strings_size;
+
+	for (i = 0; i < nr_fields; i++, dst++) {
+		*dst = fields[i];
+
+		switch (dst->type) {
+		case FAST_TYPE_STRING:
+			len = fields[i].string_len;
+			if (len >= dst->string_size)
+				len = dst->string_size - 1;
+
+			memcpy(strings, fields[i].string_value, len);
+			strings[len] = '\0';
+
+			dst->string_buf		= strings;
+			dst->string_value	= strings;
+			dst->string_len		= len;
+
+			strings += dst->string_size;
+			break;
+		case FAST_TYPE_SEQUENCE:
+			dst->ptr_value = NULL;
+			break;
+		case FAST_TYPE_INT:
+		case FAST_TYPE_UINT:
+		case FAST_TYPE_DECIMAL:
+		default:
+			break;
+		}
+	}
+
+	if (instrument->tail >= 0)
+		self->ring[instrument->tail].next = idx;
+	else
+		instrument->head = idx;
+
+	instrument->tail = idx;
+	instrument->nr_queued++;
+
+	self->stats.nr_queued++;
+}
+
+static int recovery_apply(struct fast_recovery *self, struct fast_instrument *instrument, u64 tid, struct fast_field *fields, i64 rpt_seq)
+{
+	instrument->rpt_seq = rpt_seq;
+
+	self->stats.nr_updates++;
+
+	if (!self->on_update)
+		return 0;
+
+	return self->on_update(self, instrument, tid, fields);
+}
+
+static void recovery_stale(struct fast_recovery *self, struct fast_instrument *instrument)
+{
+	instrument->state = FAST_INSTRUMENT_STALE;
+
+	self->nr_live--;
+	self->stats.nr_gaps++;
+}
+
+static int recovery_update(struct fast_recovery *self, struct fast_recovery_template *template, u64 tid,
+			   struct fast_field *fields, unsigned long nr_fields)
+{
+	struct fast_instrument *instrument;
+	i64 rpt_seq;
+
+	instrument = fields_instrument(self, template, fields, &rpt_seq);
+	if (!instrument) {
+		self->stats.nr_errors++;
+		return 0;
+	}
+
+	/* A live instrument has received all that it has applied */
+	if (rpt_seq <= instrument->last_seen) {
+		self->stats.nr_duplicates++;
+		return 0;
+	}
+
+	instrument->last_seen = rpt_seq;
+
+	if (instrument->state == FAST_INSTRUMENT_LIVE) {
+		if (rpt_seq == instrument->rpt_seq + 1)
+			return recovery_apply(self, instrument, tid, fields, rpt_seq);
+
+		recovery_stale(self, instrument);
+	}
+
+	ring_push(self, instrument, template, fields, nr_fields, rpt_seq);
+
+	return 0;
+}
+
+/*
+ * Applies the queued updates that follow the instrument's RptSeq without
+ * a gap, drops the ones that the RptSeq covers and leaves the rest.
+ */
+static int recovery_drain(struct fast_recovery *self, struct fast_instrument *instrument)
+{
+	struct fast_recovery_entry *entry;
+	long idx;
+	int ret;
+
+	while ((idx = instrument->head) >= 0) {
+		entry = self->ring + idx;
+
+		if (entry->rpt_seq > instrument->rpt_seq + 1)
+			return 0;
+
+		instrument->head = entry->next;
+		if (instrument->head < 0)
+			instrument->tail = -1;
+
+		instrument->nr_queued--;
+
+		entry->instrument = NULL;
+
+		if (entry->rpt_seq <= instrument->rpt_seq)
+			continue;
+
+		ret = recovery_apply(self, instrument, entry->template->tid, entry_fields(self, idx), entry->rpt_seq);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int recovery_snapshot(struct fast_recovery *self, struct fast_recovery_template *template, struct fast_message *msg)
+{
+	struct fast_instrument *instrument;
+	i64 rpt_seq;
+	int ret;
+
+	instrument = fields_instrument(self, template, msg->fields, &rpt_seq);
+	if (!instrument) {
+		self->stats.nr_errors++;
+		return 0;
+	}
+
+	switch (instrument->state) {
+	case FAST_INSTRUMENT_LIVE:
+		self->stats.nr_ignored++;
+		return 0;
+	case FAST_INSTRUMENT_STALE:
+		if (rpt_seq <= instrument->rpt_seq) {
+			self->stats.nr_ignored++;
+			return 0;
+		}
+		break;
+	case FAST_INSTRUMENT_EMPTY:
+	default:
+		break;
+	}
+
+	instrument->rpt_seq = rpt_seq;
+	if (instrument->last_seen < rpt_seq)
+		instrument->last_seen = rpt_seq;
+
+	self->stats.nr_snapshots++;
+
+	if (self->on_snapshot) {
+		ret = self->on_snapshot(self, instrument, msg);
+		if (ret)
+			return ret;
+	}
+
+	if (instrument->state == FAST_INSTRUMENT_EMPTY)
+		instrument->state = FAST_INSTRUMENT_STALE;
+
+	ret = recovery_drain(self, instrument);
+	if (ret)
+		return ret;
+
+	if (instrument->rpt_seq != instrument->last_seen)
+		return 0;
+
+	instrument->state = FAST_INSTRUMENT_LIVE;
+
+	self->nr_live++;
+	self->stats.nr_recovered++;
+
+	return 0;
+}
+
+/*
+ * Takes a message of either channel. Messages of templates that carry no
+ * updates or snapshots are left alone. A non-zero return value of the
+ * application's callbacks is returned as it is.
+ */
+int fast_recovery_process(struct fast_recovery *self, struct fast_message *msg)
+{
+	struct fast_recovery_template *template;
+	struct fast_sequence *seq;
+	unsigned long i;
+	int ret;
+
+	template = recovery_template(self, msg->tid);
+	if (!template)
+		return 0;
+
+	if (template->snapshot)
+		return recovery_snapshot(self, template, msg);
+
+	if (template->entries < 0)
+		return recovery_update(self, template, msg->tid, msg->fields, msg->nr_fields);
+
+	seq = msg->fields[template->entries].ptr_value;
+
+	if (field_state_empty(&seq->length))
+		return 0;
+
+	for (i = 0; i < seq->length.uint_value; i++) {
+		ret = recovery_update(self, template, msg->tid, fast_sequence_element(seq, i), seq->element.nr_fields);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+struct fast_instrument *fast_recovery_instrument(struct fast_recovery *self, const char *symbol)
+{
+	unsigned long len = strlen(symbol);
+
+	if (len >= FAST_RECOVERY_SYMBOL_LEN)
+		return NULL;
+
+	return *recovery_slot(self, symbol, len);
+}
+
+/* Up to ring_size updates are queued, older ones are dropped for newer */
+struct fast_recovery *fast_recovery_new(unsigned long ring_size)
+{
+	struct fast_recovery *self;
+
+	if (!ring_size)
+		return NULL;
+
+	self = calloc(1, sizeof *self);
+	if (!self)
+		return NULL;
+
+	self->instruments = calloc(FAST_RECOVERY_INSTRUMENT_NUMBER, sizeof(struct fast_instrument *));
+	if (!self->instruments)
+		goto fail;
+
+	self->ring = calloc(ring_size, sizeof(struct fast_recovery_entry));
+	if (!self->ring)
+		goto fail;
+
+	self->max_instruments	= FAST_RECOVERY_INSTRUMENT_NUMBER;
+	self->ring_size		= ring_size;
+
+	return self;
+
+fail:
+	fast_recovery_free(self);
+
+	return NULL;
+}
+
+void fast_recovery_free(struct fast_recovery *self)
+{
+	unsigned long i;
+
+	if (!self)
+		return;
+
+	for (i = 0; i < self->max_instruments; i++)
+		free(self->instruments[i]);
+
+	free(self->instruments);
+	free(self->ring_strings);
+	free(self->ring_fields);
+	free(self->ring);
+	free(self);
+}
@@ -1,6 +1,8 @@
 #include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_codec.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 struct fast_session *fast_session_new(int sockfd)
 {
@@ -21,18 +23,6 @@ struct fast_session *fast_session_new(int sockfd)
 		return NULL;
 	}
 
-	self->tx_pmap_buffer		= buffer_new(FAST_TX_BUFFER_SIZE);
-	if (!self->tx_pmap_buffer) {
-		fast_session_free(self);
-		return NULL;
-	}
-
-	self->rx_messages	= fast_message_new(FAST_TEMPLATE_MAX_NUMBER);
-	if (!self->rx_messages) {
-		fast_session_free(self);
-		return NULL;
-	}
-
 	buffer_set_ptr(self->rx_buffer, &self->sockfd);
 
 	self->sockfd		= sockfd;
@@ -47,21 +37,22 @@ void fast_session_free(struct fast_session *self)
 	if (!self)
 		return;
 
-	fast_message_free(self->rx_messages, FAST_TEMPLATE_MAX_NUMBER);
+	fast_message_free(self->rx_messages, self->max_messages);
+	fast_tid_map_free(&self->rx_map);
+	fast_dictionary_free(&self->dictionary);
+	fast_templates_put(self->templates);
 	buffer_delete(self->tx_message_buffer);
-	buffer_delete(self->tx_pmap_buffer);
 	buffer_delete(self->rx_buffer);
 	free(self);
 }
 
 struct fast_message *fast_session_recv(struct fast_session *self, int flags)
 {
-	struct fast_message *msgs = self->rx_messages;
 	struct buffer *buffer = self->rx_buffer;
 	u64 last_tid = self->last_tid;
 	struct fast_message *msg;
 
-	msg = fast_message_decode(msgs, buffer, last_tid);
+	msg = fast_message_decode(&self->rx_map, buffer, last_tid);
 	if (msg)
 		self->last_tid = msg->tid;
 
@@ -70,18 +61,218 @@ struct fast_message *fast_session_recv(struct fast_session *self, int flags)
 
 int fast_session_send(struct fast_session *self, struct fast_message *msg, int flags)
 {
-	msg->pmap_buf = self->tx_pmap_buffer;
-	buffer_reset(msg->pmap_buf);
 	msg->msg_buf = self->tx_message_buffer;
 	buffer_reset(msg->msg_buf);
 
 	return fast_message_send(msg, self->sockfd, flags);
 }
 
+/*
+ * Makes room for nr_messages more templates, exactly as many the first
+ * time. Messages move, so the template id map has to be rebuilt once
+ * loading is done.
+ */
+int fast_session_reserve(struct fast_session *self, int nr_messages)
+{
+	struct fast_message *msgs;
+	int max_messages;
+
+	if (self->nr_messages + nr_messages <= self->max_messages)
+		return 0;
+
+	max_messages = self->max_messages ? self->max_messages : nr_messages;
+	while (max_messages < self->nr_messages + nr_messages)
+		max_messages *= 2;
+
+	msgs = realloc(self->rx_messages, max_messages * sizeof(struct fast_message));
+	if (!msgs)
+		return -1;
+
+	memset(msgs + self->max_messages, 0, (max_messages - self->max_messages) * sizeof(struct fast_message));
+
+	self->rx_messages	= msgs;
+	self->max_messages	= max_messages;
+
+	return 0;
+}
+
 void fast_session_reset(struct fast_session *self)
+{
+	self->dictionary.generation++;
+}
+
+/*
+ * Hands the messages of template tid to a visitor instead of storing them,
+ * or stores them again if visitor is NULL.
+ */
+int fast_session_set_visitor(struct fast_session *self, u64 tid, const struct fast_visitor *visitor, void *data)
+{
+	struct fast_message *msg;
+
+	msg = fast_tid_lookup(&self->rx_map, tid);
+	if (!msg)
+		return -1;
+
+	msg->visitor		= visitor;
+	msg->visitor_data	= data;
+
+	return 0;
+}
+
+unsigned long fast_session_attach(struct fast_session *self, const struct fast_template_codec *codecs, unsigned long nr_codecs)
+{
+	unsigned long nr_attached = 0;
+	struct fast_message *msg;
+	unsigned long i;
+
+	for (i = 0; i < nr_codecs; i++) {
+		msg = fast_tid_lookup(&self->rx_map, codecs[i].tid);
+		if (!msg)
+			continue;
+
+		if (!fast_message_attach(msg, codecs + i))
+			nr_attached++;
+	}
+
+	return nr_attached;
+}
+
+/*
+ * Sets the session up with templates that other sessions may use as well,
+ * which is much cheaper than parsing them again. The session must not have
+ * templates of its own yet.
+ */
+int fast_session_use_templates(struct fast_session *self, struct fast_templates *templates)
 {
 	int i;
 
+	if (self->nr_messages || self->templates)
+		return -1;
+
+	if (fast_session_reserve(self, templates->nr_messages))
+		return -1;
+
+	if (fast_dictionary_clone(&self->dictionary, &templates->dictionary))
+		goto fail;
+
+	for (i = 0; i < templates->nr_messages; i++) {
+		if (fast_message_clone(self->rx_messages + i, templates->messages + i, &self->dictionary))
+			goto fail;
+
+		self->nr_messages++;
+	}
+
+	if (fast_tid_map_build(&self->rx_map, self->rx_messages, self->nr_messages))
+		goto fail;
+
+	self->templates = fast_templates_get(templates);
+
+	return 0;
+
+fail:
 	for (i = 0; i < self->nr_messages; i++)
-		fast_message_reset(self->rx_messages + i);
+		fast_fields_free(self->rx_messages + i);
+
+	memset(self->rx_messages, 0, self->nr_messages * sizeof(struct fast_message));
+
+	fast_dictionary_free(&self->dictionary);
+	self->nr_messages = 0;
+
+	return -1;
+}
+
+/*
+ * Parses templates to share from xml, or loads them from cache if that is
+ * not NULL, see fast_cached_template(). The caller holds the only
+ * reference.
+ */
+struct fast_templates *fast_templates_new(const char *xml, const char *cache)
+{
+	struct fast_templates *self = NULL;
+	struct fast_session *session;
+	int ret;
+	int i;
+
+	session = fast_session_new(-1);
+	if (!session)
+		return NULL;
+
+	if (cache)
+		ret = fast_cached_template(session, xml, cache);
+	else
+		ret = fast_suite_template(session, xml);
+
+	if (ret)
+		goto exit;
+
+	self = calloc(1, sizeof *self);
+	if (!self)
+		goto exit;
+
+	/* The messages and their dictionary are taken from the session */
+	self->refcount		= 1;
+	self->nr_messages	= session->nr_messages;
+	self->messages		= session->rx_messages;
+	self->dictionary	= session->dictionary;
+
+	for (i = 0; i < self->nr_messages; i++) {
+		if (self->messages[i].dictionary)
+			self->messages[i].dictionary = &self->dictionary;
+	}
+
+	session->rx_messages	= NULL;
+	session->nr_messages	= 0;
+	session->max_messages	= 0;
+
+	memset(&session->dictionary, 0, sizeof(session->dictionary));
+
+exit:
+	fast_session_free(session);
+
+	return self;
+}
+
+struct fast_templates *fast_templates_get(struct fast_templates *self)
+{
+	__atomic_add_fetch(&self->refcount, 1, __ATOMIC_RELAXED);
+
+	return self;
+}
+
+void fast_templates_put(struct fast_templates *self)
+{
+	if (!self)
+		return;
+
+	if (__atomic_sub_fetch(&self->refcount, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	fast_message_free(self->messages, self->nr_messages);
+	fast_dictionary_free(&self->dictionary);
+	free(self);
+}
+
+/*
+ * Attaches generated codecs to the templates, the sessions that use them
+ * afterwards get the codecs too.
+ */
+unsigned long fast_templates_attach(struct fast_templates *self, const struct fast_template_codec *codecs, unsigned long nr_codecs)
+{
+	unsigned long nr_attached = 0;
+	unsigned long i;
+	int j;
+
+	for (i = 0; i < nr_codecs; i++) {
+		for (j = 0; j < self->nr_messages; j++) {
+			if (self->messages[j].tid != codecs[i].tid)
+				continue;
+
+			if (!fast_message_attach(self->messages + j, codecs + i))
+				nr_attached++;
+
+			break;
+		}
+	}
+
+	return nr_attached;
 }
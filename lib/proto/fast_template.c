@@ -3,9 +3,61 @@
 
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+/*
+ * Fields that have the same key in the same dictionary share a dictionary
+ * entry. Keys are numbered from one in the order they are first seen, see
+ * fast_dictionary_build() for how they become slots.
+ */
+struct fast_scope {
+	char			**keys;
+	unsigned long		nr_keys;
+
+	/* Dictionaries of <templates> and of the template, or NULL */
+	xmlChar			*templates_dictionary;
+	xmlChar			*template_dictionary;
+
+	/* Application type of the template or sequence, or NULL */
+	xmlChar			*type;
+	u64			tid;
+};
+
+static int fast_field_init(xmlNodePtr node, struct fast_field *field, char **strings, struct fast_scope *scope);
+
+static void fast_scope_free(struct fast_scope *scope)
+{
+	unsigned long i;
+
+	for (i = 0; i < scope->nr_keys; i++)
+		free(scope->keys[i]);
 
-static int fast_field_init(xmlNodePtr node, struct fast_field *field);
+	free(scope->keys);
+	xmlFree(scope->templates_dictionary);
+}
+
+static bool fast_node_is(xmlNodePtr node, const char *name)
+{
+	return node->type == XML_ELEMENT_NODE && !xmlStrcmp(node->name, (const xmlChar *)name);
+}
+
+/* Name of the application type a <typeRef> child of node declares, or NULL */
+static xmlChar *fast_type_ref(xmlNodePtr node)
+{
+	for (node = node->xmlChildrenNode; node != NULL; node = node->next) {
+		if (fast_node_is(node, "typeRef"))
+			return xmlGetProp(node, (const xmlChar *)"name");
+	}
+
+	return NULL;
+}
 
 static int fast_presence_init(xmlNodePtr node, struct fast_field *field)
 {
@@ -31,6 +83,20 @@ static int fast_presence_init(xmlNodePtr node, struct fast_field *field)
 	return ret;
 }
 
+static bool fast_node_is_bytes(xmlNodePtr node)
+{
+	return !xmlStrcmp(node->name, (const xmlChar *)"byteVector") ||
+		!xmlStrcmp(node->name, (const xmlChar *)"ByteVector");
+}
+
+/* Byte vectors are coded just like unicode strings */
+static bool fast_node_is_string(xmlNodePtr node)
+{
+	return !xmlStrcmp(node->name, (const xmlChar *)"string") ||
+		!xmlStrcmp(node->name, (const xmlChar *)"String") ||
+		fast_node_is_bytes(node);
+}
+
 static int fast_misc_init(xmlNodePtr node, struct fast_field *field)
 {
 	xmlChar *prop;
@@ -43,11 +109,77 @@ static int fast_misc_init(xmlNodePtr node, struct fast_field *field)
 	if (prop != NULL && !xmlStrcmp(prop, (const xmlChar *)"unicode"))
 		field_add_flags(field, FAST_FIELD_FLAGS_UNICODE);
 
+	if (fast_node_is_bytes(node))
+		field_add_flags(field, FAST_FIELD_FLAGS_UNICODE);
+
 	xmlFree(prop);
 
 	return 0;
 }
 
+/*
+ * Strings take FAST_STRING_MAX_BYTES unless the template declares a
+ * smaller maxLength for them.
+ */
+static unsigned long fast_string_size(xmlNodePtr node)
+{
+	unsigned long size = FAST_STRING_MAX_BYTES;
+	unsigned long max_length;
+	xmlChar *prop;
+
+	prop = xmlGetProp(node, (const xmlChar *)"maxLength");
+
+	if (prop != NULL) {
+		max_length = strtoul((char *)prop, NULL, 10);
+
+		if (max_length > 0 && max_length < FAST_STRING_MAX_BYTES)
+			size = max_length + 1;
+	}
+
+	xmlFree(prop);
+
+	return size;
+}
+
+/* Size of the string arena for the fields below a template or sequence node */
+static unsigned long fast_strings_size(xmlNodePtr node)
+{
+	unsigned long size = 0;
+
+	for (node = node->xmlChildrenNode; node != NULL; node = node->next) {
+		if (node->type != XML_ELEMENT_NODE)
+			continue;
+
+		/* Value, reset value and previous value */
+		if (fast_node_is_string(node))
+			size += 3 * fast_string_size(node);
+	}
+
+	return size;
+}
+
+static void fast_string_assign(struct fast_field *field, unsigned long size, char **strings)
+{
+	field->string_size	= size;
+
+	field->string_buf	= *strings;
+	field->string_value	= *strings;
+	field->string_reset	= *strings + size;
+	field->string_previous	= *strings + 2 * size;
+
+	*strings += 3 * size;
+}
+
+static int fast_string_init(xmlNodePtr node, struct fast_field *field, char **strings)
+{
+	if (!strings || !*strings)
+		return 1;
+
+	fast_string_assign(field, fast_string_size(node), strings);
+
+	return 0;
+}
+
 static int fast_type_init(xmlNodePtr node, struct fast_field *field)
 {
 	int ret = 0;
@@ -63,8 +195,7 @@ static int fast_type_init(xmlNodePtr node, struct fast_field *field)
 	else if (!xmlStrcmp(node->name, (const xmlChar *)"length") ||
 			!xmlStrcmp(node->name, (const xmlChar *)"Length"))
 		field->type = FAST_TYPE_UINT;
-	else if (!xmlStrcmp(node->name, (const xmlChar *)"string") ||
-			!xmlStrcmp(node->name, (const xmlChar *)"String"))
+	else if (fast_node_is_string(node))
 		field->type = FAST_TYPE_STRING;
 	else if (!xmlStrcmp(node->name, (const xmlChar *)"decimal") ||
 			!xmlStrcmp(node->name, (const xmlChar *)"Decimal"))
@@ -92,16 +223,18 @@ static int fast_op_init(xmlNodePtr node, struct fast_field *field)
 		field->op = FAST_OP_CONSTANT;
 	else if (!xmlStrcmp(node->name, (const xmlChar *)"increment"))
 		field->op = FAST_OP_INCR;
+	else if (!xmlStrcmp(node->name, (const xmlChar *)"tail") && field->type == FAST_TYPE_STRING)
+		field->op = FAST_OP_TAIL;
 	else
 		ret = 1;
 
 	return ret;
 }
 
-static int fast_reset_init(xmlNodePtr node, struct fast_field *field)
+/* Sets up the initial value of a field, value is NULL if there is none */
+static int fast_field_reset_init(struct fast_field *field, const char *value)
 {
 	int ret = 0;
-	xmlChar *prop;
 
 	field->has_reset = false;
 
@@ -110,58 +243,46 @@ static int fast_reset_init(xmlNodePtr node, struct fast_field *field)
 		field->int_value = 0;
 		field->int_previous = 0;
 
-		if (node == NULL)
-			break;
-
-		prop = xmlGetProp(node, (const xmlChar *)"value");
-
-		if (prop == NULL)
+		if (value == NULL)
 			break;
 
 		field->has_reset = true;
-		field->int_reset = strtol((char *)prop, NULL, 10);
+		field->int_reset = strtol(value, NULL, 10);
 		field->int_value = field->int_reset;
 		field->int_previous = field->int_reset;
-
-		xmlFree(prop);
 		break;
 	case FAST_TYPE_UINT:
 		field->uint_value = 0;
 		field->uint_previous = 0;
 
-		if (node == NULL)
-			break;
-
-		prop = xmlGetProp(node, (const xmlChar *)"value");
-
-		if (prop == NULL)
+		if (value == NULL)
 			break;
 
 		field->has_reset = true;
-		field->uint_reset = strtoul((char *)prop, NULL, 10);
+		field->uint_reset = strtoul(value, NULL, 10);
 		field->uint_value = field->uint_reset;
 		field->uint_previous = field->uint_reset;
-
-		xmlFree(prop);
 		break;
 	case FAST_TYPE_STRING:
 		field->string_value[0] = 0;
 		field->string_previous[0] = 0;
+		field->string_len = 0;
+		field->string_previous_len = 0;
 
-		if (node == NULL)
+		if (value == NULL)
 			break;
 
-		prop = xmlGetProp(node, (const xmlChar *)"value");
-
-		if (prop == NULL)
+		if (strlen(value) >= field->string_size) {
+			ret = 1;
 			break;
+		}
 
 		field->has_reset = true;
-		strcpy(field->string_reset, (char *)prop);
-		strcpy(field->string_value, (char *)prop);
-		strcpy(field->string_previous, (char *)prop);
-
-		xmlFree(prop);
+		field->string_len = strlen(value);
+		field->string_previous_len = field->string_len;
+		strcpy(field->string_reset, value);
+		strcpy(field->string_value, value);
+		strcpy(field->string_previous, value);
 		break;
 	case FAST_TYPE_DECIMAL:
 		field->decimal_value.exp = 0;
@@ -181,13 +302,223 @@ static int fast_reset_init(xmlNodePtr node, struct fast_field *field)
 	return ret;
 }
 
-static int fast_sequence_init(xmlNodePtr node, struct fast_field *field)
+static int fast_reset_init(xmlNodePtr node, struct fast_field *field)
 {
+	xmlChar *prop = NULL;
+	int ret;
+
+	if (node != NULL)
+		prop = xmlGetProp(node, (const xmlChar *)"value");
+
+	ret = fast_field_reset_init(field, (const char *)prop);
+
+	xmlFree(prop);
+
+	return ret;
+}
+
+static int fast_scope_key(struct fast_scope *scope, char *key)
+{
+	char **keys;
+	unsigned long i;
+
+	for (i = 0; i < scope->nr_keys; i++) {
+		if (!strcmp(scope->keys[i], key)) {
+			free(key);
+			return i + 1;
+		}
+	}
+
+	keys = realloc(scope->keys, (scope->nr_keys + 1) * sizeof(char *));
+	if (!keys) {
+		free(key);
+		return -1;
+	}
+
+	scope->keys = keys;
+	scope->keys[scope->nr_keys++] = key;
+
+	return scope->nr_keys;
+}
+
+/*
+ * Numbers the field with the key of the dictionary entry that its operator
+ * works from. The key is the operator's key or else the field's name, the
+ * dictionary is the operator's or else the template's, the templates' or
+ * the global one. Type dictionaries of templates without a type share the
+ * "any" type.
+ */
+static int fast_slot_init(xmlNodePtr node, xmlNodePtr op, struct fast_field *field, struct fast_scope *scope)
+{
+	xmlChar *dictionary = NULL;
+	xmlChar *name = NULL;
+	const char *dict;
+	char *key = NULL;
+	int ret = 0;
+	int slot;
+
+	if (!scope || !op)
+		return 0;
+
+	switch (field->op) {
+	case FAST_OP_COPY:
+	case FAST_OP_INCR:
+	case FAST_OP_DELTA:
+	case FAST_OP_TAIL:
+		break;
+	case FAST_OP_NONE:
+	case FAST_OP_CONSTANT:
+	default:
+		return 0;
+	}
+
+	name = xmlGetProp(op, (const xmlChar *)"key");
+	if (name == NULL)
+		name = xmlGetProp(node, (const xmlChar *)"name");
+
+	if (name == NULL)
+		return 0;
+
+	dictionary = xmlGetProp(op, (const xmlChar *)"dictionary");
+
+	if (dictionary != NULL)
+		dict = (const char *)dictionary;
+	else if (scope->template_dictionary != NULL)
+		dict = (const char *)scope->template_dictionary;
+	else if (scope->templates_dictionary != NULL)
+		dict = (const char *)scope->templates_dictionary;
+	else
+		dict = "global";
+
+	if (!strcmp(dict, "global"))
+		ret = asprintf(&key, "global:%s", name);
+	else if (!strcmp(dict, "template"))
+		ret = asprintf(&key, "template:%" PRIu64 ":%s", scope->tid, name);
+	else if (!strcmp(dict, "type"))
+		ret = asprintf(&key, "type:%s:%s", scope->type ? (const char *)scope->type : "any", name);
+	else
+		ret = asprintf(&key, "user:%s:%s", dict, name);
+
+	xmlFree(dictionary);
+	xmlFree(name);
+
+	if (ret < 0)
+		return 1;
+
+	slot = fast_scope_key(scope, key);
+	if (slot < 0)
+		return 1;
+
+	field->slot = slot;
+
+	return 0;
+}
+
+static bool fast_node_is_decimal_part(xmlNodePtr node)
+{
+	return fast_node_is(node, "exponent") || fast_node_is(node, "mantissa");
+}
+
+/* The operator of an exponent or mantissa node, or NULL if it has none */
+static int fast_decimal_part_init(xmlNodePtr node, struct fast_field *part)
+{
+	int ret;
+
+	if (node != NULL) {
+		node = node->xmlChildrenNode;
+
+		while (node && node->type != XML_ELEMENT_NODE)
+			node = node->next;
+	}
+
+	ret = fast_op_init(node, part);
+	if (ret)
+		return ret;
+
+	return fast_reset_init(node, part);
+}
+
+/*
+ * Sets up a decimal whose exponent and mantissa nodes have operators of
+ * their own, a part without a node has none. The parts do not share their
+ * dictionaries with other fields.
+ */
+static int fast_decimal_parts_init(xmlNodePtr node, struct fast_field *field)
+{
+	xmlNodePtr exponent = NULL;
+	xmlNodePtr mantissa = NULL;
+	struct fast_decimal_parts *parts;
+
+	for (; node != NULL; node = node->next) {
+		if (node->type != XML_ELEMENT_NODE)
+			continue;
+
+		if (fast_node_is(node, "exponent") && !exponent)
+			exponent = node;
+		else if (fast_node_is(node, "mantissa") && !mantissa)
+			mantissa = node;
+		else
+			return 1;
+	}
+
+	parts = calloc(1, sizeof(*parts));
+	if (!parts)
+		return 1;
+
+	field->op		= FAST_OP_NONE;
+	field->ptr_reset	= parts;
+	field_add_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS);
+
+	parts->exponent.type		= FAST_TYPE_INT;
+	parts->exponent.presence	= field->presence;
+	parts->exponent.state		= FAST_STATE_UNDEFINED;
+
+	parts->mantissa.type		= FAST_TYPE_INT;
+	parts->mantissa.presence	= FAST_PRESENCE_MANDATORY;
+	parts->mantissa.state		= FAST_STATE_UNDEFINED;
+
+	if (fast_decimal_part_init(exponent, &parts->exponent))
+		return 1;
+
+	return fast_decimal_part_init(mantissa, &parts->mantissa);
+}
+
+/*
+ * Gives the field the next bits of the pmap that it needs, if any, and
+ * returns whether it needs any.
+ */
+static bool fast_pmap_init(struct fast_field *field, int *pmap_bit)
+{
+	struct fast_decimal_parts *parts;
+	bool exponent, mantissa;
+
+	if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS)) {
+		parts = field_decimal_parts(field);
+
+		exponent = fast_pmap_init(&parts->exponent, pmap_bit);
+		mantissa = fast_pmap_init(&parts->mantissa, pmap_bit);
+
+		return exponent || mantissa;
+	}
+
+	if (!pmap_required(field))
+		return false;
+
+	field->pmap_bit = (*pmap_bit)++;
+
+	return true;
+}
+
+static int fast_sequence_init(xmlNodePtr node, struct fast_field *field, struct fast_scope *scope)
+{
+	unsigned long strings_size;
 	struct fast_sequence *seq;
 	struct fast_message *msg;
 	struct fast_field *orig;
-	xmlNodePtr tmp;
-	int i, ret = 1;
+	xmlChar *outer_type = scope->type;
+	xmlChar *type = NULL;
+	int ret = 1;
+	char *strings;
 	int nr_fields;
 	int pmap_bit;
 
@@ -198,15 +529,21 @@ static int fast_sequence_init(xmlNodePtr node, struct fast_field *field)
 	seq = field->ptr_value;
 
 	nr_fields = xmlChildElementCount(node);
+	strings_size = fast_strings_size(node);
+
+	/* Elements of a sequence may be of their own application type */
+	type = fast_type_ref(node);
+	if (type != NULL)
+		scope->type = type;
 
 	node = node->xmlChildrenNode;
-	while (node && node->type != XML_ELEMENT_NODE)
+	while (node && (node->type != XML_ELEMENT_NODE || fast_node_is(node, "typeRef")))
 		node = node->next;
 
-	if (xmlStrcmp(node->name, (const xmlChar *)"length"))
+	if (!node || xmlStrcmp(node->name, (const xmlChar *)"length"))
 		goto exit;
 
-	if (fast_field_init(node, &seq->length))
+	if (fast_field_init(node, &seq->length, NULL, NULL))
 		goto exit;
 
 	if (!field_is_mandatory(field))
@@ -214,47 +551,49 @@ static int fast_sequence_init(xmlNodePtr node, struct fast_field *field)
 
 	node = node->next;
 	orig = field;
+	msg = &seq->element;
 
-	for (i = 0; i < FAST_SEQUENCE_ELEMENTS; i++) {
-		msg = seq->elements + i;
-		tmp = node;
+	msg->fields = calloc(nr_fields, sizeof(struct fast_field));
+	if (!msg->fields)
+		goto exit;
 
-		msg->fields = calloc(nr_fields, sizeof(struct fast_field));
-		if (!msg->fields)
+	if (strings_size) {
+		msg->strings = calloc(1, strings_size);
+		if (!msg->strings)
 			goto exit;
+	}
 
-		msg->nr_fields = 0;
-		pmap_bit = 0;
+	strings = msg->strings;
+	msg->nr_fields = 0;
+	pmap_bit = 0;
 
-		while (tmp != NULL) {
-			if (tmp->type != XML_ELEMENT_NODE) {
-				tmp = tmp->next;
-				continue;
-			}
+	for (; node != NULL; node = node->next) {
+		if (node->type != XML_ELEMENT_NODE || fast_node_is(node, "typeRef"))
+			continue;
 
-			field = msg->fields + msg->nr_fields;
+		field = msg->fields + msg->nr_fields;
 
-			if (fast_field_init(tmp, field))
-				goto exit;
+		if (fast_field_init(node, field, &strings, scope))
+			goto exit;
 
-			if (pmap_required(field)) {
-				field_add_flags(orig, FAST_FIELD_FLAGS_PMAPREQ);
-				field->pmap_bit = pmap_bit++;
-			}
+		if (fast_pmap_init(field, &pmap_bit))
+			field_add_flags(orig, FAST_FIELD_FLAGS_PMAPREQ);
 
-			msg->nr_fields++;
-			tmp = tmp->next;
-		}
+		msg->nr_fields++;
 	}
 
 	ret = 0;
 
 exit:
+	scope->type = outer_type;
+	xmlFree(type);
+
 	return ret;
 }
 
-static int fast_field_init(xmlNodePtr node, struct fast_field *field)
+static int fast_field_init(xmlNodePtr node, struct fast_field *field, char **strings, struct fast_scope *scope)
 {
+	xmlNodePtr parent = node;
 	int ret;
 
 	field->state = FAST_STATE_UNDEFINED;
@@ -271,6 +610,12 @@ static int fast_field_init(xmlNodePtr node, struct fast_field *field)
 	if (ret)
 		goto exit;
 
+	if (field->type == FAST_TYPE_STRING) {
+		ret = fast_string_init(node, field, strings);
+		if (ret)
+			goto exit;
+	}
+
 	switch (field->type) {
 	case FAST_TYPE_INT:
 	case FAST_TYPE_UINT:
@@ -281,6 +626,11 @@ static int fast_field_init(xmlNodePtr node, struct fast_field *field)
 		while (node && node->type != XML_ELEMENT_NODE)
 			node = node->next;
 
+		if (field->type == FAST_TYPE_DECIMAL && node && fast_node_is_decimal_part(node)) {
+			ret = fast_decimal_parts_init(node, field);
+			break;
+		}
+
 		ret = fast_op_init(node, field);
 		if (ret)
 			goto exit;
@@ -289,9 +639,13 @@ static int fast_field_init(xmlNodePtr node, struct fast_field *field)
 		if (ret)
 			goto exit;
 
+		ret = fast_slot_init(parent, node, field, scope);
+		if (ret)
+			goto exit;
+
 		break;
 	case FAST_TYPE_SEQUENCE:
-		ret = fast_sequence_init(node, field);
+		ret = fast_sequence_init(node, field, scope);
 		break;
 	default:
 		ret = 1;
@@ -302,9 +656,11 @@ exit:
 	return ret;
 }
 
-static int fast_message_init(xmlNodePtr node, struct fast_message *msg)
+static int fast_message_init(xmlNodePtr node, struct fast_message *msg, struct fast_scope *scope)
 {
+	unsigned long strings_size;
 	struct fast_field *field;
+	char *strings;
 	int nr_fields;
 	xmlChar *prop;
 	int pmap_bit;
@@ -325,28 +681,39 @@ static int fast_message_init(xmlNodePtr node, struct fast_message *msg)
 		fast_msg_add_flags(msg, FAST_MSG_FLAGS_RESET);
 	xmlFree(prop);
 
+	scope->tid			= msg->tid;
+	scope->template_dictionary	= xmlGetProp(node, (const xmlChar *)"dictionary");
+	scope->type			= fast_type_ref(node);
+
 	nr_fields = xmlChildElementCount(node);
 	msg->fields = calloc(nr_fields, sizeof(struct fast_field));
 	if (!msg->fields)
 		goto exit;
 
+	strings_size = fast_strings_size(node);
+	if (strings_size) {
+		msg->strings = calloc(1, strings_size);
+		if (!msg->strings)
+			goto exit;
+	}
+
+	strings = msg->strings;
 	msg->nr_fields = 0;
 	pmap_bit = 1;
 
 	node = node->xmlChildrenNode;
 	while (node != NULL) {
-		if (node->type != XML_ELEMENT_NODE) {
+		if (node->type != XML_ELEMENT_NODE || fast_node_is(node, "typeRef")) {
 			node = node->next;
 			continue;
 		}
 
 		field = msg->fields + msg->nr_fields;
 
-		if (fast_field_init(node, field))
+		if (fast_field_init(node, field, &strings, scope))
 			goto exit;
 
-		if (pmap_required(field))
-			field->pmap_bit = pmap_bit++;
+		fast_pmap_init(field, &pmap_bit);
 
 		msg->nr_fields++;
 		node = node->next;
@@ -355,11 +722,18 @@ static int fast_message_init(xmlNodePtr node, struct fast_message *msg)
 	ret = 0;
 
 exit:
+	xmlFree(scope->template_dictionary);
+	xmlFree(scope->type);
+
+	scope->template_dictionary	= NULL;
+	scope->type			= NULL;
+
 	return ret;
 }
 
 int fast_suite_template(struct fast_session *self, const char *xml)
 {
+	struct fast_scope scope = { };
 	struct fast_message *msg;
 	xmlNodePtr node;
 	xmlDocPtr doc;
@@ -376,9 +750,11 @@ int fast_suite_template(struct fast_session *self, const char *xml)
 	if (xmlStrcmp(node->name, (const xmlChar *)"templates"))
 		goto free;
 
-	if (xmlChildElementCount(node) > FAST_TEMPLATE_MAX_NUMBER)
+	if (fast_session_reserve(self, xmlChildElementCount(node)))
 		goto free;
 
+	scope.templates_dictionary = xmlGetProp(node, (const xmlChar *)"dictionary");
+
 	node = node->xmlChildrenNode;
 	while (node != NULL) {
 		if (node->type != XML_ELEMENT_NODE) {
@@ -387,63 +763,671 @@ int fast_suite_template(struct fast_session *self, const char *xml)
 		}
 
 		msg = self->rx_messages + self->nr_messages;
-		if (fast_message_init(node, msg))
+		if (fast_message_init(node, msg, &scope))
 			goto free;
 
 		self->nr_messages++;
 		node = node->next;
 	}
 
+	if (fast_tid_map_build(&self->rx_map, self->rx_messages, self->nr_messages))
+		goto free;
+
+	if (fast_dictionary_build(&self->dictionary, self->rx_messages, self->nr_messages))
+		goto free;
+
 	ret = 0;
 
 free:
+	fast_scope_free(&scope);
 	xmlFreeDoc(doc);
 
 exit:
 	return ret;
 }
 
+/* MICEX templates are plain FAST ones */
 int fast_micex_template(struct fast_session *self, const char *xml)
 {
+	return fast_suite_template(self, xml);
+}
+
+/*
+ * Parsed templates can be saved to a binary cache that loads without
+ * libxml2. The cache is a header followed by a record per template, each
+ * followed by records for its fields. The fields of a sequence's element
+ * follow the record of its length, the exponent and the mantissa of a
+ * decimal with operators of their own follow the decimal's record. Records
+ * are padded to eight bytes.
+ */
+#define	FAST_CACHE_MAGIC		0x54534146	/* "FAST" */
+#define	FAST_CACHE_VERSION		3
+
+struct fast_cache_header {
+	u32			magic;
+	u32			version;
+	u64			xml_hash;
+	u64			size;
+	u64			nr_messages;
+	u64			nr_slots;
+};
+
+struct fast_cache_message {
+	u64			tid;
+	u32			flags;
+	u32			nr_fields;
+	u64			strings_size;
+};
+
+struct fast_cache_field {
+	u8			type;
+	u8			op;
+	u8			presence;
+	u8			flags;
+	u32			pmap_bit;
+	/* Size of each string buffer, or of the element arena of a sequence */
+	u32			string_size;
+	/* Number of a sequence's element fields */
+	u32			nr_fields;
+	/* Size of the reset value including its NUL, zero if there is none */
+	u32			reset_size;
+	/* Shared dictionary entry, see struct fast_field */
+	u32			slot;
+};
+
+struct fast_cache {
+	const char		*pos;
+	const char		*end;
+	unsigned long		nr_slots;
+};
+
+static unsigned long fast_cache_align(unsigned long size)
+{
+	return (size + 7) & ~7UL;
+}
+
+static const void *fast_cache_take(struct fast_cache *cache, unsigned long size)
+{
+	const char *p = cache->pos;
+
+	size = fast_cache_align(size);
+	if (size > (unsigned long) (cache->end - p))
+		return NULL;
+
+	cache->pos += size;
+
+	return p;
+}
+
+/* FNV-1a of the XML file, the cache is stale once it changes */
+static int fast_xml_hash(const char *xml, u64 *hash)
+{
+	const unsigned char *p;
+	struct stat st;
+	void *map;
+	u64 h = 0xcbf29ce484222325ULL;
+	off_t i;
+	int fd;
+
+	fd = open(xml, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || !st.st_size) {
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return -1;
+
+	for (p = map, i = 0; i < st.st_size; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+
+	munmap(map, st.st_size);
+
+	*hash = h;
+
+	return 0;
+}
+
+static unsigned long fast_fields_strings_size(struct fast_field *fields, unsigned long nr_fields)
+{
+	unsigned long size = 0;
+	unsigned long i;
+
+	for (i = 0; i < nr_fields; i++) {
+		if (fields[i].type == FAST_TYPE_STRING)
+			size += 3 * fields[i].string_size;
+	}
+
+	return size;
+}
+
+static int fast_cache_write(FILE *stream, const void *data, unsigned long size)
+{
+	static const char padding[8];
+	unsigned long aligned = fast_cache_align(size);
+
+	if (fwrite(data, 1, size, stream) != size)
+		return -1;
+
+	if (aligned > size && fwrite(padding, 1, aligned - size, stream) != aligned - size)
+		return -1;
+
+	return 0;
+}
+
+static int fast_cache_write_fields(FILE *stream, struct fast_field *fields, unsigned long nr_fields)
+{
+	struct fast_cache_field rec;
+	struct fast_sequence *seq;
+	struct fast_field *field;
+	char reset[32];
+	const char *value;
+	unsigned long i;
+
+	for (i = 0; i < nr_fields; i++) {
+		field = fields + i;
+
+		memset(&rec, 0, sizeof(rec));
+
+		rec.type	= field->type;
+		rec.op		= field->op;
+		rec.presence	= field->presence;
+		rec.flags	= field->flags;
+		rec.pmap_bit	= field->pmap_bit;
+		rec.string_size	= field->string_size;
+		rec.slot	= field->slot;
+
+		seq = field->type == FAST_TYPE_SEQUENCE ? field->ptr_value : NULL;
+		value = NULL;
+
+		switch (field->type) {
+		case FAST_TYPE_INT:
+			snprintf(reset, sizeof(reset), "%" PRId64, field->int_reset);
+			value = reset;
+			break;
+		case FAST_TYPE_UINT:
+			snprintf(reset, sizeof(reset), "%" PRIu64, field->uint_reset);
+			value = reset;
+			break;
+		case FAST_TYPE_STRING:
+			value = field->string_reset;
+			break;
+		case FAST_TYPE_SEQUENCE:
+			rec.nr_fields	= seq->element.nr_fields;
+			rec.string_size	= fast_fields_strings_size(seq->element.fields, seq->element.nr_fields);
+			break;
+		case FAST_TYPE_DECIMAL:
+		default:
+			break;
+		}
+
+		if (field->has_reset && value)
+			rec.reset_size = strlen(value) + 1;
+
+		if (fast_cache_write(stream, &rec, sizeof(rec)))
+			return -1;
+
+		if (rec.reset_size && fast_cache_write(stream, value, rec.reset_size))
+			return -1;
+
+		if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS)) {
+			if (fast_cache_write_fields(stream, &field_decimal_parts(field)->exponent, 1))
+				return -1;
+
+			if (fast_cache_write_fields(stream, &field_decimal_parts(field)->mantissa, 1))
+				return -1;
+		}
+
+		if (!seq)
+			continue;
+
+		if (fast_cache_write_fields(stream, &seq->length, 1))
+			return -1;
+
+		if (fast_cache_write_fields(stream, seq->element.fields, seq->element.nr_fields))
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Saves the session's templates, which were parsed from xml, to the cache
+ * file. The file is replaced atomically, so sessions that load it at the
+ * same time see either the old templates or the new ones.
+ */
+int fast_template_save(struct fast_session *self, const char *xml, const char *cache)
+{
+	struct fast_cache_message rec;
+	struct fast_cache_header hdr;
 	struct fast_message *msg;
-	xmlNodePtr node;
-	xmlDocPtr doc;
-	int ret = 1;
+	FILE *stream = NULL;
+	char *tmp = NULL;
+	int ret = -1;
+	long size;
+	int fd;
+	int i;
 
-	doc = xmlParseFile(xml);
-	if (doc == NULL)
+	memset(&hdr, 0, sizeof(hdr));
+
+	hdr.magic	= FAST_CACHE_MAGIC;
+	hdr.version	= FAST_CACHE_VERSION;
+	hdr.nr_messages	= self->nr_messages;
+	hdr.nr_slots	= self->dictionary.nr_slots;
+
+	if (fast_xml_hash(xml, &hdr.xml_hash))
 		goto exit;
 
-	node = xmlDocGetRootElement(doc);
-	if (node == NULL)
+	if (asprintf(&tmp, "%s.XXXXXX", cache) < 0) {
+		tmp = NULL;
 		goto exit;
+	}
 
-	if (xmlStrcmp(node->name, (const xmlChar *)"templates"))
-		goto free;
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		goto exit;
 
-	if (xmlChildElementCount(node) > FAST_TEMPLATE_MAX_NUMBER)
-		goto free;
+	stream = fdopen(fd, "w");
+	if (!stream) {
+		close(fd);
+		goto unlink;
+	}
+
+	if (fast_cache_write(stream, &hdr, sizeof(hdr)))
+		goto unlink;
+
+	for (i = 0; i < self->nr_messages; i++) {
+		msg = self->rx_messages + i;
+
+		memset(&rec, 0, sizeof(rec));
+
+		rec.tid			= msg->tid;
+		rec.flags		= msg->flags;
+		rec.nr_fields		= msg->nr_fields;
+		rec.strings_size	= fast_fields_strings_size(msg->fields, msg->nr_fields);
+
+		if (fast_cache_write(stream, &rec, sizeof(rec)))
+			goto unlink;
+
+		if (fast_cache_write_fields(stream, msg->fields, msg->nr_fields))
+			goto unlink;
+	}
+
+	size = ftell(stream);
+	if (size < 0)
+		goto unlink;
+
+	hdr.size = size;
+
+	if (fseek(stream, 0, SEEK_SET) || fast_cache_write(stream, &hdr, sizeof(hdr)))
+		goto unlink;
+
+	if (fclose(stream)) {
+		stream = NULL;
+		goto unlink;
+	}
+
+	stream = NULL;
+
+	if (rename(tmp, cache) < 0)
+		goto unlink;
+
+	ret = 0;
+	goto exit;
+
+unlink:
+	if (stream)
+		fclose(stream);
+
+	unlink(tmp);
+
+exit:
+	free(tmp);
+
+	return ret;
+}
+
+static int fast_cache_fields(struct fast_cache *cache, struct fast_field *fields, unsigned long nr_fields, unsigned long strings_size, char *strings);
+
+/*
+ * Sets up a sequence from its records, or only checks them if field is
+ * NULL. The sequence is allocated before the field is typed as one, so
+ * that a failed load can be freed.
+ */
+static int fast_cache_sequence(struct fast_cache *cache, struct fast_field *field, const struct fast_cache_field *rec)
+{
+	struct fast_sequence *seq;
+	struct fast_message *elem;
+
+	if (!field) {
+		if (fast_cache_fields(cache, NULL, 1, 0, NULL))
+			return -1;
+
+		return fast_cache_fields(cache, NULL, rec->nr_fields, rec->string_size, NULL);
+	}
+
+	seq = calloc(1, sizeof(struct fast_sequence));
+	if (!seq)
+		return -1;
+
+	field->ptr_value = seq;
+	field->type = FAST_TYPE_SEQUENCE;
+
+	elem = &seq->element;
+
+	elem->fields = calloc(rec->nr_fields, sizeof(struct fast_field));
+	if (!elem->fields)
+		return -1;
+
+	elem->nr_fields = rec->nr_fields;
+
+	if (rec->string_size) {
+		elem->strings = calloc(1, rec->string_size);
+		if (!elem->strings)
+			return -1;
+	}
+
+	if (fast_cache_fields(cache, &seq->length, 1, 0, NULL))
+		return -1;
+
+	return fast_cache_fields(cache, elem->fields, elem->nr_fields, rec->string_size, elem->strings);
+}
+
+/*
+ * Sets up the exponent and the mantissa of the decimal from their records,
+ * which must be plain integers, or only checks them if field is NULL.
+ */
+static int fast_cache_decimal_parts(struct fast_cache *cache, struct fast_field *field)
+{
+	const struct fast_cache_field *rec;
+	struct fast_decimal_parts *parts;
+	const char *pos = cache->pos;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		rec = fast_cache_take(cache, sizeof(*rec));
+		if (!rec || rec->type != FAST_TYPE_INT || rec->flags || rec->slot)
+			return -1;
+
+		if (rec->reset_size && !fast_cache_take(cache, rec->reset_size))
+			return -1;
+	}
+
+	if (!field)
+		return 0;
+
+	cache->pos = pos;
+
+	parts = calloc(1, sizeof(*parts));
+	if (!parts)
+		return -1;
+
+	field->ptr_reset = parts;
+
+	if (fast_cache_fields(cache, &parts->exponent, 1, 0, NULL))
+		return -1;
+
+	return fast_cache_fields(cache, &parts->mantissa, 1, 0, NULL);
+}
+
+/*
+ * Sets up nr_fields fields from their records, or only checks the records
+ * if fields is NULL. Checking never allocates, so a cache that turns out
+ * to be broken leaves the session as it was.
+ */
+static int fast_cache_fields(struct fast_cache *cache, struct fast_field *fields, unsigned long nr_fields, unsigned long strings_size, char *strings)
+{
+	const struct fast_cache_field *rec;
+	unsigned long used = 0;
+	struct fast_field *field;
+	const char *reset;
+	unsigned long i;
+
+	for (i = 0; i < nr_fields; i++) {
+		rec = fast_cache_take(cache, sizeof(*rec));
+		if (!rec)
+			return -1;
+
+		reset = NULL;
+
+		if (rec->reset_size) {
+			reset = fast_cache_take(cache, rec->reset_size);
+			if (!reset || reset[rec->reset_size - 1])
+				return -1;
+		}
+
+		if (rec->type > FAST_TYPE_SEQUENCE || rec->op > FAST_OP_TAIL ||
+		    rec->presence > FAST_PRESENCE_MANDATORY || rec->pmap_bit >= 7 * FAST_PMAP_MAX_BYTES)
+			return -1;
+
+		if (rec->slot > cache->nr_slots || (rec->slot && rec->type == FAST_TYPE_SEQUENCE))
+			return -1;
+
+		if ((rec->flags & FAST_FIELD_FLAGS_DECIMAL_PARTS) && rec->type != FAST_TYPE_DECIMAL)
+			return -1;
+
+		if (rec->type == FAST_TYPE_STRING) {
+			if (!rec->string_size || rec->string_size > FAST_STRING_MAX_BYTES)
+				return -1;
+
+			if (3 * rec->string_size > strings_size - used || rec->reset_size > rec->string_size)
+				return -1;
+
+			used += 3 * rec->string_size;
+		}
+
+		if (!fields) {
+			if (rec->type == FAST_TYPE_SEQUENCE && fast_cache_sequence(cache, NULL, rec))
+				return -1;
+
+			if ((rec->flags & FAST_FIELD_FLAGS_DECIMAL_PARTS) && fast_cache_decimal_parts(cache, NULL))
+				return -1;
+
+			continue;
+		}
+
+		field = fields + i;
+
+		field->presence	= rec->presence;
+		field->op	= rec->op;
+		field->flags	= rec->flags;
+		field->pmap_bit	= rec->pmap_bit;
+		field->slot	= rec->slot;
+		field->state	= FAST_STATE_UNDEFINED;
+
+		if (rec->type == FAST_TYPE_SEQUENCE) {
+			if (fast_cache_sequence(cache, field, rec))
+				return -1;
+
+			continue;
+		}
+
+		field->type = rec->type;
+
+		if (field->type == FAST_TYPE_STRING)
+			fast_string_assign(field, rec->string_size, &strings);
+
+		if (fast_field_reset_init(field, reset))
+			return -1;
+
+		if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS) && fast_cache_decimal_parts(cache, field))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int fast_cache_messages(struct fast_session *self, struct fast_cache *cache, unsigned long nr_messages, bool check)
+{
+	const struct fast_cache_message *rec;
+	struct fast_message *msg;
+	unsigned long i;
+
+	for (i = 0; i < nr_messages; i++) {
+		rec = fast_cache_take(cache, sizeof(*rec));
+		if (!rec)
+			return -1;
+
+		if (check) {
+			if (fast_cache_fields(cache, NULL, rec->nr_fields, rec->strings_size, NULL))
+				return -1;
 
-	node = node->xmlChildrenNode;
-	while (node != NULL) {
-		if (node->type != XML_ELEMENT_NODE) {
-			node = node->next;
 			continue;
 		}
 
 		msg = self->rx_messages + self->nr_messages;
-		if (fast_message_init(node, msg))
-			goto free;
+
+		msg->tid	= rec->tid;
+		msg->flags	= rec->flags;
+
+		msg->fields = calloc(rec->nr_fields, sizeof(struct fast_field));
+		if (!msg->fields)
+			return -1;
+
+		msg->nr_fields = rec->nr_fields;
+
+		if (rec->strings_size) {
+			msg->strings = calloc(1, rec->strings_size);
+			if (!msg->strings)
+				return -1;
+		}
+
+		if (fast_cache_fields(cache, msg->fields, msg->nr_fields, rec->strings_size, msg->strings))
+			return -1;
 
 		self->nr_messages++;
-		node = node->next;
 	}
 
+	return 0;
+}
+
+/*
+ * Loads templates from a cache written by fast_template_save(). Fails if
+ * the cache is missing, broken or stale, that is if xml has changed since
+ * it was written, in which case the session is left as it was.
+ *
+ * The cache is not used in place: its records are copied into freshly
+ * allocated fields and the file is unmapped before returning. A struct
+ * fast_field holds the decoder's state next to the template (values,
+ * string buffers, sequence arenas), so every session needs its own
+ * writable copy anyway; what the cache saves is the libxml2 parse.
+ */
+int fast_template_load(struct fast_session *self, const char *xml, const char *cache)
+{
+	const struct fast_cache_header *hdr;
+	struct fast_cache c;
+	void *map = MAP_FAILED;
+	const char *messages;
+	int nr_messages;
+	struct stat st;
+	unsigned long i;
+	int ret = -1;
+	u64 hash;
+	int fd;
+
+	if (fast_xml_hash(xml, &hash))
+		return -1;
+
+	nr_messages = self->nr_messages;
+
+	fd = open(cache, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(*hdr))
+		goto close;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto close;
+
+	c.pos = map;
+	c.end = c.pos + st.st_size;
+
+	hdr = fast_cache_take(&c, sizeof(*hdr));
+
+	if (hdr->magic != FAST_CACHE_MAGIC || hdr->version != FAST_CACHE_VERSION)
+		goto unmap;
+
+	if (hdr->xml_hash != hash || hdr->size != (u64) st.st_size)
+		goto unmap;
+
+	if (hdr->nr_messages > (u64) st.st_size / sizeof(struct fast_cache_message))
+		goto unmap;
+
+	/* Every entry is shared by at least two fields */
+	if (hdr->nr_slots > (u64) st.st_size / sizeof(struct fast_cache_field))
+		goto unmap;
+
+	c.nr_slots = hdr->nr_slots;
+
+	messages = c.pos;
+
+	if (fast_cache_messages(self, &c, hdr->nr_messages, true) || c.pos != c.end)
+		goto unmap;
+
+	if (fast_session_reserve(self, hdr->nr_messages))
+		goto unmap;
+
+	c.pos = messages;
+
+	if (fast_cache_messages(self, &c, hdr->nr_messages, false))
+		goto unload;
+
+	if (fast_tid_map_build(&self->rx_map, self->rx_messages, self->nr_messages))
+		goto unload;
+
+	if (fast_dictionary_build(&self->dictionary, self->rx_messages, self->nr_messages))
+		goto unload;
+
 	ret = 0;
 
-free:
-	xmlFreeDoc(doc);
+	goto unmap;
+
+unload:
+	/*
+	 * The reserved messages are zeroed, so a half loaded one is freed too,
+	 * and the maps go back to the templates the session had.
+	 */
+	for (i = nr_messages; i < nr_messages + hdr->nr_messages; i++)
+		fast_fields_free(self->rx_messages + i);
+
+	memset(self->rx_messages + nr_messages, 0, hdr->nr_messages * sizeof(struct fast_message));
+
+	self->nr_messages = nr_messages;
+
+	fast_tid_map_build(&self->rx_map, self->rx_messages, self->nr_messages);
+	fast_dictionary_build(&self->dictionary, self->rx_messages, self->nr_messages);
+
+unmap:
+	munmap(map, st.st_size);
+
+close:
+	close(fd);
 
-exit:
 	return ret;
 }
+
+/*
+ * Loads templates from the cache if it is up to date with xml, otherwise
+ * parses xml and writes the cache for the next time.
+ */
+int fast_cached_template(struct fast_session *self, const char *xml, const char *cache)
+{
+	if (!fast_template_load(self, xml, cache))
+		return 0;
+
+	if (fast_suite_template(self, xml))
+		return 1;
+
+	/* A cache that cannot be written only costs the next start */
+	fast_template_save(self, xml, cache);
+
+	return 0;
+}
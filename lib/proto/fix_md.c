@@ -0,0 +1,611 @@
+#include "libtrading/proto/fix_md.h"
+
+#include "libtrading/proto/fix_message.h"
+
+#include "libtrading/array.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A NoMDEntries group entry as it is scanned from the wire.
+ */
+struct md_entry {
+	char				action;
+	char				type;
+	const char			*symbol;
+	unsigned long			symbol_len;
+	double				price;
+	double				size;
+	unsigned long			nr_orders;
+	unsigned long			level;		/* MDPriceLevel, 0 if absent */
+	unsigned long			rpt_seq;	/* RptSeq, 0 if absent */
+};
+
+static const double pow10_table[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+};
+
+static unsigned long md_parse_uint(const char *ptr, const char *end)
+{
+	unsigned long ret = 0;
+
+	for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++)
+		ret = ret * 10 + (*ptr - '0');
+
+	return ret;
+}
+
+static double md_parse_decimal(const char *ptr, const char *end)
+{
+	const char *start = ptr;
+	bool negative = false;
+	bool fraction = false;
+	unsigned long digits = 0;
+	unsigned long scale = 0;
+	uint64_t mantissa = 0;
+	double ret;
+
+	if (ptr < end && *ptr == '-') {
+		negative = true;
+		ptr++;
+	}
+
+	for (; ptr < end; ptr++) {
+		if (*ptr == '.' && !fraction) {
+			fraction = true;
+			continue;
+		}
+
+		if (*ptr < '0' || *ptr > '9')
+			break;
+
+		/* Does not fit into the mantissa, take the slow path */
+		if (++digits >= ARRAY_SIZE(pow10_table))
+			return strtod(start, NULL);
+
+		mantissa = mantissa * 10 + (*ptr - '0');
+		scale += fraction;
+	}
+
+	ret = mantissa / pow10_table[scale];
+
+	return negative ? -ret : ret;
+}
+
+/* FNV-1a */
+static unsigned long md_hash(const char *symbol, unsigned long len)
+{
+	uint32_t hash = 2166136261U;
+	unsigned long i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t) symbol[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static struct fix_book **md_slot(struct fix_md *self, const char *symbol, unsigned long len)
+{
+	unsigned long mask = self->max_books - 1;
+	unsigned long idx = md_hash(symbol, len) & mask;
+	struct fix_book *book;
+
+	for (;;) {
+		book = self->books[idx];
+
+		if (!book)
+			break;
+
+		if (!memcmp(book->symbol, symbol, len) && !book->symbol[len])
+			break;
+
+		idx = (idx + 1) & mask;
+	}
+
+	return &self->books[idx];
+}
+
+static bool md_grow(struct fix_md *self)
+{
+	unsigned long max_books = self->max_books;
+	struct fix_book **books = self->books;
+	struct fix_book *book;
+	unsigned long i;
+
+	self->books = calloc(2 * max_books, sizeof(struct fix_book *));
+	if (!self->books) {
+		self->books = books;
+		return false;
+	}
+
+	self->max_books = 2 * max_books;
+
+	for (i = 0; i < max_books; i++) {
+		book = books[i];
+		if (!book)
+			continue;
+
+		*md_slot(self, book->symbol, strlen(book->symbol)) = book;
+	}
+
+	free(books);
+
+	return true;
+}
+
+static void fix_book_free(struct fix_book *book)
+{
+	if (!book)
+		return;
+
+	free(book->levels[FIX_BOOK_BID]);
+	free(book);
+}
+
+static struct fix_book *fix_book_new(const char *symbol, unsigned long len, unsigned long depth)
+{
+	struct fix_book *self = calloc(1, sizeof *self);
+
+	if (!self)
+		return NULL;
+
+	/* Both sides share one allocation */
+	self->levels[FIX_BOOK_BID] = calloc(FIX_BOOK_SIDES * depth, sizeof(struct fix_price_level));
+	if (!self->levels[FIX_BOOK_BID]) {
+		fix_book_free(self);
+		return NULL;
+	}
+
+	self->levels[FIX_BOOK_OFFER] = self->levels[FIX_BOOK_BID] + depth;
+
+	memcpy(self->symbol, symbol, len);
+
+	self->state = FIX_BOOK_STATE_EMPTY;
+
+	return self;
+}
+
+static void fix_book_reset(struct fix_book *book, unsigned long rpt_seq)
+{
+	book->nr_levels[FIX_BOOK_BID]	= 0;
+	book->nr_levels[FIX_BOOK_OFFER]	= 0;
+
+	book->state	= FIX_BOOK_STATE_SYNCED;
+	book->rpt_seq	= rpt_seq;
+}
+
+static bool md_symbol_valid(const char *symbol, unsigned long len)
+{
+	return symbol && len && len < FIX_MD_SYMBOL_LEN;
+}
+
+/*
+ * Looks up the book of a symbol and creates an empty one when there is
+ * none yet. The symbol must be valid, so NULL means out of memory.
+ */
+static struct fix_book *md_book(struct fix_md *self, const char *symbol, unsigned long len)
+{
+	struct fix_book **slot;
+
+	slot = md_slot(self, symbol, len);
+	if (*slot)
+		return *slot;
+
+	/* Keep the load factor below one half */
+	if (2 * (self->nr_books + 1) > self->max_books) {
+		if (!md_grow(self))
+			return NULL;
+
+		slot = md_slot(self, symbol, len);
+	}
+
+	*slot = fix_book_new(symbol, len, self->depth);
+	if (!*slot)
+		return NULL;
+
+	self->nr_books++;
+
+	return *slot;
+}
+
+static void book_set(struct fix_price_level *level, struct md_entry *entry)
+{
+	level->price		= entry->price;
+	level->size		= entry->size;
+	level->nr_orders	= entry->nr_orders;
+}
+
+static void book_insert(struct fix_md *self, struct fix_book *book, enum fix_book_side side, unsigned long pos, struct md_entry *entry)
+{
+	struct fix_price_level *levels = book->levels[side];
+	unsigned long nr = book->nr_levels[side];
+
+	if (pos > nr)
+		pos = nr;
+
+	if (pos >= self->depth)
+		return;
+
+	/* The worst level falls off a full book */
+	if (nr == self->depth)
+		nr--;
+
+	memmove(&levels[pos + 1], &levels[pos], (nr - pos) * sizeof(*levels));
+
+	book_set(&levels[pos], entry);
+
+	book->nr_levels[side] = nr + 1;
+}
+
+static void book_delete(struct fix_book *book, enum fix_book_side side, unsigned long pos)
+{
+	struct fix_price_level *levels = book->levels[side];
+	unsigned long nr = book->nr_levels[side];
+
+	if (pos >= nr)
+		return;
+
+	memmove(&levels[pos], &levels[pos + 1], (nr - pos - 1) * sizeof(*levels));
+
+	book->nr_levels[side] = nr - 1;
+}
+
+/*
+ * Returns the position of a price level or the position where a level with
+ * that price would be inserted.
+ */
+static unsigned long book_find(struct fix_book *book, enum fix_book_side side, double price, bool *found)
+{
+	struct fix_price_level *levels = book->levels[side];
+	unsigned long nr = book->nr_levels[side];
+	unsigned long i;
+
+	*found = false;
+
+	for (i = 0; i < nr; i++) {
+		if (levels[i].price == price) {
+			*found = true;
+			break;
+		}
+
+		if (side == FIX_BOOK_BID ? levels[i].price < price : levels[i].price > price)
+			break;
+	}
+
+	return i;
+}
+
+static void md_apply(struct fix_md *self, struct fix_book *book, struct md_entry *entry)
+{
+	enum fix_book_side side;
+	unsigned long pos;
+	bool found;
+
+	switch (entry->type) {
+	case '0':
+		side = FIX_BOOK_BID;
+		break;
+	case '1':
+		side = FIX_BOOK_OFFER;
+		break;
+	default:
+		self->stats.nr_ignored++;
+		return;
+	}
+
+	/* Books keyed by MDPriceLevel */
+	if (entry->level) {
+		pos = entry->level - 1;
+
+		switch (entry->action) {
+		case FIX_MD_UPDATE_ACTION_NEW:
+			book_insert(self, book, side, pos, entry);
+			break;
+		case FIX_MD_UPDATE_ACTION_CHANGE:
+			if (pos < book->nr_levels[side])
+				book_set(&book->levels[side][pos], entry);
+			else
+				book_insert(self, book, side, pos, entry);
+			break;
+		case FIX_MD_UPDATE_ACTION_DELETE:
+			book_delete(book, side, pos);
+			break;
+		default:
+			self->stats.nr_ignored++;
+			break;
+		}
+		return;
+	}
+
+	/* Books keyed by MDEntryPx */
+	pos = book_find(book, side, entry->price, &found);
+
+	switch (entry->action) {
+	case FIX_MD_UPDATE_ACTION_NEW:
+	case FIX_MD_UPDATE_ACTION_CHANGE:
+		if (found)
+			book_set(&book->levels[side][pos], entry);
+		else
+			book_insert(self, book, side, pos, entry);
+		break;
+	case FIX_MD_UPDATE_ACTION_DELETE:
+		if (found)
+			book_delete(book, side, pos);
+		break;
+	default:
+		self->stats.nr_ignored++;
+		break;
+	}
+}
+
+static int md_incremental(struct fix_md *self, struct md_entry *entry)
+{
+	struct fix_book *book;
+
+	/* One bad entry does not take the rest of the message with it */
+	if (!md_symbol_valid(entry->symbol, entry->symbol_len)) {
+		self->stats.nr_bad_symbols++;
+		return 0;
+	}
+
+	book = md_book(self, entry->symbol, entry->symbol_len);
+	if (!book)
+		return -1;
+
+	if (!fix_book_is_synced(book)) {
+		self->stats.nr_dropped++;
+		return 0;
+	}
+
+	if (entry->rpt_seq) {
+		if (entry->rpt_seq <= book->rpt_seq) {
+			self->stats.nr_dropped++;
+			return 0;
+		}
+
+		/* Entries are lost: the book is useless until the next snapshot */
+		if (entry->rpt_seq != book->rpt_seq + 1) {
+			book->state = FIX_BOOK_STATE_STALE;
+			self->stats.nr_dropped++;
+			self->stats.nr_gaps++;
+			return 0;
+		}
+
+		book->rpt_seq = entry->rpt_seq;
+	}
+
+	md_apply(self, book, entry);
+
+	return 0;
+}
+
+static int md_entry_done(struct fix_md *self, bool is_snapshot, struct fix_book *snapshot, struct md_entry *entry)
+{
+	self->stats.nr_entries++;
+
+	if (!is_snapshot)
+		return md_incremental(self, entry);
+
+	/* The snapshot's symbol has no book */
+	if (!snapshot) {
+		self->stats.nr_bad_symbols++;
+		return 0;
+	}
+
+	/* Snapshots may carry RptSeq per entry only */
+	if (entry->rpt_seq > snapshot->rpt_seq)
+		snapshot->rpt_seq = entry->rpt_seq;
+
+	md_apply(self, snapshot, entry);
+
+	return 0;
+}
+
+static bool md_entry_tag(int tag)
+{
+	switch (tag) {
+	case MDUpdateAction:
+	case MDEntryType:
+	case MDEntryID:
+	case Symbol:
+	case RptSeq:
+	case MDEntryPx:
+	case MDEntrySize:
+	case NumberOfOrders:
+	case MDPriceLevel:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Walks the raw message body and applies group entries as soon as they
+ * are complete, so no fix_field arrays are needed. This works both for
+ * messages parsed with FIX_MSG_FLAGS_SKIP_BODY and for fully parsed ones.
+ * Entries whose symbol cannot have a book are counted and skipped, a body
+ * that is not made of tag=value fields fails the whole message.
+ */
+int fix_md_process(struct fix_md *self, struct fix_message *msg)
+{
+	struct fix_book *snapshot = NULL;
+	const char *symbol = NULL;
+	unsigned long symbol_len = 0;
+	unsigned long rpt_seq = 0;
+	bool in_group = false;
+	bool in_entry = false;
+	const char *value;
+	const char *delim;
+	const char *ptr;
+	const char *end;
+	struct md_entry entry;
+	int group_delim = 0;
+	bool is_snapshot;
+	int tag;
+
+	if (fix_message_type_is(msg, FIX_MSG_TYPE_MARKET_DATA_SNAPSHOT_FULL_REFRESH))
+		is_snapshot = true;
+	else if (fix_message_type_is(msg, FIX_MSG_TYPE_MARKET_DATA_INCREMENTAL_REFRESH))
+		is_snapshot = false;
+	else
+		return 0;
+
+	self->stats.nr_messages++;
+
+	/* The body starts after MsgType and ends before "10=" */
+	end = msg->check_sum - 3;
+
+	ptr = memchr(msg->msg_type, 0x01, end - msg->msg_type);
+	if (!ptr)
+		return -1;
+
+	ptr++;
+
+	memset(&entry, 0, sizeof entry);
+
+	while (ptr < end) {
+		value = ptr;
+
+		for (tag = 0; ptr < end && *ptr != '='; ptr++) {
+			if (*ptr < '0' || *ptr > '9' || tag > (INT_MAX - 9) / 10)
+				return -1;
+
+			tag = tag * 10 + (*ptr - '0');
+		}
+
+		if (ptr == end || ptr == value)
+			return -1;
+
+		value = ++ptr;
+
+		delim = memchr(ptr, 0x01, end - ptr);
+		if (!delim)
+			return -1;
+
+		ptr = delim + 1;
+
+		if (in_group) {
+			if (!group_delim)
+				group_delim = tag;
+
+			if (tag == group_delim || !md_entry_tag(tag)) {
+				if (in_entry && md_entry_done(self, is_snapshot, snapshot, &entry))
+					return -1;
+
+				in_entry = tag == group_delim;
+				in_group = in_entry;
+
+				entry = (struct md_entry) {
+					.action		= FIX_MD_UPDATE_ACTION_NEW,
+					.symbol		= symbol,
+					.symbol_len	= symbol_len,
+				};
+			}
+		}
+
+		switch (tag) {
+		case NoMDEntries:
+			in_group	= true;
+			group_delim	= 0;
+
+			if (!is_snapshot || !md_symbol_valid(symbol, symbol_len))
+				break;
+
+			snapshot = md_book(self, symbol, symbol_len);
+			if (!snapshot)
+				return -1;
+
+			fix_book_reset(snapshot, rpt_seq);
+			break;
+		case Symbol:
+			if (in_entry) {
+				entry.symbol		= value;
+				entry.symbol_len	= delim - value;
+			} else {
+				symbol			= value;
+				symbol_len		= delim - value;
+			}
+			break;
+		case RptSeq:
+			if (in_entry)
+				entry.rpt_seq = md_parse_uint(value, delim);
+			else
+				rpt_seq = md_parse_uint(value, delim);
+			break;
+		case MDUpdateAction:
+			entry.action = *value;
+			break;
+		case MDEntryType:
+			entry.type = *value;
+			break;
+		case MDEntryPx:
+			entry.price = md_parse_decimal(value, delim);
+			break;
+		case MDEntrySize:
+			entry.size = md_parse_decimal(value, delim);
+			break;
+		case NumberOfOrders:
+			entry.nr_orders = md_parse_uint(value, delim);
+			break;
+		case MDPriceLevel:
+			entry.level = md_parse_uint(value, delim);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (in_entry && md_entry_done(self, is_snapshot, snapshot, &entry))
+		return -1;
+
+	return 0;
+}
+
+struct fix_book *fix_md_book(struct fix_md *self, const char *symbol)
+{
+	unsigned long len = strlen(symbol);
+
+	if (len >= FIX_MD_SYMBOL_LEN)
+		return NULL;
+
+	return *md_slot(self, symbol, len);
+}
+
+struct fix_md *fix_md_new(unsigned long depth)
+{
+	struct fix_md *self = calloc(1, sizeof *self);
+
+	if (!self)
+		return NULL;
+
+	self->books = calloc(FIX_MD_BOOK_NUMBER, sizeof(struct fix_book *));
+	if (!self->books) {
+		fix_md_free(self);
+		return NULL;
+	}
+
+	self->max_books	= FIX_MD_BOOK_NUMBER;
+	self->depth	= depth ? depth : FIX_MD_DEFAULT_DEPTH;
+
+	return self;
+}
+
+void fix_md_free(struct fix_md *self)
+{
+	unsigned long i;
+
+	if (!self)
+		return;
+
+	for (i = 0; i < self->max_books; i++)
+		fix_book_free(self->books[i]);
+
+	free(self->books);
+	free(self);
+}
@@ -8,56 +8,449 @@
 #include <sys/time.h>
 #include <sys/uio.h>
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <endian.h>
 #include <errno.h>
 #include <stdio.h>
 #include <time.h>
 
 static const char *fix_msg_types[FIX_MSG_TYPE_MAX] = {
-	[FIX_MSG_TYPE_HEARTBEAT]		= "0",
-	[FIX_MSG_TYPE_TEST_REQUEST]		= "1",
-	[FIX_MSG_TYPE_RESEND_REQUEST]		= "2",
-	[FIX_MSG_TYPE_REJECT]			= "3",
-	[FIX_MSG_TYPE_SEQUENCE_RESET]		= "4",
-	[FIX_MSG_TYPE_LOGOUT]			= "5",
-	[FIX_MSG_TYPE_EXECUTION_REPORT]		= "8",
-	[FIX_MSG_TYPE_LOGON]			= "A",
-	[FIX_MSG_TYPE_NEW_ORDER_SINGLE]		= "D",
+	[FIX_MSG_TYPE_HEARTBEAT]			= "0",
+	[FIX_MSG_TYPE_TEST_REQUEST]			= "1",
+	[FIX_MSG_TYPE_RESEND_REQUEST]			= "2",
+	[FIX_MSG_TYPE_REJECT]				= "3",
+	[FIX_MSG_TYPE_SEQUENCE_RESET]			= "4",
+	[FIX_MSG_TYPE_LOGOUT]				= "5",
+	[FIX_MSG_TYPE_EXECUTION_REPORT]			= "8",
+	[FIX_MSG_TYPE_LOGON]				= "A",
+	[FIX_MSG_TYPE_NEW_ORDER_SINGLE]			= "D",
+	[FIX_MSG_TYPE_IOI]				= "6",
+	[FIX_MSG_TYPE_ADVERTISEMENT]			= "7",
+	[FIX_MSG_TYPE_ORDER_CANCEL_REJECT]		= "9",
+	[FIX_MSG_TYPE_NEWS]				= "B",
+	[FIX_MSG_TYPE_EMAIL]				= "C",
+	[FIX_MSG_TYPE_NEW_ORDER_LIST]			= "E",
+	[FIX_MSG_TYPE_ORDER_CANCEL_REQUEST]		= "F",
+	[FIX_MSG_TYPE_ORDER_CANCEL_REPLACE_REQUEST]	= "G",
+	[FIX_MSG_TYPE_ORDER_STATUS_REQUEST]		= "H",
+	[FIX_MSG_TYPE_ALLOCATION_INSTRUCTION]		= "J",
+	[FIX_MSG_TYPE_LIST_CANCEL_REQUEST]		= "K",
+	[FIX_MSG_TYPE_LIST_EXECUTE]			= "L",
+	[FIX_MSG_TYPE_LIST_STATUS_REQUEST]		= "M",
+	[FIX_MSG_TYPE_LIST_STATUS]			= "N",
+	[FIX_MSG_TYPE_ALLOCATION_INSTRUCTION_ACK]	= "P",
+	[FIX_MSG_TYPE_DONT_KNOW_TRADE]			= "Q",
+	[FIX_MSG_TYPE_QUOTE_REQUEST]			= "R",
+	[FIX_MSG_TYPE_QUOTE]				= "S",
+	[FIX_MSG_TYPE_SETTLEMENT_INSTRUCTIONS]		= "T",
+	[FIX_MSG_TYPE_MARKET_DATA_REQUEST]		= "V",
+	[FIX_MSG_TYPE_MARKET_DATA_SNAPSHOT_FULL_REFRESH]	= "W",
+	[FIX_MSG_TYPE_MARKET_DATA_INCREMENTAL_REFRESH]	= "X",
+	[FIX_MSG_TYPE_MARKET_DATA_REQUEST_REJECT]	= "Y",
+	[FIX_MSG_TYPE_QUOTE_CANCEL]			= "Z",
+	[FIX_MSG_TYPE_QUOTE_STATUS_REQUEST]		= "a",
+	[FIX_MSG_TYPE_MASS_QUOTE_ACKNOWLEDGEMENT]	= "b",
+	[FIX_MSG_TYPE_SECURITY_DEFINITION_REQUEST]	= "c",
+	[FIX_MSG_TYPE_SECURITY_DEFINITION]		= "d",
+	[FIX_MSG_TYPE_SECURITY_STATUS_REQUEST]		= "e",
+	[FIX_MSG_TYPE_SECURITY_STATUS]			= "f",
+	[FIX_MSG_TYPE_TRADING_SESSION_STATUS_REQUEST]	= "g",
+	[FIX_MSG_TYPE_TRADING_SESSION_STATUS]		= "h",
+	[FIX_MSG_TYPE_MASS_QUOTE]			= "i",
+	[FIX_MSG_TYPE_BUSINESS_MESSAGE_REJECT]		= "j",
+	[FIX_MSG_TYPE_BID_REQUEST]			= "k",
+	[FIX_MSG_TYPE_BID_RESPONSE]			= "l",
+	[FIX_MSG_TYPE_LIST_STRIKE_PRICE]		= "m",
+	[FIX_MSG_TYPE_XML_NON_FIX]			= "n",
+	[FIX_MSG_TYPE_REGISTRATION_INSTRUCTIONS]	= "o",
+	[FIX_MSG_TYPE_REGISTRATION_INSTRUCTIONS_RESPONSE]	= "p",
+	[FIX_MSG_TYPE_ORDER_MASS_CANCEL_REQUEST]	= "q",
+	[FIX_MSG_TYPE_ORDER_MASS_CANCEL_REPORT]		= "r",
+	[FIX_MSG_TYPE_NEW_ORDER_CROSS]			= "s",
+	[FIX_MSG_TYPE_CROSS_ORDER_CANCEL_REPLACE_REQUEST]	= "t",
+	[FIX_MSG_TYPE_CROSS_ORDER_CANCEL_REQUEST]	= "u",
+	[FIX_MSG_TYPE_SECURITY_TYPE_REQUEST]		= "v",
+	[FIX_MSG_TYPE_SECURITY_TYPES]			= "w",
+	[FIX_MSG_TYPE_SECURITY_LIST_REQUEST]		= "x",
+	[FIX_MSG_TYPE_SECURITY_LIST]			= "y",
+	[FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST_REQUEST]	= "z",
+	[FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST]		= "AA",
+	[FIX_MSG_TYPE_NEW_ORDER_MULTILEG]		= "AB",
+	[FIX_MSG_TYPE_MULTILEG_ORDER_CANCEL_REPLACE]	= "AC",
+	[FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_REQUEST]	= "AD",
+	[FIX_MSG_TYPE_TRADE_CAPTURE_REPORT]		= "AE",
+	[FIX_MSG_TYPE_ORDER_MASS_STATUS_REQUEST]	= "AF",
+	[FIX_MSG_TYPE_QUOTE_REQUEST_REJECT]		= "AG",
+	[FIX_MSG_TYPE_RFQ_REQUEST]			= "AH",
+	[FIX_MSG_TYPE_QUOTE_STATUS_REPORT]		= "AI",
+	[FIX_MSG_TYPE_QUOTE_RESPONSE]			= "AJ",
+	[FIX_MSG_TYPE_CONFIRMATION]			= "AK",
+	[FIX_MSG_TYPE_POSITION_MAINTENANCE_REQUEST]	= "AL",
+	[FIX_MSG_TYPE_POSITION_MAINTENANCE_REPORT]	= "AM",
+	[FIX_MSG_TYPE_REQUEST_FOR_POSITIONS]		= "AN",
+	[FIX_MSG_TYPE_REQUEST_FOR_POSITIONS_ACK]	= "AO",
+	[FIX_MSG_TYPE_POSITION_REPORT]			= "AP",
+	[FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_REQUEST_ACK]	= "AQ",
+	[FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_ACK]		= "AR",
+	[FIX_MSG_TYPE_ALLOCATION_REPORT]		= "AS",
+	[FIX_MSG_TYPE_ALLOCATION_REPORT_ACK]		= "AT",
+	[FIX_MSG_TYPE_CONFIRMATION_ACK]			= "AU",
+	[FIX_MSG_TYPE_SETTLEMENT_INSTRUCTION_REQUEST]	= "AV",
+	[FIX_MSG_TYPE_ASSIGNMENT_REPORT]		= "AW",
+	[FIX_MSG_TYPE_COLLATERAL_REQUEST]		= "AX",
+	[FIX_MSG_TYPE_COLLATERAL_ASSIGNMENT]		= "AY",
+	[FIX_MSG_TYPE_COLLATERAL_RESPONSE]		= "AZ",
+	[FIX_MSG_TYPE_COLLATERAL_REPORT]		= "BA",
+	[FIX_MSG_TYPE_COLLATERAL_INQUIRY]		= "BB",
+	[FIX_MSG_TYPE_NETWORK_STATUS_REQUEST]		= "BC",
+	[FIX_MSG_TYPE_NETWORK_STATUS_RESPONSE]		= "BD",
+	[FIX_MSG_TYPE_USER_REQUEST]			= "BE",
+	[FIX_MSG_TYPE_USER_RESPONSE]			= "BF",
+	[FIX_MSG_TYPE_COLLATERAL_INQUIRY_ACK]		= "BG",
+	[FIX_MSG_TYPE_CONFIRMATION_REQUEST]		= "BH",
+	[FIX_MSG_TYPE_TRADING_SESSION_LIST_REQUEST]	= "BI",
+	[FIX_MSG_TYPE_TRADING_SESSION_LIST]		= "BJ",
+	[FIX_MSG_TYPE_SECURITY_LIST_UPDATE_REPORT]	= "BK",
+	[FIX_MSG_TYPE_ADJUSTED_POSITION_REPORT]		= "BL",
+	[FIX_MSG_TYPE_ALLOCATION_INSTRUCTION_ALERT]	= "BM",
+	[FIX_MSG_TYPE_EXECUTION_ACKNOWLEDGEMENT]	= "BN",
+	[FIX_MSG_TYPE_CONTRARY_INTENTION_REPORT]	= "BO",
+	[FIX_MSG_TYPE_SECURITY_DEFINITION_UPDATE_REPORT]	= "BP",
+};
+
+/*
+ * MsgType perfect hash: single-character types are indexed directly by their
+ * character and two-character types ("AA" to "BZ") are packed above them. The
+ * table stores the message type plus one so that empty slots read as zero.
+ */
+#define MSG_TYPE_HASH1(c)		(c)
+#define MSG_TYPE_HASH2(c0, c1)		(128 + ((c0) - 'A') * 26 + ((c1) - 'A'))
+
+#define MSG_TYPE_HASH_SIZE		MSG_TYPE_HASH2('C', 'A')
+
+static const uint8_t fix_msg_type_hash[MSG_TYPE_HASH_SIZE] = {
+	[MSG_TYPE_HASH1('0')]		= FIX_MSG_TYPE_HEARTBEAT + 1,
+	[MSG_TYPE_HASH1('1')]		= FIX_MSG_TYPE_TEST_REQUEST + 1,
+	[MSG_TYPE_HASH1('2')]		= FIX_MSG_TYPE_RESEND_REQUEST + 1,
+	[MSG_TYPE_HASH1('3')]		= FIX_MSG_TYPE_REJECT + 1,
+	[MSG_TYPE_HASH1('4')]		= FIX_MSG_TYPE_SEQUENCE_RESET + 1,
+	[MSG_TYPE_HASH1('5')]		= FIX_MSG_TYPE_LOGOUT + 1,
+	[MSG_TYPE_HASH1('8')]		= FIX_MSG_TYPE_EXECUTION_REPORT + 1,
+	[MSG_TYPE_HASH1('A')]		= FIX_MSG_TYPE_LOGON + 1,
+	[MSG_TYPE_HASH1('D')]		= FIX_MSG_TYPE_NEW_ORDER_SINGLE + 1,
+	[MSG_TYPE_HASH1('6')]		= FIX_MSG_TYPE_IOI + 1,
+	[MSG_TYPE_HASH1('7')]		= FIX_MSG_TYPE_ADVERTISEMENT + 1,
+	[MSG_TYPE_HASH1('9')]		= FIX_MSG_TYPE_ORDER_CANCEL_REJECT + 1,
+	[MSG_TYPE_HASH1('B')]		= FIX_MSG_TYPE_NEWS + 1,
+	[MSG_TYPE_HASH1('C')]		= FIX_MSG_TYPE_EMAIL + 1,
+	[MSG_TYPE_HASH1('E')]		= FIX_MSG_TYPE_NEW_ORDER_LIST + 1,
+	[MSG_TYPE_HASH1('F')]		= FIX_MSG_TYPE_ORDER_CANCEL_REQUEST + 1,
+	[MSG_TYPE_HASH1('G')]		= FIX_MSG_TYPE_ORDER_CANCEL_REPLACE_REQUEST + 1,
+	[MSG_TYPE_HASH1('H')]		= FIX_MSG_TYPE_ORDER_STATUS_REQUEST + 1,
+	[MSG_TYPE_HASH1('J')]		= FIX_MSG_TYPE_ALLOCATION_INSTRUCTION + 1,
+	[MSG_TYPE_HASH1('K')]		= FIX_MSG_TYPE_LIST_CANCEL_REQUEST + 1,
+	[MSG_TYPE_HASH1('L')]		= FIX_MSG_TYPE_LIST_EXECUTE + 1,
+	[MSG_TYPE_HASH1('M')]		= FIX_MSG_TYPE_LIST_STATUS_REQUEST + 1,
+	[MSG_TYPE_HASH1('N')]		= FIX_MSG_TYPE_LIST_STATUS + 1,
+	[MSG_TYPE_HASH1('P')]		= FIX_MSG_TYPE_ALLOCATION_INSTRUCTION_ACK + 1,
+	[MSG_TYPE_HASH1('Q')]		= FIX_MSG_TYPE_DONT_KNOW_TRADE + 1,
+	[MSG_TYPE_HASH1('R')]		= FIX_MSG_TYPE_QUOTE_REQUEST + 1,
+	[MSG_TYPE_HASH1('S')]		= FIX_MSG_TYPE_QUOTE + 1,
+	[MSG_TYPE_HASH1('T')]		= FIX_MSG_TYPE_SETTLEMENT_INSTRUCTIONS + 1,
+	[MSG_TYPE_HASH1('V')]		= FIX_MSG_TYPE_MARKET_DATA_REQUEST + 1,
+	[MSG_TYPE_HASH1('W')]		= FIX_MSG_TYPE_MARKET_DATA_SNAPSHOT_FULL_REFRESH + 1,
+	[MSG_TYPE_HASH1('X')]		= FIX_MSG_TYPE_MARKET_DATA_INCREMENTAL_REFRESH + 1,
+	[MSG_TYPE_HASH1('Y')]		= FIX_MSG_TYPE_MARKET_DATA_REQUEST_REJECT + 1,
+	[MSG_TYPE_HASH1('Z')]		= FIX_MSG_TYPE_QUOTE_CANCEL + 1,
+	[MSG_TYPE_HASH1('a')]		= FIX_MSG_TYPE_QUOTE_STATUS_REQUEST + 1,
+	[MSG_TYPE_HASH1('b')]		= FIX_MSG_TYPE_MASS_QUOTE_ACKNOWLEDGEMENT + 1,
+	[MSG_TYPE_HASH1('c')]		= FIX_MSG_TYPE_SECURITY_DEFINITION_REQUEST + 1,
+	[MSG_TYPE_HASH1('d')]		= FIX_MSG_TYPE_SECURITY_DEFINITION + 1,
+	[MSG_TYPE_HASH1('e')]		= FIX_MSG_TYPE_SECURITY_STATUS_REQUEST + 1,
+	[MSG_TYPE_HASH1('f')]		= FIX_MSG_TYPE_SECURITY_STATUS + 1,
+	[MSG_TYPE_HASH1('g')]		= FIX_MSG_TYPE_TRADING_SESSION_STATUS_REQUEST + 1,
+	[MSG_TYPE_HASH1('h')]		= FIX_MSG_TYPE_TRADING_SESSION_STATUS + 1,
+	[MSG_TYPE_HASH1('i')]		= FIX_MSG_TYPE_MASS_QUOTE + 1,
+	[MSG_TYPE_HASH1('j')]		= FIX_MSG_TYPE_BUSINESS_MESSAGE_REJECT + 1,
+	[MSG_TYPE_HASH1('k')]		= FIX_MSG_TYPE_BID_REQUEST + 1,
+	[MSG_TYPE_HASH1('l')]		= FIX_MSG_TYPE_BID_RESPONSE + 1,
+	[MSG_TYPE_HASH1('m')]		= FIX_MSG_TYPE_LIST_STRIKE_PRICE + 1,
+	[MSG_TYPE_HASH1('n')]		= FIX_MSG_TYPE_XML_NON_FIX + 1,
+	[MSG_TYPE_HASH1('o')]		= FIX_MSG_TYPE_REGISTRATION_INSTRUCTIONS + 1,
+	[MSG_TYPE_HASH1('p')]		= FIX_MSG_TYPE_REGISTRATION_INSTRUCTIONS_RESPONSE + 1,
+	[MSG_TYPE_HASH1('q')]		= FIX_MSG_TYPE_ORDER_MASS_CANCEL_REQUEST + 1,
+	[MSG_TYPE_HASH1('r')]		= FIX_MSG_TYPE_ORDER_MASS_CANCEL_REPORT + 1,
+	[MSG_TYPE_HASH1('s')]		= FIX_MSG_TYPE_NEW_ORDER_CROSS + 1,
+	[MSG_TYPE_HASH1('t')]		= FIX_MSG_TYPE_CROSS_ORDER_CANCEL_REPLACE_REQUEST + 1,
+	[MSG_TYPE_HASH1('u')]		= FIX_MSG_TYPE_CROSS_ORDER_CANCEL_REQUEST + 1,
+	[MSG_TYPE_HASH1('v')]		= FIX_MSG_TYPE_SECURITY_TYPE_REQUEST + 1,
+	[MSG_TYPE_HASH1('w')]		= FIX_MSG_TYPE_SECURITY_TYPES + 1,
+	[MSG_TYPE_HASH1('x')]		= FIX_MSG_TYPE_SECURITY_LIST_REQUEST + 1,
+	[MSG_TYPE_HASH1('y')]		= FIX_MSG_TYPE_SECURITY_LIST + 1,
+	[MSG_TYPE_HASH1('z')]		= FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST_REQUEST + 1,
+	[MSG_TYPE_HASH2('A', 'A')]	= FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST + 1,
+	[MSG_TYPE_HASH2('A', 'B')]	= FIX_MSG_TYPE_NEW_ORDER_MULTILEG + 1,
+	[MSG_TYPE_HASH2('A', 'C')]	= FIX_MSG_TYPE_MULTILEG_ORDER_CANCEL_REPLACE + 1,
+	[MSG_TYPE_HASH2('A', 'D')]	= FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_REQUEST + 1,
+	[MSG_TYPE_HASH2('A', 'E')]	= FIX_MSG_TYPE_TRADE_CAPTURE_REPORT + 1,
+	[MSG_TYPE_HASH2('A', 'F')]	= FIX_MSG_TYPE_ORDER_MASS_STATUS_REQUEST + 1,
+	[MSG_TYPE_HASH2('A', 'G')]	= FIX_MSG_TYPE_QUOTE_REQUEST_REJECT + 1,
+	[MSG_TYPE_HASH2('A', 'H')]	= FIX_MSG_TYPE_RFQ_REQUEST + 1,
+	[MSG_TYPE_HASH2('A', 'I')]	= FIX_MSG_TYPE_QUOTE_STATUS_REPORT + 1,
+	[MSG_TYPE_HASH2('A', 'J')]	= FIX_MSG_TYPE_QUOTE_RESPONSE + 1,
+	[MSG_TYPE_HASH2('A', 'K')]	= FIX_MSG_TYPE_CONFIRMATION + 1,
+	[MSG_TYPE_HASH2('A', 'L')]	= FIX_MSG_TYPE_POSITION_MAINTENANCE_REQUEST + 1,
+	[MSG_TYPE_HASH2('A', 'M')]	= FIX_MSG_TYPE_POSITION_MAINTENANCE_REPORT + 1,
+	[MSG_TYPE_HASH2('A', 'N')]	= FIX_MSG_TYPE_REQUEST_FOR_POSITIONS + 1,
+	[MSG_TYPE_HASH2('A', 'O')]	= FIX_MSG_TYPE_REQUEST_FOR_POSITIONS_ACK + 1,
+	[MSG_TYPE_HASH2('A', 'P')]	= FIX_MSG_TYPE_POSITION_REPORT + 1,
+	[MSG_TYPE_HASH2('A', 'Q')]	= FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_REQUEST_ACK + 1,
+	[MSG_TYPE_HASH2('A', 'R')]	= FIX_MSG_TYPE_TRADE_CAPTURE_REPORT_ACK + 1,
+	[MSG_TYPE_HASH2('A', 'S')]	= FIX_MSG_TYPE_ALLOCATION_REPORT + 1,
+	[MSG_TYPE_HASH2('A', 'T')]	= FIX_MSG_TYPE_ALLOCATION_REPORT_ACK + 1,
+	[MSG_TYPE_HASH2('A', 'U')]	= FIX_MSG_TYPE_CONFIRMATION_ACK + 1,
+	[MSG_TYPE_HASH2('A', 'V')]	= FIX_MSG_TYPE_SETTLEMENT_INSTRUCTION_REQUEST + 1,
+	[MSG_TYPE_HASH2('A', 'W')]	= FIX_MSG_TYPE_ASSIGNMENT_REPORT + 1,
+	[MSG_TYPE_HASH2('A', 'X')]	= FIX_MSG_TYPE_COLLATERAL_REQUEST + 1,
+	[MSG_TYPE_HASH2('A', 'Y')]	= FIX_MSG_TYPE_COLLATERAL_ASSIGNMENT + 1,
+	[MSG_TYPE_HASH2('A', 'Z')]	= FIX_MSG_TYPE_COLLATERAL_RESPONSE + 1,
+	[MSG_TYPE_HASH2('B', 'A')]	= FIX_MSG_TYPE_COLLATERAL_REPORT + 1,
+	[MSG_TYPE_HASH2('B', 'B')]	= FIX_MSG_TYPE_COLLATERAL_INQUIRY + 1,
+	[MSG_TYPE_HASH2('B', 'C')]	= FIX_MSG_TYPE_NETWORK_STATUS_REQUEST + 1,
+	[MSG_TYPE_HASH2('B', 'D')]	= FIX_MSG_TYPE_NETWORK_STATUS_RESPONSE + 1,
+	[MSG_TYPE_HASH2('B', 'E')]	= FIX_MSG_TYPE_USER_REQUEST + 1,
+	[MSG_TYPE_HASH2('B', 'F')]	= FIX_MSG_TYPE_USER_RESPONSE + 1,
+	[MSG_TYPE_HASH2('B', 'G')]	= FIX_MSG_TYPE_COLLATERAL_INQUIRY_ACK + 1,
+	[MSG_TYPE_HASH2('B', 'H')]	= FIX_MSG_TYPE_CONFIRMATION_REQUEST + 1,
+	[MSG_TYPE_HASH2('B', 'I')]	= FIX_MSG_TYPE_TRADING_SESSION_LIST_REQUEST + 1,
+	[MSG_TYPE_HASH2('B', 'J')]	= FIX_MSG_TYPE_TRADING_SESSION_LIST + 1,
+	[MSG_TYPE_HASH2('B', 'K')]	= FIX_MSG_TYPE_SECURITY_LIST_UPDATE_REPORT + 1,
+	[MSG_TYPE_HASH2('B', 'L')]	= FIX_MSG_TYPE_ADJUSTED_POSITION_REPORT + 1,
+	[MSG_TYPE_HASH2('B', 'M')]	= FIX_MSG_TYPE_ALLOCATION_INSTRUCTION_ALERT + 1,
+	[MSG_TYPE_HASH2('B', 'N')]	= FIX_MSG_TYPE_EXECUTION_ACKNOWLEDGEMENT + 1,
+	[MSG_TYPE_HASH2('B', 'O')]	= FIX_MSG_TYPE_CONTRARY_INTENTION_REPORT + 1,
+	[MSG_TYPE_HASH2('B', 'P')]	= FIX_MSG_TYPE_SECURITY_DEFINITION_UPDATE_REPORT + 1,
 };
 
 enum fix_msg_type fix_msg_type_parse(const char *s)
 {
-	switch (s[1]) {
-	case 0x01: {
+	unsigned int idx, hi, lo;
+	uint8_t type;
+
+	if (s[1] == 0x01) {
 		/*
 		 * Single-character message type:
 		 */
-		switch (s[0]) {
-		case '0': return FIX_MSG_TYPE_HEARTBEAT;
-		case '1': return FIX_MSG_TYPE_TEST_REQUEST;
-		case '2': return FIX_MSG_TYPE_RESEND_REQUEST;
-		case '3': return FIX_MSG_TYPE_REJECT;
-		case '4': return FIX_MSG_TYPE_SEQUENCE_RESET;
-		case '5': return FIX_MSG_TYPE_LOGOUT;
-		case '8': return FIX_MSG_TYPE_EXECUTION_REPORT;
-		case 'A': return FIX_MSG_TYPE_LOGON;
-		case 'D': return FIX_MSG_TYPE_NEW_ORDER_SINGLE;
-		default : return FIX_MSG_TYPE_UNKNOWN;
+		idx = (uint8_t) s[0];
+		if (idx >= 128)
+			return FIX_MSG_TYPE_UNKNOWN;
+	} else if (s[2] == 0x01) {
+		/*
+		 * Two-character message type:
+		 */
+		hi = (uint8_t) s[0] - 'A';
+		lo = (uint8_t) s[1] - 'A';
+
+		if (hi >= 2 || lo >= 26)
+			return FIX_MSG_TYPE_UNKNOWN;
+
+		idx = MSG_TYPE_HASH2('A', 'A') + hi * 26 + lo;
+	} else
+		return FIX_MSG_TYPE_UNKNOWN;
+
+	type = fix_msg_type_hash[idx];
+	if (!type)
+		return FIX_MSG_TYPE_UNKNOWN;
+
+	return type - 1;
+}
+
+/*
+ * Days since the epoch of a date in the proleptic Gregorian calendar.
+ */
+static int64_t days_from_civil(int64_t year, unsigned int month, unsigned int day)
+{
+	unsigned int yoe, doy, doe;
+	int64_t era;
+
+	year -= month <= 2;
+
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+#define	NSEC_PER_SEC	1000000000LL
+#define	NSEC_PER_DAY	(86400 * NSEC_PER_SEC)
+
+static const int64_t nsec_scale[] = {
+	1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1,
+};
+
+/*
+ * The date rarely changes between timestamps so the start of the last
+ * parsed day is cached per thread, keyed by its eight raw digits. The key
+ * starts out as bytes that are not digits, so nothing matches it.
+ */
+static __thread uint64_t	timestamp_date = UINT64_MAX;
+static __thread int64_t		timestamp_day;
+
+static const unsigned char days_in_month[] = {
+	31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31,
+};
+
+static inline bool is_leap_year(unsigned int year)
+{
+	return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+/* True if all eight bytes of a little-endian word are ASCII digits */
+static inline bool swar_is_digits(uint64_t v)
+{
+	return ((v & 0xf0f0f0f0f0f0f0f0ULL) |
+		(((v + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+static bool timestamp_parse_date(const char *s, int64_t *day)
+{
+	unsigned int year, month, mday;
+	uint64_t raw, v;
+
+	memcpy(&raw, s, sizeof raw);
+	raw = le64toh(raw);
+
+	if (raw == timestamp_date) {
+		*day = timestamp_day;
+		return true;
+	}
+
+	if (!swar_is_digits(raw))
+		return false;
+
+	/* Eight digits to four two-digit numbers in bytes 0, 2, 4 and 6 */
+	v = raw - 0x3030303030303030ULL;
+	v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffULL;
+
+	year	= (v & 0xff) * 100 + ((v >> 16) & 0xff);
+	month	= (v >> 32) & 0xff;
+	mday	= (v >> 48) & 0xff;
+
+	if (month < 1 || month > 12 || mday < 1)
+		return false;
+
+	if (mday > days_in_month[month - 1] + (month == 2 && is_leap_year(year)))
+		return false;
+
+	timestamp_day	= days_from_civil(year, month, mday) * NSEC_PER_DAY;
+	timestamp_date	= raw;
+
+	*day = timestamp_day;
+
+	return true;
+}
+
+#define	DIGIT(c)	((unsigned int) ((c) - '0'))
+
+/*
+ * Parses the len bytes of a UTCTimestamp of the form
+ * YYYYMMDD-HH:MM:SS[.s[s...]] with up to nine fractional digits to
+ * nanoseconds since the epoch.
+ */
+bool fix_utc_timestamp_parse(const char *s, unsigned long len, int64_t *value)
+{
+	unsigned int hour, min, sec;
+	int64_t frac = 0;
+	unsigned long i;
+	int64_t day;
+
+	/* Short values are turned down before the date is read as one word */
+	if (len < 17 || len > 27)
+		return false;
+
+	if (!timestamp_parse_date(s, &day))
+		return false;
+
+	if (s[8] != '-' || s[11] != ':' || s[14] != ':')
+		return false;
+
+	if (DIGIT(s[9]) > 9 || DIGIT(s[10]) > 9 || DIGIT(s[12]) > 9 ||
+	    DIGIT(s[13]) > 9 || DIGIT(s[15]) > 9 || DIGIT(s[16]) > 9)
+		return false;
+
+	hour	= DIGIT(s[9]) * 10 + DIGIT(s[10]);
+	min	= DIGIT(s[12]) * 10 + DIGIT(s[13]);
+	sec	= DIGIT(s[15]) * 10 + DIGIT(s[16]);
+
+	/* Leap seconds are allowed */
+	if (hour > 23 || min > 59 || sec > 60)
+		return false;
+
+	if (len > 17) {
+		if (s[17] != '.' || len == 18)
+			return false;
+
+		for (i = 18; i < len; i++) {
+			if (DIGIT(s[i]) > 9)
+				return false;
+
+			frac = frac * 10 + DIGIT(s[i]);
 		}
+
+		frac *= nsec_scale[len - 18];
 	}
-	default:
-		return FIX_MSG_TYPE_UNKNOWN;
+
+	*value = day + ((hour * 60 + min) * 60 + sec) * NSEC_PER_SEC + frac;
+
+	return true;
+}
+
+int fix_utc_timestamp_format(int64_t value, char *buf, unsigned long len)
+{
+	int64_t nsec = value % NSEC_PER_SEC;
+	time_t sec = value / NSEC_PER_SEC;
+	struct tm tm;
+	int digits;
+
+	if (nsec < 0) {
+		nsec += NSEC_PER_SEC;
+		sec--;
 	}
+
+	if (!gmtime_r(&sec, &tm))
+		return -1;
+
+	/*
+	 * The value does not keep the precision it was parsed with, so the
+	 * fraction has as many millisecond, microsecond or nanosecond digits
+	 * as it takes to keep the value exact.
+	 */
+	if (nsec % 1000000 == 0) {
+		nsec /= 1000000;
+		digits = 3;
+	} else if (nsec % 1000 == 0) {
+		nsec /= 1000;
+		digits = 6;
+	} else
+		digits = 9;
+
+	/* YYYYMMDD-HH:MM:SS.sss[sss[sss]] */
+	return snprintf(buf, len, "%04d%02d%02d-%02d:%02d:%02d.%0*d",
+			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+			tm.tm_hour, tm.tm_min, tm.tm_sec, digits, (int) nsec);
 }
 
 static int parse_tag(struct buffer *self, int *tag)
 {
 	const char *delim;
 	const char *start;
-	char *end;
-	int ret;
+	const char *ptr;
+	int ret = 0;
 
 	start = buffer_start(self);
 	delim = buffer_find(self, '=');
@@ -65,9 +458,15 @@ static int parse_tag(struct buffer *self, int *tag)
 	if (!delim || *delim != '=')
 		return FIX_MSG_STATE_PARTIAL;
 
-	ret = strtol(start, &end, 10);
-	if (end != delim)
-		return FIX_MSG_STATE_GARBLED;
+	for (ptr = start; ptr < delim; ptr++) {
+		if (*ptr < '0' || *ptr > '9')
+			return FIX_MSG_STATE_GARBLED;
+
+		if (ret > (INT_MAX - 9) / 10)
+			return FIX_MSG_STATE_GARBLED;
+
+		ret = ret * 10 + (*ptr - '0');
+	}
 
 	buffer_advance(self, 1);
 
@@ -147,35 +546,153 @@ fail:
 	return ret;
 }
 
+static const bool fix_msg_type_session[FIX_MSG_TYPE_MAX] = {
+	[FIX_MSG_TYPE_HEARTBEAT]		= true,
+	[FIX_MSG_TYPE_TEST_REQUEST]		= true,
+	[FIX_MSG_TYPE_RESEND_REQUEST]		= true,
+	[FIX_MSG_TYPE_REJECT]			= true,
+	[FIX_MSG_TYPE_SEQUENCE_RESET]		= true,
+	[FIX_MSG_TYPE_LOGOUT]			= true,
+	[FIX_MSG_TYPE_LOGON]			= true,
+};
+
 static inline bool fix_message_is_session(struct fix_message *self)
 {
-	/*
-	 * TODO: For the sake of performance we should avoid
-	 * using tons of strncmp calls here. The possible solution
-	 * is to map FIX messages' types into integers (enum possibly)
-	 * and to use switch-case construction in this function and
-	 * everywhere outside where msg_type is exploited.
-	 */
+	return fix_msg_type_session[self->type];
+}
 
-	if (fix_message_type_is(self, FIX_MSG_TYPE_EXECUTION_REPORT))
-		return false;
-	else if (fix_message_type_is(self, FIX_MSG_TYPE_NEW_ORDER_SINGLE))
-		return false;
-	else
-		return true;
+static void *arena_grow(void *base, unsigned long *max, size_t size)
+{
+	unsigned long nr = *max ? 2 * *max : 1;
+	void *ret;
+
+	ret = realloc(base, nr * size);
+	if (ret)
+		*max = nr;
+
+	return ret;
 }
 
-static void rest_of_message_session(struct fix_message *self, struct buffer *buffer)
+static struct fix_field *next_field(struct fix_message *self)
 {
-	int tag = 0;
-	const char *tag_ptr = NULL;
-	unsigned long nr_fields = 0;
+	struct fix_field *fields;
+
+	if (self->nr_fields == self->max_fields) {
+		fields = arena_grow(self->fields, &self->max_fields, sizeof(*fields));
+		if (!fields)
+			return NULL;
+
+		self->fields = fields;
+	}
+
+	return &self->fields[self->nr_fields++];
+}
+
+static struct fix_group *next_group(struct fix_message *self)
+{
+	struct fix_group *groups;
 
-	self->nr_fields = 0;
+	if (self->nr_groups == self->max_groups) {
+		groups = arena_grow(self->groups, &self->max_groups, sizeof(*groups));
+		if (!groups)
+			return NULL;
+
+		self->groups = groups;
+	}
+
+	return &self->groups[self->nr_groups++];
+}
+
+static bool next_entry(struct fix_message *self)
+{
+	unsigned long *entries;
+
+	if (self->nr_entries == self->max_entries) {
+		entries = arena_grow(self->entries, &self->max_entries, sizeof(*entries));
+		if (!entries)
+			return false;
+
+		self->entries = entries;
+	}
+
+	self->entries[self->nr_entries++] = self->nr_fields;
+
+	return true;
+}
+
+/*
+ * Repeating groups known to the parser. A field that is neither the
+ * delimiter nor one of the members terminates the group.
+ */
+struct fix_group_def {
+	enum fix_tag			tag;
+	unsigned long			nr_members;
+	const enum fix_tag		*members;
+};
+
+static const enum fix_tag md_entry_tags[] = {
+	MDUpdateAction,
+	MDEntryType,
+	MDEntryID,
+	Symbol,
+	RptSeq,
+	MDEntryPx,
+	MDEntrySize,
+	NumberOfOrders,
+	MDPriceLevel,
+};
+
+static const enum fix_tag alloc_tags[] = {
+	AllocAccount,
+	AllocPrice,
+	AllocQty,
+};
+
+static const enum fix_tag party_tags[] = {
+	PartyID,
+	PartyIDSource,
+	PartyRole,
+};
+
+static const struct fix_group_def fix_group_defs[] = {
+	{ NoMDEntries,	ARRAY_SIZE(md_entry_tags),	md_entry_tags },
+	{ NoAllocs,	ARRAY_SIZE(alloc_tags),		alloc_tags },
+	{ NoPartyIDs,	ARRAY_SIZE(party_tags),		party_tags },
+};
+
+static const struct fix_group_def *fix_group_def_lookup(int tag)
+{
+	unsigned long i;
+
+	for (i = 0; i < ARRAY_SIZE(fix_group_defs); i++) {
+		if (fix_group_defs[i].tag == tag)
+			return &fix_group_defs[i];
+	}
+
+	return NULL;
+}
+
+static bool fix_group_def_has(const struct fix_group_def *def, int tag)
+{
+	unsigned long i;
+
+	for (i = 0; i < def->nr_members; i++) {
+		if (def->members[i] == tag)
+			return true;
+	}
+
+	return false;
+}
+
+static int rest_of_message_session(struct fix_message *self, struct buffer *buffer)
+{
+	struct fix_field *field;
+	const char *tag_ptr = NULL;
+	int tag = 0;
 
 retry:
 	if (parse_field_promisc(buffer, &tag, &tag_ptr))
-		return;
+		return 0;
 
 	switch (tag) {
 	case CheckSum:
@@ -183,51 +700,68 @@ retry:
 	case BeginSeqNo:
 	case EndSeqNo:
 	case NewSeqNo:
-		self->fields[nr_fields++] = FIX_INT_FIELD(tag, strtol(tag_ptr, NULL, 10));
+		field = next_field(self);
+		if (!field)
+			return FIX_MSG_STATE_GARBLED;
+
+		*field = FIX_INT_FIELD(tag, strtol(tag_ptr, NULL, 10));
 		goto retry;
 	case GapFillFlag:
 	case PossDupFlag:
 	case TestReqID:
-		self->fields[nr_fields++] = FIX_STRING_FIELD(tag, tag_ptr);
+		field = next_field(self);
+		if (!field)
+			return FIX_MSG_STATE_GARBLED;
+
+		*field = FIX_STRING_FIELD(tag, tag_ptr);
 		goto retry;
 	case MsgSeqNum:
 		self->msg_seq_num = strtol(tag_ptr, NULL, 10);
 		goto retry;
+	case SendingTime:
+		if (!fix_utc_timestamp_parse(tag_ptr, buffer_start(buffer) - tag_ptr - 1, &self->sending_time))
+			self->sending_time = 0;
+		goto retry;
 	default:
 		goto retry;
 	};
 
-	self->nr_fields = nr_fields;
+	return 0;
 }
 
-static void rest_of_message_application(struct fix_message *self, struct buffer *buffer)
+/*
+ * Returns the type a field with the given tag is decoded to. Fields with
+ * unknown tags are dropped by the eager parser.
+ */
+static bool fix_tag_type(int tag, enum fix_type *type)
 {
-	int tag = 0;
-	const char *tag_ptr = NULL;
-	unsigned long nr_fields = 0;
-
-	self->nr_fields = 0;
-
-retry:
-	if (parse_field_promisc(buffer, &tag, &tag_ptr))
-		return;
-
 	switch (tag) {
-	case CheckSum:
-		break;
 	case BeginSeqNo:
 	case EndSeqNo:
 	case NewSeqNo:
-		self->fields[nr_fields++] = FIX_INT_FIELD(tag, strtol(tag_ptr, NULL, 10));
-		goto retry;
+	case RptSeq:
+	case NumberOfOrders:
+	case MDPriceLevel:
+	case PartyRole:
+	case NoMDEntries:
+	case NoPartyIDs:
+	case NoAllocs:
+		*type = FIX_TYPE_INT;
+		return true;
 	case LeavesQty:
 	case OrderQty:
 	case CumQty:
 	case AvgPx:
 	case Price:
-		self->fields[nr_fields++] = FIX_FLOAT_FIELD(tag, strtod(tag_ptr, NULL));
-		goto retry;
+	case MDEntryPx:
+	case MDEntrySize:
+	case AllocPrice:
+	case AllocQty:
+		*type = FIX_TYPE_FLOAT;
+		return true;
 	case TransactTime:
+		*type = FIX_TYPE_UTC_TIMESTAMP;
+		return true;
 	case GapFillFlag:
 	case PossDupFlag:
 	case OrdStatus:
@@ -240,27 +774,201 @@ retry:
 	case ExecID:
 	case Symbol:
 	case Side:
-		self->fields[nr_fields++] = FIX_STRING_FIELD(tag, tag_ptr);
+	case MDReqID:
+	case MDUpdateAction:
+	case MDEntryType:
+	case MDEntryID:
+	case AllocAccount:
+	case PartyID:
+	case PartyIDSource:
+		*type = FIX_TYPE_STRING;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void fix_field_convert(struct fix_field *field, enum fix_type type)
+{
+	const char *ptr = field->string_value;
+	int64_t timestamp;
+
+	switch (type) {
+	case FIX_TYPE_UTC_TIMESTAMP:
+		/* Malformed timestamps stay accessible as strings */
+		if (!fix_utc_timestamp_parse(ptr, strcspn(ptr, "\001"), &timestamp)) {
+			type = FIX_TYPE_STRING;
+			break;
+		}
+
+		field->timestamp_value = timestamp;
+		break;
+	case FIX_TYPE_INT:
+	case FIX_TYPE_CHECKSUM:
+		field->int_value = strtol(ptr, NULL, 10);
+		break;
+	case FIX_TYPE_FLOAT:
+		field->float_value = strtod(ptr, NULL);
+		break;
+	case FIX_TYPE_CHAR:
+		field->char_value = ptr[0];
+		break;
+	case FIX_TYPE_STRING:
+	case FIX_TYPE_RAW:
+		break;
+	default:
+		break;
+	}
+
+	field->type = type;
+}
+
+static int rest_of_message_application(struct fix_message *self, struct buffer *buffer)
+{
+	const struct fix_group_def *def = NULL;
+	struct fix_group *group = NULL;
+	unsigned long nr_expected = 0;
+	struct fix_field *field;
+	const char *tag_ptr = NULL;
+	enum fix_type type;
+	bool lazy, skip;
+	int tag = 0;
+
+	lazy = fix_msg_has_flags(self, FIX_MSG_FLAGS_LAZY);
+	skip = fix_msg_has_flags(self, FIX_MSG_FLAGS_SKIP_BODY);
+
+retry:
+	if (parse_field_promisc(buffer, &tag, &tag_ptr))
+		goto out;
+
+	if (group) {
+		if (!group->nr_entries) {
+			/* The first field of an entry must belong to the group */
+			if (!fix_group_def_has(def, tag))
+				return FIX_MSG_STATE_GARBLED;
+
+			group->delim = tag;
+		}
+
+		if (tag == group->delim) {
+			/* More entries than NoXXX announced */
+			if (group->nr_entries == nr_expected)
+				return FIX_MSG_STATE_GARBLED;
+
+			if (!next_entry(self))
+				return FIX_MSG_STATE_GARBLED;
+
+			group->nr_entries++;
+		} else if (!fix_group_def_has(def, tag)) {
+			/* Fewer entries than NoXXX announced */
+			if (group->nr_entries != nr_expected)
+				return FIX_MSG_STATE_GARBLED;
+
+			if (!next_entry(self))
+				return FIX_MSG_STATE_GARBLED;
+
+			group = NULL;
+		}
+	}
+
+	switch (tag) {
+	case CheckSum:
+		break;
+	case NoMDEntries:
+	case NoPartyIDs:
+	case NoAllocs:
+		nr_expected = strtol(tag_ptr, NULL, 10);
+
+		field = next_field(self);
+		if (!field)
+			return FIX_MSG_STATE_GARBLED;
+
+		*field = FIX_INT_FIELD(tag, nr_expected);
+
+		group = next_group(self);
+		if (!group)
+			return FIX_MSG_STATE_GARBLED;
+
+		*group = (struct fix_group) {
+			.tag		= tag,
+			.entry		= self->nr_entries,
+		};
+
+		def = fix_group_def_lookup(tag);
+
+		/* An empty group has only the closing offset */
+		if (!nr_expected) {
+			if (!next_entry(self))
+				return FIX_MSG_STATE_GARBLED;
+
+			group = NULL;
+		}
 		goto retry;
 	case MsgSeqNum:
 		self->msg_seq_num = strtol(tag_ptr, NULL, 10);
-		goto retry;
+		goto header;
+	case SendingTime:
+		if (!fix_utc_timestamp_parse(tag_ptr, buffer_start(buffer) - tag_ptr - 1, &self->sending_time))
+			self->sending_time = 0;
+		goto header;
 	default:
+		if (skip)
+			goto retry;
+
+		/*
+		 * Lazy mode keeps every field as a pointer to its raw value and
+		 * leaves the conversion to the first lookup.
+		 */
+		if (lazy)
+			type = FIX_TYPE_RAW;
+		else if (!fix_tag_type(tag, &type))
+			goto retry;
+
+		field = next_field(self);
+		if (!field)
+			return FIX_MSG_STATE_GARBLED;
+
+		*field = FIX_STRING_FIELD(tag, tag_ptr);
+
+		fix_field_convert(field, type);
 		goto retry;
 	};
 
-	self->nr_fields = nr_fields;
-}
+	goto out;
 
-static void rest_of_message(struct fix_message *self, struct buffer *buffer)
-{
-	if (fix_message_is_session(self)) {
-		rest_of_message_session(self, buffer);
-	} else {
-		rest_of_message_application(self, buffer);
+header:
+	if (!skip || !self->msg_seq_num || !self->sending_time)
+		goto retry;
+
+	/* The checksum has been verified, jump past it */
+	buffer_advance(buffer, self->check_sum - buffer_start(buffer));
+	next_tag(buffer);
+
+out:
+	/* The message ended inside of a group */
+	if (group) {
+		if (group->nr_entries != nr_expected)
+			return FIX_MSG_STATE_GARBLED;
+
+		if (!next_entry(self))
+			return FIX_MSG_STATE_GARBLED;
 	}
 
-	return;
+	return 0;
+}
+
+static int rest_of_message(struct fix_message *self, struct buffer *buffer)
+{
+	self->nr_fields		= 0;
+	self->nr_groups		= 0;
+	self->nr_entries	= 0;
+	self->msg_seq_num	= 0;
+	self->sending_time	= 0;
+
+	if (fix_message_is_session(self))
+		return rest_of_message_session(self, buffer);
+	else
+		return rest_of_message_application(self, buffer);
 }
 
 static bool verify_checksum(struct fix_message *self, struct buffer *buffer)
@@ -397,8 +1105,11 @@ retry:
 	start	= buffer_start(buffer);
 	size	= buffer_size(buffer);
 
-	if (!size)
+	/* A garbled message may have taken the rest of the buffer */
+	if (!size) {
+		ret = FIX_MSG_STATE_PARTIAL;
 		goto fail;
+	}
 
 	ret = first_three_fields(self);
 	if (ret)
@@ -408,7 +1119,9 @@ retry:
 	if (ret)
 		goto fail;
 
-	rest_of_message(self, buffer);
+	ret = rest_of_message(self, buffer);
+	if (ret)
+		goto fail;
 
 	return 0;
 
@@ -421,13 +1134,188 @@ fail:
 	return -1;
 }
 
-struct fix_field *fix_get_field(struct fix_message *self, int tag)
+struct fix_field *fix_field_decode(struct fix_field *field)
 {
-	unsigned long i;
+	enum fix_type type;
+
+	if (field->type != FIX_TYPE_RAW)
+		return field;
+
+	if (!fix_tag_type(field->tag, &type))
+		type = FIX_TYPE_STRING;
+
+	fix_field_convert(field, type);
+
+	return field;
+}
+
+static struct fix_field *fix_find_field(struct fix_message *self, int tag)
+{
+	struct fix_group *group = self->groups;
+	struct fix_group *end = group + self->nr_groups;
+	unsigned long i = 0;
+
+	while (i < self->nr_fields) {
+		/* Fields of repeating groups are not top-level fields */
+		if (group < end && i == self->entries[group->entry]) {
+			i = self->entries[group->entry + group->nr_entries];
+			group++;
+			continue;
+		}
 
-	for (i = 0; i < self->nr_fields; i++) {
 		if (self->fields[i].tag == tag)
 			return &self->fields[i];
+
+		i++;
+	}
+
+	return NULL;
+}
+
+struct fix_field *fix_get_field(struct fix_message *self, int tag)
+{
+	struct fix_field *field;
+
+	field = fix_find_field(self, tag);
+	if (!field)
+		return NULL;
+
+	return fix_field_decode(field);
+}
+
+/*
+ * The field keeps the type of its tag, the value is converted on the way
+ * out, so later lookups see the field as the parser would have left it.
+ */
+bool fix_get_int(struct fix_message *self, int tag, int64_t *value)
+{
+	struct fix_field *field;
+
+	field = fix_get_field(self, tag);
+	if (!field)
+		return false;
+
+	switch (field->type) {
+	case FIX_TYPE_INT:
+	case FIX_TYPE_CHECKSUM:
+		*value = field->int_value;
+		break;
+	case FIX_TYPE_FLOAT:
+		*value = field->float_value;
+		break;
+	case FIX_TYPE_CHAR:
+		*value = field->char_value - '0';
+		break;
+	case FIX_TYPE_STRING:
+		*value = strtol(field->string_value, NULL, 10);
+		break;
+	case FIX_TYPE_UTC_TIMESTAMP:
+	case FIX_TYPE_RAW:
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+bool fix_get_float(struct fix_message *self, int tag, double *value)
+{
+	struct fix_field *field;
+
+	field = fix_get_field(self, tag);
+	if (!field)
+		return false;
+
+	switch (field->type) {
+	case FIX_TYPE_FLOAT:
+		*value = field->float_value;
+		break;
+	case FIX_TYPE_INT:
+	case FIX_TYPE_CHECKSUM:
+		*value = field->int_value;
+		break;
+	case FIX_TYPE_CHAR:
+		*value = field->char_value - '0';
+		break;
+	case FIX_TYPE_STRING:
+		*value = strtod(field->string_value, NULL);
+		break;
+	case FIX_TYPE_UTC_TIMESTAMP:
+	case FIX_TYPE_RAW:
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+bool fix_get_timestamp(struct fix_message *self, int tag, int64_t *value)
+{
+	struct fix_field *field;
+
+	field = fix_find_field(self, tag);
+	if (!field)
+		return false;
+
+	switch (field->type) {
+	case FIX_TYPE_RAW:
+		fix_field_convert(field, FIX_TYPE_UTC_TIMESTAMP);
+		if (field->type != FIX_TYPE_UTC_TIMESTAMP)
+			return false;
+		/* fall through */
+	case FIX_TYPE_UTC_TIMESTAMP:
+		*value = field->timestamp_value;
+		break;
+	case FIX_TYPE_STRING:
+		return fix_utc_timestamp_parse(field->string_value, strcspn(field->string_value, "\001"), value);
+	case FIX_TYPE_INT:
+	case FIX_TYPE_FLOAT:
+	case FIX_TYPE_CHAR:
+	case FIX_TYPE_CHECKSUM:
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+struct fix_group *fix_get_group(struct fix_message *self, int tag)
+{
+	unsigned long i;
+
+	for (i = 0; i < self->nr_groups; i++) {
+		if (self->groups[i].tag == tag)
+			return &self->groups[i];
+	}
+
+	return NULL;
+}
+
+unsigned long fix_group_entry(struct fix_message *self, struct fix_group *group, unsigned long idx, struct fix_field **fields)
+{
+	unsigned long start, end;
+
+	if (idx >= group->nr_entries)
+		return 0;
+
+	start	= self->entries[group->entry + idx];
+	end	= self->entries[group->entry + idx + 1];
+
+	*fields	= &self->fields[start];
+
+	return end - start;
+}
+
+struct fix_field *fix_group_get_field(struct fix_message *self, struct fix_group *group, unsigned long idx, int tag)
+{
+	struct fix_field *fields;
+	unsigned long nr, i;
+
+	nr = fix_group_entry(self, group, idx, &fields);
+
+	for (i = 0; i < nr; i++) {
+		if (fields[i].tag == tag)
+			return fix_field_decode(&fields[i]);
 	}
 
 	return NULL;
@@ -475,6 +1363,22 @@ struct fix_message *fix_message_new(void)
 		return NULL;
 	}
 
+	self->groups = calloc(FIX_MAX_GROUP_NUMBER, sizeof(struct fix_group));
+	if (!self->groups) {
+		fix_message_free(self);
+		return NULL;
+	}
+
+	self->entries = calloc(FIX_MAX_ENTRY_NUMBER, sizeof(unsigned long));
+	if (!self->entries) {
+		fix_message_free(self);
+		return NULL;
+	}
+
+	self->max_fields	= FIX_MAX_FIELD_NUMBER;
+	self->max_groups	= FIX_MAX_GROUP_NUMBER;
+	self->max_entries	= FIX_MAX_ENTRY_NUMBER;
+
 	return self;
 }
 
@@ -483,6 +1387,8 @@ void fix_message_free(struct fix_message *self)
 	if (!self)
 		return;
 
+	free(self->entries);
+	free(self->groups);
 	free(self->fields);
 	free(self);
 }
@@ -494,6 +1400,8 @@ bool fix_message_type_is(struct fix_message *self, enum fix_msg_type type)
 
 bool fix_field_unparse(struct fix_field *self, struct buffer *buffer)
 {
+	char buf[64];
+
 	switch (self->type) {
 	case FIX_TYPE_STRING:
 		return buffer_printf(buffer, "%d=%s\x01", self->tag, self->string_value);
@@ -505,6 +1413,12 @@ bool fix_field_unparse(struct fix_field *self, struct buffer *buffer)
 		return buffer_printf(buffer, "%d=%" PRId64 "\x01", self->tag, self->int_value);
 	case FIX_TYPE_CHECKSUM:
 		return buffer_printf(buffer, "%d=%03" PRId64 "\x01", self->tag, self->int_value);
+	case FIX_TYPE_UTC_TIMESTAMP:
+		if (fix_utc_timestamp_format(self->timestamp_value, buf, sizeof buf) < 0)
+			return false;
+
+		return buffer_printf(buffer, "%d=%s\x01", self->tag, buf);
+	case FIX_TYPE_RAW:
 	default:
 		/* unknown type */
 		break;
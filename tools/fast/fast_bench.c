@@ -0,0 +1,1270 @@
+#include "libtrading/proto/fast_publisher.h"
+#include "libtrading/proto/fast_recovery.h"
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_decimal.h"
+#include "libtrading/proto/fast_codec.h"
+#include "libtrading/proto/fast_feed.h"
+
+#include "libtrading/buffer.h"
+#include "libtrading/array.h"
+#include "libtrading/die.h"
+
+#include <sys/socket.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <math.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "test.h"
+
+/* Generated from tools/fast/templates/micex.xml by fast_codegen */
+extern const struct fast_template_codec micex_codecs[];
+extern const unsigned long micex_nr_codecs;
+
+#define	MICEX_FULL_REFRESH	2
+#define	MICEX_SNAPSHOT		3
+#define	MICEX_HEARTBEAT		6
+#define	MICEX_SECURITY_STATUS	7
+#define	MICEX_TRADE		4
+
+#define	BENCH_SYMBOLS		8
+#define	BENCH_DECIMALS		1024
+#define	BENCH_INSTRUMENTS	10000
+#define	BENCH_STRINGS		1024
+#define	BENCH_TEMPLATES		2000
+#define	BENCH_TEMPLATE_FIELDS	40
+
+static const char	*program;
+
+static const char *symbols[BENCH_SYMBOLS] = {
+	"SBER", "GAZP", "LKOH", "GMKN", "ROSN", "VTBR", "MGNT", "NVTK",
+};
+
+struct bench_state {
+	u64			seed;
+	u64			msg_seq_num;
+	u64			sending_time;
+	i64			rpt_seq;
+	i64			nr_trades;
+	i64			price[BENCH_SYMBOLS];
+};
+
+static u64 bench_rand(struct bench_state *state)
+{
+	state->seed ^= state->seed << 13;
+	state->seed ^= state->seed >> 7;
+	state->seed ^= state->seed << 17;
+
+	return state->seed;
+}
+
+static void bench_state_init(struct bench_state *state)
+{
+	int i;
+
+	memset(state, 0, sizeof(*state));
+
+	state->seed		= 0x9e3779b97f4a7c15ULL;
+	state->sending_time	= 20131028100000000ULL;
+
+	for (i = 0; i < BENCH_SYMBOLS; i++)
+		state->price[i] = 10000 + i * 1500;
+}
+
+static void set_uint(struct fast_field *field, u64 value)
+{
+	field->state = FAST_STATE_ASSIGNED;
+	field->uint_value = value;
+}
+
+static void set_int(struct fast_field *field, i64 value)
+{
+	field->state = FAST_STATE_ASSIGNED;
+	field->int_value = value;
+}
+
+static void set_string(struct fast_field *field, const char *value)
+{
+	field_set_string(field, value, strlen(value));
+}
+
+static void set_decimal(struct fast_field *field, i64 exp, i64 mnt)
+{
+	field->state = FAST_STATE_ASSIGNED;
+	field->decimal_value.exp = exp;
+	field->decimal_value.mnt = mnt;
+}
+
+static void fill_header(struct fast_message *msg, struct bench_state *state)
+{
+	int i;
+
+	/* MessageType, ApplVerID and SenderCompID are constants */
+	for (i = 0; i < 3; i++)
+		msg->fields[i].state = FAST_STATE_ASSIGNED;
+
+	state->sending_time += bench_rand(state) % 1000;
+
+	set_uint(msg->fields + 3, ++state->msg_seq_num);
+	set_uint(msg->fields + 4, state->sending_time);
+}
+
+static void fill_security_status(struct fast_message *msg, struct bench_state *state)
+{
+	u64 r = bench_rand(state);
+
+	fill_header(msg, state);
+
+	set_string(msg->fields + 5, symbols[r % BENCH_SYMBOLS]);
+
+	if (r & 0x100)
+		set_string(msg->fields + 6, "TQBR");
+	else
+		field_set_empty(msg->fields + 6);
+
+	if (r & 0x200)
+		set_int(msg->fields + 7, 17 + (r >> 12) % 2);
+	else
+		field_set_empty(msg->fields + 7);
+
+	if (r & 0x400)
+		set_uint(msg->fields + 8, (r >> 16) % 3);
+	else
+		field_set_empty(msg->fields + 8);
+}
+
+static void fill_trade(struct fast_message *msg, struct bench_state *state)
+{
+	u64 r = bench_rand(state);
+	unsigned long sym = r % BENCH_SYMBOLS;
+	char entry_id[32];
+	i64 size;
+
+	fill_header(msg, state);
+
+	state->price[sym] += (i64) ((r >> 8) % 7) - 3;
+	size = 1 + (r >> 16) % 1000;
+
+	snprintf(entry_id, sizeof(entry_id), "%" PRIu64, state->msg_seq_num * 7);
+
+	set_uint(msg->fields + 5, 0);
+	set_string(msg->fields + 6, "z");
+
+	if (r & 0x1000000)
+		set_string(msg->fields + 7, entry_id);
+	else
+		field_set_empty(msg->fields + 7);
+
+	set_string(msg->fields + 8, symbols[sym]);
+
+	/* Mostly consecutive, with the odd gap */
+	state->rpt_seq += (r & 0x2000000) && (r & 0x4000000) ? 2 : 1;
+	set_int(msg->fields + 9, state->rpt_seq);
+
+	set_uint(msg->fields + 10, state->sending_time / 1000000 % 1000000);
+
+	if (r & 0x8000000)
+		set_uint(msg->fields + 11, state->sending_time % 1000000000);
+	else
+		field_set_empty(msg->fields + 11);
+
+	set_decimal(msg->fields + 12, -2, state->price[sym]);
+
+	if (r & 0x10000000)
+		set_decimal(msg->fields + 13, 0, size);
+	else
+		field_set_empty(msg->fields + 13);
+
+	set_decimal(msg->fields + 14, -2, state->price[sym] * size);
+
+	switch ((r >> 29) % 3) {
+	case 0:
+		set_string(msg->fields + 15, "B");
+		break;
+	case 1:
+		set_string(msg->fields + 15, "S");
+		break;
+	default:
+		field_set_empty(msg->fields + 15);
+		break;
+	}
+
+	set_string(msg->fields + 16, "TQBR");
+
+	state->nr_trades += 1 + (r >> 32) % 3;
+	set_int(msg->fields + 17, state->nr_trades);
+}
+
+/* An order book of one symbol, nr_levels entries with the bids first */
+static void fill_snapshot(struct fast_message *msg, struct bench_state *state, unsigned long nr_levels)
+{
+	u64 r = bench_rand(state);
+	unsigned long sym = r % BENCH_SYMBOLS;
+	unsigned long nr_bids = nr_levels / 2;
+	struct fast_sequence *seq;
+	struct fast_field *entry;
+	unsigned long i;
+
+	fill_header(msg, state);
+
+	seq = msg->fields[5].ptr_value;
+
+	if (fast_sequence_reserve(seq, nr_levels))
+		die("unable to allocate memory");
+
+	set_uint(&seq->length, nr_levels);
+
+	for (i = 0; i < nr_levels; i++) {
+		entry = fast_sequence_element(seq, i);
+		r = bench_rand(state);
+
+		set_uint(entry + 0, 0);
+		set_string(entry + 1, i < nr_bids ? "0" : "1");
+		field_set_empty(entry + 2);
+		set_string(entry + 3, symbols[sym]);
+		set_int(entry + 4, ++state->rpt_seq);
+		set_uint(entry + 5, state->sending_time / 1000000 % 1000000);
+
+		if (i < nr_bids)
+			set_decimal(entry + 6, -2, state->price[sym] - 1 - i);
+		else
+			set_decimal(entry + 6, -2, state->price[sym] + 1 + i - nr_bids);
+
+		set_decimal(entry + 7, 0, 1 + r % 5000);
+		set_string(entry + 8, "TQBR");
+	}
+}
+
+static struct fast_message *template_lookup(struct fast_session *session, unsigned long tid)
+{
+	struct fast_message *msg;
+
+	msg = fast_tid_lookup(&session->rx_map, tid);
+	if (!msg)
+		die("template %lu is missing", tid);
+
+	return msg;
+}
+
+/*
+ * Fills in the next message of a MICEX style stream: mostly trades with the
+ * odd security status and heartbeat, as in the trades feed, or order book
+ * snapshots of nr_levels levels a side if it is not zero.
+ */
+static struct fast_message *next_message(struct fast_session *session, struct bench_state *state, unsigned long nr_levels)
+{
+	struct fast_message *msg;
+	u64 r;
+
+	r = bench_rand(state) % 20;
+
+	if (nr_levels) {
+		msg = template_lookup(session, MICEX_SNAPSHOT);
+		fill_snapshot(msg, state, nr_levels);
+	} else if (r == 0) {
+		msg = template_lookup(session, MICEX_HEARTBEAT);
+		fill_header(msg, state);
+	} else if (r < 3) {
+		msg = template_lookup(session, MICEX_SECURITY_STATUS);
+		fill_security_status(msg, state);
+	} else {
+		msg = template_lookup(session, MICEX_TRADE);
+		fill_trade(msg, state);
+	}
+
+	return msg;
+}
+
+static void encode_stream(struct fast_session *session, struct buffer *stream, unsigned long nr_messages, unsigned long nr_levels)
+{
+	struct bench_state state;
+	struct fast_message *msg;
+	unsigned long i;
+
+	bench_state_init(&state);
+
+	fast_session_reset(session);
+
+	for (i = 0; i < nr_messages; i++) {
+		msg = next_message(session, &state, nr_levels);
+
+		msg->msg_buf = stream;
+
+		if (fast_message_encode(msg))
+			die("unable to encode message %lu", i);
+	}
+}
+
+static unsigned long decode_stream(struct fast_session *session, struct buffer *stream)
+{
+	unsigned long start = stream->start;
+	unsigned long nr_messages = 0;
+	struct fast_message *msg;
+	u64 last_tid = 0;
+
+	fast_session_reset(session);
+
+	while (buffer_size(stream)) {
+		msg = fast_message_decode(&session->rx_map, stream, last_tid);
+		if (!msg)
+			die("unable to decode message %lu", nr_messages);
+
+		last_tid = msg->tid;
+		nr_messages++;
+	}
+
+	stream->start = start;
+
+	return nr_messages;
+}
+
+static void verify_stream(struct fast_session *interp, struct fast_session *compiled, struct buffer *stream)
+{
+	struct fast_message *expected;
+	struct fast_message *actual;
+	unsigned long begin = stream->start;
+	unsigned long nr_messages = 0;
+	u64 last_tid = 0;
+
+	fast_session_reset(interp);
+	fast_session_reset(compiled);
+
+	while (buffer_size(stream)) {
+		unsigned long start = stream->start;
+
+		expected = fast_message_decode(&interp->rx_map, stream, last_tid);
+		if (!expected)
+			die("interpreter: unable to decode message %lu", nr_messages);
+
+		stream->start = start;
+
+		actual = fast_message_decode(&compiled->rx_map, stream, last_tid);
+		if (!actual)
+			die("compiled: unable to decode message %lu", nr_messages);
+
+		if (actual->tid != expected->tid || fmsgcmp(expected, actual))
+			die("message %lu differs", nr_messages);
+
+		last_tid = expected->tid;
+		nr_messages++;
+	}
+
+	stream->start = begin;
+}
+
+/* Folds every visited value into a checksum, like a handler filling its own structs */
+static int sum_value(void *data, unsigned long field, u64 value)
+{
+	u64 *sum = data;
+
+	*sum = (*sum ^ value) * 0x100000001b3ULL + field;
+
+	return 0;
+}
+
+static int sum_int(void *data, unsigned long field, i64 value)
+{
+	return sum_value(data, field, value);
+}
+
+static int sum_decimal(void *data, unsigned long field, i64 exp, i64 mnt)
+{
+	return sum_value(data, field, exp ^ (mnt << 8));
+}
+
+static int sum_string(void *data, unsigned long field, const char *value, unsigned long len)
+{
+	u64 v = 0;
+
+	memcpy(&v, value, len < sizeof(v) ? len : sizeof(v));
+
+	return sum_value(data, field, v ^ len);
+}
+
+static int sum_empty(void *data, unsigned long field)
+{
+	return sum_value(data, field, ~0ULL);
+}
+
+static const struct fast_visitor sum_visitor = {
+	.on_int		= sum_int,
+	.on_uint	= sum_value,
+	.on_decimal	= sum_decimal,
+	.on_string	= sum_string,
+	.on_empty	= sum_empty,
+};
+
+static void set_visitor(struct fast_session *session, u64 *sum)
+{
+	int i;
+
+	for (i = 0; i < session->nr_messages; i++)
+		fast_session_set_visitor(session, session->rx_messages[i].tid, sum ? &sum_visitor : NULL, sum);
+}
+
+static struct fast_session *session_new(const char *xml, bool compile)
+{
+	struct fast_session *session;
+	unsigned long nr;
+
+	session = fast_session_new(-1);
+	if (!session)
+		die("unable to allocate memory");
+
+	if (fast_suite_template(session, xml))
+		die("%s: cannot read template xml file", xml);
+
+	if (!compile)
+		return session;
+
+	nr = fast_session_attach(session, micex_codecs, micex_nr_codecs);
+	if (nr != micex_nr_codecs)
+		die("%s: only %lu of %lu codecs match the templates", xml, nr, micex_nr_codecs);
+
+	return session;
+}
+
+static double timespec_ns(struct timespec *before, struct timespec *after)
+{
+	return 1000000000.0 * (after->tv_sec - before->tv_sec) + (after->tv_nsec - before->tv_nsec);
+}
+
+static double bench_decode(struct fast_session *session, struct buffer *stream, unsigned long nr_iterations)
+{
+	struct timespec before, after;
+	unsigned long nr_messages = 0;
+	unsigned long i;
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++)
+		nr_messages += decode_stream(session, stream);
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	return timespec_ns(&before, &after) / nr_messages;
+}
+
+static double bench_encode(struct fast_session *session, struct buffer *stream, unsigned long nr_messages, unsigned long nr_levels, unsigned long nr_iterations)
+{
+	struct timespec before, after;
+	unsigned long i;
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		buffer_reset(stream);
+		encode_stream(session, stream, nr_messages, nr_levels);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	return timespec_ns(&before, &after) / (nr_messages * nr_iterations);
+}
+
+/*
+ * Messages a second that a publisher writes to /dev/null, with one write()
+ * a message and packed into packets of packet_size bytes, so mostly the
+ * system calls that packing saves.
+ */
+static void bench_publish(struct fast_session *session, unsigned long nr_messages, unsigned long packet_size, unsigned long nr_iterations)
+{
+	struct fast_publisher *publisher;
+	struct timespec before, after;
+	struct bench_state state;
+	struct fast_message *msg;
+	double single, batched;
+	unsigned long i, j;
+	int fd;
+
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0)
+		die("unable to open /dev/null");
+
+	session->sockfd = fd;
+
+	publisher = fast_publisher_new(session, packet_size);
+	if (!publisher)
+		die("unable to allocate memory");
+
+	publisher->flags = FAST_PUBLISHER_FLAGS_SEQ;
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		bench_state_init(&state);
+		fast_session_reset(session);
+
+		for (j = 0; j < nr_messages; j++) {
+			msg = next_message(session, &state, 0);
+
+			if (fast_session_send(session, msg, 0))
+				die("unable to send message %lu", j);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	single = 1e9 * nr_messages * nr_iterations / timespec_ns(&before, &after);
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		bench_state_init(&state);
+		fast_session_reset(session);
+
+		for (j = 0; j < nr_messages; j++) {
+			msg = next_message(session, &state, 0);
+
+			if (fast_publisher_add(publisher, msg))
+				die("unable to publish message %lu", j);
+		}
+
+		if (fast_publisher_flush(publisher))
+			die("unable to publish");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	batched = 1e9 * nr_messages * nr_iterations / timespec_ns(&before, &after);
+
+	printf("  publish: one write a message %.2lf M msgs/s, %lu byte packets %.2lf M msgs/s (%.1lf msgs/packet, %.2lfx)\n",
+		single / 1e6, packet_size, batched / 1e6,
+		(double) publisher->stats.nr_messages / publisher->stats.nr_packets, batched / single);
+
+	fast_publisher_free(publisher);
+
+	session->sockfd = -1;
+	close(fd);
+}
+
+/*
+ * Time to set up a session's templates from the XML file, from its cache
+ * and from templates that are shared with other sessions
+ */
+static void bench_templates(const char *xml, unsigned long nr_iterations)
+{
+	char cache[] = "/tmp/fast_bench-XXXXXX";
+	double xml_ns, cache_ns, shared_ns;
+	struct fast_templates *templates;
+	struct timespec before, after;
+	struct fast_session *session;
+	unsigned long i;
+	int fd;
+
+	fd = mkstemp(cache);
+	if (fd < 0)
+		die("unable to create a template cache");
+	close(fd);
+
+	session = session_new(xml, false);
+	if (fast_template_save(session, xml, cache))
+		die("unable to write the template cache");
+	fast_session_free(session);
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++)
+		fast_session_free(session_new(xml, false));
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	xml_ns = timespec_ns(&before, &after) / nr_iterations;
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		session = fast_session_new(-1);
+		if (!session || fast_template_load(session, xml, cache))
+			die("unable to load the template cache");
+		fast_session_free(session);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	cache_ns = timespec_ns(&before, &after) / nr_iterations;
+
+	unlink(cache);
+
+	templates = fast_templates_new(xml, NULL);
+	if (!templates)
+		die("unable to parse templates");
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		session = fast_session_new(-1);
+		if (!session || fast_session_use_templates(session, templates))
+			die("unable to use shared templates");
+		fast_session_free(session);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	shared_ns = timespec_ns(&before, &after) / nr_iterations;
+
+	fast_templates_put(templates);
+
+	printf("templates: xml %.1lf us/session, cache %.1lf us/session (%.2lfx), shared %.1lf us/session (%.2lfx)\n",
+		xml_ns / 1000, cache_ns / 1000, xml_ns / cache_ns, shared_ns / 1000, xml_ns / shared_ns);
+}
+
+/* Prices as the feed sends them, converted with pow() and with the tables */
+static void bench_decimals(unsigned long nr_iterations)
+{
+	struct fast_decimal decimals[BENCH_DECIMALS];
+	struct timespec before, after;
+	struct bench_state state;
+	double pow_ns, double_ns, fixed_ns;
+	volatile double sum = 0;
+	volatile i64 total = 0;
+	unsigned long i, j;
+	i64 value;
+
+	bench_state_init(&state);
+
+	for (i = 0; i < BENCH_DECIMALS; i++) {
+		decimals[i].exp = -(i64) (bench_rand(&state) % 9);
+		decimals[i].mnt = bench_rand(&state) % 1000000000;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		for (j = 0; j < BENCH_DECIMALS; j++)
+			sum += decimals[j].mnt * pow(10, decimals[j].exp);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	pow_ns = timespec_ns(&before, &after) / (nr_iterations * BENCH_DECIMALS);
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		for (j = 0; j < BENCH_DECIMALS; j++)
+			sum += fast_decimal_to_double(decimals + j);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	double_ns = timespec_ns(&before, &after) / (nr_iterations * BENCH_DECIMALS);
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		for (j = 0; j < BENCH_DECIMALS; j++) {
+			if (fast_decimal_to_fixed(decimals + j, -8, &value))
+				die("decimal does not fit a tick of 10^-8");
+
+			total += value;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	fixed_ns = timespec_ns(&before, &after) / (nr_iterations * BENCH_DECIMALS);
+
+	printf("decimals: pow() %.2lf ns, double %.2lf ns (%.2lfx), fixed %.2lf ns (%.2lfx)\n", pow_ns, double_ns, pow_ns / double_ns, fixed_ns, pow_ns / fixed_ns);
+}
+
+/* The same order id and byte vector with each string operator, in dictionaries of their own */
+static const char strings_templates[] =
+	"<templates>\n"
+	"<template name=\"Copy\" dictionary=\"template\" id=\"1\"><string name=\"OrderID\"><copy/></string>"
+	"<byteVector name=\"Ref\"><copy/></byteVector></template>\n"
+	"<template name=\"Delta\" dictionary=\"template\" id=\"2\"><string name=\"OrderID\"><delta/></string>"
+	"<byteVector name=\"Ref\"><delta/></byteVector></template>\n"
+	"<template name=\"Tail\" dictionary=\"template\" id=\"3\"><string name=\"OrderID\"><tail/></string>"
+	"<byteVector name=\"Ref\"><tail/></byteVector></template>\n"
+	"</templates>\n";
+
+/*
+ * Encoding and decoding of strings that, like order ids, mostly change at
+ * the back, with the copy, delta and tail operators.
+ */
+static void bench_strings(unsigned long nr_messages, unsigned long nr_iterations)
+{
+	static const char *names[] = { "copy", "delta", "tail" };
+	static char ids[BENCH_STRINGS][16];
+	static char refs[BENCH_STRINGS][24];
+	char xml[] = "/tmp/fast_bench-XXXXXX";
+	double encode_ns[3], decode_ns[3];
+	unsigned long nr_bytes[3];
+	struct timespec before, after;
+	struct fast_session *session;
+	struct bench_state state;
+	struct fast_message *msg;
+	struct buffer *stream;
+	unsigned long i, j;
+	u64 id = 7000000000ULL;
+	FILE *file;
+	int fd;
+	int tid;
+
+	fd = mkstemp(xml);
+	if (fd < 0)
+		die("unable to create templates");
+
+	file = fdopen(fd, "w");
+	if (!file)
+		die("unable to create templates");
+
+	fputs(strings_templates, file);
+	fclose(file);
+
+	session = session_new(xml, false);
+
+	unlink(xml);
+
+	bench_state_init(&state);
+
+	for (i = 0; i < BENCH_STRINGS; i++) {
+		id += 1 + bench_rand(&state) % 50;
+
+		snprintf(ids[i], sizeof(ids[i]), "%" PRIu64, id);
+		snprintf(refs[i], sizeof(refs[i]), "%s/%05" PRIu64, symbols[i % BENCH_SYMBOLS], id % 100000);
+	}
+
+	stream = buffer_new(nr_messages * 64);
+	if (!stream)
+		die("unable to allocate memory");
+
+	for (tid = 1; tid <= 3; tid++) {
+		msg = template_lookup(session, tid);
+
+		clock_gettime(CLOCK_MONOTONIC, &before);
+
+		for (i = 0; i < nr_iterations; i++) {
+			buffer_reset(stream);
+			fast_session_reset(session);
+
+			for (j = 0; j < nr_messages; j++) {
+				set_string(msg->fields + 0, ids[j % BENCH_STRINGS]);
+				set_string(msg->fields + 1, refs[j % BENCH_STRINGS]);
+
+				msg->msg_buf = stream;
+
+				if (fast_message_encode(msg))
+					die("unable to encode message %lu", j);
+			}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &after);
+
+		encode_ns[tid - 1] = timespec_ns(&before, &after) / (nr_messages * nr_iterations);
+		nr_bytes[tid - 1] = buffer_size(stream);
+
+		clock_gettime(CLOCK_MONOTONIC, &before);
+
+		for (i = 0; i < nr_iterations; i++)
+			decode_stream(session, stream);
+
+		clock_gettime(CLOCK_MONOTONIC, &after);
+
+		decode_ns[tid - 1] = timespec_ns(&before, &after) / (nr_messages * nr_iterations);
+
+		if (strcmp(msg->fields[0].string_value, ids[(nr_messages - 1) % BENCH_STRINGS]))
+			die("%s strings decode to the wrong value", names[tid - 1]);
+	}
+
+	printf("strings: encode/decode");
+
+	for (i = 0; i < 3; i++) {
+		printf(" %s %.1lf/%.1lf ns, %.1lf bytes%s", names[i], encode_ns[i], decode_ns[i],
+			(double) nr_bytes[i] / nr_messages, i < 2 ? "," : "\n");
+	}
+
+	buffer_delete(stream);
+	fast_session_free(session);
+}
+
+/* Five field types and operators that take turns in each template */
+static const char *template_set_fields[] = {
+	"<uInt32 name=\"F%d\"><copy/></uInt32>",
+	"<uInt32 name=\"F%d\"><increment/></uInt32>",
+	"<int64 name=\"F%d\"><delta/></int64>",
+	"<decimal name=\"F%d\" presence=\"optional\"><copy/></decimal>",
+	"<string name=\"F%d\"><copy/></string>",
+};
+
+static struct fast_session *template_set_new(unsigned long nr_templates)
+{
+	char xml[] = "/tmp/fast_bench-XXXXXX";
+	struct fast_session *session;
+	unsigned long i;
+	FILE *file;
+	int fd, j;
+
+	fd = mkstemp(xml);
+	if (fd < 0)
+		die("unable to create templates");
+
+	file = fdopen(fd, "w");
+	if (!file)
+		die("unable to create templates");
+
+	fputs("<templates>\n", file);
+
+	for (i = 0; i < nr_templates; i++) {
+		fprintf(file, "<template name=\"T%lu\" dictionary=\"template\" id=\"%lu\">", i, i + 1);
+
+		for (j = 0; j < BENCH_TEMPLATE_FIELDS; j++)
+			fprintf(file, template_set_fields[j % ARRAY_SIZE(template_set_fields)], j);
+
+		fputs("</template>\n", file);
+	}
+
+	fputs("</templates>\n", file);
+	fclose(file);
+
+	session = session_new(xml, false);
+
+	unlink(xml);
+
+	return session;
+}
+
+static void template_set_encode(struct fast_session *session, struct buffer *stream, unsigned long nr_templates, unsigned long nr_messages)
+{
+	struct bench_state state;
+	struct fast_message *msg;
+	struct fast_field *field;
+	unsigned long i;
+	int j;
+	u64 r;
+
+	bench_state_init(&state);
+	fast_session_reset(session);
+
+	for (i = 0; i < nr_messages; i++) {
+		msg = template_lookup(session, 1 + bench_rand(&state) % nr_templates);
+
+		for (j = 0; j < BENCH_TEMPLATE_FIELDS; j++) {
+			field = msg->fields + j;
+			r = bench_rand(&state);
+
+			switch (j % ARRAY_SIZE(template_set_fields)) {
+			case 0:
+				set_uint(field, r % 4);
+				break;
+			case 1:
+				set_uint(field, field->uint_value + 1);
+				break;
+			case 2:
+				set_int(field, field->int_value + (i64) (r % 200) - 100);
+				break;
+			case 3:
+				set_decimal(field, -2, 10000 + r % 100);
+				break;
+			default:
+				set_string(field, symbols[r % BENCH_SYMBOLS]);
+				break;
+			}
+		}
+
+		msg->msg_buf = stream;
+
+		if (fast_message_encode(msg))
+			die("unable to encode message %lu", i);
+	}
+}
+
+/*
+ * Decoding of messages of 40 fields that pick their template at random
+ * from a few templates, whose state stays in L1, and from many, where
+ * every message touches cold template state.
+ */
+static void bench_template_set(unsigned long nr_messages, unsigned long nr_iterations)
+{
+	static const unsigned long nr_templates[] = { 4, BENCH_TEMPLATES };
+	struct fast_session *session;
+	struct buffer *stream;
+	double ns[2];
+	unsigned long i;
+
+	stream = buffer_new(nr_messages * 256);
+	if (!stream)
+		die("unable to allocate memory");
+
+	for (i = 0; i < ARRAY_SIZE(nr_templates); i++) {
+		session = template_set_new(nr_templates[i]);
+
+		buffer_reset(stream);
+		template_set_encode(session, stream, nr_templates[i], nr_messages);
+
+		ns[i] = bench_decode(session, stream, nr_iterations);
+
+		fast_session_free(session);
+	}
+
+	printf("template set: %d fields (%lu bytes of fields), %lu templates %.1lf ns/message, %lu templates %.1lf ns/message (%.2lfx)\n",
+		BENCH_TEMPLATE_FIELDS, BENCH_TEMPLATE_FIELDS * sizeof(struct fast_field),
+		nr_templates[0], ns[0], nr_templates[1], ns[1], ns[1] / ns[0]);
+
+	buffer_delete(stream);
+}
+
+/* A channel of a feed, published on one end of a socket pair */
+struct bench_channel {
+	struct fast_session	*session;
+	struct fast_session	*rx;
+	struct fast_publisher	*publisher;
+	struct fast_feed	*feed;
+	int			sv[2];
+};
+
+static int recovery_handler(struct fast_feed *feed, struct fast_message *msg)
+{
+	return fast_recovery_process(feed->data, msg);
+}
+
+static int recovery_snapshot(struct fast_recovery *rec, struct fast_instrument *instrument, struct fast_message *msg)
+{
+	return 0;
+}
+
+static int recovery_update(struct fast_recovery *rec, struct fast_instrument *instrument, u64 tid, struct fast_field *fields)
+{
+	return 0;
+}
+
+static void channel_init(struct bench_channel *channel, const char *xml, bool compile, struct fast_recovery *rec)
+{
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, channel->sv))
+		die("unable to create socket pair");
+
+	channel->session = session_new(xml, compile);
+	channel->session->sockfd = channel->sv[0];
+
+	channel->publisher = fast_publisher_new(channel->session, 1400);
+	if (!channel->publisher)
+		die("unable to allocate memory");
+
+	channel->publisher->flags = FAST_PUBLISHER_FLAGS_SEQ;
+
+	channel->rx = session_new(xml, compile);
+
+	channel->feed = fast_feed_new(channel->rx);
+	if (!channel->feed)
+		die("unable to allocate memory");
+
+	channel->feed->handler	= recovery_handler;
+	channel->feed->data	= rec;
+}
+
+static void channel_exit(struct bench_channel *channel)
+{
+	fast_feed_free(channel->feed);
+	fast_session_free(channel->rx);
+	fast_publisher_free(channel->publisher);
+	fast_session_free(channel->session);
+	close(channel->sv[0]);
+	close(channel->sv[1]);
+}
+
+static void channel_pump(struct bench_channel *channel)
+{
+	char buf[FAST_FEED_PACKET_SIZE];
+	ssize_t len;
+
+	if (fast_publisher_flush(channel->publisher))
+		die("unable to publish");
+
+	while ((len = recv(channel->sv[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+		if (fast_feed_process(channel->feed, FAST_FEED_LINE_A, buf, len))
+			die("unable to process packet");
+	}
+}
+
+/*
+ * Time for a handler that joins late to recover nr_instruments from a
+ * snapshot cycle of two level books while incremental updates of two
+ * entries keep coming, over a socket pair per channel. The snapshot channel
+ * has the templates of snapshot_xml.
+ */
+static void bench_recovery(const char *xml, const char *snapshot_xml, unsigned long nr_instruments)
+{
+	struct bench_channel incremental, snapshot;
+	struct timespec before, after;
+	struct bench_state state;
+	struct fast_sequence *seq;
+	struct fast_recovery *rec;
+	struct fast_message *msg;
+	struct fast_field *entry;
+	unsigned long i, j, idx;
+	char symbol[16];
+	i64 *rpt_seqs;
+	u64 r;
+
+	rpt_seqs = calloc(nr_instruments, sizeof(*rpt_seqs));
+	if (!rpt_seqs)
+		die("unable to allocate memory");
+
+	rec = fast_recovery_new(4 * nr_instruments);
+	if (!rec)
+		die("unable to allocate memory");
+
+	rec->on_snapshot	= recovery_snapshot;
+	rec->on_update		= recovery_update;
+
+	channel_init(&incremental, xml, true, rec);
+	channel_init(&snapshot, snapshot_xml, false, rec);
+
+	if (fast_recovery_add_updates(rec, fast_tid_lookup(&incremental.rx->rx_map, MICEX_SNAPSHOT), 5, 3, 4) ||
+	    fast_recovery_add_snapshot(rec, fast_tid_lookup(&snapshot.rx->rx_map, MICEX_FULL_REFRESH), 7, 6))
+		die("%s, %s: no MICEX incremental and snapshot templates", xml, snapshot_xml);
+
+	bench_state_init(&state);
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_instruments; i++) {
+		snprintf(symbol, sizeof(symbol), "S%05lu", i);
+
+		msg = template_lookup(snapshot.session, MICEX_FULL_REFRESH);
+		fill_header(msg, &state);
+		field_set_empty(msg->fields + 5);
+		set_int(msg->fields + 6, rpt_seqs[i]);
+		set_string(msg->fields + 7, symbol);
+		set_string(msg->fields + 8, "TQBR");
+
+		seq = msg->fields[9].ptr_value;
+		if (fast_sequence_reserve(seq, 2))
+			die("unable to allocate memory");
+
+		set_uint(&seq->length, 2);
+
+		for (j = 0; j < 2; j++) {
+			entry = fast_sequence_element(seq, j);
+			set_string(entry + 0, j ? "1" : "0");
+			set_decimal(entry + 1, -2, 10000 + i - 1 + 2 * j);
+			set_decimal(entry + 2, 0, 1 + bench_rand(&state) % 5000);
+		}
+
+		if (fast_publisher_add(snapshot.publisher, msg))
+			die("unable to publish snapshot %lu", i);
+
+		msg = template_lookup(incremental.session, MICEX_SNAPSHOT);
+		fill_header(msg, &state);
+
+		seq = msg->fields[5].ptr_value;
+		if (fast_sequence_reserve(seq, 2))
+			die("unable to allocate memory");
+
+		set_uint(&seq->length, 2);
+
+		for (j = 0; j < 2; j++) {
+			r = bench_rand(&state);
+			idx = r % nr_instruments;
+
+			snprintf(symbol, sizeof(symbol), "S%05lu", idx);
+
+			entry = fast_sequence_element(seq, j);
+			set_uint(entry + 0, 1);
+			set_string(entry + 1, r & 0x100 ? "1" : "0");
+			field_set_empty(entry + 2);
+			set_string(entry + 3, symbol);
+			set_int(entry + 4, ++rpt_seqs[idx]);
+			set_uint(entry + 5, state.sending_time / 1000000 % 1000000);
+			set_decimal(entry + 6, -2, 10000 + idx + (r >> 8) % 7 - 3);
+			set_decimal(entry + 7, 0, 1 + (r >> 16) % 5000);
+			field_set_empty(entry + 8);
+		}
+
+		if (fast_publisher_add(incremental.publisher, msg))
+			die("unable to publish update %lu", i);
+
+		if (i % 16 == 15) {
+			channel_pump(&snapshot);
+			channel_pump(&incremental);
+		}
+	}
+
+	channel_pump(&snapshot);
+	channel_pump(&incremental);
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	if (!fast_recovery_is_done(rec) || rec->nr_instruments != nr_instruments)
+		die("only %lu of %lu instruments recovered", rec->nr_live, nr_instruments);
+
+	printf("recovery: %lu instruments in %.1lf ms (%.2lf us/instrument), %lu updates queued, %lu overruns\n",
+		nr_instruments, timespec_ns(&before, &after) / 1e6,
+		timespec_ns(&before, &after) / 1e3 / nr_instruments,
+		rec->stats.nr_queued, rec->stats.nr_overruns);
+
+	channel_exit(&snapshot);
+	channel_exit(&incremental);
+	fast_recovery_free(rec);
+	free(rpt_seqs);
+}
+
+static void usage(void)
+{
+	printf("\n  usage: %s [-t template] [-r snapshot template] [-m messages] [-n iterations] [-l levels] [-s packet size]\n\n", program);
+
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct fast_session *compiled_enc;
+	struct fast_session *interp_enc;
+	struct fast_session *compiled;
+	struct fast_session *interp;
+	unsigned long nr_iterations;
+	unsigned long nr_snapshots;
+	unsigned long packet_size;
+	unsigned long nr_messages;
+	unsigned long nr_levels;
+	struct buffer *expected;
+	struct buffer *stream;
+	u64 interp_sum = 0;
+	u64 sum = 0;
+	double interp_ns;
+	double ns;
+	const char *snapshot_xml;
+	const char *xml;
+	int opt;
+
+	program		= basename(argv[0]);
+
+	xml		= "tools/fast/templates/micex.xml";
+	snapshot_xml	= "tools/fast/templates/micex-snapshot.xml";
+	nr_messages	= 100000;
+	nr_iterations	= 20;
+	nr_levels	= 100;
+	packet_size	= 1400;
+
+	while ((opt = getopt(argc, argv, "t:r:m:n:l:s:")) != -1) {
+		switch (opt) {
+		case 't':
+			xml = optarg;
+			break;
+		case 'r':
+			snapshot_xml = optarg;
+			break;
+		case 'm':
+			nr_messages = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			nr_iterations = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			nr_levels = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			packet_size = strtoul(optarg, NULL, 10);
+			break;
+		default: /* '?' */
+			usage();
+		}
+	}
+
+	if (!nr_levels || packet_size > FAST_FEED_PACKET_SIZE)
+		usage();
+
+	interp = session_new(xml, false);
+	compiled = session_new(xml, true);
+	interp_enc = session_new(xml, false);
+	compiled_enc = session_new(xml, true);
+
+	stream = buffer_new(nr_messages * FAST_MESSAGE_MAX_SIZE / 16);
+	expected = buffer_new(nr_messages * FAST_MESSAGE_MAX_SIZE / 16);
+
+	if (!stream || !expected)
+		die("unable to allocate memory");
+
+	/* The generated encoders must produce the interpreter's bytes */
+	encode_stream(interp_enc, expected, nr_messages, 0);
+	encode_stream(compiled_enc, stream, nr_messages, 0);
+
+	if (buffer_size(stream) != buffer_size(expected) ||
+	    memcmp(buffer_start(stream), buffer_start(expected), buffer_size(stream)))
+		die("compiled encoders differ from the interpreter");
+
+	verify_stream(interp, compiled, stream);
+
+	printf("%lu messages, %lu bytes, %s\n", nr_messages, buffer_size(stream), xml);
+
+	interp_ns = bench_decode(interp, stream, nr_iterations);
+	ns = bench_decode(compiled, stream, nr_iterations);
+
+	printf("  decode: interpreter %.1lf ns/message, compiled %.1lf ns/message (%.2lfx)\n", interp_ns, ns, interp_ns / ns);
+
+	interp_ns = bench_encode(interp_enc, expected, nr_messages, 0, nr_iterations);
+	ns = bench_encode(compiled_enc, stream, nr_messages, 0, nr_iterations);
+
+	printf("  encode: interpreter %.1lf ns/message, compiled %.1lf ns/message (%.2lfx)\n", interp_ns, ns, interp_ns / ns);
+
+	bench_publish(compiled_enc, nr_messages, packet_size, nr_iterations);
+
+	set_visitor(interp, &interp_sum);
+	set_visitor(compiled, &sum);
+
+	decode_stream(interp, stream);
+	decode_stream(compiled, stream);
+
+	if (interp_sum != sum)
+		die("compiled visitors differ from the interpreter");
+
+	interp_ns = bench_decode(interp, stream, nr_iterations);
+	ns = bench_decode(compiled, stream, nr_iterations);
+
+	printf("  visit:  interpreter %.1lf ns/message, compiled %.1lf ns/message (%.2lfx)\n", interp_ns, ns, interp_ns / ns);
+
+	set_visitor(interp, NULL);
+	set_visitor(compiled, NULL);
+
+	/* Order book snapshots carry their levels in a sequence */
+	nr_snapshots = nr_messages / nr_levels ? nr_messages / nr_levels : 1;
+
+	buffer_reset(expected);
+	buffer_reset(stream);
+
+	encode_stream(interp_enc, expected, nr_snapshots, nr_levels);
+	encode_stream(compiled_enc, stream, nr_snapshots, nr_levels);
+
+	if (buffer_size(stream) != buffer_size(expected) ||
+	    memcmp(buffer_start(stream), buffer_start(expected), buffer_size(stream)))
+		die("compiled snapshot encoders differ from the interpreter");
+
+	verify_stream(interp, compiled, stream);
+
+	printf("%lu snapshots of %lu levels, %lu bytes\n", nr_snapshots, nr_levels, buffer_size(stream));
+
+	interp_ns = bench_decode(interp, stream, nr_iterations);
+	ns = bench_decode(compiled, stream, nr_iterations);
+
+	printf("  decode: interpreter %.1lf ns/message, compiled %.1lf ns/message (%.2lfx)\n", interp_ns, ns, interp_ns / ns);
+
+	interp_ns = bench_encode(interp_enc, expected, nr_snapshots, nr_levels, nr_iterations);
+	ns = bench_encode(compiled_enc, stream, nr_snapshots, nr_levels, nr_iterations);
+
+	printf("  encode: interpreter %.1lf ns/message, compiled %.1lf ns/message (%.2lfx)\n", interp_ns, ns, interp_ns / ns);
+
+	bench_templates(xml, 50 * nr_iterations);
+
+	bench_decimals(100 * nr_iterations);
+
+	bench_strings(nr_messages, nr_iterations);
+
+	bench_template_set(nr_messages, nr_iterations);
+
+	bench_recovery(xml, snapshot_xml, BENCH_INSTRUMENTS);
+
+	fast_session_free(compiled_enc);
+	fast_session_free(interp_enc);
+	fast_session_free(compiled);
+	fast_session_free(interp);
+	buffer_delete(expected);
+	buffer_delete(stream);
+
+	return 0;
+}
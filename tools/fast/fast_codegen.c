@@ -0,0 +1,807 @@
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_codec.h"
+
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+/*
+ * Generates straight-line C codecs from a template XML file. Decoders are
+ * specialised per template: mandatory constants are left out and set once
+ * by fast_message_attach(), pmap bits are tested inline, uint, int and
+ * ASCII fields with no, copy or increment operators are read in place, and
+ * a shared dictionary value is only loaded when the operator works from
+ * it. Everything else goes through the fast_codec.h codec for its type,
+ * with the operator, presence and pmap bit passed as constants, and the
+ * encoders always do. The output is meant to be linked next to the
+ * interpreter and attached with fast_session_attach(). On the MICEX
+ * templates the generated decoders run about 1.9 times as fast as the
+ * interpreter (1.5 times with one codec call per field), short of the 3-5x
+ * that was aimed for: the per-message work of reading the pmap and
+ * template id and saving the shadow copy, and the string copies of shared
+ * fields, are the same on both paths.
+ */
+
+static char *program;
+
+static void usage(void)
+{
+	printf("\n  usage: %s -t [template] [-n name] [-o output] [-b cache]\n\n", basename(program));
+
+	exit(EXIT_FAILURE);
+}
+
+static const char *op_name(enum fast_op op)
+{
+	switch (op) {
+	case FAST_OP_NONE:
+		return "FAST_OP_NONE";
+	case FAST_OP_COPY:
+		return "FAST_OP_COPY";
+	case FAST_OP_INCR:
+		return "FAST_OP_INCR";
+	case FAST_OP_DELTA:
+		return "FAST_OP_DELTA";
+	case FAST_OP_CONSTANT:
+		return "FAST_OP_CONSTANT";
+	case FAST_OP_TAIL:
+		return "FAST_OP_TAIL";
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+static const char *type_name(struct fast_field *field)
+{
+	switch (field->type) {
+	case FAST_TYPE_INT:
+		return "int";
+	case FAST_TYPE_UINT:
+		return "uint";
+	case FAST_TYPE_STRING:
+		if (field_has_flags(field, FAST_FIELD_FLAGS_UNICODE))
+			return "unicode";
+		return "ascii";
+	case FAST_TYPE_DECIMAL:
+		if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS))
+			return "decimal_parts";
+		return "decimal";
+	case FAST_TYPE_SEQUENCE:
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+static const char *encode_name(struct fast_field *field)
+{
+	return field->type == FAST_TYPE_STRING ? "string" : type_name(field);
+}
+
+static const char *visit_name(struct fast_field *field)
+{
+	return field->type == FAST_TYPE_DECIMAL ? "decimal" : encode_name(field);
+}
+
+static void emit_args(FILE *out, struct fast_field *field)
+{
+	struct fast_decimal_parts *parts;
+
+	if (field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS)) {
+		parts = field_decimal_parts(field);
+
+		emit_args(out, &parts->exponent);
+		fprintf(out, ", %s, %u", op_name(parts->mantissa.op), parts->mantissa.pmap_bit);
+
+		return;
+	}
+
+	fprintf(out, "%s, %s, %u", op_name(field->op),
+			field_is_mandatory(field) ? "true" : "false", field->pmap_bit);
+}
+
+static bool has_slots(struct fast_message *msg)
+{
+	unsigned long i;
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		if (msg->fields[i].slot)
+			return true;
+	}
+
+	return false;
+}
+
+/* Whether a decoder has anything left to do once its constants are left out */
+static bool has_work(struct fast_message *msg)
+{
+	unsigned long i;
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		if (!fast_field_is_fixed(msg->fields + i))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Fields that share a dictionary entry take it before their encoder runs
+ * and put it back after, see fast_dict_load_previous(). Encoders keep the
+ * dictionary in the previous values.
+ */
+static void emit_dict_load(FILE *out, const char *indent, struct fast_field *field, unsigned long i)
+{
+	if (!field->slot)
+		return;
+
+	fprintf(out, "%sif (fast_dict_load_previous(dict, fields + %lu))\n", indent, i);
+	fprintf(out, "%s\treturn -1;\n", indent);
+}
+
+static void emit_dict_store(FILE *out, const char *indent, struct fast_field *field, unsigned long i)
+{
+	if (!field->slot)
+		return;
+
+	fprintf(out, "%sfast_dict_store_previous(dict, fields + %lu);\n", indent, i);
+}
+
+/*
+ * Tests a pmap bit with its byte and mask worked out here. The pmap is a
+ * pointer, or the address of a local such as &spmap.
+ */
+static void emit_pmap_test(FILE *out, const char *pmap, unsigned long bit)
+{
+	const char *member = "->";
+
+	if (pmap[0] == '&') {
+		member = ".";
+		pmap++;
+	}
+
+	fprintf(out, "%s%snr_bytes > %lu && (%s%sbytes[%lu] & 0x%02x)",
+			pmap, member, bit / 7, pmap, member, bit / 7, 1 << (6 - bit % 7));
+}
+
+/* Reads an integer that is in the stream, see FAST_OP_NONE in fast_decode_uint() */
+static void emit_int_read(FILE *out, const char *indent, const char *f, struct fast_field *field)
+{
+	const char *type = type_name(field);
+
+	fprintf(out, "%sret = fast_get_%s(buffer, &%s.%s_value);\n", indent, type, f, type);
+	fprintf(out, "%sif (ret)\n%s\treturn ret;\n\n", indent, indent);
+	fprintf(out, "%s%s.state = FAST_STATE_ASSIGNED;\n", indent, f);
+
+	if (field_is_mandatory(field))
+		return;
+
+	fprintf(out, "\n%sif (!%s.%s_value)\n", indent, f, type);
+	fprintf(out, "%s\t%s.state = FAST_STATE_EMPTY;\n", indent, f);
+	if (field->type == FAST_TYPE_INT)
+		fprintf(out, "%selse if (%s.int_value > 0)\n", indent, f);
+	else
+		fprintf(out, "%selse\n", indent);
+	fprintf(out, "%s\t%s.%s_value--;\n", indent, f, type);
+}
+
+/* Reads an ascii string that is in the stream, see fast_read_ascii() */
+static void emit_ascii_read(FILE *out, const char *indent, const char *f, struct fast_field *field)
+{
+	fprintf(out, "%sret = fast_get_string(buffer, %s.string_buf, %s.string_size);\n", indent, f, f);
+	fprintf(out, "%sif (ret < 0)\n%s\treturn ret;\n\n", indent, indent);
+	fprintf(out, "%s%s.state = FAST_STATE_ASSIGNED;\n", indent, f);
+	fprintf(out, "%s%s.string_value = %s.string_buf;\n\n", indent, f, f);
+
+	fprintf(out, "%sif (unlikely(!%s.string_buf[0])) {\n", indent, f);
+	if (field_is_mandatory(field))
+		fprintf(out, "%s\tret -= 1;\n", indent);
+	else {
+		fprintf(out, "%s\tif (ret > 1)\n", indent);
+		fprintf(out, "%s\t\tret -= 2;\n", indent);
+		fprintf(out, "%s\telse {\n", indent);
+		fprintf(out, "%s\t\t%s.state = FAST_STATE_EMPTY;\n", indent, f);
+		fprintf(out, "%s\t\tret = 0;\n", indent);
+		fprintf(out, "%s\t}\n", indent);
+	}
+	fprintf(out, "\n%s\t%s.string_buf[ret] = '\\0';\n", indent, f);
+	fprintf(out, "%s}\n\n", indent);
+
+	fprintf(out, "%s%s.string_len = ret;\n", indent, f);
+}
+
+/*
+ * Reads a value that is in the stream. Decimals are left to their codec,
+ * whose FAST_OP_NONE path is what a copy operator does with its bit set.
+ */
+static void emit_read(FILE *out, const char *indent, const char *pmap, const char *f, struct fast_field *field)
+{
+	switch (field->type) {
+	case FAST_TYPE_INT:
+	case FAST_TYPE_UINT:
+		emit_int_read(out, indent, f, field);
+		break;
+	case FAST_TYPE_STRING:
+		emit_ascii_read(out, indent, f, field);
+		break;
+	case FAST_TYPE_DECIMAL:
+		fprintf(out, "%sret = fast_decode_decimal(buffer, %s, &%s, FAST_OP_NONE, %s, 0);\n",
+				indent, pmap, f, field_is_mandatory(field) ? "true" : "false");
+		fprintf(out, "%sif (ret)\n%s\treturn ret;\n", indent, indent);
+		break;
+	case FAST_TYPE_SEQUENCE:
+	default:
+		break;
+	}
+}
+
+/*
+ * Takes the value of a field that shares its dictionary entry, see
+ * fast_dict_load(). Only strings can fail to fit.
+ */
+static void emit_shared_load(FILE *out, const char *indent, const char *f, struct fast_field *field)
+{
+	if (field->type != FAST_TYPE_STRING) {
+		fprintf(out, "%sfast_dict_load(dict, &%s);\n\n", indent, f);
+		return;
+	}
+
+	fprintf(out, "%sret = fast_dict_load(dict, &%s);\n", indent, f);
+	fprintf(out, "%sif (ret)\n%s\treturn ret;\n\n", indent, indent);
+}
+
+/*
+ * What a copy or increment operator does when the pmap bit is not set:
+ * keep or bump an assigned value, take the initial value of an undefined
+ * one, and turn down a mandatory field that is empty. A shared value is
+ * taken from the dictionary first and only put back if it changed.
+ */
+static void emit_previous(FILE *out, const char *indent, const char *f, struct fast_field *field)
+{
+	const char *type = type_name(field);
+	const char *arm = " else if";
+	const char *in = indent;
+	char inner[16];
+
+	snprintf(inner, sizeof(inner), "%s\t", indent);
+
+	if (field->slot) {
+		fprintf(out, " else {\n");
+		emit_shared_load(out, inner, f, field);
+		fprintf(out, "%s", inner);
+
+		arm = "if";
+		in = inner;
+	}
+
+	if (field->op == FAST_OP_INCR) {
+		fprintf(out, "%s (%s.state == FAST_STATE_ASSIGNED) {\n", arm, f);
+		fprintf(out, "%s\t%s.%s_value++;\n", in, f, type);
+		if (field->slot)
+			fprintf(out, "%s\tfast_dict_store(dict, &%s);\n", in, f);
+		fprintf(out, "%s}", in);
+
+		arm = " else if";
+	}
+
+	fprintf(out, "%s (%s.state == FAST_STATE_UNDEFINED) {\n", arm, f);
+	if (field->type == FAST_TYPE_STRING) {
+		fprintf(out, "%s\tret = fast_read_reset(&%s, %s);\n", in, f, field_is_mandatory(field) ? "true" : "false");
+		fprintf(out, "%s\tif (ret)\n%s\t\treturn ret;\n", in, in);
+	} else if (field_has_reset_value(field)) {
+		fprintf(out, "%s\t%s.state = FAST_STATE_ASSIGNED;\n", in, f);
+		fprintf(out, "%s\t%s.%s_value = %s.%s_reset;\n", in, f, type, f, type);
+	} else if (field_is_mandatory(field))
+		fprintf(out, "%s\treturn FAST_MSG_STATE_GARBLED;\n", in);
+	else
+		fprintf(out, "%s\t%s.state = FAST_STATE_EMPTY;\n", in, f);
+	if (field->slot && (field_has_reset_value(field) || !field_is_mandatory(field)))
+		fprintf(out, "\n%s\tfast_dict_store(dict, &%s);\n", in, f);
+	fprintf(out, "%s}", in);
+
+	if (field_is_mandatory(field)) {
+		fprintf(out, " else if (%s.state == FAST_STATE_EMPTY) {\n", f);
+		fprintf(out, "%s\treturn FAST_MSG_STATE_GARBLED;\n", in);
+		fprintf(out, "%s}", in);
+	}
+
+	if (field->slot)
+		fprintf(out, "\n%s}", indent);
+
+	fprintf(out, "\n");
+}
+
+/*
+ * Decodes a field with the operator, presence and pmap bit of the template
+ * written out, so that the generated code has no codec left to call for
+ * integers and ascii strings. A value that is read from the stream does
+ * not need the one in the dictionary, which is only loaded when the
+ * operator works from it. Mandatory constants are not decoded at all, see
+ * fast_field_is_fixed(). Everything else goes to the codecs.
+ */
+static void emit_field_decode(FILE *out, const char *indent, const char *pmap, const char *f, struct fast_field *field)
+{
+	bool is_int = field->type == FAST_TYPE_INT || field->type == FAST_TYPE_UINT;
+	bool is_ascii = field->type == FAST_TYPE_STRING && !field_has_flags(field, FAST_FIELD_FLAGS_UNICODE);
+	bool is_decimal = field->type == FAST_TYPE_DECIMAL && !field_has_flags(field, FAST_FIELD_FLAGS_DECIMAL_PARTS);
+	char inner[16];
+
+	snprintf(inner, sizeof(inner), "%s\t", indent);
+
+	if (fast_field_is_fixed(field))
+		return;
+
+	if (field->op == FAST_OP_CONSTANT && !field->slot && (is_int || field->type == FAST_TYPE_STRING)) {
+		fprintf(out, "%sif (", indent);
+		emit_pmap_test(out, pmap, field->pmap_bit);
+		fprintf(out, ")\n");
+		fprintf(out, "%s%s.state = FAST_STATE_ASSIGNED;\n", inner, f);
+		fprintf(out, "%selse\n", indent);
+		fprintf(out, "%s%s.state = FAST_STATE_EMPTY;\n\n", inner, f);
+		return;
+	}
+
+	if (field->op == FAST_OP_NONE && (is_int || is_ascii)) {
+		emit_read(out, indent, pmap, f, field);
+
+		if (field->slot)
+			fprintf(out, "\n%sfast_dict_store(dict, &%s);\n", indent, f);
+		fprintf(out, "\n");
+		return;
+	}
+
+	if ((field->op == FAST_OP_COPY && (is_int || is_ascii || is_decimal)) || (field->op == FAST_OP_INCR && is_int)) {
+		fprintf(out, "%sif (", indent);
+		emit_pmap_test(out, pmap, field->pmap_bit);
+		fprintf(out, ") {\n");
+
+		emit_read(out, inner, pmap, f, field);
+
+		if (field->slot)
+			fprintf(out, "\n%sfast_dict_store(dict, &%s);\n", inner, f);
+
+		fprintf(out, "%s}", indent);
+		emit_previous(out, indent, f, field);
+		fprintf(out, "\n");
+		return;
+	}
+
+	if (field->slot)
+		emit_shared_load(out, indent, f, field);
+
+	fprintf(out, "%sret = fast_decode_%s(buffer, %s, &%s, ", indent, type_name(field), pmap, f);
+	emit_args(out, field);
+	fprintf(out, ");\n");
+	fprintf(out, "%sif (ret)\n%s\treturn ret;\n\n", indent, indent);
+
+	if (field->slot)
+		fprintf(out, "%sfast_dict_store(dict, &%s);\n\n", indent, f);
+}
+
+/*
+ * Sequences are decoded through the element template's fields, which hold
+ * the dictionary. The decoder copies every element out of them into the
+ * sequence's values, the visitor hands the values over as they are.
+ */
+static int emit_sequence(FILE *out, const char *name, struct fast_message *msg, unsigned long idx, bool visit)
+{
+	struct fast_field *field = msg->fields + idx;
+	struct fast_sequence *seq = field->ptr_value;
+	struct fast_message *elem = &seq->element;
+	struct fast_field *f;
+	unsigned long i;
+	char expr[32];
+
+	for (i = 0; i < elem->nr_fields; i++) {
+		/* At the moment we do no support nested sequences */
+		if (elem->fields[i].type == FAST_TYPE_SEQUENCE)
+			return -1;
+	}
+
+	fprintf(out, "static int %s_%lu_seq%lu_%s(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)\n",
+			name, msg->tid, idx, visit ? "visit" : "decode");
+	fprintf(out, "{\n");
+	fprintf(out, "\tstruct fast_sequence *seq = msg->fields[%lu].ptr_value;\n", idx);
+	fprintf(out, "\tstruct fast_field *fields = seq->element.fields;\n");
+	if (has_slots(elem))
+		fprintf(out, "\tstruct fast_dictionary *dict = msg->dictionary;\n");
+	fprintf(out, "\tstruct fast_pmap spmap;\n");
+	if (!visit)
+		fprintf(out, "\tstruct fast_field *cur;\n");
+	fprintf(out, "\tunsigned long i;\n");
+	if (visit || !fast_field_is_fixed(&seq->length) || has_work(elem))
+		fprintf(out, "\tint ret;\n");
+	fprintf(out, "\n");
+
+	emit_field_decode(out, "\t", "pmap", "seq->length", &seq->length);
+
+	fprintf(out, "\tif (field_state_empty(&seq->length))\n");
+	if (field_is_mandatory(field))
+		fprintf(out, "\t\treturn FAST_MSG_STATE_GARBLED;\n\n");
+	else if (visit)
+		fprintf(out, "\t\treturn fast_visit_empty(msg, %lu);\n\n", idx);
+	else
+		fprintf(out, "\t\treturn 0;\n\n");
+
+	if (visit) {
+		fprintf(out, "\tret = fast_visit_sequence_begin(msg, %lu, seq->length.uint_value);\n", idx);
+		fprintf(out, "\tif (ret)\n\t\treturn ret;\n\n");
+	} else {
+		fprintf(out, "\tif (fast_sequence_reserve(seq, seq->length.uint_value))\n");
+		fprintf(out, "\t\treturn FAST_MSG_STATE_GARBLED;\n\n");
+	}
+
+	fprintf(out, "\tspmap.nr_bytes = 0;\n\n");
+
+	fprintf(out, "\tfor (i = 0; i < seq->length.uint_value; i++) {\n");
+	if (!visit)
+		fprintf(out, "\t\tcur = fast_sequence_element(seq, i);\n\n");
+
+	if (field_has_flags(field, FAST_FIELD_FLAGS_PMAPREQ)) {
+		fprintf(out, "\t\tret = fast_get_pmap(buffer, &spmap);\n");
+		fprintf(out, "\t\tif (ret)\n\t\t\treturn ret;\n\n");
+	}
+
+	for (i = 0; i < elem->nr_fields; i++) {
+		f = elem->fields + i;
+
+		snprintf(expr, sizeof(expr), "fields[%lu]", i);
+
+		emit_field_decode(out, "\t\t", "&spmap", expr, f);
+
+		if (visit) {
+			fprintf(out, "\t\tret = fast_visit_%s(msg, %lu, fields + %lu);\n", visit_name(f), i, i);
+			fprintf(out, "\t\tif (ret)\n\t\t\treturn ret;\n");
+
+			if (i + 1 < elem->nr_fields)
+				fprintf(out, "\n");
+
+			continue;
+		}
+
+		switch (f->type) {
+		case FAST_TYPE_INT:
+			fprintf(out, "\t\tcur[%lu].int_value = fields[%lu].int_value;\n", i, i);
+			break;
+		case FAST_TYPE_UINT:
+			fprintf(out, "\t\tcur[%lu].uint_value = fields[%lu].uint_value;\n", i, i);
+			break;
+		case FAST_TYPE_STRING:
+			fprintf(out, "\t\tfield_copy_string(cur + %lu, fields + %lu);\n", i, i);
+			break;
+		case FAST_TYPE_DECIMAL:
+			fprintf(out, "\t\tcur[%lu].decimal_value = fields[%lu].decimal_value;\n", i, i);
+			break;
+		case FAST_TYPE_SEQUENCE:
+		default:
+			return -1;
+		}
+
+		fprintf(out, "\t\tcur[%lu].state = fields[%lu].state;\n", i, i);
+
+		if (i + 1 < elem->nr_fields)
+			fprintf(out, "\n");
+	}
+
+	fprintf(out, "\t}\n\n");
+	if (visit)
+		fprintf(out, "\treturn fast_visit_sequence_end(msg, %lu);\n", idx);
+	else
+		fprintf(out, "\treturn 0;\n");
+	fprintf(out, "}\n\n");
+
+	return 0;
+}
+
+static int emit_decode(FILE *out, const char *name, struct fast_message *msg, bool visit)
+{
+	const char *suffix = visit ? "visit" : "decode";
+	struct fast_field *field;
+	unsigned long i;
+	char expr[32];
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		if (msg->fields[i].type != FAST_TYPE_SEQUENCE)
+			continue;
+
+		if (emit_sequence(out, name, msg, i, visit))
+			return -1;
+	}
+
+	fprintf(out, "static int %s_%lu_%s(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)\n", name, msg->tid, suffix);
+	fprintf(out, "{\n");
+	fprintf(out, "\tstruct fast_field *fields = msg->fields;\n");
+	if (has_slots(msg))
+		fprintf(out, "\tstruct fast_dictionary *dict = msg->dictionary;\n");
+	if (visit || has_work(msg))
+		fprintf(out, "\tint ret;\n");
+	fprintf(out, "\n");
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
+
+		if (field->type == FAST_TYPE_SEQUENCE)
+			fprintf(out, "\tret = %s_%lu_seq%lu_%s(buffer, pmap, msg);\n", name, msg->tid, i, suffix);
+		else {
+			snprintf(expr, sizeof(expr), "fields[%lu]", i);
+
+			emit_field_decode(out, "\t", "pmap", expr, field);
+
+			if (!visit)
+				continue;
+
+			fprintf(out, "\tret = fast_visit_%s(msg, %lu, fields + %lu);\n", visit_name(field), i, i);
+		}
+
+		fprintf(out, "\tif (ret)\n\t\treturn ret;\n\n");
+	}
+
+	fprintf(out, "\treturn 0;\n");
+	fprintf(out, "}\n\n");
+
+	return 0;
+}
+
+/*
+ * Every element is copied into the element template's fields, which hold
+ * the dictionary, and encoded from there. Room for the element's pmap is
+ * left in front of its fields and squeezed out once it is known.
+ */
+static void emit_sequence_encode(FILE *out, const char *name, struct fast_message *msg, unsigned long idx)
+{
+	struct fast_field *field = msg->fields + idx;
+	struct fast_sequence *seq = field->ptr_value;
+	struct fast_message *elem = &seq->element;
+	bool pmap_req = field_has_flags(field, FAST_FIELD_FLAGS_PMAPREQ);
+	struct fast_field *f;
+	unsigned long i;
+
+	fprintf(out, "static int %s_%lu_seq%lu_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)\n", name, msg->tid, idx);
+	fprintf(out, "{\n");
+	fprintf(out, "\tstruct fast_sequence *seq = msg->fields[%lu].ptr_value;\n", idx);
+	fprintf(out, "\tstruct fast_field *fields = seq->element.fields;\n");
+	if (has_slots(elem))
+		fprintf(out, "\tstruct fast_dictionary *dict = msg->dictionary;\n");
+	fprintf(out, "\tstruct fast_pmap spmap;\n");
+	fprintf(out, "\tstruct fast_field *cur;\n");
+	if (pmap_req)
+		fprintf(out, "\tunsigned long offset;\n");
+	fprintf(out, "\tunsigned long i;\n\n");
+
+	fprintf(out, "\tif (fast_encode_uint(buffer, pmap, &seq->length, ");
+	emit_args(out, &seq->length);
+	fprintf(out, "))\n\t\treturn -1;\n\n");
+
+	fprintf(out, "\tif (field_state_empty(&seq->length))\n");
+	fprintf(out, "\t\treturn %s;\n\n", field_is_mandatory(field) ? "-1" : "0");
+
+	fprintf(out, "\tif (seq->length.uint_value > seq->max_elements)\n");
+	fprintf(out, "\t\treturn -1;\n\n");
+
+	fprintf(out, "\tspmap.nr_bytes = 0;\n\n");
+
+	fprintf(out, "\tfor (i = 0; i < seq->length.uint_value; i++) {\n");
+	fprintf(out, "\t\tcur = fast_sequence_element(seq, i);\n\n");
+
+	if (pmap_req)
+		fprintf(out, "\t\tif (fast_pmap_reserve(buffer, &spmap, &offset))\n\t\t\treturn -1;\n\n");
+
+	for (i = 0; i < elem->nr_fields; i++) {
+		f = elem->fields + i;
+
+		switch (f->type) {
+		case FAST_TYPE_INT:
+			fprintf(out, "\t\tfields[%lu].int_value = cur[%lu].int_value;\n", i, i);
+			break;
+		case FAST_TYPE_UINT:
+			fprintf(out, "\t\tfields[%lu].uint_value = cur[%lu].uint_value;\n", i, i);
+			break;
+		case FAST_TYPE_STRING:
+			fprintf(out, "\t\tfield_copy_string(fields + %lu, cur + %lu);\n", i, i);
+			break;
+		case FAST_TYPE_DECIMAL:
+			fprintf(out, "\t\tfields[%lu].decimal_value = cur[%lu].decimal_value;\n", i, i);
+			break;
+		case FAST_TYPE_SEQUENCE:
+		default:
+			break;
+		}
+
+		fprintf(out, "\t\tfields[%lu].state = cur[%lu].state;\n", i, i);
+
+		emit_dict_load(out, "\t\t", f, i);
+
+		fprintf(out, "\t\tif (fast_encode_%s(buffer, &spmap, fields + %lu, ", encode_name(f), i);
+		emit_args(out, f);
+		fprintf(out, "))\n\t\t\treturn -1;\n");
+
+		emit_dict_store(out, "\t\t", f, i);
+
+		if (i + 1 < elem->nr_fields || pmap_req)
+			fprintf(out, "\n");
+	}
+
+	if (pmap_req)
+		fprintf(out, "\t\tfast_pmap_commit(buffer, &spmap, offset);\n");
+
+	fprintf(out, "\t}\n\n");
+	fprintf(out, "\treturn 0;\n");
+	fprintf(out, "}\n\n");
+}
+
+static void emit_encode(FILE *out, const char *name, struct fast_message *msg)
+{
+	struct fast_field *field;
+	unsigned long i;
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		if (msg->fields[i].type == FAST_TYPE_SEQUENCE)
+			emit_sequence_encode(out, name, msg, i);
+	}
+
+	fprintf(out, "static int %s_%lu_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)\n", name, msg->tid);
+	fprintf(out, "{\n");
+	fprintf(out, "\tstruct fast_field *fields = msg->fields;\n");
+	if (has_slots(msg))
+		fprintf(out, "\tstruct fast_dictionary *dict = msg->dictionary;\n");
+	fprintf(out, "\n");
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		field = msg->fields + i;
+
+		if (field->type == FAST_TYPE_SEQUENCE)
+			fprintf(out, "\tif (%s_%lu_seq%lu_encode(buffer, pmap, msg", name, msg->tid, i);
+		else {
+			emit_dict_load(out, "\t", field, i);
+
+			fprintf(out, "\tif (fast_encode_%s(buffer, pmap, fields + %lu, ", encode_name(field), i);
+			emit_args(out, field);
+		}
+		fprintf(out, "))\n\t\treturn -1;\n");
+
+		emit_dict_store(out, "\t", field, i);
+
+		fprintf(out, "\n");
+	}
+
+	fprintf(out, "\treturn 0;\n");
+	fprintf(out, "}\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct fast_session *session;
+	const char *output = NULL;
+	const char *cache = NULL;
+	const char *name = NULL;
+	const char *xml = NULL;
+	struct fast_message *msg;
+	bool *compiled;
+	FILE *tmpl;
+	char *code;
+	size_t size;
+	FILE *out;
+	int opt;
+	int i;
+
+	program = argv[0];
+
+	while ((opt = getopt(argc, argv, "t:n:o:b:")) != -1) {
+		switch (opt) {
+		case 't':
+			xml = optarg;
+			break;
+		case 'n':
+			name = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'b':
+			cache = optarg;
+			break;
+		default:
+			usage();
+			break;
+		}
+	}
+
+	if (!xml || (!name && !cache))
+		usage();
+
+	session = fast_session_new(-1);
+	if (!session) {
+		fprintf(stderr, "%s: FAST session cannot be created\n", program);
+		return EXIT_FAILURE;
+	}
+
+	if (fast_suite_template(session, xml)) {
+		fprintf(stderr, "%s: Cannot read template xml file\n", program);
+		return EXIT_FAILURE;
+	}
+
+	if (cache && fast_template_save(session, xml, cache)) {
+		fprintf(stderr, "%s: Cannot write %s\n", program, cache);
+		return EXIT_FAILURE;
+	}
+
+	if (!name) {
+		fast_session_free(session);
+		return 0;
+	}
+
+	out = output ? fopen(output, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "%s: Cannot open %s\n", program, output);
+		return EXIT_FAILURE;
+	}
+
+	compiled = calloc(session->nr_messages, sizeof(bool));
+	if (!compiled)
+		return EXIT_FAILURE;
+
+	fprintf(out, "/* Generated by fast_codegen from %s, do not edit */\n\n", xml);
+	fprintf(out, "#include \"libtrading/proto/fast_codec.h\"\n\n");
+	fprintf(out, "#include <string.h>\n\n");
+
+	for (i = 0; i < session->nr_messages; i++) {
+		msg = session->rx_messages + i;
+
+		/* A template that cannot be compiled must leave nothing behind */
+		tmpl = open_memstream(&code, &size);
+		if (!tmpl)
+			return EXIT_FAILURE;
+
+		if (emit_decode(tmpl, name, msg, false) || emit_decode(tmpl, name, msg, true)) {
+			fprintf(stderr, "%s: template %lu is left to the interpreter\n", program, msg->tid);
+			fclose(tmpl);
+			free(code);
+			continue;
+		}
+
+		emit_encode(tmpl, name, msg);
+
+		fclose(tmpl);
+
+		fwrite(code, 1, size, out);
+		free(code);
+
+		compiled[i] = true;
+	}
+
+	fprintf(out, "extern const struct fast_template_codec %s_codecs[];\n", name);
+	fprintf(out, "extern const unsigned long %s_nr_codecs;\n\n", name);
+
+	fprintf(out, "const struct fast_template_codec %s_codecs[] = {\n", name);
+
+	for (i = 0; i < session->nr_messages; i++) {
+		msg = session->rx_messages + i;
+
+		if (!compiled[i])
+			continue;
+
+		fprintf(out, "\t{\n");
+		fprintf(out, "\t\t.tid\t\t= %lu,\n", msg->tid);
+		fprintf(out, "\t\t.signature\t= 0x%016" PRIx64 "ULL,\n", fast_message_signature(msg));
+		fprintf(out, "\t\t.decode\t\t= %s_%lu_decode,\n", name, msg->tid);
+		fprintf(out, "\t\t.visit\t\t= %s_%lu_visit,\n", name, msg->tid);
+		fprintf(out, "\t\t.encode\t\t= %s_%lu_encode,\n", name, msg->tid);
+		fprintf(out, "\t},\n");
+	}
+
+	fprintf(out, "};\n\n");
+	fprintf(out, "const unsigned long %s_nr_codecs = sizeof(%s_codecs) / sizeof(%s_codecs[0]);\n", name, name, name);
+
+	if (out != stdout)
+		fclose(out);
+
+	free(compiled);
+	fast_session_free(session);
+
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_feed.h"
+
+#include "libtrading/die.h"
+
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+static const char *program;
+
+static void usage(void)
+{
+	fprintf(stderr, "\n  usage: %s -t [template] -a [group:port] -b [group:port] [-c cache] [-i ifaddr] [-n seconds] [-r]\n\n", program);
+	exit(EXIT_FAILURE);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void feed_join(struct fast_feed *feed, enum fast_feed_line line, char *addr, const char *ifaddr)
+{
+	char *port;
+
+	port = strchr(addr, ':');
+	if (!port)
+		usage();
+
+	*port++ = '\0';
+
+	if (fast_feed_join(feed, line, addr, atoi(port), ifaddr))
+		die("unable to join %s:%s", addr, port);
+}
+
+static double percent(unsigned long part, unsigned long total)
+{
+	return total ? 100.0 * part / total : 0.0;
+}
+
+static void print_stats(struct fast_feed_stats *cur, struct fast_feed_stats *prev, double secs)
+{
+	unsigned long pkts_a = cur->nr_packets[FAST_FEED_LINE_A] - prev->nr_packets[FAST_FEED_LINE_A];
+	unsigned long pkts_b = cur->nr_packets[FAST_FEED_LINE_B] - prev->nr_packets[FAST_FEED_LINE_B];
+	unsigned long wins_a = cur->nr_wins[FAST_FEED_LINE_A] - prev->nr_wins[FAST_FEED_LINE_A];
+	unsigned long wins_b = cur->nr_wins[FAST_FEED_LINE_B] - prev->nr_wins[FAST_FEED_LINE_B];
+
+	printf("A %.0lf pkts/s (%.1lf%% wins), B %.0lf pkts/s (%.1lf%% wins), %.0lf msgs/s, "
+		"%lu duplicates, %lu gaps, %lu lost, %lu errors\n",
+		pkts_a / secs, percent(wins_a, wins_a + wins_b),
+		pkts_b / secs, percent(wins_b, wins_a + wins_b),
+		(cur->nr_messages - prev->nr_messages) / secs,
+		cur->nr_duplicates, cur->nr_gaps, cur->nr_lost, cur->nr_errors);
+
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	struct fast_feed_stats prev;
+	struct fast_session *session;
+	struct fast_feed *feed;
+	const char *ifaddr = NULL;
+	const char *cache = NULL;
+	const char *xml = NULL;
+	unsigned long duration = 0;
+	char *line_a = NULL;
+	char *line_b = NULL;
+	int flags = 0;
+	double start, last, t;
+	int opt;
+
+	program = basename(argv[0]);
+
+	while ((opt = getopt(argc, argv, "t:a:b:c:i:n:r")) != -1) {
+		switch (opt) {
+		case 't':
+			xml = optarg;
+			break;
+		case 'a':
+			line_a = optarg;
+			break;
+		case 'b':
+			line_b = optarg;
+			break;
+		case 'c':
+			cache = optarg;
+			break;
+		case 'i':
+			ifaddr = optarg;
+			break;
+		case 'n':
+			duration = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			flags |= FAST_FEED_FLAGS_PACKET_RESET;
+			break;
+		default: /* '?' */
+			usage();
+		}
+	}
+
+	if (!xml || (!line_a && !line_b))
+		usage();
+
+	session = fast_session_new(-1);
+	if (!session)
+		die("unable to allocate memory");
+
+	if (cache) {
+		if (fast_cached_template(session, xml, cache))
+			die("unable to read templates from %s", xml);
+	} else if (fast_micex_template(session, xml))
+		die("unable to read templates from %s", xml);
+
+	feed = fast_feed_new(session);
+	if (!feed)
+		die("unable to allocate memory");
+
+	feed->flags = flags;
+
+	if (line_a)
+		feed_join(feed, FAST_FEED_LINE_A, line_a, ifaddr);
+
+	if (line_b)
+		feed_join(feed, FAST_FEED_LINE_B, line_b, ifaddr);
+
+	memset(&prev, 0, sizeof(prev));
+
+	start = last = now();
+
+	for (;;) {
+		if (fast_feed_poll(feed, 100) < 0)
+			die("unable to receive");
+
+		t = now();
+		if (t - last < 1.0)
+			continue;
+
+		print_stats(&feed->stats, &prev, t - last);
+
+		prev = feed->stats;
+		last = t;
+
+		if (duration && t - start >= duration)
+			break;
+	}
+
+	fast_feed_free(feed);
+	fast_session_free(session);
+
+	return 0;
+}
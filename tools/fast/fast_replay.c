@@ -0,0 +1,694 @@
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_codec.h"
+#include "libtrading/proto/fast_feed.h"
+
+#include "libtrading/buffer.h"
+#include "libtrading/die.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "test.h"
+
+/* Generated from tools/fast/templates/micex.xml by fast_codegen */
+extern const struct fast_template_codec micex_codecs[];
+extern const unsigned long micex_nr_codecs;
+
+#define	PCAP_MAGIC		0xa1b2c3d4
+#define	PCAP_MAGIC_NS		0xa1b23c4d
+#define	PCAP_HEADER_SIZE	24
+#define	PCAP_RECORD_SIZE	16
+
+#define	LINKTYPE_ETHERNET	1
+#define	LINKTYPE_RAW		101
+#define	LINKTYPE_LINUX_SLL	113
+
+#define	ETH_HEADER_SIZE		14
+#define	SLL_HEADER_SIZE		16
+#define	VLAN_HEADER_SIZE	4
+#define	UDP_HEADER_SIZE		8
+
+#define	ETHERTYPE_IP		0x0800
+#define	ETHERTYPE_VLAN		0x8100
+#define	IPPROTO_UDP_NR		17
+
+static const char	*program;
+
+/* Where the payload of a UDP datagram is in the capture */
+struct replay_packet {
+	unsigned long		offset;
+	unsigned long		len;
+};
+
+struct replay_template {
+	unsigned long		nr_messages;
+	unsigned long		nr_bytes;
+	unsigned long		begin;		/* of its samples once they are sorted */
+};
+
+struct replay_sample {
+	u32			template;
+	u32			ns;
+};
+
+/*
+ * A capture is either a stream of messages, as fast_parser -p raw saves
+ * it, or the UDP datagrams of a pcap file, each a packet of messages that
+ * starts with a sequence number.
+ */
+struct replay {
+	struct fast_session	*session;
+	struct buffer		*capture;
+
+	unsigned long		nr_packets;
+	struct replay_packet	*packets;
+	unsigned long		skip;
+	bool			reset;
+
+	unsigned long		nr_messages;
+	unsigned long		nr_errors;
+};
+
+struct replay_cursor {
+	struct buffer		stream;
+	u64			last_tid;
+
+	unsigned long		next;
+	struct fast_packet	packet;
+
+	/* Size of the last message */
+	unsigned long		size;
+};
+
+static void usage(void)
+{
+	fprintf(stderr, "\n  usage: %s -t [template] -f [capture] [-p] [-s skip] [-r] [-c] [-n iterations] [-g golden] [-w golden]\n\n", program);
+	exit(EXIT_FAILURE);
+}
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static u32 pcap_u32(const char *p, bool swap)
+{
+	u32 v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return swap ? __builtin_bswap32(v) : v;
+}
+
+static u16 get_be16(const u8 *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+/* Finds the UDP payload of a frame, returns -1 if it has none */
+static long frame_payload(const u8 *frame, unsigned long len, u32 linktype, unsigned long *payload_len)
+{
+	unsigned long offset;
+	unsigned long ihl;
+	u16 ethertype;
+	u16 udp_len;
+
+	switch (linktype) {
+	case LINKTYPE_ETHERNET:
+		if (len < ETH_HEADER_SIZE)
+			return -1;
+
+		offset = ETH_HEADER_SIZE;
+		ethertype = get_be16(frame + 12);
+
+		if (ethertype == ETHERTYPE_VLAN) {
+			if (len < offset + VLAN_HEADER_SIZE)
+				return -1;
+
+			ethertype = get_be16(frame + offset + 2);
+			offset += VLAN_HEADER_SIZE;
+		}
+		break;
+	case LINKTYPE_LINUX_SLL:
+		if (len < SLL_HEADER_SIZE)
+			return -1;
+
+		offset = SLL_HEADER_SIZE;
+		ethertype = get_be16(frame + 14);
+		break;
+	case LINKTYPE_RAW:
+		offset = 0;
+		ethertype = ETHERTYPE_IP;
+		break;
+	default:
+		return -1;
+	}
+
+	if (ethertype != ETHERTYPE_IP || len < offset + 20)
+		return -1;
+
+	if ((frame[offset] >> 4) != 4 || frame[offset + 9] != IPPROTO_UDP_NR)
+		return -1;
+
+	/* Fragments would have to be put back together first */
+	if (get_be16(frame + offset + 6) & 0x3fff)
+		return -1;
+
+	ihl = (frame[offset] & 0x0f) * 4;
+	offset += ihl;
+
+	if (len < offset + UDP_HEADER_SIZE)
+		return -1;
+
+	udp_len = get_be16(frame + offset + 4);
+	if (udp_len < UDP_HEADER_SIZE || len < offset + udp_len)
+		return -1;
+
+	*payload_len = udp_len - UDP_HEADER_SIZE;
+
+	return offset + UDP_HEADER_SIZE;
+}
+
+/* Lists the packets of a pcap capture, frames that are not UDP are left out */
+static void pcap_index(struct replay *self, const char *filename)
+{
+	const char *data = self->capture->data;
+	unsigned long size = buffer_size(self->capture);
+	unsigned long max_packets = 0;
+	unsigned long payload_len;
+	unsigned long offset;
+	unsigned long caplen;
+	u32 linktype;
+	long payload;
+	bool swap;
+	u32 magic;
+
+	if (size < PCAP_HEADER_SIZE)
+		die("%s: not a pcap file", filename);
+
+	memcpy(&magic, data, sizeof(magic));
+
+	if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NS)
+		swap = false;
+	else if (__builtin_bswap32(magic) == PCAP_MAGIC || __builtin_bswap32(magic) == PCAP_MAGIC_NS)
+		swap = true;
+	else
+		die("%s: not a pcap file", filename);
+
+	linktype = pcap_u32(data + 20, swap);
+
+	for (offset = PCAP_HEADER_SIZE; offset + PCAP_RECORD_SIZE <= size; offset += caplen) {
+		caplen = pcap_u32(data + offset + 8, swap);
+		offset += PCAP_RECORD_SIZE;
+
+		if (offset + caplen > size)
+			die("%s: truncated at %lu", filename, offset);
+
+		payload = frame_payload((const u8 *) data + offset, caplen, linktype, &payload_len);
+		if (payload < 0 || payload_len < self->skip)
+			continue;
+
+		if (self->nr_packets == max_packets) {
+			max_packets = max_packets ? 2 * max_packets : 1024;
+
+			self->packets = realloc(self->packets, max_packets * sizeof(struct replay_packet));
+			if (!self->packets)
+				die("unable to allocate memory");
+		}
+
+		self->packets[self->nr_packets++] = (struct replay_packet) {
+			.offset		= offset + payload + self->skip,
+			.len		= payload_len - self->skip,
+		};
+	}
+
+	if (!self->nr_packets)
+		die("%s: no UDP packets", filename);
+}
+
+static void replay_begin(struct replay *self, struct replay_cursor *cur)
+{
+	memset(cur, 0, sizeof(*cur));
+
+	cur->stream = *self->capture;
+
+	fast_session_reset(self->session);
+}
+
+/*
+ * Decodes the next message of the capture. Returns 0 and the message, 1
+ * at the end of the capture or the error. Like the feed, a packet that
+ * fails to decode is dropped and the dictionaries are reset.
+ */
+static inline int replay_next(struct replay *self, struct replay_cursor *cur, struct fast_message **msg)
+{
+	struct fast_session *session = self->session;
+	struct replay_packet *pkt;
+	unsigned long start;
+	int ret;
+
+	if (!self->nr_packets) {
+		if (!buffer_size(&cur->stream))
+			return 1;
+
+		start = cur->stream.start;
+
+		*msg = fast_message_decode(&session->rx_map, &cur->stream, cur->last_tid);
+		if (!*msg)
+			return FAST_MSG_STATE_GARBLED;
+
+		cur->last_tid = (*msg)->tid;
+		cur->size = cur->stream.start - start;
+
+		return 0;
+	}
+
+	while (fast_packet_empty(&cur->packet)) {
+		if (cur->next == self->nr_packets)
+			return 1;
+
+		pkt = self->packets + cur->next++;
+
+		fast_packet_init(&cur->packet, self->capture->data + pkt->offset, pkt->len);
+
+		if (self->reset)
+			fast_session_reset(session);
+	}
+
+	start = cur->packet.offset;
+
+	ret = fast_packet_decode(&session->rx_map, &cur->packet, msg);
+	if (ret) {
+		cur->packet.offset = cur->packet.len;
+		fast_session_reset(session);
+
+		return ret;
+	}
+
+	cur->size = cur->packet.offset - start;
+
+	return 0;
+}
+
+static void replay_error(struct replay *self, struct replay_cursor *cur, unsigned long nr_messages)
+{
+	if (!self->nr_packets)
+		die("unable to decode message %lu at offset %lu", nr_messages, cur->stream.start);
+
+	self->nr_errors++;
+}
+
+static void replay_message(struct replay *self, struct fast_message *msg)
+{
+	if (fast_msg_has_flags(msg, FAST_MSG_FLAGS_RESET))
+		fast_session_reset(self->session);
+}
+
+/* Decodes the capture once, as fast as it goes */
+static unsigned long replay(struct replay *self)
+{
+	unsigned long nr_messages = 0;
+	struct replay_cursor cur;
+	struct fast_message *msg;
+	int ret;
+
+	replay_begin(self, &cur);
+
+	while ((ret = replay_next(self, &cur, &msg)) != 1) {
+		if (ret) {
+			replay_error(self, &cur, nr_messages);
+			continue;
+		}
+
+		replay_message(self, msg);
+		nr_messages++;
+	}
+
+	return nr_messages;
+}
+
+/* Sequences take a line an element, so messages are compared line by line */
+static void golden_check(FILE *golden, const char *filename, const char *actual, unsigned long nr_message)
+{
+	char expected[FAST_MAX_LINE_LENGTH + 64];
+	const char *end;
+	size_t len;
+
+	for (; *actual; actual = end) {
+		end = strchr(actual, '\n') + 1;
+		len = end - actual;
+
+		if (!fgets(expected, sizeof(expected), golden))
+			die("%s: ends in message %lu", filename, nr_message);
+
+		if (strlen(expected) != len || memcmp(expected, actual, len))
+			die("message %lu differs from %s:\n  expected %s  actual   %.*s", nr_message, filename, expected, (int) len, actual);
+	}
+}
+
+/*
+ * Decodes the capture once and prints every message the way fast_parser
+ * does to golden, or checks that it is printed as it is in golden.
+ */
+static void replay_golden(struct replay *self, const char *filename, bool write)
+{
+	char expected[FAST_MAX_LINE_LENGTH + 64];
+	char actual[FAST_MAX_LINE_LENGTH + 64];
+	unsigned long nr_messages = 0;
+	struct replay_cursor cur;
+	struct fast_message *msg;
+	unsigned long len;
+	FILE *golden;
+	int ret;
+
+	golden = fopen(filename, write ? "w" : "r");
+	if (!golden)
+		die("%s: unable to open", filename);
+
+	replay_begin(self, &cur);
+
+	while ((ret = replay_next(self, &cur, &msg)) != 1) {
+		if (ret) {
+			replay_error(self, &cur, nr_messages);
+			continue;
+		}
+
+		if (fast_msg_has_flags(msg, FAST_MSG_FLAGS_RESET)) {
+			len = snprintf(actual, sizeof(actual), "< tid = %lu: reset\n", msg->tid);
+		} else {
+			len = snprintf(actual, sizeof(actual), "< tid = %lu:\n", msg->tid);
+			len += snprintmsg(actual + len, sizeof(actual) - len - 1, msg);
+
+			if (len >= sizeof(actual) - 1)
+				die("message %lu is too long to print", nr_messages);
+
+			actual[len++] = '\n';
+			actual[len] = '\0';
+		}
+
+		replay_message(self, msg);
+
+		if (write)
+			fputs(actual, golden);
+		else
+			golden_check(golden, filename, actual, nr_messages);
+
+		nr_messages++;
+	}
+
+	if (!write && fgets(expected, sizeof(expected), golden))
+		die("%s: has more than %lu messages", filename, nr_messages);
+
+	fclose(golden);
+
+	printf("  golden: %lu messages %s %s\n", nr_messages, write ? "written to" : "match", filename);
+}
+
+static int sample_cmp(const void *a, const void *b)
+{
+	const struct replay_sample *x = a;
+	const struct replay_sample *y = b;
+
+	if (x->template != y->template)
+		return x->template < y->template ? -1 : 1;
+
+	if (x->ns != y->ns)
+		return x->ns < y->ns ? -1 : 1;
+
+	return 0;
+}
+
+static int ns_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *) a;
+	u32 y = *(const u32 *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Nearest rank */
+static u32 percentile(const u32 *sorted, unsigned long nr, double p)
+{
+	unsigned long rank = p * nr;
+
+	if (rank >= nr)
+		rank = nr - 1;
+
+	return sorted[rank];
+}
+
+static u32 sample_percentile(const struct replay_sample *sorted, unsigned long nr, double p)
+{
+	unsigned long rank = p * nr;
+
+	if (rank >= nr)
+		rank = nr - 1;
+
+	return sorted[rank].ns;
+}
+
+/* The cost of reading the clock, which every sample includes */
+static u32 timer_overhead(void)
+{
+	u32 min = UINT32_MAX;
+	u64 t0, t1;
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		t0 = now_ns();
+		t1 = now_ns();
+
+		if (t1 - t0 < min)
+			min = t1 - t0;
+	}
+
+	return min;
+}
+
+/*
+ * Times every message of one more pass on its own. The pass comes after
+ * the others so that the caches and branch predictors are as warm as they
+ * are in a feed handler that keeps up.
+ */
+static void replay_latency(struct replay *self)
+{
+	struct fast_session *session = self->session;
+	struct replay_template *templates;
+	struct replay_sample *samples;
+	unsigned long nr_samples = 0;
+	struct replay_template *tmpl;
+	struct replay_cursor cur;
+	struct fast_message *msg;
+	unsigned long i;
+	u64 t0, t1;
+	u32 *ns;
+	int ret;
+
+	templates = calloc(session->nr_messages, sizeof(struct replay_template));
+	samples = calloc(self->nr_messages, sizeof(struct replay_sample));
+	ns = calloc(self->nr_messages, sizeof(u32));
+	if (!templates || !samples || !ns)
+		die("unable to allocate memory");
+
+	replay_begin(self, &cur);
+
+	for (;;) {
+		t0 = now_ns();
+		ret = replay_next(self, &cur, &msg);
+		t1 = now_ns();
+
+		if (ret == 1 || nr_samples == self->nr_messages)
+			break;
+
+		if (ret) {
+			replay_error(self, &cur, nr_samples);
+			continue;
+		}
+
+		replay_message(self, msg);
+
+		samples[nr_samples] = (struct replay_sample) {
+			.template	= msg - session->rx_messages,
+			.ns		= t1 - t0,
+		};
+
+		ns[nr_samples++] = t1 - t0;
+
+		tmpl = templates + (msg - session->rx_messages);
+		tmpl->nr_messages++;
+		tmpl->nr_bytes += cur.size;
+	}
+
+	if (!nr_samples)
+		die("no messages decoded");
+
+	qsort(ns, nr_samples, sizeof(u32), ns_cmp);
+	qsort(samples, nr_samples, sizeof(struct replay_sample), sample_cmp);
+
+	printf("  latency: p50 %" PRIu32 " ns, p90 %" PRIu32 " ns, p99 %" PRIu32 " ns, p99.9 %" PRIu32 " ns, max %" PRIu32 " ns (timer %" PRIu32 " ns)\n",
+		percentile(ns, nr_samples, 0.50), percentile(ns, nr_samples, 0.90),
+		percentile(ns, nr_samples, 0.99), percentile(ns, nr_samples, 0.999),
+		ns[nr_samples - 1], timer_overhead());
+
+	printf("  %10s %10s %7s %10s %8s %8s %8s\n", "tid", "messages", "share", "bytes/msg", "p50 ns", "p99 ns", "max ns");
+
+	for (i = 0, nr_samples = 0; i < session->nr_messages; i++) {
+		tmpl = templates + i;
+		if (!tmpl->nr_messages)
+			continue;
+
+		tmpl->begin = nr_samples;
+		nr_samples += tmpl->nr_messages;
+
+		printf("  %10lu %10lu %6.1lf%% %10.1lf %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "\n",
+			session->rx_messages[i].tid, tmpl->nr_messages,
+			100.0 * tmpl->nr_messages / self->nr_messages,
+			(double) tmpl->nr_bytes / tmpl->nr_messages,
+			sample_percentile(samples + tmpl->begin, tmpl->nr_messages, 0.50),
+			sample_percentile(samples + tmpl->begin, tmpl->nr_messages, 0.99),
+			samples[tmpl->begin + tmpl->nr_messages - 1].ns);
+	}
+
+	free(ns);
+	free(samples);
+	free(templates);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long nr_iterations = 20;
+	unsigned long nr_messages = 0;
+	const char *golden = NULL;
+	const char *input = NULL;
+	const char *xml = NULL;
+	bool write_golden = false;
+	bool compile = false;
+	struct replay self;
+	unsigned long nr;
+	struct stat st;
+	bool pcap = false;
+	long skip = -1;
+	unsigned long i;
+	u64 t0, t1;
+	int opt;
+	int fd;
+
+	program = basename(argv[0]);
+
+	memset(&self, 0, sizeof(self));
+
+	while ((opt = getopt(argc, argv, "t:f:ps:rcn:g:w:")) != -1) {
+		switch (opt) {
+		case 't':
+			xml = optarg;
+			break;
+		case 'f':
+			input = optarg;
+			break;
+		case 'p':
+			pcap = true;
+			break;
+		case 's':
+			skip = strtol(optarg, NULL, 10);
+			break;
+		case 'r':
+			self.reset = true;
+			break;
+		case 'c':
+			compile = true;
+			break;
+		case 'n':
+			nr_iterations = strtoul(optarg, NULL, 10);
+			break;
+		case 'g':
+			golden = optarg;
+			write_golden = false;
+			break;
+		case 'w':
+			golden = optarg;
+			write_golden = true;
+			break;
+		default: /* '?' */
+			usage();
+		}
+	}
+
+	if (!xml || !input || !nr_iterations || (!pcap && (skip >= 0 || self.reset)))
+		usage();
+
+	/* Packets of a feed start with their sequence number */
+	self.skip = skip >= 0 ? skip : FAST_FEED_SEQ_SIZE;
+
+	self.session = fast_session_new(-1);
+	if (!self.session)
+		die("unable to allocate memory");
+
+	if (fast_micex_template(self.session, xml))
+		die("%s: cannot read template xml file", xml);
+
+	fd = open(input, O_RDONLY);
+	if (fd < 0)
+		die("%s: unable to open", input);
+
+	if (fstat(fd, &st) < 0 || !st.st_size)
+		die("%s: empty", input);
+
+	self.capture = buffer_mmap(fd, st.st_size);
+	if (!self.capture)
+		die("%s: unable to map", input);
+
+	close(fd);
+
+	if (pcap)
+		pcap_index(&self, input);
+
+	if (compile) {
+		nr = fast_session_attach(self.session, micex_codecs, micex_nr_codecs);
+
+		printf("%lu of %d templates compiled\n", nr, self.session->nr_messages);
+	}
+
+	if (golden)
+		replay_golden(&self, golden, write_golden);
+
+	/* Warms up and counts the messages */
+	self.nr_messages = replay(&self);
+	self.nr_errors = 0;
+
+	if (pcap)
+		printf("%s: %lu messages in %lu packets, %lu bytes, %lu iterations\n", input, self.nr_messages, self.nr_packets, (unsigned long) st.st_size, nr_iterations);
+	else
+		printf("%s: %lu messages, %lu bytes, %lu iterations\n", input, self.nr_messages, (unsigned long) st.st_size, nr_iterations);
+
+	t0 = now_ns();
+
+	for (i = 0; i < nr_iterations; i++)
+		nr_messages += replay(&self);
+
+	t1 = now_ns();
+
+	printf("  decode: %.2lf M msgs/s, %.1lf ns/message, %.1lf MB/s, %lu errors\n",
+		1000.0 * nr_messages / (t1 - t0), (double) (t1 - t0) / nr_messages,
+		1000.0 * st.st_size * nr_iterations / (t1 - t0), self.nr_errors / nr_iterations);
+
+	replay_latency(&self);
+
+	buffer_munmap(self.capture);
+	free(self.packets);
+	fast_session_free(self.session);
+
+	return 0;
+}
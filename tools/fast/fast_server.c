@@ -1,3 +1,4 @@
+#include "libtrading/proto/fast_publisher.h"
 #include "libtrading/proto/fast_message.h"
 #include "libtrading/proto/fast_session.h"
 
@@ -17,6 +18,9 @@
 
 #include "test.h"
 
+/* Pack the messages into packets of this size, or send them one by one if zero */
+static unsigned long packet_size;
+
 struct protocol_info {
 	const char		*name;
 	int			(*session_accept)(int incoming_fd, const char *xml, const char *script);
@@ -48,7 +52,7 @@ static void fast_send_prepare(struct fast_message *msg, struct felem *elem)
 			field->uint_value = elem_field->uint_value;
 			break;
 		case FAST_TYPE_STRING:
-			memcpy(field->string_value, elem_field->string_value, strlen(elem_field->string_value) + 1);
+			field_copy_string(field, elem_field);
 			break;
 		case FAST_TYPE_DECIMAL:
 			field->decimal_value.exp = elem_field->decimal_value.exp;
@@ -67,6 +71,7 @@ exit:
 
 static int fast_session_accept(int incoming_fd, const char *xml, const char *script)
 {
+	struct fast_publisher *publisher = NULL;
 	struct fcontainer *container = NULL;
 	struct fast_session *session = NULL;
 	struct felem *expected_elem;
@@ -97,6 +102,14 @@ static int fast_session_accept(int incoming_fd, const char *xml, const char *scr
 		goto exit;
 	}
 
+	if (packet_size) {
+		publisher = fast_publisher_new(session, packet_size);
+		if (!publisher) {
+			fprintf(stderr, "FAST publisher cannot be created\n");
+			goto exit;
+		}
+	}
+
 	fcontainer_init(container, session->rx_messages);
 
 	if (script_read(stream, container)) {
@@ -112,15 +125,22 @@ static int fast_session_accept(int incoming_fd, const char *xml, const char *scr
 	while (expected_elem) {
 		fast_send_prepare(msg, expected_elem);
 
-		if (fast_session_send(session, msg, 0))
+		if (publisher) {
+			if (fast_publisher_add(publisher, msg))
+				goto exit;
+		} else if (fast_session_send(session, msg, 0))
 			goto exit;
 
 		expected_elem = next_elem(container);
 	}
 
+	if (publisher && fast_publisher_flush(publisher))
+		goto exit;
+
 	ret = 0;
 
 exit:
+	fast_publisher_free(publisher);
 	fcontainer_free(container);
 	fast_session_free(session);
 	fclose(stream);
@@ -147,7 +167,7 @@ static const struct protocol_info *lookup_protocol_info(const char *name)
 
 static void usage(void)
 {
-	printf("\n  usage: trade server -p [port] -c [protocol] -t [template] -f [filename]\n\n");
+	printf("\n  usage: trade server -p [port] -c [protocol] -t [template] -f [filename] [-s packet size]\n\n");
 }
 
 static int socket_setopt(int sockfd, int level, int optname, int optval)
@@ -168,7 +188,7 @@ int main(int argc, char *argv[])
 	int opt;
 	int ret;
 
-	while ((opt = getopt(argc, argv, "p:c:f:t:")) != -1) {
+	while ((opt = getopt(argc, argv, "p:c:f:t:s:")) != -1) {
 		switch (opt) {
 		case 'p':
 			port = atoi(optarg);
@@ -182,6 +202,9 @@ int main(int argc, char *argv[])
 		case 't':
 			xml = optarg;
 			break;
+		case 's':
+			packet_size = strtoul(optarg, NULL, 10);
+			break;
 		default: /* '?' */
 			usage();
 			exit(EXIT_FAILURE);
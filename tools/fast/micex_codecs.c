@@ -0,0 +1,1797 @@
+/* Generated by fast_codegen from tools/fast/templates/micex.xml, do not edit */
+
+#include "libtrading/proto/fast_codec.h"
+
+#include <string.h>
+
+static int micex_6_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	int ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	return 0;
+}
+
+static int micex_6_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	int ret;
+
+	ret = fast_visit_string(msg, 0, fields + 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 1, fields + 1);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 2, fields + 2);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 3, fields + 3);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 4, fields + 4);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int micex_6_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+
+	if (fast_encode_string(buffer, pmap, fields + 0, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 1, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 2, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 3, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 4, FAST_OP_NONE, true, 0))
+		return -1;
+
+	return 0;
+}
+
+static int micex_7_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	int ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_get_string(buffer, fields[5].string_buf, fields[5].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[5].state = FAST_STATE_ASSIGNED;
+	fields[5].string_value = fields[5].string_buf;
+
+	if (unlikely(!fields[5].string_buf[0])) {
+		ret -= 1;
+
+		fields[5].string_buf[ret] = '\0';
+	}
+
+	fields[5].string_len = ret;
+
+	ret = fast_get_string(buffer, fields[6].string_buf, fields[6].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[6].state = FAST_STATE_ASSIGNED;
+	fields[6].string_value = fields[6].string_buf;
+
+	if (unlikely(!fields[6].string_buf[0])) {
+		if (ret > 1)
+			ret -= 2;
+		else {
+			fields[6].state = FAST_STATE_EMPTY;
+			ret = 0;
+		}
+
+		fields[6].string_buf[ret] = '\0';
+	}
+
+	fields[6].string_len = ret;
+
+	ret = fast_get_int(buffer, &fields[7].int_value);
+	if (ret)
+		return ret;
+
+	fields[7].state = FAST_STATE_ASSIGNED;
+
+	if (!fields[7].int_value)
+		fields[7].state = FAST_STATE_EMPTY;
+	else if (fields[7].int_value > 0)
+		fields[7].int_value--;
+
+	ret = fast_get_uint(buffer, &fields[8].uint_value);
+	if (ret)
+		return ret;
+
+	fields[8].state = FAST_STATE_ASSIGNED;
+
+	if (!fields[8].uint_value)
+		fields[8].state = FAST_STATE_EMPTY;
+	else
+		fields[8].uint_value--;
+
+	return 0;
+}
+
+static int micex_7_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	int ret;
+
+	ret = fast_visit_string(msg, 0, fields + 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 1, fields + 1);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 2, fields + 2);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 3, fields + 3);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 4, fields + 4);
+	if (ret)
+		return ret;
+
+	ret = fast_get_string(buffer, fields[5].string_buf, fields[5].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[5].state = FAST_STATE_ASSIGNED;
+	fields[5].string_value = fields[5].string_buf;
+
+	if (unlikely(!fields[5].string_buf[0])) {
+		ret -= 1;
+
+		fields[5].string_buf[ret] = '\0';
+	}
+
+	fields[5].string_len = ret;
+
+	ret = fast_visit_string(msg, 5, fields + 5);
+	if (ret)
+		return ret;
+
+	ret = fast_get_string(buffer, fields[6].string_buf, fields[6].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[6].state = FAST_STATE_ASSIGNED;
+	fields[6].string_value = fields[6].string_buf;
+
+	if (unlikely(!fields[6].string_buf[0])) {
+		if (ret > 1)
+			ret -= 2;
+		else {
+			fields[6].state = FAST_STATE_EMPTY;
+			ret = 0;
+		}
+
+		fields[6].string_buf[ret] = '\0';
+	}
+
+	fields[6].string_len = ret;
+
+	ret = fast_visit_string(msg, 6, fields + 6);
+	if (ret)
+		return ret;
+
+	ret = fast_get_int(buffer, &fields[7].int_value);
+	if (ret)
+		return ret;
+
+	fields[7].state = FAST_STATE_ASSIGNED;
+
+	if (!fields[7].int_value)
+		fields[7].state = FAST_STATE_EMPTY;
+	else if (fields[7].int_value > 0)
+		fields[7].int_value--;
+
+	ret = fast_visit_int(msg, 7, fields + 7);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[8].uint_value);
+	if (ret)
+		return ret;
+
+	fields[8].state = FAST_STATE_ASSIGNED;
+
+	if (!fields[8].uint_value)
+		fields[8].state = FAST_STATE_EMPTY;
+	else
+		fields[8].uint_value--;
+
+	ret = fast_visit_uint(msg, 8, fields + 8);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int micex_7_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+
+	if (fast_encode_string(buffer, pmap, fields + 0, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 1, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 2, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 3, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 4, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 5, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 6, FAST_OP_NONE, false, 0))
+		return -1;
+
+	if (fast_encode_int(buffer, pmap, fields + 7, FAST_OP_NONE, false, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 8, FAST_OP_NONE, false, 0))
+		return -1;
+
+	return 0;
+}
+
+static int micex_3_seq5_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_sequence *seq = msg->fields[5].ptr_value;
+	struct fast_field *fields = seq->element.fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	struct fast_pmap spmap;
+	struct fast_field *cur;
+	unsigned long i;
+	int ret;
+
+	ret = fast_get_uint(buffer, &seq->length.uint_value);
+	if (ret)
+		return ret;
+
+	seq->length.state = FAST_STATE_ASSIGNED;
+
+	if (field_state_empty(&seq->length))
+		return FAST_MSG_STATE_GARBLED;
+
+	if (fast_sequence_reserve(seq, seq->length.uint_value))
+		return FAST_MSG_STATE_GARBLED;
+
+	spmap.nr_bytes = 0;
+
+	for (i = 0; i < seq->length.uint_value; i++) {
+		cur = fast_sequence_element(seq, i);
+
+		ret = fast_get_pmap(buffer, &spmap);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x40)) {
+			ret = fast_get_uint(buffer, &fields[0].uint_value);
+			if (ret)
+				return ret;
+
+			fields[0].state = FAST_STATE_ASSIGNED;
+
+			fast_dict_store(dict, &fields[0]);
+		} else {
+			fast_dict_load(dict, &fields[0]);
+
+			if (fields[0].state == FAST_STATE_UNDEFINED) {
+				return FAST_MSG_STATE_GARBLED;
+			} else if (fields[0].state == FAST_STATE_EMPTY) {
+				return FAST_MSG_STATE_GARBLED;
+			}
+		}
+
+		cur[0].uint_value = fields[0].uint_value;
+		cur[0].state = fields[0].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x20)) {
+			ret = fast_get_string(buffer, fields[1].string_buf, fields[1].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[1].state = FAST_STATE_ASSIGNED;
+			fields[1].string_value = fields[1].string_buf;
+
+			if (unlikely(!fields[1].string_buf[0])) {
+				ret -= 1;
+
+				fields[1].string_buf[ret] = '\0';
+			}
+
+			fields[1].string_len = ret;
+
+			fast_dict_store(dict, &fields[1]);
+		} else {
+			ret = fast_dict_load(dict, &fields[1]);
+			if (ret)
+				return ret;
+
+			if (fields[1].state == FAST_STATE_UNDEFINED) {
+				ret = fast_read_reset(&fields[1], true);
+				if (ret)
+					return ret;
+			} else if (fields[1].state == FAST_STATE_EMPTY) {
+				return FAST_MSG_STATE_GARBLED;
+			}
+		}
+
+		field_copy_string(cur + 1, fields + 1);
+		cur[1].state = fields[1].state;
+
+		ret = fast_get_string(buffer, fields[2].string_buf, fields[2].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[2].state = FAST_STATE_ASSIGNED;
+		fields[2].string_value = fields[2].string_buf;
+
+		if (unlikely(!fields[2].string_buf[0])) {
+			if (ret > 1)
+				ret -= 2;
+			else {
+				fields[2].state = FAST_STATE_EMPTY;
+				ret = 0;
+			}
+
+			fields[2].string_buf[ret] = '\0';
+		}
+
+		fields[2].string_len = ret;
+
+		field_copy_string(cur + 2, fields + 2);
+		cur[2].state = fields[2].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x10)) {
+			ret = fast_get_string(buffer, fields[3].string_buf, fields[3].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[3].state = FAST_STATE_ASSIGNED;
+			fields[3].string_value = fields[3].string_buf;
+
+			if (unlikely(!fields[3].string_buf[0])) {
+				if (ret > 1)
+					ret -= 2;
+				else {
+					fields[3].state = FAST_STATE_EMPTY;
+					ret = 0;
+				}
+
+				fields[3].string_buf[ret] = '\0';
+			}
+
+			fields[3].string_len = ret;
+
+			fast_dict_store(dict, &fields[3]);
+		} else {
+			ret = fast_dict_load(dict, &fields[3]);
+			if (ret)
+				return ret;
+
+			if (fields[3].state == FAST_STATE_UNDEFINED) {
+				ret = fast_read_reset(&fields[3], false);
+				if (ret)
+					return ret;
+
+				fast_dict_store(dict, &fields[3]);
+			}
+		}
+
+		field_copy_string(cur + 3, fields + 3);
+		cur[3].state = fields[3].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x08)) {
+			ret = fast_get_int(buffer, &fields[4].int_value);
+			if (ret)
+				return ret;
+
+			fields[4].state = FAST_STATE_ASSIGNED;
+
+			if (!fields[4].int_value)
+				fields[4].state = FAST_STATE_EMPTY;
+			else if (fields[4].int_value > 0)
+				fields[4].int_value--;
+
+			fast_dict_store(dict, &fields[4]);
+		} else {
+			fast_dict_load(dict, &fields[4]);
+
+			if (fields[4].state == FAST_STATE_ASSIGNED) {
+				fields[4].int_value++;
+				fast_dict_store(dict, &fields[4]);
+			} else if (fields[4].state == FAST_STATE_UNDEFINED) {
+				fields[4].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[4]);
+			}
+		}
+
+		cur[4].int_value = fields[4].int_value;
+		cur[4].state = fields[4].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x04)) {
+			ret = fast_get_uint(buffer, &fields[5].uint_value);
+			if (ret)
+				return ret;
+
+			fields[5].state = FAST_STATE_ASSIGNED;
+
+			if (!fields[5].uint_value)
+				fields[5].state = FAST_STATE_EMPTY;
+			else
+				fields[5].uint_value--;
+
+			fast_dict_store(dict, &fields[5]);
+		} else {
+			fast_dict_load(dict, &fields[5]);
+
+			if (fields[5].state == FAST_STATE_UNDEFINED) {
+				fields[5].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[5]);
+			}
+		}
+
+		cur[5].uint_value = fields[5].uint_value;
+		cur[5].state = fields[5].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x02)) {
+			ret = fast_decode_decimal(buffer, &spmap, &fields[6], FAST_OP_NONE, false, 0);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[6]);
+		} else {
+			fast_dict_load(dict, &fields[6]);
+
+			if (fields[6].state == FAST_STATE_UNDEFINED) {
+				fields[6].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[6]);
+			}
+		}
+
+		cur[6].decimal_value = fields[6].decimal_value;
+		cur[6].state = fields[6].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x01)) {
+			ret = fast_decode_decimal(buffer, &spmap, &fields[7], FAST_OP_NONE, false, 0);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[7]);
+		} else {
+			fast_dict_load(dict, &fields[7]);
+
+			if (fields[7].state == FAST_STATE_UNDEFINED) {
+				fields[7].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[7]);
+			}
+		}
+
+		cur[7].decimal_value = fields[7].decimal_value;
+		cur[7].state = fields[7].state;
+
+		if (spmap.nr_bytes > 1 && (spmap.bytes[1] & 0x40)) {
+			ret = fast_get_string(buffer, fields[8].string_buf, fields[8].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[8].state = FAST_STATE_ASSIGNED;
+			fields[8].string_value = fields[8].string_buf;
+
+			if (unlikely(!fields[8].string_buf[0])) {
+				if (ret > 1)
+					ret -= 2;
+				else {
+					fields[8].state = FAST_STATE_EMPTY;
+					ret = 0;
+				}
+
+				fields[8].string_buf[ret] = '\0';
+			}
+
+			fields[8].string_len = ret;
+
+			fast_dict_store(dict, &fields[8]);
+		} else {
+			ret = fast_dict_load(dict, &fields[8]);
+			if (ret)
+				return ret;
+
+			if (fields[8].state == FAST_STATE_UNDEFINED) {
+				ret = fast_read_reset(&fields[8], false);
+				if (ret)
+					return ret;
+
+				fast_dict_store(dict, &fields[8]);
+			}
+		}
+
+		field_copy_string(cur + 8, fields + 8);
+		cur[8].state = fields[8].state;
+	}
+
+	return 0;
+}
+
+static int micex_3_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	int ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = micex_3_seq5_decode(buffer, pmap, msg);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int micex_3_seq5_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_sequence *seq = msg->fields[5].ptr_value;
+	struct fast_field *fields = seq->element.fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	struct fast_pmap spmap;
+	unsigned long i;
+	int ret;
+
+	ret = fast_get_uint(buffer, &seq->length.uint_value);
+	if (ret)
+		return ret;
+
+	seq->length.state = FAST_STATE_ASSIGNED;
+
+	if (field_state_empty(&seq->length))
+		return FAST_MSG_STATE_GARBLED;
+
+	ret = fast_visit_sequence_begin(msg, 5, seq->length.uint_value);
+	if (ret)
+		return ret;
+
+	spmap.nr_bytes = 0;
+
+	for (i = 0; i < seq->length.uint_value; i++) {
+		ret = fast_get_pmap(buffer, &spmap);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x40)) {
+			ret = fast_get_uint(buffer, &fields[0].uint_value);
+			if (ret)
+				return ret;
+
+			fields[0].state = FAST_STATE_ASSIGNED;
+
+			fast_dict_store(dict, &fields[0]);
+		} else {
+			fast_dict_load(dict, &fields[0]);
+
+			if (fields[0].state == FAST_STATE_UNDEFINED) {
+				return FAST_MSG_STATE_GARBLED;
+			} else if (fields[0].state == FAST_STATE_EMPTY) {
+				return FAST_MSG_STATE_GARBLED;
+			}
+		}
+
+		ret = fast_visit_uint(msg, 0, fields + 0);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x20)) {
+			ret = fast_get_string(buffer, fields[1].string_buf, fields[1].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[1].state = FAST_STATE_ASSIGNED;
+			fields[1].string_value = fields[1].string_buf;
+
+			if (unlikely(!fields[1].string_buf[0])) {
+				ret -= 1;
+
+				fields[1].string_buf[ret] = '\0';
+			}
+
+			fields[1].string_len = ret;
+
+			fast_dict_store(dict, &fields[1]);
+		} else {
+			ret = fast_dict_load(dict, &fields[1]);
+			if (ret)
+				return ret;
+
+			if (fields[1].state == FAST_STATE_UNDEFINED) {
+				ret = fast_read_reset(&fields[1], true);
+				if (ret)
+					return ret;
+			} else if (fields[1].state == FAST_STATE_EMPTY) {
+				return FAST_MSG_STATE_GARBLED;
+			}
+		}
+
+		ret = fast_visit_string(msg, 1, fields + 1);
+		if (ret)
+			return ret;
+
+		ret = fast_get_string(buffer, fields[2].string_buf, fields[2].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[2].state = FAST_STATE_ASSIGNED;
+		fields[2].string_value = fields[2].string_buf;
+
+		if (unlikely(!fields[2].string_buf[0])) {
+			if (ret > 1)
+				ret -= 2;
+			else {
+				fields[2].state = FAST_STATE_EMPTY;
+				ret = 0;
+			}
+
+			fields[2].string_buf[ret] = '\0';
+		}
+
+		fields[2].string_len = ret;
+
+		ret = fast_visit_string(msg, 2, fields + 2);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x10)) {
+			ret = fast_get_string(buffer, fields[3].string_buf, fields[3].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[3].state = FAST_STATE_ASSIGNED;
+			fields[3].string_value = fields[3].string_buf;
+
+			if (unlikely(!fields[3].string_buf[0])) {
+				if (ret > 1)
+					ret -= 2;
+				else {
+					fields[3].state = FAST_STATE_EMPTY;
+					ret = 0;
+				}
+
+				fields[3].string_buf[ret] = '\0';
+			}
+
+			fields[3].string_len = ret;
+
+			fast_dict_store(dict, &fields[3]);
+		} else {
+			ret = fast_dict_load(dict, &fields[3]);
+			if (ret)
+				return ret;
+
+			if (fields[3].state == FAST_STATE_UNDEFINED) {
+				ret = fast_read_reset(&fields[3], false);
+				if (ret)
+					return ret;
+
+				fast_dict_store(dict, &fields[3]);
+			}
+		}
+
+		ret = fast_visit_string(msg, 3, fields + 3);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x08)) {
+			ret = fast_get_int(buffer, &fields[4].int_value);
+			if (ret)
+				return ret;
+
+			fields[4].state = FAST_STATE_ASSIGNED;
+
+			if (!fields[4].int_value)
+				fields[4].state = FAST_STATE_EMPTY;
+			else if (fields[4].int_value > 0)
+				fields[4].int_value--;
+
+			fast_dict_store(dict, &fields[4]);
+		} else {
+			fast_dict_load(dict, &fields[4]);
+
+			if (fields[4].state == FAST_STATE_ASSIGNED) {
+				fields[4].int_value++;
+				fast_dict_store(dict, &fields[4]);
+			} else if (fields[4].state == FAST_STATE_UNDEFINED) {
+				fields[4].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[4]);
+			}
+		}
+
+		ret = fast_visit_int(msg, 4, fields + 4);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x04)) {
+			ret = fast_get_uint(buffer, &fields[5].uint_value);
+			if (ret)
+				return ret;
+
+			fields[5].state = FAST_STATE_ASSIGNED;
+
+			if (!fields[5].uint_value)
+				fields[5].state = FAST_STATE_EMPTY;
+			else
+				fields[5].uint_value--;
+
+			fast_dict_store(dict, &fields[5]);
+		} else {
+			fast_dict_load(dict, &fields[5]);
+
+			if (fields[5].state == FAST_STATE_UNDEFINED) {
+				fields[5].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[5]);
+			}
+		}
+
+		ret = fast_visit_uint(msg, 5, fields + 5);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x02)) {
+			ret = fast_decode_decimal(buffer, &spmap, &fields[6], FAST_OP_NONE, false, 0);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[6]);
+		} else {
+			fast_dict_load(dict, &fields[6]);
+
+			if (fields[6].state == FAST_STATE_UNDEFINED) {
+				fields[6].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[6]);
+			}
+		}
+
+		ret = fast_visit_decimal(msg, 6, fields + 6);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x01)) {
+			ret = fast_decode_decimal(buffer, &spmap, &fields[7], FAST_OP_NONE, false, 0);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[7]);
+		} else {
+			fast_dict_load(dict, &fields[7]);
+
+			if (fields[7].state == FAST_STATE_UNDEFINED) {
+				fields[7].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[7]);
+			}
+		}
+
+		ret = fast_visit_decimal(msg, 7, fields + 7);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 1 && (spmap.bytes[1] & 0x40)) {
+			ret = fast_get_string(buffer, fields[8].string_buf, fields[8].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[8].state = FAST_STATE_ASSIGNED;
+			fields[8].string_value = fields[8].string_buf;
+
+			if (unlikely(!fields[8].string_buf[0])) {
+				if (ret > 1)
+					ret -= 2;
+				else {
+					fields[8].state = FAST_STATE_EMPTY;
+					ret = 0;
+				}
+
+				fields[8].string_buf[ret] = '\0';
+			}
+
+			fields[8].string_len = ret;
+
+			fast_dict_store(dict, &fields[8]);
+		} else {
+			ret = fast_dict_load(dict, &fields[8]);
+			if (ret)
+				return ret;
+
+			if (fields[8].state == FAST_STATE_UNDEFINED) {
+				ret = fast_read_reset(&fields[8], false);
+				if (ret)
+					return ret;
+
+				fast_dict_store(dict, &fields[8]);
+			}
+		}
+
+		ret = fast_visit_string(msg, 8, fields + 8);
+		if (ret)
+			return ret;
+	}
+
+	return fast_visit_sequence_end(msg, 5);
+}
+
+static int micex_3_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	int ret;
+
+	ret = fast_visit_string(msg, 0, fields + 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 1, fields + 1);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 2, fields + 2);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 3, fields + 3);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 4, fields + 4);
+	if (ret)
+		return ret;
+
+	ret = micex_3_seq5_visit(buffer, pmap, msg);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int micex_3_seq5_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_sequence *seq = msg->fields[5].ptr_value;
+	struct fast_field *fields = seq->element.fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	struct fast_pmap spmap;
+	struct fast_field *cur;
+	unsigned long offset;
+	unsigned long i;
+
+	if (fast_encode_uint(buffer, pmap, &seq->length, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (field_state_empty(&seq->length))
+		return -1;
+
+	if (seq->length.uint_value > seq->max_elements)
+		return -1;
+
+	spmap.nr_bytes = 0;
+
+	for (i = 0; i < seq->length.uint_value; i++) {
+		cur = fast_sequence_element(seq, i);
+
+		if (fast_pmap_reserve(buffer, &spmap, &offset))
+			return -1;
+
+		fields[0].uint_value = cur[0].uint_value;
+		fields[0].state = cur[0].state;
+		if (fast_dict_load_previous(dict, fields + 0))
+			return -1;
+		if (fast_encode_uint(buffer, &spmap, fields + 0, FAST_OP_COPY, true, 0))
+			return -1;
+		fast_dict_store_previous(dict, fields + 0);
+
+		field_copy_string(fields + 1, cur + 1);
+		fields[1].state = cur[1].state;
+		if (fast_dict_load_previous(dict, fields + 1))
+			return -1;
+		if (fast_encode_string(buffer, &spmap, fields + 1, FAST_OP_COPY, true, 1))
+			return -1;
+		fast_dict_store_previous(dict, fields + 1);
+
+		field_copy_string(fields + 2, cur + 2);
+		fields[2].state = cur[2].state;
+		if (fast_encode_string(buffer, &spmap, fields + 2, FAST_OP_NONE, false, 0))
+			return -1;
+
+		field_copy_string(fields + 3, cur + 3);
+		fields[3].state = cur[3].state;
+		if (fast_dict_load_previous(dict, fields + 3))
+			return -1;
+		if (fast_encode_string(buffer, &spmap, fields + 3, FAST_OP_COPY, false, 2))
+			return -1;
+		fast_dict_store_previous(dict, fields + 3);
+
+		fields[4].int_value = cur[4].int_value;
+		fields[4].state = cur[4].state;
+		if (fast_dict_load_previous(dict, fields + 4))
+			return -1;
+		if (fast_encode_int(buffer, &spmap, fields + 4, FAST_OP_INCR, false, 3))
+			return -1;
+		fast_dict_store_previous(dict, fields + 4);
+
+		fields[5].uint_value = cur[5].uint_value;
+		fields[5].state = cur[5].state;
+		if (fast_dict_load_previous(dict, fields + 5))
+			return -1;
+		if (fast_encode_uint(buffer, &spmap, fields + 5, FAST_OP_COPY, false, 4))
+			return -1;
+		fast_dict_store_previous(dict, fields + 5);
+
+		fields[6].decimal_value = cur[6].decimal_value;
+		fields[6].state = cur[6].state;
+		if (fast_dict_load_previous(dict, fields + 6))
+			return -1;
+		if (fast_encode_decimal(buffer, &spmap, fields + 6, FAST_OP_COPY, false, 5))
+			return -1;
+		fast_dict_store_previous(dict, fields + 6);
+
+		fields[7].decimal_value = cur[7].decimal_value;
+		fields[7].state = cur[7].state;
+		if (fast_dict_load_previous(dict, fields + 7))
+			return -1;
+		if (fast_encode_decimal(buffer, &spmap, fields + 7, FAST_OP_COPY, false, 6))
+			return -1;
+		fast_dict_store_previous(dict, fields + 7);
+
+		field_copy_string(fields + 8, cur + 8);
+		fields[8].state = cur[8].state;
+		if (fast_dict_load_previous(dict, fields + 8))
+			return -1;
+		if (fast_encode_string(buffer, &spmap, fields + 8, FAST_OP_COPY, false, 7))
+			return -1;
+		fast_dict_store_previous(dict, fields + 8);
+
+		fast_pmap_commit(buffer, &spmap, offset);
+	}
+
+	return 0;
+}
+
+static int micex_3_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+
+	if (fast_encode_string(buffer, pmap, fields + 0, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 1, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 2, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 3, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 4, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (micex_3_seq5_encode(buffer, pmap, msg))
+		return -1;
+
+	return 0;
+}
+
+static int micex_4_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	int ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x20)) {
+		ret = fast_get_uint(buffer, &fields[5].uint_value);
+		if (ret)
+			return ret;
+
+		fields[5].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[5]);
+	} else {
+		fast_dict_load(dict, &fields[5]);
+
+		if (fields[5].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[5].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x10)) {
+		ret = fast_get_string(buffer, fields[6].string_buf, fields[6].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[6].state = FAST_STATE_ASSIGNED;
+		fields[6].string_value = fields[6].string_buf;
+
+		if (unlikely(!fields[6].string_buf[0])) {
+			ret -= 1;
+
+			fields[6].string_buf[ret] = '\0';
+		}
+
+		fields[6].string_len = ret;
+
+		fast_dict_store(dict, &fields[6]);
+	} else {
+		ret = fast_dict_load(dict, &fields[6]);
+		if (ret)
+			return ret;
+
+		if (fields[6].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[6], true);
+			if (ret)
+				return ret;
+		} else if (fields[6].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_get_string(buffer, fields[7].string_buf, fields[7].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[7].state = FAST_STATE_ASSIGNED;
+	fields[7].string_value = fields[7].string_buf;
+
+	if (unlikely(!fields[7].string_buf[0])) {
+		if (ret > 1)
+			ret -= 2;
+		else {
+			fields[7].state = FAST_STATE_EMPTY;
+			ret = 0;
+		}
+
+		fields[7].string_buf[ret] = '\0';
+	}
+
+	fields[7].string_len = ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x08)) {
+		ret = fast_get_string(buffer, fields[8].string_buf, fields[8].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[8].state = FAST_STATE_ASSIGNED;
+		fields[8].string_value = fields[8].string_buf;
+
+		if (unlikely(!fields[8].string_buf[0])) {
+			ret -= 1;
+
+			fields[8].string_buf[ret] = '\0';
+		}
+
+		fields[8].string_len = ret;
+
+		fast_dict_store(dict, &fields[8]);
+	} else {
+		ret = fast_dict_load(dict, &fields[8]);
+		if (ret)
+			return ret;
+
+		if (fields[8].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[8], true);
+			if (ret)
+				return ret;
+		} else if (fields[8].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x04)) {
+		ret = fast_get_int(buffer, &fields[9].int_value);
+		if (ret)
+			return ret;
+
+		fields[9].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[9]);
+	} else {
+		fast_dict_load(dict, &fields[9]);
+
+		if (fields[9].state == FAST_STATE_ASSIGNED) {
+			fields[9].int_value++;
+			fast_dict_store(dict, &fields[9]);
+		} else if (fields[9].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[9].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x02)) {
+		ret = fast_get_uint(buffer, &fields[10].uint_value);
+		if (ret)
+			return ret;
+
+		fields[10].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[10]);
+	} else {
+		fast_dict_load(dict, &fields[10]);
+
+		if (fields[10].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[10].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_decode_uint(buffer, pmap, &fields[11], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x01)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[12], FAST_OP_NONE, true, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[12]);
+	} else {
+		fast_dict_load(dict, &fields[12]);
+
+		if (fields[12].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[12].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x40)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[13], FAST_OP_NONE, false, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[13]);
+	} else {
+		fast_dict_load(dict, &fields[13]);
+
+		if (fields[13].state == FAST_STATE_UNDEFINED) {
+			fields[13].state = FAST_STATE_EMPTY;
+
+			fast_dict_store(dict, &fields[13]);
+		}
+	}
+
+	ret = fast_decode_decimal(buffer, pmap, &fields[14], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x20)) {
+		ret = fast_get_string(buffer, fields[15].string_buf, fields[15].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[15].state = FAST_STATE_ASSIGNED;
+		fields[15].string_value = fields[15].string_buf;
+
+		if (unlikely(!fields[15].string_buf[0])) {
+			if (ret > 1)
+				ret -= 2;
+			else {
+				fields[15].state = FAST_STATE_EMPTY;
+				ret = 0;
+			}
+
+			fields[15].string_buf[ret] = '\0';
+		}
+
+		fields[15].string_len = ret;
+	} else if (fields[15].state == FAST_STATE_UNDEFINED) {
+		ret = fast_read_reset(&fields[15], false);
+		if (ret)
+			return ret;
+	}
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x10)) {
+		ret = fast_get_string(buffer, fields[16].string_buf, fields[16].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[16].state = FAST_STATE_ASSIGNED;
+		fields[16].string_value = fields[16].string_buf;
+
+		if (unlikely(!fields[16].string_buf[0])) {
+			ret -= 1;
+
+			fields[16].string_buf[ret] = '\0';
+		}
+
+		fields[16].string_len = ret;
+
+		fast_dict_store(dict, &fields[16]);
+	} else {
+		ret = fast_dict_load(dict, &fields[16]);
+		if (ret)
+			return ret;
+
+		if (fields[16].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[16], true);
+			if (ret)
+				return ret;
+		} else if (fields[16].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_decode_int(buffer, pmap, &fields[17], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int micex_4_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	int ret;
+
+	ret = fast_visit_string(msg, 0, fields + 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 1, fields + 1);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 2, fields + 2);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[3].uint_value);
+	if (ret)
+		return ret;
+
+	fields[3].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 3, fields + 3);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 4, fields + 4);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x20)) {
+		ret = fast_get_uint(buffer, &fields[5].uint_value);
+		if (ret)
+			return ret;
+
+		fields[5].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[5]);
+	} else {
+		fast_dict_load(dict, &fields[5]);
+
+		if (fields[5].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[5].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_uint(msg, 5, fields + 5);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x10)) {
+		ret = fast_get_string(buffer, fields[6].string_buf, fields[6].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[6].state = FAST_STATE_ASSIGNED;
+		fields[6].string_value = fields[6].string_buf;
+
+		if (unlikely(!fields[6].string_buf[0])) {
+			ret -= 1;
+
+			fields[6].string_buf[ret] = '\0';
+		}
+
+		fields[6].string_len = ret;
+
+		fast_dict_store(dict, &fields[6]);
+	} else {
+		ret = fast_dict_load(dict, &fields[6]);
+		if (ret)
+			return ret;
+
+		if (fields[6].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[6], true);
+			if (ret)
+				return ret;
+		} else if (fields[6].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_string(msg, 6, fields + 6);
+	if (ret)
+		return ret;
+
+	ret = fast_get_string(buffer, fields[7].string_buf, fields[7].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[7].state = FAST_STATE_ASSIGNED;
+	fields[7].string_value = fields[7].string_buf;
+
+	if (unlikely(!fields[7].string_buf[0])) {
+		if (ret > 1)
+			ret -= 2;
+		else {
+			fields[7].state = FAST_STATE_EMPTY;
+			ret = 0;
+		}
+
+		fields[7].string_buf[ret] = '\0';
+	}
+
+	fields[7].string_len = ret;
+
+	ret = fast_visit_string(msg, 7, fields + 7);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x08)) {
+		ret = fast_get_string(buffer, fields[8].string_buf, fields[8].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[8].state = FAST_STATE_ASSIGNED;
+		fields[8].string_value = fields[8].string_buf;
+
+		if (unlikely(!fields[8].string_buf[0])) {
+			ret -= 1;
+
+			fields[8].string_buf[ret] = '\0';
+		}
+
+		fields[8].string_len = ret;
+
+		fast_dict_store(dict, &fields[8]);
+	} else {
+		ret = fast_dict_load(dict, &fields[8]);
+		if (ret)
+			return ret;
+
+		if (fields[8].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[8], true);
+			if (ret)
+				return ret;
+		} else if (fields[8].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_string(msg, 8, fields + 8);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x04)) {
+		ret = fast_get_int(buffer, &fields[9].int_value);
+		if (ret)
+			return ret;
+
+		fields[9].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[9]);
+	} else {
+		fast_dict_load(dict, &fields[9]);
+
+		if (fields[9].state == FAST_STATE_ASSIGNED) {
+			fields[9].int_value++;
+			fast_dict_store(dict, &fields[9]);
+		} else if (fields[9].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[9].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_int(msg, 9, fields + 9);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x02)) {
+		ret = fast_get_uint(buffer, &fields[10].uint_value);
+		if (ret)
+			return ret;
+
+		fields[10].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[10]);
+	} else {
+		fast_dict_load(dict, &fields[10]);
+
+		if (fields[10].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[10].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_uint(msg, 10, fields + 10);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_uint(buffer, pmap, &fields[11], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_uint(msg, 11, fields + 11);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x01)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[12], FAST_OP_NONE, true, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[12]);
+	} else {
+		fast_dict_load(dict, &fields[12]);
+
+		if (fields[12].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[12].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_decimal(msg, 12, fields + 12);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x40)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[13], FAST_OP_NONE, false, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[13]);
+	} else {
+		fast_dict_load(dict, &fields[13]);
+
+		if (fields[13].state == FAST_STATE_UNDEFINED) {
+			fields[13].state = FAST_STATE_EMPTY;
+
+			fast_dict_store(dict, &fields[13]);
+		}
+	}
+
+	ret = fast_visit_decimal(msg, 13, fields + 13);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_decimal(buffer, pmap, &fields[14], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_decimal(msg, 14, fields + 14);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x20)) {
+		ret = fast_get_string(buffer, fields[15].string_buf, fields[15].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[15].state = FAST_STATE_ASSIGNED;
+		fields[15].string_value = fields[15].string_buf;
+
+		if (unlikely(!fields[15].string_buf[0])) {
+			if (ret > 1)
+				ret -= 2;
+			else {
+				fields[15].state = FAST_STATE_EMPTY;
+				ret = 0;
+			}
+
+			fields[15].string_buf[ret] = '\0';
+		}
+
+		fields[15].string_len = ret;
+	} else if (fields[15].state == FAST_STATE_UNDEFINED) {
+		ret = fast_read_reset(&fields[15], false);
+		if (ret)
+			return ret;
+	}
+
+	ret = fast_visit_string(msg, 15, fields + 15);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x10)) {
+		ret = fast_get_string(buffer, fields[16].string_buf, fields[16].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[16].state = FAST_STATE_ASSIGNED;
+		fields[16].string_value = fields[16].string_buf;
+
+		if (unlikely(!fields[16].string_buf[0])) {
+			ret -= 1;
+
+			fields[16].string_buf[ret] = '\0';
+		}
+
+		fields[16].string_len = ret;
+
+		fast_dict_store(dict, &fields[16]);
+	} else {
+		ret = fast_dict_load(dict, &fields[16]);
+		if (ret)
+			return ret;
+
+		if (fields[16].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[16], true);
+			if (ret)
+				return ret;
+		} else if (fields[16].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_string(msg, 16, fields + 16);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_int(buffer, pmap, &fields[17], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_int(msg, 17, fields + 17);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int micex_4_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+
+	if (fast_encode_string(buffer, pmap, fields + 0, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 1, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 2, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 3, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 4, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 5))
+		return -1;
+	if (fast_encode_uint(buffer, pmap, fields + 5, FAST_OP_COPY, true, 1))
+		return -1;
+	fast_dict_store_previous(dict, fields + 5);
+
+	if (fast_dict_load_previous(dict, fields + 6))
+		return -1;
+	if (fast_encode_string(buffer, pmap, fields + 6, FAST_OP_COPY, true, 2))
+		return -1;
+	fast_dict_store_previous(dict, fields + 6);
+
+	if (fast_encode_string(buffer, pmap, fields + 7, FAST_OP_NONE, false, 0))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 8))
+		return -1;
+	if (fast_encode_string(buffer, pmap, fields + 8, FAST_OP_COPY, true, 3))
+		return -1;
+	fast_dict_store_previous(dict, fields + 8);
+
+	if (fast_dict_load_previous(dict, fields + 9))
+		return -1;
+	if (fast_encode_int(buffer, pmap, fields + 9, FAST_OP_INCR, true, 4))
+		return -1;
+	fast_dict_store_previous(dict, fields + 9);
+
+	if (fast_dict_load_previous(dict, fields + 10))
+		return -1;
+	if (fast_encode_uint(buffer, pmap, fields + 10, FAST_OP_COPY, true, 5))
+		return -1;
+	fast_dict_store_previous(dict, fields + 10);
+
+	if (fast_encode_uint(buffer, pmap, fields + 11, FAST_OP_DELTA, false, 0))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 12))
+		return -1;
+	if (fast_encode_decimal(buffer, pmap, fields + 12, FAST_OP_COPY, true, 6))
+		return -1;
+	fast_dict_store_previous(dict, fields + 12);
+
+	if (fast_dict_load_previous(dict, fields + 13))
+		return -1;
+	if (fast_encode_decimal(buffer, pmap, fields + 13, FAST_OP_COPY, false, 7))
+		return -1;
+	fast_dict_store_previous(dict, fields + 13);
+
+	if (fast_encode_decimal(buffer, pmap, fields + 14, FAST_OP_DELTA, false, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 15, FAST_OP_COPY, false, 8))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 16))
+		return -1;
+	if (fast_encode_string(buffer, pmap, fields + 16, FAST_OP_COPY, true, 9))
+		return -1;
+	fast_dict_store_previous(dict, fields + 16);
+
+	if (fast_encode_int(buffer, pmap, fields + 17, FAST_OP_DELTA, false, 0))
+		return -1;
+
+	return 0;
+}
+
+extern const struct fast_template_codec micex_codecs[];
+extern const unsigned long micex_nr_codecs;
+
+const struct fast_template_codec micex_codecs[] = {
+	{
+		.tid		= 6,
+		.signature	= 0x3be69865cee4ed40ULL,
+		.decode		= micex_6_decode,
+		.visit		= micex_6_visit,
+		.encode		= micex_6_encode,
+	},
+	{
+		.tid		= 7,
+		.signature	= 0xd28d2181e17d9d0dULL,
+		.decode		= micex_7_decode,
+		.visit		= micex_7_visit,
+		.encode		= micex_7_encode,
+	},
+	{
+		.tid		= 3,
+		.signature	= 0x1eee4a972942d5aaULL,
+		.decode		= micex_3_decode,
+		.visit		= micex_3_visit,
+		.encode		= micex_3_encode,
+	},
+	{
+		.tid		= 4,
+		.signature	= 0xe679c61b050443d4ULL,
+		.decode		= micex_4_decode,
+		.visit		= micex_4_visit,
+		.encode		= micex_4_encode,
+	},
+};
+
+const unsigned long micex_nr_codecs = sizeof(micex_codecs) / sizeof(micex_codecs[0]);
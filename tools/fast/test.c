@@ -22,6 +22,10 @@ struct fcontainer *fcontainer_new(void)
 		container->felems[i].msg.fields = calloc(FAST_FIELD_MAX_NUMBER, sizeof(struct fast_field));
 		if (!container->felems[i].msg.fields)
 			goto free;
+
+		container->felems[i].msg.strings = calloc(FAST_FIELD_MAX_NUMBER, FAST_STRING_MAX_BYTES);
+		if (!container->felems[i].msg.strings)
+			goto free;
 	}
 
 	return container;
@@ -38,18 +42,21 @@ void fcontainer_free(struct fcontainer *container)
 	if (!container)
 		return;
 
-	for (i = 0; i < FAST_MAX_ELEMENTS_NUMBER; i++)
+	for (i = 0; i < FAST_MAX_ELEMENTS_NUMBER; i++) {
+		free(container->felems[i].msg.strings);
 		free(container->felems[i].msg.fields);
+	}
 
 	free(container);
 }
 
 void fcontainer_init(struct fcontainer *self, struct fast_message *init_msg)
 {
-	int i;
+	int i, j;
 	unsigned long nr_fields;
 	struct fast_message *msg;
 	struct fast_field *fields;
+	struct fast_field *field;
 
 	nr_fields = init_msg->nr_fields;
 	fields = init_msg->fields;
@@ -60,6 +67,20 @@ void fcontainer_init(struct fcontainer *self, struct fast_message *init_msg)
 		msg->tid = 0;
 
 		memcpy(msg->fields, fields, nr_fields * sizeof(struct fast_field));
+
+		/* Strings must not share the template's buffers */
+		for (j = 0; j < nr_fields; j++) {
+			field = msg->fields + j;
+
+			if (field->type != FAST_TYPE_STRING)
+				continue;
+
+			field->string_size = FAST_STRING_MAX_BYTES;
+			field->string_buf = msg->strings + j * FAST_STRING_MAX_BYTES;
+			field->string_value = field->string_buf;
+			field->string_value[0] = '\0';
+			field->string_len = 0;
+		}
 	}
 
 	return;
@@ -121,10 +142,13 @@ int init_elem(struct felem *elem, char *line)
 			start = end + 1;
 			break;
 		case FAST_TYPE_STRING:
+			field->string_value = field->string_buf;
+
 			if (sscanf(start, "%[^" DELIMS  "]s", field->string_value) != 1)
 				goto fail;
 
-			start = start + strlen(field->string_value) + 1;
+			field->string_len = strlen(field->string_value);
+			start = start + field->string_len + 1;
 			break;
 		case FAST_TYPE_DECIMAL:
 			field->decimal_value.exp = strtol(start, &end, 10);
@@ -167,6 +191,28 @@ fail:
 	return 1;
 }
 
+static int fseqcmp(struct fast_field *expected, struct fast_field *actual)
+{
+	struct fast_sequence *expected_seq = expected->ptr_value;
+	struct fast_sequence *actual_seq = actual->ptr_value;
+	struct fast_message expected_elem = expected_seq->element;
+	struct fast_message actual_elem = actual_seq->element;
+	unsigned long i;
+
+	if (actual_seq->length.uint_value != expected_seq->length.uint_value)
+		return 1;
+
+	for (i = 0; i < expected_seq->length.uint_value; i++) {
+		expected_elem.fields = fast_sequence_element(expected_seq, i);
+		actual_elem.fields = fast_sequence_element(actual_seq, i);
+
+		if (fmsgcmp(&expected_elem, &actual_elem))
+			return 1;
+	}
+
+	return 0;
+}
+
 int fmsgcmp(struct fast_message *expected, struct fast_message *actual)
 {
 	struct fast_field *expected_field;
@@ -207,7 +253,10 @@ int fmsgcmp(struct fast_message *expected, struct fast_message *actual)
 				goto exit;
 			break;
 		case FAST_TYPE_STRING:
-			if (strcmp(actual_field->string_value, expected_field->string_value))
+			if (actual_field->string_len != expected_field->string_len)
+				goto exit;
+
+			if (memcmp(actual_field->string_value, expected_field->string_value, expected_field->string_len))
 				goto exit;
 			break;
 		case FAST_TYPE_DECIMAL:
@@ -219,6 +268,8 @@ int fmsgcmp(struct fast_message *expected, struct fast_message *actual)
 
 			break;
 		case FAST_TYPE_SEQUENCE:
+			if (fseqcmp(expected_field, actual_field))
+				goto exit;
 			break;
 		default:
 			break;
@@ -260,7 +311,7 @@ int snprintmsg(char *buf, size_t size, struct fast_message *msg)
 			len += snprintf(buf + len, size - len, "%" PRIu64 "%c", field->uint_value, delim);
 			break;
 		case FAST_TYPE_STRING:
-			len += snprintf(buf + len, size - len, "%s%c", field->string_value, delim);
+			len += snprintf(buf + len, size - len, "%.*s%c", (int) field->string_len, field->string_value, delim);
 			break;
 		case FAST_TYPE_DECIMAL:
 			len += snprintf(buf + len, size - len, "%" PRId64 "%c", field->decimal_value.exp, delim);
@@ -281,7 +332,7 @@ exit:
 int snprintseq(char *buf, size_t size, struct fast_field *field)
 {
 	struct fast_sequence *seq;
-	struct fast_message *msg;
+	struct fast_message msg;
 	int len = 0;
 	int i;
 
@@ -292,11 +343,12 @@ int snprintseq(char *buf, size_t size, struct fast_field *field)
 		len += snprintf(buf + len, size - len, "\n<sequence>\n");
 
 	seq = field->ptr_value;
+	msg = seq->element;
 
-	for (i = 1; i <= seq->length.uint_value && len < size; i++) {
-		msg = seq->elements + i;
+	for (i = 0; i < seq->length.uint_value && len < size; i++) {
+		msg.fields = fast_sequence_element(seq, i);
 
-		len += snprintmsg(buf + len, size - len, msg);
+		len += snprintmsg(buf + len, size - len, &msg);
 		len += snprintf(buf + len, size - len, "\n");
 	}
 
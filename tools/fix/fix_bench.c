@@ -0,0 +1,283 @@
+#include "libtrading/proto/fix_message.h"
+#include "libtrading/proto/fix_md.h"
+
+#include "libtrading/buffer.h"
+#include "libtrading/array.h"
+#include "libtrading/die.h"
+
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+#define	BENCH_BUFFER_SIZE	(4 * FIX_MAX_MESSAGE_SIZE)
+
+static const char	*program;
+
+struct bench_info {
+	const char		*name;
+	void			(*setup)(struct fix_message *);
+	void			(*body)(struct buffer *, unsigned long);
+	unsigned long		(*consume)(struct fix_message *);
+};
+
+#define	MD_BOOK_SYMBOLS		8
+
+static struct fix_md	*md;
+
+static void fix_message_build(struct buffer *buf, struct buffer *body)
+{
+	unsigned long cksum;
+
+	buffer_printf(buf, "8=FIX.4.4\0019=%lu\001", buffer_size(body));
+
+	memcpy(buffer_end(buf), buffer_start(body), buffer_size(body));
+	buf->end += buffer_size(body);
+
+	cksum = buffer_sum(buf);
+
+	buffer_printf(buf, "10=%03lu\001", cksum % 256);
+}
+
+static void md_incremental_body(struct buffer *body, unsigned long nr_entries)
+{
+	unsigned long i;
+
+	buffer_printf(body, "35=X\00149=SELLSIDE\00156=BUYSIDE\00134=1\00152=20131028-10:00:00.000\001");
+	buffer_printf(body, "262=MDREQ\001268=%lu\001", nr_entries);
+
+	for (i = 0; i < nr_entries; i++) {
+		buffer_printf(body, "279=%lu\001269=%lu\00155=SYM%lu\001", i % 3, i % 2, i % 8);
+		buffer_printf(body, "270=%lu.%02lu\001271=%lu\0011023=%lu\001", 100 + i / 2, i % 100, 100 * (i + 1), i / 2 + 1);
+	}
+}
+
+static unsigned long md_incremental_consume(struct fix_message *msg)
+{
+	struct fix_group *group;
+	struct fix_field *field;
+	unsigned long nr, i;
+
+	group = fix_get_group(msg, NoMDEntries);
+	if (!group)
+		die("NoMDEntries group is missing");
+
+	nr = fix_group_nr_entries(group);
+
+	for (i = 0; i < nr; i++) {
+		field = fix_group_get_field(msg, group, i, MDEntryPx);
+		if (!field)
+			die("MDEntryPx is missing");
+	}
+
+	return nr;
+}
+
+static void md_book_setup(struct fix_message *msg)
+{
+	struct buffer *body;
+	struct buffer *buf;
+	unsigned long i;
+
+	md = fix_md_new(FIX_MD_DEFAULT_DEPTH);
+	body = buffer_new(BENCH_BUFFER_SIZE);
+	buf = buffer_new(BENCH_BUFFER_SIZE);
+
+	if (!md || !body || !buf)
+		die("unable to allocate memory");
+
+	for (i = 0; i < MD_BOOK_SYMBOLS; i++) {
+		buffer_reset(body);
+		buffer_reset(buf);
+
+		buffer_printf(body, "35=W\00149=SELLSIDE\00156=BUYSIDE\00134=1\00152=20131028-10:00:00.000\001");
+		buffer_printf(body, "262=MDREQ\00155=SYM%lu\001268=0\001", i);
+
+		fix_message_build(buf, body);
+
+		if (fix_message_parse(msg, buf) || fix_md_process(md, msg))
+			die("unable to process snapshot");
+	}
+
+	/* Group entries are scanned by the book handler */
+	fix_msg_add_flags(msg, FIX_MSG_FLAGS_SKIP_BODY);
+
+	buffer_delete(body);
+	buffer_delete(buf);
+}
+
+static void md_book_body(struct buffer *body, unsigned long nr_entries)
+{
+	unsigned long i;
+
+	buffer_printf(body, "35=X\00149=SELLSIDE\00156=BUYSIDE\00134=1\00152=20131028-10:00:00.000\001");
+	buffer_printf(body, "262=MDREQ\001268=%lu\001", nr_entries);
+
+	for (i = 0; i < nr_entries; i++) {
+		buffer_printf(body, "279=%lu\001269=%lu\00155=SYM%lu\001", i % 3, i % 2, i % MD_BOOK_SYMBOLS);
+		buffer_printf(body, "270=%lu.%02lu\001271=%lu\0011023=%lu\001", 100 + i / 2, i % 100, 100 * (i + 1), i % FIX_MD_DEFAULT_DEPTH + 1);
+	}
+}
+
+static unsigned long md_book_consume(struct fix_message *msg)
+{
+	unsigned long nr = md->stats.nr_entries;
+
+	if (fix_md_process(md, msg))
+		die("unable to process incremental refresh");
+
+	return md->stats.nr_entries - nr;
+}
+
+static void execution_report_body(struct buffer *body, unsigned long nr_entries)
+{
+	buffer_printf(body, "35=8\00149=SELLSIDE\00156=BUYSIDE\00134=1\00152=20131028-10:00:00.000\001");
+	buffer_printf(body, "1=ACCOUNT\00137=ORDERID\00117=EXECID\001150=F\00139=2\00155=SYM\00154=1\001");
+	buffer_printf(body, "38=100\00144=100.25\001151=0\00114=100\0016=100.25\00111=CLORDID\001");
+	buffer_printf(body, "60=20131028-09:59:59.998\001");
+}
+
+static unsigned long execution_report_consume(struct fix_message *msg)
+{
+	int64_t transact_time;
+
+	if (!fix_get_field(msg, ClOrdID))
+		die("ClOrdID is missing");
+
+	/* Wire-to-wire latency */
+	if (!fix_get_timestamp(msg, TransactTime, &transact_time) || msg->sending_time < transact_time)
+		die("TransactTime is missing");
+
+	if (!fix_get_field(msg, OrdStatus))
+		die("OrdStatus is missing");
+
+	return 0;
+}
+
+static const struct bench_info benches[] = {
+	{ "md-incremental",	NULL,		md_incremental_body,	md_incremental_consume },
+	{ "md-book",		md_book_setup,	md_book_body,		md_book_consume },
+	{ "execution-report",	NULL,		execution_report_body,	execution_report_consume },
+};
+
+static const struct bench_info *lookup_bench_info(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		const struct bench_info *bench_info = &benches[i];
+
+		if (!strcmp(bench_info->name, name))
+			return bench_info;
+	}
+	return NULL;
+}
+
+static double timespec_ns(struct timespec *before, struct timespec *after)
+{
+	return 1000000000.0 * (after->tv_sec - before->tv_sec) + (after->tv_nsec - before->tv_nsec);
+}
+
+static void usage(void)
+{
+	printf("\n  usage: %s [-b bench] [-n iterations] [-e entries] [-l]\n\n", program);
+
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct bench_info *bench_info;
+	struct timespec before, after;
+	unsigned long nr_iterations;
+	unsigned long nr_entries;
+	unsigned long entries;
+	struct fix_message *msg;
+	struct buffer *body;
+	struct buffer *buf;
+	const char *bench;
+	unsigned long i;
+	bool lazy;
+	double ns;
+	int opt;
+
+	program		= basename(argv[0]);
+
+	bench		= "md-incremental";
+	nr_iterations	= 100000;
+	nr_entries	= 100;
+	lazy		= false;
+
+	while ((opt = getopt(argc, argv, "b:n:e:l")) != -1) {
+		switch (opt) {
+		case 'b':
+			bench = optarg;
+			break;
+		case 'n':
+			nr_iterations = strtoul(optarg, NULL, 10);
+			break;
+		case 'e':
+			nr_entries = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			lazy = true;
+			break;
+		default: /* '?' */
+			usage();
+		}
+	}
+
+	bench_info = lookup_bench_info(bench);
+	if (!bench_info)
+		usage();
+
+	body = buffer_new(BENCH_BUFFER_SIZE);
+	buf = buffer_new(BENCH_BUFFER_SIZE);
+	msg = fix_message_new();
+
+	if (!body || !buf || !msg)
+		die("unable to allocate memory");
+
+	if (lazy)
+		fix_msg_add_flags(msg, FIX_MSG_FLAGS_LAZY);
+
+	if (bench_info->setup)
+		bench_info->setup(msg);
+
+	bench_info->body(body, nr_entries);
+
+	if (buffer_size(body) > FIX_MAX_BODY_LEN)
+		die("message body is too large (%lu bytes)", buffer_size(body));
+
+	fix_message_build(buf, body);
+
+	entries = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+
+	for (i = 0; i < nr_iterations; i++) {
+		buf->start = 0;
+
+		if (fix_message_parse(msg, buf))
+			die("unable to parse message");
+
+		entries += bench_info->consume(msg);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	ns = timespec_ns(&before, &after);
+
+	printf("%s%s: %lu messages of %lu bytes, %lu entries\n", bench_info->name, lazy ? " (lazy)" : "", nr_iterations, buf->end, entries);
+	printf("  %.1lf ns/message, %.0lf messages/sec, %.0lf entries/sec\n",
+		ns / nr_iterations, nr_iterations * 1e9 / ns, entries * 1e9 / ns);
+
+	fix_md_free(md);
+	fix_message_free(msg);
+	buffer_delete(body);
+	buffer_delete(buf);
+
+	return 0;
+}
@@ -247,6 +247,11 @@ int fmsgcmp(struct fix_message *expected, struct fix_message *actual)
 				if (expected_field->int_value != actual_field->int_value)
 					goto exit;
 				break;
+			case FIX_TYPE_UTC_TIMESTAMP:
+				if (expected_field->timestamp_value != actual_field->timestamp_value)
+					goto exit;
+				break;
+			case FIX_TYPE_RAW:
 			default:
 				break;
 		}
@@ -327,6 +332,14 @@ void fprintmsg(FILE *stream, struct fix_message *msg)
 			case FIX_TYPE_INT:
 				len += snprintf(buf + len, size - len, "%c%d=%" PRId64, delim, field->tag, field->int_value);
 				break;
+			case FIX_TYPE_UTC_TIMESTAMP:
+				len += snprintf(buf + len, size - len, "%c%d=", delim, field->tag);
+				len += fix_utc_timestamp_format(field->timestamp_value, buf + len, size - len);
+				break;
+			case FIX_TYPE_RAW:
+				len += snprintf(buf + len, size - len, "%c%d=", delim, field->tag);
+				len += fstrncpy(buf + len, field->string_value, size - len);
+				break;
 			default:
 				break;
 		}
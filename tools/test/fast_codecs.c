@@ -0,0 +1,1342 @@
+/* Generated by fast_codegen from tools/test/protocol/fast/codegen.xml, do not edit */
+
+#include "libtrading/proto/fast_codec.h"
+
+#include <string.h>
+
+static int codegen_1_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	int ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x20))
+		fields[2].state = FAST_STATE_ASSIGNED;
+	else
+		fields[2].state = FAST_STATE_EMPTY;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x10))
+		fields[3].state = FAST_STATE_ASSIGNED;
+	else
+		fields[3].state = FAST_STATE_EMPTY;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_get_int(buffer, &fields[5].int_value);
+	if (ret)
+		return ret;
+
+	fields[5].state = FAST_STATE_ASSIGNED;
+
+	if (!fields[5].int_value)
+		fields[5].state = FAST_STATE_EMPTY;
+	else if (fields[5].int_value > 0)
+		fields[5].int_value--;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x08)) {
+		ret = fast_get_uint(buffer, &fields[6].uint_value);
+		if (ret)
+			return ret;
+
+		fields[6].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[6]);
+	} else {
+		fast_dict_load(dict, &fields[6]);
+
+		if (fields[6].state == FAST_STATE_UNDEFINED) {
+			fields[6].state = FAST_STATE_ASSIGNED;
+			fields[6].uint_value = fields[6].uint_reset;
+
+			fast_dict_store(dict, &fields[6]);
+		} else if (fields[6].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x04)) {
+		ret = fast_get_uint(buffer, &fields[7].uint_value);
+		if (ret)
+			return ret;
+
+		fields[7].state = FAST_STATE_ASSIGNED;
+
+		if (!fields[7].uint_value)
+			fields[7].state = FAST_STATE_EMPTY;
+		else
+			fields[7].uint_value--;
+	} else if (fields[7].state == FAST_STATE_UNDEFINED) {
+		fields[7].state = FAST_STATE_EMPTY;
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x02)) {
+		ret = fast_get_int(buffer, &fields[8].int_value);
+		if (ret)
+			return ret;
+
+		fields[8].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[8]);
+	} else {
+		fast_dict_load(dict, &fields[8]);
+
+		if (fields[8].state == FAST_STATE_ASSIGNED) {
+			fields[8].int_value++;
+			fast_dict_store(dict, &fields[8]);
+		} else if (fields[8].state == FAST_STATE_UNDEFINED) {
+			fields[8].state = FAST_STATE_ASSIGNED;
+			fields[8].int_value = fields[8].int_reset;
+
+			fast_dict_store(dict, &fields[8]);
+		} else if (fields[8].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x01)) {
+		ret = fast_get_uint(buffer, &fields[9].uint_value);
+		if (ret)
+			return ret;
+
+		fields[9].state = FAST_STATE_ASSIGNED;
+
+		if (!fields[9].uint_value)
+			fields[9].state = FAST_STATE_EMPTY;
+		else
+			fields[9].uint_value--;
+	} else if (fields[9].state == FAST_STATE_ASSIGNED) {
+		fields[9].uint_value++;
+	} else if (fields[9].state == FAST_STATE_UNDEFINED) {
+		fields[9].state = FAST_STATE_EMPTY;
+	}
+
+	ret = fast_decode_uint(buffer, pmap, &fields[10], FAST_OP_DELTA, true, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_get_string(buffer, fields[11].string_buf, fields[11].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[11].state = FAST_STATE_ASSIGNED;
+	fields[11].string_value = fields[11].string_buf;
+
+	if (unlikely(!fields[11].string_buf[0])) {
+		ret -= 1;
+
+		fields[11].string_buf[ret] = '\0';
+	}
+
+	fields[11].string_len = ret;
+
+	ret = fast_get_string(buffer, fields[12].string_buf, fields[12].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[12].state = FAST_STATE_ASSIGNED;
+	fields[12].string_value = fields[12].string_buf;
+
+	if (unlikely(!fields[12].string_buf[0])) {
+		if (ret > 1)
+			ret -= 2;
+		else {
+			fields[12].state = FAST_STATE_EMPTY;
+			ret = 0;
+		}
+
+		fields[12].string_buf[ret] = '\0';
+	}
+
+	fields[12].string_len = ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x40)) {
+		ret = fast_get_string(buffer, fields[13].string_buf, fields[13].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[13].state = FAST_STATE_ASSIGNED;
+		fields[13].string_value = fields[13].string_buf;
+
+		if (unlikely(!fields[13].string_buf[0])) {
+			ret -= 1;
+
+			fields[13].string_buf[ret] = '\0';
+		}
+
+		fields[13].string_len = ret;
+
+		fast_dict_store(dict, &fields[13]);
+	} else {
+		ret = fast_dict_load(dict, &fields[13]);
+		if (ret)
+			return ret;
+
+		if (fields[13].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[13], true);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[13]);
+		} else if (fields[13].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x20)) {
+		ret = fast_get_string(buffer, fields[14].string_buf, fields[14].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[14].state = FAST_STATE_ASSIGNED;
+		fields[14].string_value = fields[14].string_buf;
+
+		if (unlikely(!fields[14].string_buf[0])) {
+			if (ret > 1)
+				ret -= 2;
+			else {
+				fields[14].state = FAST_STATE_EMPTY;
+				ret = 0;
+			}
+
+			fields[14].string_buf[ret] = '\0';
+		}
+
+		fields[14].string_len = ret;
+	} else if (fields[14].state == FAST_STATE_UNDEFINED) {
+		ret = fast_read_reset(&fields[14], false);
+		if (ret)
+			return ret;
+	}
+
+	ret = fast_decode_ascii(buffer, pmap, &fields[15], FAST_OP_TAIL, true, 9);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_unicode(buffer, pmap, &fields[16], FAST_OP_COPY, false, 10);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_unicode(buffer, pmap, &fields[17], FAST_OP_NONE, true, 0);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x04)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[18], FAST_OP_NONE, true, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[18]);
+	} else {
+		fast_dict_load(dict, &fields[18]);
+
+		if (fields[18].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[18].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x02)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[19], FAST_OP_NONE, false, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[19]);
+	} else {
+		fast_dict_load(dict, &fields[19]);
+
+		if (fields[19].state == FAST_STATE_UNDEFINED) {
+			fields[19].state = FAST_STATE_EMPTY;
+
+			fast_dict_store(dict, &fields[19]);
+		}
+	}
+
+	ret = fast_decode_decimal(buffer, pmap, &fields[20], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_decimal_parts(buffer, pmap, &fields[21], FAST_OP_COPY, true, 13, FAST_OP_DELTA, 0);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int codegen_1_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	int ret;
+
+	ret = fast_visit_string(msg, 0, fields + 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_uint(msg, 1, fields + 1);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x20))
+		fields[2].state = FAST_STATE_ASSIGNED;
+	else
+		fields[2].state = FAST_STATE_EMPTY;
+
+	ret = fast_visit_int(msg, 2, fields + 2);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x10))
+		fields[3].state = FAST_STATE_ASSIGNED;
+	else
+		fields[3].state = FAST_STATE_EMPTY;
+
+	ret = fast_visit_string(msg, 3, fields + 3);
+	if (ret)
+		return ret;
+
+	ret = fast_get_uint(buffer, &fields[4].uint_value);
+	if (ret)
+		return ret;
+
+	fields[4].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 4, fields + 4);
+	if (ret)
+		return ret;
+
+	ret = fast_get_int(buffer, &fields[5].int_value);
+	if (ret)
+		return ret;
+
+	fields[5].state = FAST_STATE_ASSIGNED;
+
+	if (!fields[5].int_value)
+		fields[5].state = FAST_STATE_EMPTY;
+	else if (fields[5].int_value > 0)
+		fields[5].int_value--;
+
+	ret = fast_visit_int(msg, 5, fields + 5);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x08)) {
+		ret = fast_get_uint(buffer, &fields[6].uint_value);
+		if (ret)
+			return ret;
+
+		fields[6].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[6]);
+	} else {
+		fast_dict_load(dict, &fields[6]);
+
+		if (fields[6].state == FAST_STATE_UNDEFINED) {
+			fields[6].state = FAST_STATE_ASSIGNED;
+			fields[6].uint_value = fields[6].uint_reset;
+
+			fast_dict_store(dict, &fields[6]);
+		} else if (fields[6].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_uint(msg, 6, fields + 6);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x04)) {
+		ret = fast_get_uint(buffer, &fields[7].uint_value);
+		if (ret)
+			return ret;
+
+		fields[7].state = FAST_STATE_ASSIGNED;
+
+		if (!fields[7].uint_value)
+			fields[7].state = FAST_STATE_EMPTY;
+		else
+			fields[7].uint_value--;
+	} else if (fields[7].state == FAST_STATE_UNDEFINED) {
+		fields[7].state = FAST_STATE_EMPTY;
+	}
+
+	ret = fast_visit_uint(msg, 7, fields + 7);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x02)) {
+		ret = fast_get_int(buffer, &fields[8].int_value);
+		if (ret)
+			return ret;
+
+		fields[8].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[8]);
+	} else {
+		fast_dict_load(dict, &fields[8]);
+
+		if (fields[8].state == FAST_STATE_ASSIGNED) {
+			fields[8].int_value++;
+			fast_dict_store(dict, &fields[8]);
+		} else if (fields[8].state == FAST_STATE_UNDEFINED) {
+			fields[8].state = FAST_STATE_ASSIGNED;
+			fields[8].int_value = fields[8].int_reset;
+
+			fast_dict_store(dict, &fields[8]);
+		} else if (fields[8].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_int(msg, 8, fields + 8);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x01)) {
+		ret = fast_get_uint(buffer, &fields[9].uint_value);
+		if (ret)
+			return ret;
+
+		fields[9].state = FAST_STATE_ASSIGNED;
+
+		if (!fields[9].uint_value)
+			fields[9].state = FAST_STATE_EMPTY;
+		else
+			fields[9].uint_value--;
+	} else if (fields[9].state == FAST_STATE_ASSIGNED) {
+		fields[9].uint_value++;
+	} else if (fields[9].state == FAST_STATE_UNDEFINED) {
+		fields[9].state = FAST_STATE_EMPTY;
+	}
+
+	ret = fast_visit_uint(msg, 9, fields + 9);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_uint(buffer, pmap, &fields[10], FAST_OP_DELTA, true, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_uint(msg, 10, fields + 10);
+	if (ret)
+		return ret;
+
+	ret = fast_get_string(buffer, fields[11].string_buf, fields[11].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[11].state = FAST_STATE_ASSIGNED;
+	fields[11].string_value = fields[11].string_buf;
+
+	if (unlikely(!fields[11].string_buf[0])) {
+		ret -= 1;
+
+		fields[11].string_buf[ret] = '\0';
+	}
+
+	fields[11].string_len = ret;
+
+	ret = fast_visit_string(msg, 11, fields + 11);
+	if (ret)
+		return ret;
+
+	ret = fast_get_string(buffer, fields[12].string_buf, fields[12].string_size);
+	if (ret < 0)
+		return ret;
+
+	fields[12].state = FAST_STATE_ASSIGNED;
+	fields[12].string_value = fields[12].string_buf;
+
+	if (unlikely(!fields[12].string_buf[0])) {
+		if (ret > 1)
+			ret -= 2;
+		else {
+			fields[12].state = FAST_STATE_EMPTY;
+			ret = 0;
+		}
+
+		fields[12].string_buf[ret] = '\0';
+	}
+
+	fields[12].string_len = ret;
+
+	ret = fast_visit_string(msg, 12, fields + 12);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x40)) {
+		ret = fast_get_string(buffer, fields[13].string_buf, fields[13].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[13].state = FAST_STATE_ASSIGNED;
+		fields[13].string_value = fields[13].string_buf;
+
+		if (unlikely(!fields[13].string_buf[0])) {
+			ret -= 1;
+
+			fields[13].string_buf[ret] = '\0';
+		}
+
+		fields[13].string_len = ret;
+
+		fast_dict_store(dict, &fields[13]);
+	} else {
+		ret = fast_dict_load(dict, &fields[13]);
+		if (ret)
+			return ret;
+
+		if (fields[13].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[13], true);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[13]);
+		} else if (fields[13].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_string(msg, 13, fields + 13);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x20)) {
+		ret = fast_get_string(buffer, fields[14].string_buf, fields[14].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[14].state = FAST_STATE_ASSIGNED;
+		fields[14].string_value = fields[14].string_buf;
+
+		if (unlikely(!fields[14].string_buf[0])) {
+			if (ret > 1)
+				ret -= 2;
+			else {
+				fields[14].state = FAST_STATE_EMPTY;
+				ret = 0;
+			}
+
+			fields[14].string_buf[ret] = '\0';
+		}
+
+		fields[14].string_len = ret;
+	} else if (fields[14].state == FAST_STATE_UNDEFINED) {
+		ret = fast_read_reset(&fields[14], false);
+		if (ret)
+			return ret;
+	}
+
+	ret = fast_visit_string(msg, 14, fields + 14);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_ascii(buffer, pmap, &fields[15], FAST_OP_TAIL, true, 9);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 15, fields + 15);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_unicode(buffer, pmap, &fields[16], FAST_OP_COPY, false, 10);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 16, fields + 16);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_unicode(buffer, pmap, &fields[17], FAST_OP_NONE, true, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_string(msg, 17, fields + 17);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x04)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[18], FAST_OP_NONE, true, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[18]);
+	} else {
+		fast_dict_load(dict, &fields[18]);
+
+		if (fields[18].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[18].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_decimal(msg, 18, fields + 18);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 1 && (pmap->bytes[1] & 0x02)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[19], FAST_OP_NONE, false, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[19]);
+	} else {
+		fast_dict_load(dict, &fields[19]);
+
+		if (fields[19].state == FAST_STATE_UNDEFINED) {
+			fields[19].state = FAST_STATE_EMPTY;
+
+			fast_dict_store(dict, &fields[19]);
+		}
+	}
+
+	ret = fast_visit_decimal(msg, 19, fields + 19);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_decimal(buffer, pmap, &fields[20], FAST_OP_DELTA, false, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_decimal(msg, 20, fields + 20);
+	if (ret)
+		return ret;
+
+	ret = fast_decode_decimal_parts(buffer, pmap, &fields[21], FAST_OP_COPY, true, 13, FAST_OP_DELTA, 0);
+	if (ret)
+		return ret;
+
+	ret = fast_visit_decimal(msg, 21, fields + 21);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int codegen_1_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+
+	if (fast_encode_string(buffer, pmap, fields + 0, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 1, FAST_OP_CONSTANT, true, 0))
+		return -1;
+
+	if (fast_encode_int(buffer, pmap, fields + 2, FAST_OP_CONSTANT, false, 1))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 3, FAST_OP_CONSTANT, false, 2))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 4, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_int(buffer, pmap, fields + 5, FAST_OP_NONE, false, 0))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 6))
+		return -1;
+	if (fast_encode_uint(buffer, pmap, fields + 6, FAST_OP_COPY, true, 3))
+		return -1;
+	fast_dict_store_previous(dict, fields + 6);
+
+	if (fast_encode_uint(buffer, pmap, fields + 7, FAST_OP_COPY, false, 4))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 8))
+		return -1;
+	if (fast_encode_int(buffer, pmap, fields + 8, FAST_OP_INCR, true, 5))
+		return -1;
+	fast_dict_store_previous(dict, fields + 8);
+
+	if (fast_encode_uint(buffer, pmap, fields + 9, FAST_OP_INCR, false, 6))
+		return -1;
+
+	if (fast_encode_uint(buffer, pmap, fields + 10, FAST_OP_DELTA, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 11, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 12, FAST_OP_NONE, false, 0))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 13))
+		return -1;
+	if (fast_encode_string(buffer, pmap, fields + 13, FAST_OP_COPY, true, 7))
+		return -1;
+	fast_dict_store_previous(dict, fields + 13);
+
+	if (fast_encode_string(buffer, pmap, fields + 14, FAST_OP_COPY, false, 8))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 15, FAST_OP_TAIL, true, 9))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 16, FAST_OP_COPY, false, 10))
+		return -1;
+
+	if (fast_encode_string(buffer, pmap, fields + 17, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 18))
+		return -1;
+	if (fast_encode_decimal(buffer, pmap, fields + 18, FAST_OP_COPY, true, 11))
+		return -1;
+	fast_dict_store_previous(dict, fields + 18);
+
+	if (fast_dict_load_previous(dict, fields + 19))
+		return -1;
+	if (fast_encode_decimal(buffer, pmap, fields + 19, FAST_OP_COPY, false, 12))
+		return -1;
+	fast_dict_store_previous(dict, fields + 19);
+
+	if (fast_encode_decimal(buffer, pmap, fields + 20, FAST_OP_DELTA, false, 0))
+		return -1;
+
+	if (fast_encode_decimal_parts(buffer, pmap, fields + 21, FAST_OP_COPY, true, 13, FAST_OP_DELTA, 0))
+		return -1;
+
+	return 0;
+}
+
+static int codegen_2_seq5_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_sequence *seq = msg->fields[5].ptr_value;
+	struct fast_field *fields = seq->element.fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	struct fast_pmap spmap;
+	struct fast_field *cur;
+	unsigned long i;
+	int ret;
+
+	ret = fast_get_uint(buffer, &seq->length.uint_value);
+	if (ret)
+		return ret;
+
+	seq->length.state = FAST_STATE_ASSIGNED;
+
+	if (field_state_empty(&seq->length))
+		return FAST_MSG_STATE_GARBLED;
+
+	if (fast_sequence_reserve(seq, seq->length.uint_value))
+		return FAST_MSG_STATE_GARBLED;
+
+	spmap.nr_bytes = 0;
+
+	for (i = 0; i < seq->length.uint_value; i++) {
+		cur = fast_sequence_element(seq, i);
+
+		ret = fast_get_pmap(buffer, &spmap);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x40)) {
+			ret = fast_get_uint(buffer, &fields[0].uint_value);
+			if (ret)
+				return ret;
+
+			fields[0].state = FAST_STATE_ASSIGNED;
+		} else if (fields[0].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[0].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+
+		cur[0].uint_value = fields[0].uint_value;
+		cur[0].state = fields[0].state;
+
+		field_copy_string(cur + 1, fields + 1);
+		cur[1].state = fields[1].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x20)) {
+			ret = fast_get_string(buffer, fields[2].string_buf, fields[2].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[2].state = FAST_STATE_ASSIGNED;
+			fields[2].string_value = fields[2].string_buf;
+
+			if (unlikely(!fields[2].string_buf[0])) {
+				if (ret > 1)
+					ret -= 2;
+				else {
+					fields[2].state = FAST_STATE_EMPTY;
+					ret = 0;
+				}
+
+				fields[2].string_buf[ret] = '\0';
+			}
+
+			fields[2].string_len = ret;
+		} else if (fields[2].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[2], false);
+			if (ret)
+				return ret;
+		}
+
+		field_copy_string(cur + 2, fields + 2);
+		cur[2].state = fields[2].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x10)) {
+			ret = fast_get_int(buffer, &fields[3].int_value);
+			if (ret)
+				return ret;
+
+			fields[3].state = FAST_STATE_ASSIGNED;
+
+			if (!fields[3].int_value)
+				fields[3].state = FAST_STATE_EMPTY;
+			else if (fields[3].int_value > 0)
+				fields[3].int_value--;
+		} else if (fields[3].state == FAST_STATE_ASSIGNED) {
+			fields[3].int_value++;
+		} else if (fields[3].state == FAST_STATE_UNDEFINED) {
+			fields[3].state = FAST_STATE_EMPTY;
+		}
+
+		cur[3].int_value = fields[3].int_value;
+		cur[3].state = fields[3].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x08))
+			fields[4].state = FAST_STATE_ASSIGNED;
+		else
+			fields[4].state = FAST_STATE_EMPTY;
+
+		cur[4].uint_value = fields[4].uint_value;
+		cur[4].state = fields[4].state;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x04)) {
+			ret = fast_decode_decimal(buffer, &spmap, &fields[5], FAST_OP_NONE, false, 0);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[5]);
+		} else {
+			fast_dict_load(dict, &fields[5]);
+
+			if (fields[5].state == FAST_STATE_UNDEFINED) {
+				fields[5].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[5]);
+			}
+		}
+
+		cur[5].decimal_value = fields[5].decimal_value;
+		cur[5].state = fields[5].state;
+	}
+
+	return 0;
+}
+
+static int codegen_2_decode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	int ret;
+
+	ret = fast_get_uint(buffer, &fields[0].uint_value);
+	if (ret)
+		return ret;
+
+	fields[0].state = FAST_STATE_ASSIGNED;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x20)) {
+		ret = fast_get_uint(buffer, &fields[1].uint_value);
+		if (ret)
+			return ret;
+
+		fields[1].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[1]);
+	} else {
+		fast_dict_load(dict, &fields[1]);
+
+		if (fields[1].state == FAST_STATE_UNDEFINED) {
+			fields[1].state = FAST_STATE_ASSIGNED;
+			fields[1].uint_value = fields[1].uint_reset;
+
+			fast_dict_store(dict, &fields[1]);
+		} else if (fields[1].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x10)) {
+		ret = fast_get_int(buffer, &fields[2].int_value);
+		if (ret)
+			return ret;
+
+		fields[2].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[2]);
+	} else {
+		fast_dict_load(dict, &fields[2]);
+
+		if (fields[2].state == FAST_STATE_ASSIGNED) {
+			fields[2].int_value++;
+			fast_dict_store(dict, &fields[2]);
+		} else if (fields[2].state == FAST_STATE_UNDEFINED) {
+			fields[2].state = FAST_STATE_ASSIGNED;
+			fields[2].int_value = fields[2].int_reset;
+
+			fast_dict_store(dict, &fields[2]);
+		} else if (fields[2].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x08)) {
+		ret = fast_get_string(buffer, fields[3].string_buf, fields[3].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[3].state = FAST_STATE_ASSIGNED;
+		fields[3].string_value = fields[3].string_buf;
+
+		if (unlikely(!fields[3].string_buf[0])) {
+			ret -= 1;
+
+			fields[3].string_buf[ret] = '\0';
+		}
+
+		fields[3].string_len = ret;
+
+		fast_dict_store(dict, &fields[3]);
+	} else {
+		ret = fast_dict_load(dict, &fields[3]);
+		if (ret)
+			return ret;
+
+		if (fields[3].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[3], true);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[3]);
+		} else if (fields[3].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x04)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[4], FAST_OP_NONE, true, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[4]);
+	} else {
+		fast_dict_load(dict, &fields[4]);
+
+		if (fields[4].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[4].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = codegen_2_seq5_decode(buffer, pmap, msg);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int codegen_2_seq5_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_sequence *seq = msg->fields[5].ptr_value;
+	struct fast_field *fields = seq->element.fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	struct fast_pmap spmap;
+	unsigned long i;
+	int ret;
+
+	ret = fast_get_uint(buffer, &seq->length.uint_value);
+	if (ret)
+		return ret;
+
+	seq->length.state = FAST_STATE_ASSIGNED;
+
+	if (field_state_empty(&seq->length))
+		return FAST_MSG_STATE_GARBLED;
+
+	ret = fast_visit_sequence_begin(msg, 5, seq->length.uint_value);
+	if (ret)
+		return ret;
+
+	spmap.nr_bytes = 0;
+
+	for (i = 0; i < seq->length.uint_value; i++) {
+		ret = fast_get_pmap(buffer, &spmap);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x40)) {
+			ret = fast_get_uint(buffer, &fields[0].uint_value);
+			if (ret)
+				return ret;
+
+			fields[0].state = FAST_STATE_ASSIGNED;
+		} else if (fields[0].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[0].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+
+		ret = fast_visit_uint(msg, 0, fields + 0);
+		if (ret)
+			return ret;
+
+		ret = fast_visit_string(msg, 1, fields + 1);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x20)) {
+			ret = fast_get_string(buffer, fields[2].string_buf, fields[2].string_size);
+			if (ret < 0)
+				return ret;
+
+			fields[2].state = FAST_STATE_ASSIGNED;
+			fields[2].string_value = fields[2].string_buf;
+
+			if (unlikely(!fields[2].string_buf[0])) {
+				if (ret > 1)
+					ret -= 2;
+				else {
+					fields[2].state = FAST_STATE_EMPTY;
+					ret = 0;
+				}
+
+				fields[2].string_buf[ret] = '\0';
+			}
+
+			fields[2].string_len = ret;
+		} else if (fields[2].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[2], false);
+			if (ret)
+				return ret;
+		}
+
+		ret = fast_visit_string(msg, 2, fields + 2);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x10)) {
+			ret = fast_get_int(buffer, &fields[3].int_value);
+			if (ret)
+				return ret;
+
+			fields[3].state = FAST_STATE_ASSIGNED;
+
+			if (!fields[3].int_value)
+				fields[3].state = FAST_STATE_EMPTY;
+			else if (fields[3].int_value > 0)
+				fields[3].int_value--;
+		} else if (fields[3].state == FAST_STATE_ASSIGNED) {
+			fields[3].int_value++;
+		} else if (fields[3].state == FAST_STATE_UNDEFINED) {
+			fields[3].state = FAST_STATE_EMPTY;
+		}
+
+		ret = fast_visit_int(msg, 3, fields + 3);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x08))
+			fields[4].state = FAST_STATE_ASSIGNED;
+		else
+			fields[4].state = FAST_STATE_EMPTY;
+
+		ret = fast_visit_uint(msg, 4, fields + 4);
+		if (ret)
+			return ret;
+
+		if (spmap.nr_bytes > 0 && (spmap.bytes[0] & 0x04)) {
+			ret = fast_decode_decimal(buffer, &spmap, &fields[5], FAST_OP_NONE, false, 0);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[5]);
+		} else {
+			fast_dict_load(dict, &fields[5]);
+
+			if (fields[5].state == FAST_STATE_UNDEFINED) {
+				fields[5].state = FAST_STATE_EMPTY;
+
+				fast_dict_store(dict, &fields[5]);
+			}
+		}
+
+		ret = fast_visit_decimal(msg, 5, fields + 5);
+		if (ret)
+			return ret;
+	}
+
+	return fast_visit_sequence_end(msg, 5);
+}
+
+static int codegen_2_visit(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	int ret;
+
+	ret = fast_get_uint(buffer, &fields[0].uint_value);
+	if (ret)
+		return ret;
+
+	fields[0].state = FAST_STATE_ASSIGNED;
+
+	ret = fast_visit_uint(msg, 0, fields + 0);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x20)) {
+		ret = fast_get_uint(buffer, &fields[1].uint_value);
+		if (ret)
+			return ret;
+
+		fields[1].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[1]);
+	} else {
+		fast_dict_load(dict, &fields[1]);
+
+		if (fields[1].state == FAST_STATE_UNDEFINED) {
+			fields[1].state = FAST_STATE_ASSIGNED;
+			fields[1].uint_value = fields[1].uint_reset;
+
+			fast_dict_store(dict, &fields[1]);
+		} else if (fields[1].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_uint(msg, 1, fields + 1);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x10)) {
+		ret = fast_get_int(buffer, &fields[2].int_value);
+		if (ret)
+			return ret;
+
+		fields[2].state = FAST_STATE_ASSIGNED;
+
+		fast_dict_store(dict, &fields[2]);
+	} else {
+		fast_dict_load(dict, &fields[2]);
+
+		if (fields[2].state == FAST_STATE_ASSIGNED) {
+			fields[2].int_value++;
+			fast_dict_store(dict, &fields[2]);
+		} else if (fields[2].state == FAST_STATE_UNDEFINED) {
+			fields[2].state = FAST_STATE_ASSIGNED;
+			fields[2].int_value = fields[2].int_reset;
+
+			fast_dict_store(dict, &fields[2]);
+		} else if (fields[2].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_int(msg, 2, fields + 2);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x08)) {
+		ret = fast_get_string(buffer, fields[3].string_buf, fields[3].string_size);
+		if (ret < 0)
+			return ret;
+
+		fields[3].state = FAST_STATE_ASSIGNED;
+		fields[3].string_value = fields[3].string_buf;
+
+		if (unlikely(!fields[3].string_buf[0])) {
+			ret -= 1;
+
+			fields[3].string_buf[ret] = '\0';
+		}
+
+		fields[3].string_len = ret;
+
+		fast_dict_store(dict, &fields[3]);
+	} else {
+		ret = fast_dict_load(dict, &fields[3]);
+		if (ret)
+			return ret;
+
+		if (fields[3].state == FAST_STATE_UNDEFINED) {
+			ret = fast_read_reset(&fields[3], true);
+			if (ret)
+				return ret;
+
+			fast_dict_store(dict, &fields[3]);
+		} else if (fields[3].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_string(msg, 3, fields + 3);
+	if (ret)
+		return ret;
+
+	if (pmap->nr_bytes > 0 && (pmap->bytes[0] & 0x04)) {
+		ret = fast_decode_decimal(buffer, pmap, &fields[4], FAST_OP_NONE, true, 0);
+		if (ret)
+			return ret;
+
+		fast_dict_store(dict, &fields[4]);
+	} else {
+		fast_dict_load(dict, &fields[4]);
+
+		if (fields[4].state == FAST_STATE_UNDEFINED) {
+			return FAST_MSG_STATE_GARBLED;
+		} else if (fields[4].state == FAST_STATE_EMPTY) {
+			return FAST_MSG_STATE_GARBLED;
+		}
+	}
+
+	ret = fast_visit_decimal(msg, 4, fields + 4);
+	if (ret)
+		return ret;
+
+	ret = codegen_2_seq5_visit(buffer, pmap, msg);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int codegen_2_seq5_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_sequence *seq = msg->fields[5].ptr_value;
+	struct fast_field *fields = seq->element.fields;
+	struct fast_dictionary *dict = msg->dictionary;
+	struct fast_pmap spmap;
+	struct fast_field *cur;
+	unsigned long offset;
+	unsigned long i;
+
+	if (fast_encode_uint(buffer, pmap, &seq->length, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (field_state_empty(&seq->length))
+		return -1;
+
+	if (seq->length.uint_value > seq->max_elements)
+		return -1;
+
+	spmap.nr_bytes = 0;
+
+	for (i = 0; i < seq->length.uint_value; i++) {
+		cur = fast_sequence_element(seq, i);
+
+		if (fast_pmap_reserve(buffer, &spmap, &offset))
+			return -1;
+
+		fields[0].uint_value = cur[0].uint_value;
+		fields[0].state = cur[0].state;
+		if (fast_encode_uint(buffer, &spmap, fields + 0, FAST_OP_COPY, true, 0))
+			return -1;
+
+		field_copy_string(fields + 1, cur + 1);
+		fields[1].state = cur[1].state;
+		if (fast_encode_string(buffer, &spmap, fields + 1, FAST_OP_CONSTANT, true, 0))
+			return -1;
+
+		field_copy_string(fields + 2, cur + 2);
+		fields[2].state = cur[2].state;
+		if (fast_encode_string(buffer, &spmap, fields + 2, FAST_OP_COPY, false, 1))
+			return -1;
+
+		fields[3].int_value = cur[3].int_value;
+		fields[3].state = cur[3].state;
+		if (fast_encode_int(buffer, &spmap, fields + 3, FAST_OP_INCR, false, 2))
+			return -1;
+
+		fields[4].uint_value = cur[4].uint_value;
+		fields[4].state = cur[4].state;
+		if (fast_encode_uint(buffer, &spmap, fields + 4, FAST_OP_CONSTANT, false, 3))
+			return -1;
+
+		fields[5].decimal_value = cur[5].decimal_value;
+		fields[5].state = cur[5].state;
+		if (fast_dict_load_previous(dict, fields + 5))
+			return -1;
+		if (fast_encode_decimal(buffer, &spmap, fields + 5, FAST_OP_COPY, false, 4))
+			return -1;
+		fast_dict_store_previous(dict, fields + 5);
+
+		fast_pmap_commit(buffer, &spmap, offset);
+	}
+
+	return 0;
+}
+
+static int codegen_2_encode(struct buffer *buffer, struct fast_pmap *pmap, struct fast_message *msg)
+{
+	struct fast_field *fields = msg->fields;
+	struct fast_dictionary *dict = msg->dictionary;
+
+	if (fast_encode_uint(buffer, pmap, fields + 0, FAST_OP_NONE, true, 0))
+		return -1;
+
+	if (fast_dict_load_previous(dict, fields + 1))
+		return -1;
+	if (fast_encode_uint(buffer, pmap, fields + 1, FAST_OP_COPY, true, 1))
+		return -1;
+	fast_dict_store_previous(dict, fields + 1);
+
+	if (fast_dict_load_previous(dict, fields + 2))
+		return -1;
+	if (fast_encode_int(buffer, pmap, fields + 2, FAST_OP_INCR, true, 2))
+		return -1;
+	fast_dict_store_previous(dict, fields + 2);
+
+	if (fast_dict_load_previous(dict, fields + 3))
+		return -1;
+	if (fast_encode_string(buffer, pmap, fields + 3, FAST_OP_COPY, true, 3))
+		return -1;
+	fast_dict_store_previous(dict, fields + 3);
+
+	if (fast_dict_load_previous(dict, fields + 4))
+		return -1;
+	if (fast_encode_decimal(buffer, pmap, fields + 4, FAST_OP_COPY, true, 4))
+		return -1;
+	fast_dict_store_previous(dict, fields + 4);
+
+	if (codegen_2_seq5_encode(buffer, pmap, msg))
+		return -1;
+
+	return 0;
+}
+
+extern const struct fast_template_codec codegen_codecs[];
+extern const unsigned long codegen_nr_codecs;
+
+const struct fast_template_codec codegen_codecs[] = {
+	{
+		.tid		= 1,
+		.signature	= 0x9855f07037453093ULL,
+		.decode		= codegen_1_decode,
+		.visit		= codegen_1_visit,
+		.encode		= codegen_1_encode,
+	},
+	{
+		.tid		= 2,
+		.signature	= 0x3f21f33ddfec9fa2ULL,
+		.decode		= codegen_2_decode,
+		.visit		= codegen_2_visit,
+		.encode		= codegen_2_encode,
+	},
+};
+
+const unsigned long codegen_nr_codecs = sizeof(codegen_codecs) / sizeof(codegen_codecs[0]);
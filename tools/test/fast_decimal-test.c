@@ -0,0 +1,87 @@
+#include "test-suite.h"
+#include "harness.h"
+
+#include "libtrading/proto/fast_decimal.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+static void assert_fixed(i64 expected, i64 mnt, i64 exp, i64 tick)
+{
+	struct fast_decimal decimal = { .exp = exp, .mnt = mnt };
+	i64 value = 0;
+
+	assert_int_equals(0, fast_decimal_to_fixed(&decimal, tick, &value));
+	assert_int_equals(expected, value);
+}
+
+static void assert_fixed_fails(i64 mnt, i64 exp, i64 tick)
+{
+	struct fast_decimal decimal = { .exp = exp, .mnt = mnt };
+	i64 value = 0;
+
+	assert_int_equals(-1, fast_decimal_to_fixed(&decimal, tick, &value));
+}
+
+void test_fast_decimal_to_fixed(void)
+{
+	assert_fixed(12345, 12345, -2, -2);
+	assert_fixed(123450, 12345, -2, -3);
+	assert_fixed(-1234500000, -12345, -2, -7);
+	assert_fixed(1234, 123400, -4, -2);
+	assert_fixed(0, 0, 60, -8);
+	assert_fixed(4200000000, 42, 0, -8);
+	assert_fixed(INT64_MAX, INT64_MAX, 0, 0);
+
+	/* Digits below the tick */
+	assert_fixed_fails(12345, -3, -2);
+	assert_fixed_fails(1, -20, 0);
+
+	/* Too big for an i64 */
+	assert_fixed_fails(INT64_MAX / 10 + 1, 0, -1);
+	assert_fixed_fails(1, 19, 0);
+	assert_fixed_fails(-922337203685477581LL, -1, -2);
+}
+
+static void assert_double(i64 mnt, i64 exp)
+{
+	struct fast_decimal decimal = { .exp = exp, .mnt = mnt };
+	char buf[64];
+	double d;
+
+	snprintf(buf, sizeof(buf), "%" PRId64 "e%" PRId64, mnt, exp);
+
+	d = fast_decimal_to_double(&decimal);
+
+	assert_true(d == strtod(buf, NULL));
+}
+
+void test_fast_decimal_to_double(void)
+{
+	i64 mnt = 1;
+	int exp;
+	int i;
+
+	assert_double(0, 0);
+	assert_double(12345, -2);
+	assert_double(-12345, -2);
+	assert_double(1, -22);
+	assert_double(7, 22);
+
+	/* Slow path: the mantissa or the power of ten is not exact */
+	assert_double(FAST_DOUBLE_MANTISSA_MAX + 1, -3);
+	assert_double(INT64_MAX, -10);
+	assert_double(INT64_MIN + 1, 5);
+	assert_double(3, -23);
+	assert_double(3, 23);
+	assert_double(1, -63);
+
+	for (i = 0; i < 1000; i++) {
+		mnt = mnt * 6364136223846793005ULL + 1442695040888963407ULL;
+
+		for (exp = -30; exp <= 30; exp += 3)
+			assert_double(mnt >> (i % 64), exp);
+	}
+}
@@ -0,0 +1,649 @@
+#include "test-suite.h"
+#include "harness.h"
+
+#include "libtrading/proto/fast_publisher.h"
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_message.h"
+#include "libtrading/proto/fast_feed.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+
+#define	FEED_GROUP_A	"239.255.0.1"
+#define	FEED_GROUP_B	"239.255.0.2"
+
+struct feed_log {
+	unsigned long		nr;
+	u64			values[128];
+};
+
+static int feed_log_message(struct fast_feed *feed, struct fast_message *msg)
+{
+	struct feed_log *log = feed->data;
+
+	log->values[log->nr++] = msg->fields[0].uint_value;
+
+	return 0;
+}
+
+static struct fast_session *feed_session(void)
+{
+	char xml[] = "/tmp/fast-templates-XXXXXX";
+	struct fast_session *session;
+	FILE *stream;
+	int fd;
+
+	fd = mkstemp(xml);
+	assert_true(fd >= 0);
+
+	stream = fdopen(fd, "w");
+	assert_true(stream != NULL);
+
+	fprintf(stream, "<templates>"
+		"<template id=\"1\"><uInt32/></template>"
+		"<template id=\"2\"><uInt32><increment/></uInt32></template>"
+		"<template id=\"3\"><uInt32/><uInt32><copy/></uInt32></template>"
+		"<template id=\"120\" reset=\"T\"/>"
+		"</templates>\n");
+	fclose(stream);
+
+	session = fast_session_new(-1);
+	assert_int_equals(0, fast_suite_template(session, xml));
+
+	unlink(xml);
+
+	return session;
+}
+
+static struct fast_feed *feed_new(struct feed_log *log)
+{
+	struct fast_session *session;
+	struct fast_feed *feed;
+
+	session = feed_session();
+
+	feed = fast_feed_new(session);
+	assert_true(feed != NULL);
+
+	memset(log, 0, sizeof(*log));
+
+	feed->handler	= feed_log_message;
+	feed->data	= log;
+
+	return feed;
+}
+
+static void feed_free(struct fast_feed *feed)
+{
+	struct fast_session *session = feed->session;
+
+	fast_feed_free(feed);
+	fast_session_free(session);
+}
+
+/* One message of template 1 that carries the sequence number */
+static unsigned long feed_packet(char *buf, u32 seq)
+{
+	u32 le = htole32(seq);
+	unsigned long len = 0;
+
+	memcpy(buf, &le, sizeof(le));
+	len += sizeof(le);
+
+	buf[len++] = 0xc0;
+	buf[len++] = 0x81;
+	buf[len++] = (seq >> 7) & 0x7f;
+	buf[len++] = (seq & 0x7f) | 0x80;
+
+	return len;
+}
+
+static void feed_send(struct fast_feed *feed, enum fast_feed_line line, u32 seq)
+{
+	char buf[16];
+	unsigned long len;
+
+	len = feed_packet(buf, seq);
+
+	assert_int_equals(0, fast_feed_process(feed, line, buf, len));
+}
+
+void test_fast_feed_arbitration(void)
+{
+	struct fast_feed *feed;
+	struct feed_log log;
+
+	feed = feed_new(&log);
+
+	feed_send(feed, FAST_FEED_LINE_A, 1);
+	feed_send(feed, FAST_FEED_LINE_B, 1);
+	feed_send(feed, FAST_FEED_LINE_B, 2);
+	feed_send(feed, FAST_FEED_LINE_A, 2);
+	feed_send(feed, FAST_FEED_LINE_A, 3);
+
+	/* Lost on both lines */
+	feed_send(feed, FAST_FEED_LINE_A, 6);
+	feed_send(feed, FAST_FEED_LINE_B, 6);
+	feed_send(feed, FAST_FEED_LINE_B, 4);
+
+	assert_int_equals(4, log.nr);
+	assert_int_equals(1, log.values[0]);
+	assert_int_equals(2, log.values[1]);
+	assert_int_equals(3, log.values[2]);
+	assert_int_equals(6, log.values[3]);
+
+	assert_int_equals(4, feed->stats.nr_packets[FAST_FEED_LINE_A]);
+	assert_int_equals(4, feed->stats.nr_packets[FAST_FEED_LINE_B]);
+	assert_int_equals(3, feed->stats.nr_wins[FAST_FEED_LINE_A]);
+	assert_int_equals(1, feed->stats.nr_wins[FAST_FEED_LINE_B]);
+	assert_int_equals(4, feed->stats.nr_duplicates);
+	assert_int_equals(1, feed->stats.nr_gaps);
+	assert_int_equals(2, feed->stats.nr_lost);
+	assert_int_equals(4, feed->stats.nr_messages);
+	assert_int_equals(0, feed->stats.nr_errors);
+
+	feed_free(feed);
+}
+
+/* The rest of a packet is dropped after a message that fails to decode */
+void test_fast_feed_resync(void)
+{
+	struct fast_session *session;
+	struct fast_feed *feed;
+	struct feed_log log;
+	u64 generation;
+	unsigned long len;
+	char buf[16];
+
+	feed = feed_new(&log);
+	session = feed->session;
+
+	feed_send(feed, FAST_FEED_LINE_A, 1);
+
+	/* Template 5 does not exist */
+	len = feed_packet(buf, 2);
+	buf[len++] = 0xc0;
+	buf[len++] = 0x85;
+	buf[len++] = 0x80;
+
+	generation = session->dictionary.generation;
+
+	assert_int_equals(0, fast_feed_process(feed, FAST_FEED_LINE_A, buf, len));
+	assert_int_equals(1, feed->stats.nr_errors);
+	assert_true(session->dictionary.generation != generation);
+
+	feed_send(feed, FAST_FEED_LINE_A, 3);
+
+	assert_int_equals(3, log.nr);
+	assert_int_equals(1, log.values[0]);
+	assert_int_equals(2, log.values[1]);
+	assert_int_equals(3, log.values[2]);
+	assert_int_equals(0, feed->stats.nr_gaps);
+	assert_int_equals(3, feed->stats.nr_messages);
+
+	feed_free(feed);
+}
+
+static int feed_stop_uint(void *data, unsigned long field, u64 value)
+{
+	return value == 2 ? 1 : 0;
+}
+
+static const struct fast_visitor feed_stopper = {
+	.on_uint	= feed_stop_uint,
+};
+
+/* A visitor that stops decoding is not taken for a broken packet */
+void test_fast_feed_visitor_stop(void)
+{
+	struct fast_session *session;
+	struct fast_feed *feed;
+	struct feed_log log;
+	u64 generation;
+	unsigned long len;
+	char buf[16];
+
+	feed = feed_new(&log);
+	session = feed->session;
+
+	assert_int_equals(0, fast_session_set_visitor(session, 1, &feed_stopper, NULL));
+
+	feed_send(feed, FAST_FEED_LINE_A, 1);
+
+	generation = session->dictionary.generation;
+
+	len = feed_packet(buf, 2);
+	assert_int_equals(FAST_MSG_STATE_STOPPED, fast_feed_process(feed, FAST_FEED_LINE_A, buf, len));
+	assert_int_equals(0, feed->stats.nr_errors);
+	assert_true(session->dictionary.generation == generation);
+
+	feed_send(feed, FAST_FEED_LINE_A, 3);
+
+	assert_int_equals(2, log.nr);
+	assert_int_equals(1, log.values[0]);
+	assert_int_equals(3, log.values[1]);
+	assert_int_equals(2, feed->stats.nr_messages);
+
+	feed_free(feed);
+}
+
+/* A publisher that starts over is followed instead of taken for duplicates */
+void test_fast_feed_restart(void)
+{
+	struct fast_feed *feed;
+	struct feed_log log;
+
+	feed = feed_new(&log);
+
+	feed_send(feed, FAST_FEED_LINE_A, 1);
+	feed_send(feed, FAST_FEED_LINE_A, 2);
+	feed_send(feed, FAST_FEED_LINE_B, 1);
+	feed_send(feed, FAST_FEED_LINE_A, 3);
+
+	/* Line A goes back to the first packet, line B follows it */
+	feed_send(feed, FAST_FEED_LINE_A, 1);
+	feed_send(feed, FAST_FEED_LINE_B, 1);
+	feed_send(feed, FAST_FEED_LINE_A, 2);
+	feed_send(feed, FAST_FEED_LINE_B, 2);
+
+	assert_int_equals(5, log.nr);
+	assert_int_equals(3, log.values[2]);
+	assert_int_equals(1, log.values[3]);
+	assert_int_equals(2, log.values[4]);
+
+	assert_int_equals(1, feed->stats.nr_restarts);
+	assert_int_equals(3, feed->stats.nr_duplicates);
+	assert_int_equals(0, feed->stats.nr_gaps);
+
+	/* The sequence numbers wrap around */
+	feed_send(feed, FAST_FEED_LINE_A, 0xfffffffe);
+	feed_send(feed, FAST_FEED_LINE_A, 0xffffffff);
+	feed_send(feed, FAST_FEED_LINE_A, 0);
+	feed_send(feed, FAST_FEED_LINE_A, 1);
+
+	assert_int_equals(9, log.nr);
+	assert_int_equals(2, feed->stats.nr_restarts);
+	assert_int_equals(1, feed->stats.nr_gaps);
+
+	feed_free(feed);
+}
+
+static int feed_port(struct fast_feed *feed, enum fast_feed_line line)
+{
+	struct sockaddr_in sa;
+	socklen_t len = sizeof(sa);
+
+	assert_int_equals(0, getsockname(feed->sockfd[line], (struct sockaddr *) &sa, &len));
+
+	return ntohs(sa.sin_port);
+}
+
+static void feed_publish(int sockfd, const char *group, int port, u32 seq)
+{
+	struct sockaddr_in sa;
+	unsigned long len;
+	char buf[16];
+
+	sa = (struct sockaddr_in) {
+		.sin_family		= AF_INET,
+		.sin_port		= htons(port),
+		.sin_addr		= (struct in_addr) {
+			.s_addr			= inet_addr(group),
+		},
+	};
+
+	len = feed_packet(buf, seq);
+
+	assert_int_equals(len, sendto(sockfd, buf, len, 0, (const struct sockaddr *) &sa, sizeof(sa)));
+}
+
+void test_fast_feed_loopback(void)
+{
+	struct in_addr ifaddr;
+	struct fast_feed *feed;
+	struct feed_log log;
+	int port_a, port_b;
+	int sockfd;
+	int nr = 0;
+	int i;
+
+	feed = feed_new(&log);
+
+	assert_int_equals(0, fast_feed_join(feed, FAST_FEED_LINE_A, FEED_GROUP_A, 0, "127.0.0.1"));
+	assert_int_equals(0, fast_feed_join(feed, FAST_FEED_LINE_B, FEED_GROUP_B, 0, "127.0.0.1"));
+
+	port_a = feed_port(feed, FAST_FEED_LINE_A);
+	port_b = feed_port(feed, FAST_FEED_LINE_B);
+
+	sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	assert_true(sockfd >= 0);
+
+	ifaddr.s_addr = inet_addr("127.0.0.1");
+	assert_int_equals(0, setsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)));
+
+	/* Line A drops 3 and 4, line B drops 4 to 6 and lags behind */
+	for (i = 1; i <= 10; i++) {
+		if (i != 3 && i != 4)
+			feed_publish(sockfd, FEED_GROUP_A, port_a, i);
+	}
+
+	for (i = 1; i <= 10; i++) {
+		if (i < 4 || i > 6)
+			feed_publish(sockfd, FEED_GROUP_B, port_b, i);
+	}
+
+	while (nr < 15) {
+		i = fast_feed_poll(feed, 1000);
+		assert_true(i > 0);
+		nr += i;
+	}
+
+	assert_int_equals(9, log.nr);
+	assert_int_equals(3, log.values[2]);
+	assert_int_equals(5, log.values[3]);
+	assert_int_equals(10, log.values[8]);
+
+	assert_int_equals(8, feed->stats.nr_wins[FAST_FEED_LINE_A]);
+	assert_int_equals(1, feed->stats.nr_wins[FAST_FEED_LINE_B]);
+	assert_int_equals(6, feed->stats.nr_duplicates);
+	assert_int_equals(1, feed->stats.nr_gaps);
+	assert_int_equals(1, feed->stats.nr_lost);
+
+	close(sockfd);
+	feed_free(feed);
+}
+
+static void feed_poll(struct fast_feed *feed, int nr_packets)
+{
+	int nr = 0;
+	int i;
+
+	while (nr < nr_packets) {
+		i = fast_feed_poll(feed, 1000);
+		assert_true(i > 0);
+		nr += i;
+	}
+}
+
+/* A restart in the middle of a batch is not sorted ahead of the old packets */
+void test_fast_feed_poll_restart(void)
+{
+	struct fast_feed *feed;
+	struct feed_log log;
+	int port_a, port_b;
+	int sockfd;
+	int i;
+
+	feed = feed_new(&log);
+
+	assert_int_equals(0, fast_feed_join(feed, FAST_FEED_LINE_A, "127.0.0.1", 0, NULL));
+	assert_int_equals(0, fast_feed_join(feed, FAST_FEED_LINE_B, "127.0.0.1", 0, NULL));
+
+	port_a = feed_port(feed, FAST_FEED_LINE_A);
+	port_b = feed_port(feed, FAST_FEED_LINE_B);
+
+	sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	assert_true(sockfd >= 0);
+
+	for (i = 1; i <= 100; i++)
+		feed_publish(sockfd, "127.0.0.1", port_a, i);
+
+	feed_poll(feed, 100);
+
+	/* 101 and 102, then 1 to 5 after the restart, on both lines */
+	for (i = 101; i <= 107; i++) {
+		feed_publish(sockfd, "127.0.0.1", port_a, i <= 102 ? i : i - 102);
+		feed_publish(sockfd, "127.0.0.1", port_b, i <= 102 ? i : i - 102);
+	}
+
+	feed_poll(feed, 14);
+
+	for (i = 6; i <= 10; i++)
+		feed_publish(sockfd, "127.0.0.1", port_a, i);
+
+	feed_poll(feed, 5);
+
+	assert_int_equals(112, log.nr);
+	assert_int_equals(102, log.values[101]);
+	assert_int_equals(1, log.values[102]);
+	assert_int_equals(10, log.values[111]);
+
+	assert_int_equals(1, feed->stats.nr_restarts);
+	assert_int_equals(7, feed->stats.nr_duplicates);
+	assert_int_equals(0, feed->stats.nr_gaps);
+	assert_int_equals(0, feed->stats.nr_lost);
+	assert_int_equals(11, feed->next_seq);
+
+	close(sockfd);
+	feed_free(feed);
+}
+
+/* A datagram that does not fit in the receive buffer is dropped */
+void test_fast_feed_oversized(void)
+{
+	char big[FAST_FEED_PACKET_SIZE + 64];
+	struct sockaddr_in sa;
+	struct fast_feed *feed;
+	struct feed_log log;
+	unsigned long len;
+	int sockfd;
+	int nr = 0;
+	int i;
+
+	feed = feed_new(&log);
+
+	assert_int_equals(0, fast_feed_join(feed, FAST_FEED_LINE_A, "127.0.0.1", 0, NULL));
+
+	sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	assert_true(sockfd >= 0);
+
+	/* Starts with a good message that the cut off copy would decode */
+	memset(big, 0x80, sizeof(big));
+	len = feed_packet(big, 1);
+	assert_true(len < sizeof(big));
+
+	sa = (struct sockaddr_in) {
+		.sin_family		= AF_INET,
+		.sin_port		= htons(feed_port(feed, FAST_FEED_LINE_A)),
+		.sin_addr		= (struct in_addr) {
+			.s_addr			= inet_addr("127.0.0.1"),
+		},
+	};
+
+	assert_int_equals(sizeof(big), sendto(sockfd, big, sizeof(big), 0, (const struct sockaddr *) &sa, sizeof(sa)));
+
+	feed_publish(sockfd, "127.0.0.1", ntohs(sa.sin_port), 2);
+
+	while (nr < 2) {
+		i = fast_feed_poll(feed, 1000);
+		assert_true(i > 0);
+		nr += i;
+	}
+
+	assert_int_equals(1, feed->stats.nr_oversized);
+	assert_int_equals(2, feed->stats.nr_packets[FAST_FEED_LINE_A]);
+	assert_int_equals(0, feed->stats.nr_errors);
+
+	assert_int_equals(1, log.nr);
+	assert_int_equals(2, log.values[0]);
+
+	close(sockfd);
+	feed_free(feed);
+}
+
+#define	PUBLISH_PACKET_SIZE	16
+#define	PUBLISH_MESSAGES	40
+
+/*
+ * Publishes messages of template 2, which only send a value that is not
+ * one more than the last, over a datagram socket pair and feeds every
+ * packet to a fast_feed with its own session.
+ */
+static void publish_roundtrip(int flags, int feed_flags, unsigned long reset_interval)
+{
+	struct fast_publisher *publisher;
+	struct fast_session *session;
+	char buf[FAST_FEED_PACKET_SIZE];
+	struct fast_message *msg;
+	struct fast_feed *feed;
+	unsigned long nr = 0;
+	struct feed_log log;
+	u64 value = 0;
+	ssize_t len;
+	int sv[2];
+	int i;
+
+	assert_int_equals(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+
+	feed = feed_new(&log);
+	feed->flags = feed_flags;
+
+	session = feed_session();
+	session->sockfd = sv[0];
+
+	publisher = fast_publisher_new(session, PUBLISH_PACKET_SIZE);
+	assert_true(publisher != NULL);
+
+	publisher->flags = flags;
+
+	if (reset_interval)
+		assert_int_equals(0, fast_publisher_set_reset(publisher, 120, reset_interval));
+
+	msg = fast_tid_lookup(&session->rx_map, 2);
+	assert_true(msg != NULL);
+
+	for (i = 0; i < PUBLISH_MESSAGES; i++) {
+		value += 1 + (i % 3 == 0);
+
+		msg->fields[0].state		= FAST_STATE_ASSIGNED;
+		msg->fields[0].uint_value	= value;
+
+		assert_int_equals(0, fast_publisher_add(publisher, msg));
+	}
+
+	assert_int_equals(0, fast_publisher_flush(publisher));
+
+	/* Flushing again sends nothing */
+	assert_int_equals(0, fast_publisher_flush(publisher));
+
+	while ((len = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+		assert_true(len <= PUBLISH_PACKET_SIZE);
+		assert_int_equals(0, fast_feed_process(feed, FAST_FEED_LINE_A, buf, len));
+		nr++;
+	}
+
+	assert_int_equals(EAGAIN, errno);
+
+	assert_int_equals(PUBLISH_MESSAGES, publisher->stats.nr_messages);
+	assert_int_equals(nr, publisher->stats.nr_packets);
+	assert_true(nr > 1);
+
+	assert_int_equals(PUBLISH_MESSAGES, log.nr);
+	assert_int_equals(0, feed->stats.nr_gaps);
+	assert_int_equals(0, feed->stats.nr_errors);
+	assert_int_equals(PUBLISH_MESSAGES + publisher->stats.nr_resets, feed->stats.nr_messages);
+
+	value = 0;
+
+	for (i = 0; i < PUBLISH_MESSAGES; i++) {
+		value += 1 + (i % 3 == 0);
+		assert_int_equals(value, log.values[i]);
+	}
+
+	if (reset_interval)
+		assert_int_equals((nr + reset_interval - 1) / reset_interval, publisher->stats.nr_resets);
+
+	fast_publisher_free(publisher);
+	fast_session_free(session);
+	feed_free(feed);
+	close(sv[0]);
+	close(sv[1]);
+}
+
+void test_fast_publisher_packets(void)
+{
+	publish_roundtrip(FAST_PUBLISHER_FLAGS_SEQ, 0, 0);
+}
+
+void test_fast_publisher_packet_reset(void)
+{
+	publish_roundtrip(FAST_PUBLISHER_FLAGS_SEQ | FAST_PUBLISHER_FLAGS_PACKET_RESET, FAST_FEED_FLAGS_PACKET_RESET, 0);
+}
+
+void test_fast_publisher_reset_message(void)
+{
+	publish_roundtrip(FAST_PUBLISHER_FLAGS_SEQ, 0, 3);
+}
+
+/* A message that fails to encode leaves nothing behind in the packet */
+void test_fast_publisher_encode_failure(void)
+{
+	struct fast_publisher *publisher;
+	struct fast_session *session;
+	char buf[FAST_FEED_PACKET_SIZE];
+	struct fast_message *msg;
+	struct fast_message *bad;
+	struct fast_feed *feed;
+	struct feed_log log;
+	ssize_t len;
+	int sv[2];
+
+	assert_int_equals(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+
+	feed = feed_new(&log);
+
+	session = feed_session();
+	session->sockfd = sv[0];
+
+	publisher = fast_publisher_new(session, 1024);
+	assert_true(publisher != NULL);
+
+	publisher->flags = FAST_PUBLISHER_FLAGS_SEQ;
+
+	msg = fast_tid_lookup(&session->rx_map, 2);
+	bad = fast_tid_lookup(&session->rx_map, 3);
+	assert_true(msg != NULL && bad != NULL);
+
+	msg->fields[0].state		= FAST_STATE_ASSIGNED;
+	msg->fields[0].uint_value	= 5;
+	assert_int_equals(0, fast_publisher_add(publisher, msg));
+
+	/* The first field is written before the empty copy field fails */
+	bad->fields[0].state		= FAST_STATE_ASSIGNED;
+	bad->fields[0].uint_value	= 7;
+	field_set_empty(bad->fields + 1);
+	assert_int_equals(-1, fast_publisher_add(publisher, bad));
+
+	msg->fields[0].uint_value	= 9;
+	assert_int_equals(0, fast_publisher_add(publisher, msg));
+
+	assert_int_equals(0, fast_publisher_flush(publisher));
+
+	len = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT);
+	assert_true(len > 0);
+
+	/* Sequence number, then two messages of a pmap, a tid and a value */
+	assert_int_equals(FAST_FEED_SEQ_SIZE + 2 * 3, len);
+
+	assert_int_equals(0, fast_feed_process(feed, FAST_FEED_LINE_A, buf, len));
+
+	assert_int_equals(0, feed->stats.nr_errors);
+	assert_int_equals(2, log.nr);
+	assert_int_equals(5, log.values[0]);
+	assert_int_equals(9, log.values[1]);
+
+	assert_int_equals(2, publisher->stats.nr_messages);
+
+	fast_publisher_free(publisher);
+	fast_session_free(session);
+	feed_free(feed);
+	close(sv[0]);
+	close(sv[1]);
+}
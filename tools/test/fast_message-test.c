@@ -0,0 +1,1951 @@
+#include "test-suite.h"
+#include "harness.h"
+
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_message.h"
+#include "libtrading/proto/fast_codec.h"
+#include "libtrading/buffer.h"
+#include "libtrading/array.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+static void put_uint(struct buffer *buf, u64 value)
+{
+	char bytes[10];
+	int i = 0;
+
+	do {
+		bytes[i++] = value & 0x7f;
+		value >>= 7;
+	} while (value);
+
+	bytes[0] |= 0x80;
+
+	while (i--)
+		buffer_put(buf, bytes[i]);
+}
+
+static void put_int(struct buffer *buf, i64 value)
+{
+	char bytes[10];
+	int i = 0;
+
+	for (;;) {
+		bytes[i++] = value & 0x7f;
+		value >>= 7;
+
+		if (value == 0 && !(bytes[i - 1] & 0x40))
+			break;
+
+		if (value == -1 && (bytes[i - 1] & 0x40))
+			break;
+	}
+
+	bytes[0] |= 0x80;
+
+	while (i--)
+		buffer_put(buf, bytes[i]);
+}
+
+/*
+ * The stop bit decoders take a fast path when enough bytes are left in the
+ * buffer and the byte-by-byte parsers otherwise. Both must agree.
+ */
+static void put_padding(struct buffer *buf, int padding)
+{
+	while (padding--)
+		buffer_put(buf, 0x80);
+}
+
+static const int paddings[] = { 0, 1, FAST_STOP_BIT_BYTES };
+
+void test_fast_get_uint(void)
+{
+	struct buffer *buf;
+	u64 value;
+	int i, j;
+
+	buf = buffer_new(64);
+
+	for (i = 0; i < 63; i++) {
+		for (j = 0; j < ARRAY_SIZE(paddings); j++) {
+			buffer_reset(buf);
+			put_uint(buf, (1ULL << i) + i);
+			put_padding(buf, paddings[j]);
+
+			assert_int_equals(0, fast_get_uint(buf, &value));
+			assert_true(value == (1ULL << i) + i);
+			assert_int_equals(paddings[j], buffer_size(buf));
+		}
+	}
+
+	/* Ten bytes without a stop bit */
+	buffer_reset(buf);
+	put_padding(buf, FAST_STOP_BIT_BYTES);
+	memset(buffer_start(buf), 0x01, 10);
+
+	assert_int_equals(FAST_MSG_STATE_GARBLED, fast_get_uint(buf, &value));
+
+	buffer_delete(buf);
+}
+
+void test_fast_get_int(void)
+{
+	struct buffer *buf;
+	i64 expected;
+	i64 value;
+	int i, j;
+
+	buf = buffer_new(64);
+
+	for (i = 0; i < 62; i++) {
+		for (j = 0; j < ARRAY_SIZE(paddings); j++) {
+			expected = (1LL << i) + i;
+
+			buffer_reset(buf);
+			put_int(buf, expected);
+			put_int(buf, -expected);
+			put_padding(buf, paddings[j]);
+
+			assert_int_equals(0, fast_get_int(buf, &value));
+			assert_int_equals(expected, value);
+
+			assert_int_equals(0, fast_get_int(buf, &value));
+			assert_int_equals(-expected, value);
+
+			assert_int_equals(paddings[j], buffer_size(buf));
+		}
+	}
+
+	buffer_delete(buf);
+}
+
+/*
+ * The stop bit encoders store eight bytes at once when the buffer has room
+ * to spare and only what the value takes at its very end.
+ */
+static void check_transfer(struct buffer *buf, struct buffer *expected, i64 value, bool sign)
+{
+	unsigned long tail;
+
+	for (tail = 0; tail <= FAST_INT_MAX_BYTES; tail += FAST_INT_MAX_BYTES) {
+		buffer_reset(expected);
+
+		if (sign)
+			put_int(expected, value);
+		else
+			put_uint(expected, value);
+
+		buffer_reset(buf);
+		buf->start = buf->end = tail ? buf->capacity - buffer_size(expected) : 0;
+
+		if (sign)
+			assert_int_equals(0, transfer_int(buf, value));
+		else
+			assert_int_equals(0, transfer_uint(buf, value));
+
+		assert_int_equals(buffer_size(expected), buffer_size(buf));
+		assert_true(!memcmp(buffer_start(expected), buffer_start(buf), buffer_size(buf)));
+	}
+
+	/* One byte short */
+	buffer_reset(buf);
+	buf->end = buf->capacity - buffer_size(expected) + 1;
+
+	if (sign)
+		assert_int_equals(-1, transfer_int(buf, value));
+	else
+		assert_int_equals(-1, transfer_uint(buf, value));
+}
+
+void test_fast_transfer_int(void)
+{
+	struct buffer *expected;
+	struct buffer *buf;
+	i64 value;
+	int i;
+
+	buf = buffer_new(64);
+	expected = buffer_new(64);
+
+	for (i = 0; i < 62; i++) {
+		value = (1LL << i) + i;
+
+		check_transfer(buf, expected, value, false);
+		check_transfer(buf, expected, value, true);
+		check_transfer(buf, expected, -value, true);
+	}
+
+	buffer_delete(expected);
+	buffer_delete(buf);
+}
+
+void test_fast_get_string(void)
+{
+	char expected[64];
+	char value[64];
+	struct buffer *buf;
+	int i, j;
+
+	buf = buffer_new(128);
+
+	for (i = 1; i < 50; i++) {
+		for (j = 0; j < ARRAY_SIZE(paddings); j++) {
+			memset(expected, 'a' + j, i);
+			expected[i] = '\0';
+
+			buffer_reset(buf);
+			buffer_printf(buf, "%.*s%c", i - 1, expected, expected[i - 1] | 0x80);
+			put_padding(buf, paddings[j]);
+
+			assert_int_equals(i, fast_get_string(buf, value, sizeof(value)));
+			assert_str_equals(expected, value, i + 1);
+			assert_int_equals(paddings[j], buffer_size(buf));
+		}
+	}
+
+	/* Does not fit in the destination */
+	buffer_reset(buf);
+	buffer_printf(buf, "%.20s", "aaaaaaaaaaaaaaaaaaaa");
+	put_padding(buf, FAST_STOP_BIT_BYTES);
+
+	assert_int_equals(FAST_MSG_STATE_GARBLED, fast_get_string(buf, value, 20));
+
+	buffer_delete(buf);
+}
+
+void test_fast_get_pmap(void)
+{
+	struct fast_pmap pmap;
+	struct buffer *buf;
+	int i, j, k;
+
+	buf = buffer_new(64);
+
+	for (i = 1; i <= FAST_PMAP_MAX_BYTES; i++) {
+		for (j = 0; j < ARRAY_SIZE(paddings); j++) {
+			buffer_reset(buf);
+			for (k = 0; k < i - 1; k++)
+				buffer_put(buf, 0x55);
+			buffer_put(buf, 0x80 | 0x2a);
+			put_padding(buf, paddings[j]);
+
+			assert_int_equals(0, fast_get_pmap(buf, &pmap));
+			assert_int_equals(i, pmap.nr_bytes);
+			assert_true(pmap_is_set(&pmap, 7 * (i - 1) + 1));
+			assert_false(pmap_is_set(&pmap, 7 * (i - 1)));
+			assert_int_equals(paddings[j], buffer_size(buf));
+		}
+	}
+
+	buffer_reset(buf);
+	for (k = 0; k < FAST_PMAP_MAX_BYTES; k++)
+		buffer_put(buf, 0x55);
+	put_padding(buf, FAST_STOP_BIT_BYTES);
+
+	assert_int_equals(FAST_MSG_STATE_GARBLED, fast_get_pmap(buf, &pmap));
+
+	buffer_delete(buf);
+}
+
+void test_fast_tid_map_dense(void)
+{
+	struct fast_tid_map map = {};
+	struct fast_message msgs[10];
+	int i;
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (i = 0; i < 10; i++)
+		msgs[i].tid = i * 3;
+
+	assert_int_equals(0, fast_tid_map_build(&map, msgs, 10));
+	assert_is_null(map.hash);
+
+	for (i = 0; i < 10; i++)
+		assert_true(fast_tid_lookup(&map, i * 3) == msgs + i);
+
+	assert_is_null(fast_tid_lookup(&map, 1));
+	assert_is_null(fast_tid_lookup(&map, 30));
+	assert_is_null(fast_tid_lookup(&map, 100000));
+
+	fast_tid_map_free(&map);
+}
+
+void test_fast_tid_map_sparse(void)
+{
+	static const u64 tids[] = { 7, 2101, 2102, 3500, 100000, 1ULL << 40 };
+	struct fast_message msgs[ARRAY_SIZE(tids)];
+	struct fast_tid_map map = {};
+	int i;
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (i = 0; i < ARRAY_SIZE(tids); i++)
+		msgs[i].tid = tids[i];
+
+	assert_int_equals(0, fast_tid_map_build(&map, msgs, ARRAY_SIZE(tids)));
+
+	for (i = 0; i < ARRAY_SIZE(tids); i++)
+		assert_true(fast_tid_lookup(&map, tids[i]) == msgs + i);
+
+	assert_is_null(fast_tid_lookup(&map, 0));
+	assert_is_null(fast_tid_lookup(&map, 2103));
+	assert_is_null(fast_tid_lookup(&map, 100001));
+
+	fast_tid_map_free(&map);
+}
+
+static void templates_write(char *xml, const char *templates)
+{
+	FILE *stream;
+	int fd;
+
+	fd = mkstemp(xml);
+	assert_true(fd >= 0);
+
+	stream = fdopen(fd, "w");
+	assert_true(stream != NULL);
+
+	fprintf(stream, "<templates>\n%s</templates>\n", templates);
+	fclose(stream);
+}
+
+static struct fast_session *fast_session_templates(const char *templates)
+{
+	char xml[] = "/tmp/fast-templates-XXXXXX";
+	struct fast_session *session;
+
+	templates_write(xml, templates);
+
+	session = fast_session_new(-1);
+	assert_int_equals(0, fast_suite_template(session, xml));
+
+	unlink(xml);
+
+	return session;
+}
+
+void test_fast_session_many_templates(void)
+{
+	struct fast_session *session;
+	struct fast_message *msg;
+	struct buffer *buf;
+	char *templates;
+	int len = 0;
+	int i;
+
+	templates = malloc(500 * 64);
+	assert_true(templates != NULL);
+
+	for (i = 0; i < 500; i++)
+		len += sprintf(templates + len, "<template id=\"%d\"><uInt32><copy/></uInt32></template>\n", 1000 + i * 37);
+
+	session = fast_session_templates(templates);
+	assert_int_equals(500, session->nr_messages);
+
+	free(templates);
+
+	buf = buffer_new(64);
+
+	for (i = 0; i < 500; i += 50) {
+		buffer_reset(buf);
+		buffer_put(buf, 0xe0);
+		put_uint(buf, 1000 + i * 37);
+		put_uint(buf, i);
+
+		msg = fast_message_decode(&session->rx_map, buf, 0);
+		assert_true(msg != NULL);
+		assert_int_equals(1000 + i * 37, msg->tid);
+		assert_int_equals(i, msg->fields[0].uint_value);
+	}
+
+	/* Unknown template id */
+	buffer_reset(buf);
+	buffer_put(buf, 0xe0);
+	put_uint(buf, 1001);
+	put_uint(buf, 0);
+
+	assert_is_null(fast_message_decode(&session->rx_map, buf, 0));
+
+	buffer_delete(buf);
+	fast_session_free(session);
+}
+
+void test_fast_string_max_length(void)
+{
+	struct fast_session *session;
+	struct fast_message *msg;
+	struct buffer *buf;
+
+	session = fast_session_templates("<template id=\"1\"><string maxLength=\"4\"/><string/></template>\n");
+
+	msg = session->rx_messages;
+	assert_int_equals(5, msg->fields[0].string_size);
+	assert_int_equals(FAST_STRING_MAX_BYTES, msg->fields[1].string_size);
+
+	buf = buffer_new(64);
+
+	buffer_put(buf, 0xc0);
+	put_uint(buf, 1);
+	buffer_printf(buf, "abc%c", 'd' | 0x80);
+	buffer_printf(buf, "abcde%c", 'f' | 0x80);
+
+	msg = fast_message_decode(&session->rx_map, buf, 0);
+	assert_true(msg != NULL);
+	assert_str_equals("abcd", msg->fields[0].string_value, 5);
+	assert_str_equals("abcdef", msg->fields[1].string_value, 7);
+
+	/* Longer than the declared maximum */
+	buffer_reset(buf);
+	buffer_put(buf, 0xc0);
+	put_uint(buf, 1);
+	buffer_printf(buf, "abcd%c", 'e' | 0x80);
+	buffer_printf(buf, "abcde%c", 'f' | 0x80);
+
+	assert_is_null(fast_message_decode(&session->rx_map, buf, 0));
+
+	buffer_delete(buf);
+	fast_session_free(session);
+}
+
+static void put_packet_message(struct buffer *buf, bool tid)
+{
+	buffer_put(buf, tid ? 0xc0 : 0x80);
+	if (tid)
+		put_uint(buf, 1);
+
+	put_uint(buf, 300);
+	put_int(buf, -5);
+	buffer_printf(buf, "AB%c", 'C' | 0x80);
+	put_int(buf, -2);
+	put_int(buf, 12345);
+}
+
+void test_fast_packet_decode(void)
+{
+	struct fast_session *session;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	unsigned long first;
+	struct buffer *buf;
+	int i;
+
+	session = fast_session_templates("<template id=\"1\"><uInt32/><int64/><string/><decimal/></template>\n");
+
+	buf = buffer_new(64);
+
+	put_packet_message(buf, true);
+	first = buffer_size(buf);
+	put_packet_message(buf, false);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+
+	for (i = 0; i < 2; i++) {
+		msg = NULL;
+
+		assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+		assert_true(msg != NULL);
+		assert_int_equals(1, msg->tid);
+		assert_int_equals(300, msg->fields[0].uint_value);
+		assert_int_equals(-5, msg->fields[1].int_value);
+		assert_str_equals("ABC", msg->fields[2].string_value, 4);
+		assert_int_equals(-2, msg->fields[3].decimal_value.exp);
+		assert_int_equals(12345, msg->fields[3].decimal_value.mnt);
+	}
+
+	assert_true(fast_packet_empty(&packet));
+	assert_int_equals(FAST_MSG_STATE_TRUNCATED, fast_packet_decode(&session->rx_map, &packet, &msg));
+
+	/* Cut short anywhere, the message is truncated and nothing is consumed */
+	for (i = 0; i < first; i++) {
+		fast_packet_init(&packet, buffer_start(buf), i);
+
+		assert_int_equals(FAST_MSG_STATE_TRUNCATED, fast_packet_decode(&session->rx_map, &packet, &msg));
+		assert_int_equals(0, packet.offset);
+	}
+
+	/* The second message has no template id without the first one */
+	fast_packet_init(&packet, buffer_start(buf) + first, buffer_size(buf) - first);
+	assert_int_equals(FAST_MSG_STATE_GARBLED, fast_packet_decode(&session->rx_map, &packet, &msg));
+
+	buffer_delete(buf);
+	fast_session_free(session);
+}
+
+static void put_encoded(struct buffer *buf, struct fast_message *msg)
+{
+	msg->msg_buf = buf;
+
+	assert_int_equals(0, fast_message_encode(msg));
+}
+
+static bool in_packet(const char *ptr, struct fast_packet *packet)
+{
+	return ptr >= packet->data && ptr < packet->data + packet->len;
+}
+
+void test_fast_string_views(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<byteVector/>"
+		"<string charset=\"unicode\" presence=\"optional\"><copy/></string>"
+		"<string presence=\"optional\"/>"
+		"<string/>"
+		"</template>\n";
+	struct fast_session *session;
+	struct fast_session *enc;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct fast_field *fields;
+	struct buffer *buf;
+
+	session = fast_session_templates(templates);
+	enc = fast_session_templates(templates);
+
+	buf = buffer_new(256);
+
+	fields = enc->rx_messages->fields;
+
+	assert_int_equals(0, field_set_string(fields + 0, "\x00\x01\xff", 3));
+	assert_int_equals(0, field_set_string(fields + 1, "h\xc3\xa9llo", 6));
+	assert_int_equals(0, field_set_string(fields + 2, "", 0));
+	assert_int_equals(0, field_set_string(fields + 3, "", 0));
+	put_encoded(buf, enc->rx_messages);
+
+	assert_int_equals(0, field_set_string(fields + 0, "xy", 2));
+	field_set_empty(fields + 2);
+	assert_int_equals(0, field_set_string(fields + 3, "AB", 2));
+	put_encoded(buf, enc->rx_messages);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+	fields = msg->fields;
+
+	/* Byte vectors are left in the datagram, copied values are not */
+	assert_true(in_packet(fields[0].string_value, &packet));
+	assert_int_equals(3, fields[0].string_len);
+	assert_true(!memcmp("\x00\x01\xff", fields[0].string_value, 3));
+
+	assert_true(fields[1].string_value == fields[1].string_buf);
+	assert_int_equals(6, fields[1].string_len);
+	assert_str_equals("h\xc3\xa9llo", fields[1].string_value, 7);
+
+	assert_int_equals(FAST_STATE_ASSIGNED, fields[2].state);
+	assert_int_equals(0, fields[2].string_len);
+	assert_int_equals(FAST_STATE_ASSIGNED, fields[3].state);
+	assert_int_equals(0, fields[3].string_len);
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+
+	assert_true(in_packet(fields[0].string_value, &packet));
+	assert_int_equals(2, fields[0].string_len);
+	assert_true(!memcmp("xy", fields[0].string_value, 2));
+
+	assert_int_equals(FAST_STATE_ASSIGNED, fields[1].state);
+	assert_int_equals(6, fields[1].string_len);
+	assert_str_equals("h\xc3\xa9llo", fields[1].string_value, 7);
+
+	assert_int_equals(FAST_STATE_EMPTY, fields[2].state);
+	assert_int_equals(2, fields[3].string_len);
+	assert_str_equals("AB", fields[3].string_value, 3);
+
+	assert_true(fast_packet_empty(&packet));
+
+	buffer_delete(buf);
+	fast_session_free(enc);
+	fast_session_free(session);
+}
+
+struct visit_log {
+	char			buf[1024];
+	unsigned long		len;
+	const char		*stop;
+};
+
+static int visit_printf(struct visit_log *log, const char *fmt, ...)
+	__attribute__ ((format (printf, 2, 3)));
+
+static int visit_printf(struct visit_log *log, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	log->len += vsnprintf(log->buf + log->len, sizeof(log->buf) - log->len, fmt, ap);
+	va_end(ap);
+
+	return 0;
+}
+
+static int visit_message(void *data, struct fast_message *msg)
+{
+	return visit_printf(data, "m%lu ", msg->tid);
+}
+
+static int visit_message_end(void *data, struct fast_message *msg)
+{
+	return visit_printf(data, "/m%lu", msg->tid);
+}
+
+static int visit_uint(void *data, unsigned long field, u64 value)
+{
+	return visit_printf(data, "u%lu=%" PRIu64 " ", field, value);
+}
+
+static int visit_decimal(void *data, unsigned long field, i64 exp, i64 mnt)
+{
+	return visit_printf(data, "d%lu=%" PRId64 "/%" PRId64 " ", field, exp, mnt);
+}
+
+static int visit_string(void *data, unsigned long field, const char *value, unsigned long len)
+{
+	struct visit_log *log = data;
+
+	if (log->stop && len == strlen(log->stop) && !memcmp(value, log->stop, len))
+		return 7;
+
+	return visit_printf(data, "s%lu=%.*s ", field, (int) len, value);
+}
+
+static int visit_empty(void *data, unsigned long field)
+{
+	return visit_printf(data, "e%lu ", field);
+}
+
+static int visit_sequence_begin(void *data, unsigned long field, unsigned long length)
+{
+	return visit_printf(data, "[%lu:%lu ", field, length);
+}
+
+static int visit_sequence_end(void *data, unsigned long field)
+{
+	return visit_printf(data, "]%lu ", field);
+}
+
+static const struct fast_visitor visit_logger = {
+	.on_message		= visit_message,
+	.on_message_end		= visit_message_end,
+	.on_uint		= visit_uint,
+	.on_decimal		= visit_decimal,
+	.on_string		= visit_string,
+	.on_empty		= visit_empty,
+	.on_sequence_begin	= visit_sequence_begin,
+	.on_sequence_end	= visit_sequence_end,
+};
+
+static void put_visit_message(struct buffer *buf, unsigned long nr_elements)
+{
+	unsigned long i;
+
+	buffer_put(buf, 0xc0);
+	put_uint(buf, 1);
+
+	put_uint(buf, 5);
+	buffer_printf(buf, "A%c", 'B' | 0x80);
+	put_int(buf, -2);
+	put_int(buf, 123);
+	put_uint(buf, 0);
+
+	put_uint(buf, nr_elements);
+
+	for (i = 0; i < nr_elements; i++) {
+		put_uint(buf, i + 1);
+		buffer_put(buf, ('x' + i % 2) | 0x80);
+	}
+}
+
+void test_fast_visitor(void)
+{
+	struct fast_session *session;
+	struct fast_sequence *seq;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct visit_log log;
+	struct buffer *buf;
+
+	session = fast_session_templates("<template id=\"1\"><uInt32/><string/><decimal/><uInt32 presence=\"optional\"/>"
+					 "<sequence><length/><uInt32/><string/></sequence></template>\n");
+
+	memset(&log, 0, sizeof(log));
+
+	assert_int_equals(0, fast_session_set_visitor(session, 1, &visit_logger, &log));
+	assert_int_equals(-1, fast_session_set_visitor(session, 2, &visit_logger, &log));
+
+	buf = buffer_new(1024);
+	put_visit_message(buf, 2);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+	assert_true(fast_packet_empty(&packet));
+	assert_str_equals("m1 u0=5 s1=AB d2=-2/123 e3 [4:2 u0=1 s1=x u0=2 s1=y ]4 /m1", log.buf, log.len + 1);
+
+	/* Elements are handed over as they are decoded, none are stored */
+	buffer_reset(buf);
+	put_visit_message(buf, 64);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+	memset(&log, 0, sizeof(log));
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+	assert_true(strstr(log.buf, "u0=64 s1=y ]4 /m1") != NULL);
+
+	/* A handler stops decoding, whatever it returns to do so */
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+	memset(&log, 0, sizeof(log));
+	log.stop = "x";
+
+	assert_int_equals(FAST_MSG_STATE_STOPPED, fast_packet_decode(&session->rx_map, &packet, &msg));
+	assert_int_equals(0, packet.offset);
+
+	/* Without the visitor the message and all of its elements are stored */
+	assert_int_equals(0, fast_session_set_visitor(session, 1, NULL, NULL));
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+
+	seq = msg->fields[4].ptr_value;
+	assert_int_equals(64, seq->length.uint_value);
+	assert_int_equals(64, fast_sequence_element(seq, 63)[0].uint_value);
+	assert_str_equals("y", fast_sequence_element(seq, 63)[1].string_value, 2);
+
+	buffer_delete(buf);
+	fast_session_free(session);
+}
+
+static void put_sequence_message(struct fast_session *session, struct buffer *buf, unsigned long nr_elements)
+{
+	struct fast_message *msg = session->rx_messages;
+	struct fast_sequence *seq = msg->fields[1].ptr_value;
+	struct fast_field *elem;
+	char value[24];
+	unsigned long i;
+
+	msg->fields[0].uint_value = nr_elements;
+	msg->fields[0].state = FAST_STATE_ASSIGNED;
+
+	if (!nr_elements) {
+		field_set_empty(&seq->length);
+		put_encoded(buf, msg);
+		return;
+	}
+
+	assert_int_equals(0, fast_sequence_reserve(seq, nr_elements));
+
+	seq->length.uint_value = nr_elements;
+	seq->length.state = FAST_STATE_ASSIGNED;
+
+	for (i = 0; i < nr_elements; i++) {
+		elem = fast_sequence_element(seq, i);
+
+		elem[0].uint_value = 1000 + i / 4;
+		elem[0].state = FAST_STATE_ASSIGNED;
+
+		snprintf(value, sizeof(value), "L%lu", i / 8);
+		assert_int_equals(0, field_set_string(elem + 1, value, strlen(value)));
+
+		elem[2].decimal_value.exp = -2;
+		elem[2].decimal_value.mnt = i * 25;
+		elem[2].state = FAST_STATE_ASSIGNED;
+	}
+
+	put_encoded(buf, msg);
+}
+
+static void check_sequence_message(struct fast_message *msg, unsigned long nr_elements)
+{
+	struct fast_sequence *seq = msg->fields[1].ptr_value;
+	struct fast_field *elem;
+	char value[24];
+	unsigned long i;
+
+	assert_int_equals(nr_elements, msg->fields[0].uint_value);
+
+	if (!nr_elements) {
+		assert_true(field_state_empty(&seq->length));
+		return;
+	}
+
+	assert_int_equals(nr_elements, seq->length.uint_value);
+	assert_true(seq->max_elements >= nr_elements);
+
+	for (i = 0; i < nr_elements; i++) {
+		elem = fast_sequence_element(seq, i);
+
+		assert_int_equals(1000 + i / 4, elem[0].uint_value);
+
+		snprintf(value, sizeof(value), "L%lu", i / 8);
+		assert_int_equals(strlen(value), elem[1].string_len);
+		assert_str_equals(value, elem[1].string_value, elem[1].string_len + 1);
+
+		assert_int_equals(-2, elem[2].decimal_value.exp);
+		assert_int_equals(i * 25, elem[2].decimal_value.mnt);
+	}
+}
+
+void test_fast_sequence_roundtrip(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<uInt32/>"
+		"<sequence presence=\"optional\"><length/>"
+		"<uInt32><copy/></uInt32>"
+		"<string><copy/></string>"
+		"<decimal/>"
+		"</sequence>"
+		"</template>\n";
+	static const unsigned long lengths[] = { 100, 0, 3, 250 };
+	struct fast_session *session;
+	struct fast_session *enc;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct buffer *buf;
+	unsigned long i;
+
+	session = fast_session_templates(templates);
+	enc = fast_session_templates(templates);
+
+	buf = buffer_new(64 * 1024);
+
+	for (i = 0; i < ARRAY_SIZE(lengths); i++)
+		put_sequence_message(enc, buf, lengths[i]);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+
+	for (i = 0; i < ARRAY_SIZE(lengths); i++) {
+		assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+		check_sequence_message(msg, lengths[i]);
+	}
+
+	assert_true(fast_packet_empty(&packet));
+
+	/* Lengths past the limit are garbled rather than allocated */
+	buffer_reset(buf);
+	buffer_put(buf, 0xc0);
+	put_uint(buf, 1);
+	put_uint(buf, 1);
+	put_uint(buf, FAST_SEQUENCE_MAX_ELEMENTS + 2);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+	assert_int_equals(FAST_MSG_STATE_GARBLED, fast_packet_decode(&session->rx_map, &packet, &msg));
+
+	buffer_delete(buf);
+	fast_session_free(enc);
+	fast_session_free(session);
+}
+
+static void check_cached_parts(struct fast_decimal_parts *expected, struct fast_decimal_parts *actual)
+{
+	assert_int_equals(expected->exponent.op, actual->exponent.op);
+	assert_int_equals(expected->exponent.presence, actual->exponent.presence);
+	assert_int_equals(expected->exponent.pmap_bit, actual->exponent.pmap_bit);
+	assert_int_equals(expected->exponent.has_reset, actual->exponent.has_reset);
+	assert_int_equals(expected->exponent.int_reset, actual->exponent.int_reset);
+	assert_int_equals(expected->mantissa.op, actual->mantissa.op);
+	assert_int_equals(expected->mantissa.pmap_bit, actual->mantissa.pmap_bit);
+	assert_int_equals(expected->mantissa.int_reset, actual->mantissa.int_reset);
+}
+
+static void check_cached_templates(struct fast_session *expected, struct fast_session *actual)
+{
+	struct fast_field *expected_field;
+	struct fast_field *actual_field;
+	struct fast_sequence *seq;
+	unsigned long i;
+	int j;
+
+	assert_int_equals(expected->nr_messages, actual->nr_messages);
+	assert_int_equals(expected->dictionary.nr_slots, actual->dictionary.nr_slots);
+
+	for (j = 0; j < expected->nr_messages; j++) {
+		assert_true(fast_tid_lookup(&actual->rx_map, expected->rx_messages[j].tid) == actual->rx_messages + j);
+		assert_int_equals(expected->rx_messages[j].flags, actual->rx_messages[j].flags);
+		assert_int_equals(fast_message_signature(expected->rx_messages + j), fast_message_signature(actual->rx_messages + j));
+
+		for (i = 0; i < expected->rx_messages[j].nr_fields; i++) {
+			expected_field = expected->rx_messages[j].fields + i;
+			actual_field = actual->rx_messages[j].fields + i;
+
+			assert_int_equals(expected_field->string_size, actual_field->string_size);
+			assert_int_equals(expected_field->has_reset, actual_field->has_reset);
+			assert_int_equals(expected_field->slot, actual_field->slot);
+
+			switch (expected_field->type) {
+			case FAST_TYPE_INT:
+				assert_int_equals(expected_field->int_reset, actual_field->int_reset);
+				break;
+			case FAST_TYPE_UINT:
+				assert_int_equals(expected_field->uint_reset, actual_field->uint_reset);
+				break;
+			case FAST_TYPE_STRING:
+				if (expected_field->has_reset)
+					assert_str_equals(expected_field->string_reset, actual_field->string_reset, expected_field->string_size);
+				break;
+			case FAST_TYPE_SEQUENCE:
+				seq = actual_field->ptr_value;
+				assert_true(seq->element.strings != NULL);
+				break;
+			case FAST_TYPE_DECIMAL:
+				assert_int_equals(expected_field->flags, actual_field->flags);
+				if (field_has_flags(expected_field, FAST_FIELD_FLAGS_DECIMAL_PARTS))
+					check_cached_parts(field_decimal_parts(expected_field), field_decimal_parts(actual_field));
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void test_fast_template_cache(void)
+{
+	static const char templates[] =
+		"<template id=\"7\">"
+		"<uInt32 name=\"Seq\"><copy value=\"5\"/></uInt32>"
+		"<string maxLength=\"8\"><constant value=\"AB\"/></string>"
+		"<int32 presence=\"optional\"><increment value=\"-3\"/></int32>"
+		"<byteVector presence=\"optional\"/>"
+		"<sequence presence=\"optional\"><length><copy/></length>"
+		"<string><copy/></string><decimal><copy/></decimal>"
+		"</sequence>"
+		"</template>\n"
+		"<template id=\"8\"><uInt32 name=\"Seq\"><increment/></uInt32>"
+		"<decimal presence=\"optional\"><exponent><copy value=\"-2\"/></exponent><mantissa><delta/></mantissa></decimal>"
+		"</template>\n"
+		"<template id=\"120\" reset=\"T\"/>\n";
+	char cache[] = "/tmp/fast-cache-XXXXXX";
+	char xml[] = "/tmp/fast-templates-XXXXXX";
+	struct fast_session *parsed;
+	struct fast_session *loaded;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct buffer *buf;
+	FILE *stream;
+	int fd;
+
+	templates_write(xml, templates);
+
+	fd = mkstemp(cache);
+	assert_true(fd >= 0);
+	close(fd);
+
+	parsed = fast_session_new(-1);
+	assert_int_equals(0, fast_suite_template(parsed, xml));
+	assert_int_equals(0, fast_template_save(parsed, xml, cache));
+
+	loaded = fast_session_new(-1);
+	assert_int_equals(0, fast_template_load(loaded, xml, cache));
+	check_cached_templates(parsed, loaded);
+
+	/* The loaded templates decode what the parsed ones encode */
+	buf = buffer_new(256);
+
+	msg = parsed->rx_messages;
+	msg->fields[0].uint_value = 5;
+	msg->fields[0].state = FAST_STATE_ASSIGNED;
+	msg->fields[1].state = FAST_STATE_ASSIGNED;
+	msg->fields[2].int_value = -2;
+	msg->fields[2].state = FAST_STATE_ASSIGNED;
+	assert_int_equals(0, field_set_string(msg->fields + 3, "xyz", 3));
+	field_set_empty(&((struct fast_sequence *) msg->fields[4].ptr_value)->length);
+	put_encoded(buf, msg);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+	assert_int_equals(0, fast_packet_decode(&loaded->rx_map, &packet, &msg));
+	assert_int_equals(7, msg->tid);
+	assert_int_equals(5, msg->fields[0].uint_value);
+	assert_str_equals("AB", msg->fields[1].string_value, 3);
+	assert_int_equals(-2, msg->fields[2].int_value);
+	assert_int_equals(3, msg->fields[3].string_len);
+	assert_true(fast_packet_empty(&packet));
+
+	buffer_delete(buf);
+	fast_session_free(loaded);
+
+	/* A changed template file makes the cache stale */
+	stream = fopen(xml, "a");
+	assert_true(stream != NULL);
+	fprintf(stream, "\n");
+	fclose(stream);
+
+	loaded = fast_session_new(-1);
+	assert_int_equals(-1, fast_template_load(loaded, xml, cache));
+	assert_int_equals(0, loaded->nr_messages);
+
+	/* ...and is written again on the next start */
+	assert_int_equals(0, fast_cached_template(loaded, xml, cache));
+	check_cached_templates(parsed, loaded);
+	fast_session_free(loaded);
+
+	loaded = fast_session_new(-1);
+	assert_int_equals(0, fast_template_load(loaded, xml, cache));
+	check_cached_templates(parsed, loaded);
+	fast_session_free(loaded);
+
+	/* A truncated cache is not loaded */
+	assert_int_equals(0, truncate(cache, 100));
+
+	loaded = fast_session_new(-1);
+	assert_int_equals(-1, fast_template_load(loaded, xml, cache));
+	assert_int_equals(0, loaded->nr_messages);
+	fast_session_free(loaded);
+
+	unlink(cache);
+	unlink(xml);
+
+	fast_session_free(parsed);
+}
+
+void test_fast_session_reset(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<uInt32><copy value=\"5\"/></uInt32>"
+		"<string><copy/></string>"
+		"</template>\n";
+	struct fast_session *enc;
+	struct fast_session *dec;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct buffer *buf;
+	unsigned long size;
+
+	enc = fast_session_templates(templates);
+	dec = fast_session_templates(templates);
+
+	buf = buffer_new(64);
+
+	msg = enc->rx_messages;
+	msg->fields[0].uint_value = 7;
+	msg->fields[0].state = FAST_STATE_ASSIGNED;
+	assert_int_equals(0, field_set_string(msg->fields + 1, "ab", 2));
+	put_encoded(buf, msg);
+
+	size = buffer_size(buf);
+
+	/* The encoder keeps the values it was given before the reset */
+	msg->fields[0].uint_value = 5;
+	fast_session_reset(enc);
+	assert_true(fast_message_stale(msg));
+	put_encoded(buf, msg);
+
+	assert_false(fast_message_stale(msg));
+	assert_int_equals(5, msg->fields[0].uint_value);
+	assert_str_equals("ab", msg->fields[1].string_value, 3);
+
+	/* pmap, template id and the string that is no longer the previous one */
+	assert_int_equals(4, buffer_size(buf) - size);
+
+	fast_packet_init(&packet, buffer_start(buf), size);
+	assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+	assert_int_equals(7, msg->fields[0].uint_value);
+
+	/* Nothing is touched until the template is used again */
+	fast_session_reset(dec);
+	assert_true(fast_message_stale(msg));
+	assert_int_equals(7, msg->fields[0].uint_value);
+
+	fast_packet_init(&packet, buffer_start(buf) + size, buffer_size(buf) - size);
+	assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+	assert_false(fast_message_stale(msg));
+	assert_int_equals(5, msg->fields[0].uint_value);
+	assert_str_equals("ab", msg->fields[1].string_value, 3);
+	assert_true(fast_packet_empty(&packet));
+
+	buffer_delete(buf);
+	fast_session_free(dec);
+	fast_session_free(enc);
+}
+
+void test_fast_dictionary_scopes(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<uInt32 name=\"MsgSeqNum\"><increment/></uInt32>"
+		"<string name=\"Symbol\"><copy dictionary=\"template\"/></string>"
+		"</template>\n"
+		"<template id=\"2\">"
+		"<uInt32 name=\"MsgSeqNum\"><increment/></uInt32>"
+		"<string name=\"Symbol\"><copy dictionary=\"template\"/></string>"
+		"<uInt32 name=\"Px\"><copy key=\"Price\" dictionary=\"quotes\"/></uInt32>"
+		"</template>\n"
+		"<template id=\"3\"><uInt32 name=\"Last\"><copy key=\"Price\" dictionary=\"quotes\"/></uInt32></template>\n"
+		"<template id=\"4\" dictionary=\"type\"><typeRef name=\"Quote\"/><uInt32 name=\"Bid\"><copy/></uInt32></template>\n"
+		"<template id=\"5\" dictionary=\"type\"><typeRef name=\"Quote\"/><uInt32 name=\"Bid\"><copy/></uInt32></template>\n"
+		"<template id=\"6\" dictionary=\"type\"><typeRef name=\"Trade\"/><uInt32 name=\"Bid\"><copy/></uInt32></template>\n";
+	struct fast_session *enc;
+	struct fast_session *dec;
+	struct fast_packet packet;
+	struct fast_message *msgs;
+	struct fast_message *msg;
+	struct buffer *buf;
+	unsigned long size;
+
+	enc = fast_session_templates(templates);
+	dec = fast_session_templates(templates);
+
+	msgs = enc->rx_messages;
+
+	assert_int_equals(3, enc->dictionary.nr_slots);
+
+	assert_true(msgs[0].fields[0].slot != 0);
+	assert_int_equals(msgs[0].fields[0].slot, msgs[1].fields[0].slot);
+	assert_int_equals(0, msgs[0].fields[1].slot);
+	assert_int_equals(0, msgs[1].fields[1].slot);
+	assert_true(msgs[1].fields[2].slot != 0);
+	assert_int_equals(msgs[1].fields[2].slot, msgs[2].fields[0].slot);
+	assert_true(msgs[3].fields[0].slot != 0);
+	assert_int_equals(msgs[3].fields[0].slot, msgs[4].fields[0].slot);
+	assert_int_equals(0, msgs[5].fields[0].slot);
+
+	buf = buffer_new(64);
+
+	msgs[0].fields[0].uint_value = 10;
+	msgs[0].fields[0].state = FAST_STATE_ASSIGNED;
+	assert_int_equals(0, field_set_string(msgs[0].fields + 1, "A", 1));
+	put_encoded(buf, msgs + 0);
+
+	size = buffer_size(buf);
+
+	/* The sequence number goes on from template 1, the symbol does not */
+	msgs[1].fields[0].uint_value = 11;
+	msgs[1].fields[0].state = FAST_STATE_ASSIGNED;
+	assert_int_equals(0, field_set_string(msgs[1].fields + 1, "A", 1));
+	msgs[1].fields[2].uint_value = 100;
+	msgs[1].fields[2].state = FAST_STATE_ASSIGNED;
+	put_encoded(buf, msgs + 1);
+
+	assert_int_equals(4, buffer_size(buf) - size);
+	size = buffer_size(buf);
+
+	msgs[2].fields[0].uint_value = 100;
+	msgs[2].fields[0].state = FAST_STATE_ASSIGNED;
+	put_encoded(buf, msgs + 2);
+
+	assert_int_equals(2, buffer_size(buf) - size);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+
+	assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+	assert_int_equals(10, msg->fields[0].uint_value);
+
+	assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+	assert_int_equals(2, msg->tid);
+	assert_int_equals(11, msg->fields[0].uint_value);
+	assert_str_equals("A", msg->fields[1].string_value, 2);
+	assert_int_equals(100, msg->fields[2].uint_value);
+
+	assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+	assert_int_equals(100, msg->fields[0].uint_value);
+	assert_true(fast_packet_empty(&packet));
+
+	/* A reset reaches the entries that the first template after it uses */
+	buffer_reset(buf);
+
+	fast_session_reset(enc);
+	put_encoded(buf, msgs + 2);
+
+	assert_int_equals(3, buffer_size(buf));
+
+	fast_session_reset(dec);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+	assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+	assert_int_equals(100, msg->fields[0].uint_value);
+
+	buffer_delete(buf);
+	fast_session_free(dec);
+	fast_session_free(enc);
+}
+
+void test_fast_dictionary_type_mismatch(void)
+{
+	static const char templates[] =
+		"<template id=\"1\"><uInt32 name=\"Id\"><copy/></uInt32></template>\n"
+		"<template id=\"2\"><string name=\"Id\"><copy/></string></template>\n";
+	char xml[] = "/tmp/fast-templates-XXXXXX";
+	struct fast_session *session;
+
+	templates_write(xml, templates);
+
+	session = fast_session_new(-1);
+	assert_true(fast_suite_template(session, xml) != 0);
+
+	unlink(xml);
+	fast_session_free(session);
+}
+
+static void put_decimal(struct buffer *buf, struct fast_message *msg, i64 px_mnt, i64 px_exp, bool qty)
+{
+	msg->fields[0].state = FAST_STATE_ASSIGNED;
+	msg->fields[0].decimal_value.mnt = px_mnt;
+	msg->fields[0].decimal_value.exp = px_exp;
+
+	if (qty) {
+		msg->fields[1].state = FAST_STATE_ASSIGNED;
+		msg->fields[1].decimal_value.mnt = 7;
+		msg->fields[1].decimal_value.exp = 0;
+	} else
+		field_set_empty(msg->fields + 1);
+
+	put_encoded(buf, msg);
+}
+
+static void check_decimal(struct fast_packet *packet, struct fast_session *session, i64 px_mnt, i64 px_exp, bool qty)
+{
+	struct fast_message *msg;
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, packet, &msg));
+	assert_int_equals(px_mnt, msg->fields[0].decimal_value.mnt);
+	assert_int_equals(px_exp, msg->fields[0].decimal_value.exp);
+
+	if (qty) {
+		assert_false(field_state_empty(msg->fields + 1));
+		assert_int_equals(7, msg->fields[1].decimal_value.mnt);
+		assert_int_equals(0, msg->fields[1].decimal_value.exp);
+	} else
+		assert_true(field_state_empty(msg->fields + 1));
+}
+
+void test_fast_decimal_parts(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<decimal name=\"Px\"><exponent><copy value=\"-2\"/></exponent><mantissa><delta/></mantissa></decimal>"
+		"<decimal name=\"Qty\" presence=\"optional\"><exponent><copy value=\"0\"/></exponent><mantissa><copy/></mantissa></decimal>"
+		"</template>\n";
+	struct fast_session *enc;
+	struct fast_session *dec;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct buffer *buf;
+	unsigned long size;
+
+	enc = fast_session_templates(templates);
+	dec = fast_session_templates(templates);
+
+	msg = enc->rx_messages;
+	assert_true(field_has_flags(msg->fields + 0, FAST_FIELD_FLAGS_DECIMAL_PARTS));
+
+	buf = buffer_new(64);
+
+	/* pmap, template id, both exponents, a three byte delta and the quantity's mantissa */
+	put_decimal(buf, msg, 12345, -2, true);
+	assert_int_equals(8, buffer_size(buf));
+	size = buffer_size(buf);
+
+	/* Only the price's mantissa changes */
+	put_decimal(buf, msg, 12350, -2, true);
+	assert_int_equals(3, buffer_size(buf) - size);
+	size = buffer_size(buf);
+
+	/* The price's exponent, a zero delta and the NULL quantity's exponent */
+	put_decimal(buf, msg, 12350, -3, false);
+	assert_int_equals(5, buffer_size(buf) - size);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+	check_decimal(&packet, dec, 12345, -2, true);
+	check_decimal(&packet, dec, 12350, -2, true);
+	check_decimal(&packet, dec, 12350, -3, false);
+	assert_true(fast_packet_empty(&packet));
+
+	buffer_delete(buf);
+	fast_session_free(dec);
+	fast_session_free(enc);
+}
+
+void test_fast_templates_shared(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<uInt32 name=\"MsgSeqNum\"><increment/></uInt32>"
+		"<string name=\"Symbol\"><copy value=\"AB\"/></string>"
+		"<decimal name=\"Px\"><exponent><copy value=\"-2\"/></exponent><mantissa><delta/></mantissa></decimal>"
+		"<sequence name=\"Entries\"><length/><string name=\"Id\"><copy/></string></sequence>"
+		"</template>\n"
+		"<template id=\"2\"><uInt32 name=\"MsgSeqNum\"><increment/></uInt32></template>\n";
+	char xml[] = "/tmp/fast-templates-XXXXXX";
+	struct fast_templates *shared;
+	struct fast_session *parsed;
+	struct fast_session *enc;
+	struct fast_session *dec;
+	struct fast_packet packet;
+	struct fast_sequence *seq;
+	struct fast_message *msg;
+	struct buffer *buf;
+	unsigned long size;
+	int i;
+
+	templates_write(xml, templates);
+
+	shared = fast_templates_new(xml, NULL);
+	assert_true(shared != NULL);
+	assert_int_equals(2, shared->nr_messages);
+
+	parsed = fast_session_new(-1);
+	assert_int_equals(0, fast_suite_template(parsed, xml));
+
+	enc = fast_session_new(-1);
+	dec = fast_session_new(-1);
+	assert_int_equals(0, fast_session_use_templates(enc, shared));
+	assert_int_equals(0, fast_session_use_templates(dec, shared));
+	assert_int_equals(-1, fast_session_use_templates(dec, shared));
+	assert_int_equals(3, shared->refcount);
+
+	unlink(xml);
+
+	/* The sessions look just like one that parsed the templates */
+	check_cached_templates(parsed, enc);
+	assert_int_equals(parsed->max_messages, enc->max_messages);
+	fast_session_free(parsed);
+
+	/* ...but read their initial values from the shared templates */
+	assert_true(enc->rx_messages[0].fields[1].string_reset == shared->messages[0].fields[1].string_reset);
+	assert_true(enc->rx_messages[0].fields[1].string_buf != dec->rx_messages[0].fields[1].string_buf);
+	assert_true(enc->rx_messages[0].dictionary == &enc->dictionary);
+
+	buf = buffer_new(256);
+
+	for (i = 0; i < 2; i++) {
+		msg = enc->rx_messages;
+		msg->fields[0].uint_value = 10 + i;
+		msg->fields[0].state = FAST_STATE_ASSIGNED;
+		assert_int_equals(0, field_set_string(msg->fields + 1, "AB", 2));
+		msg->fields[2].decimal_value = (struct fast_decimal) { .exp = -2, .mnt = 12345 + i };
+		msg->fields[2].state = FAST_STATE_ASSIGNED;
+
+		seq = msg->fields[3].ptr_value;
+		seq->length.uint_value = 1;
+		seq->length.state = FAST_STATE_ASSIGNED;
+		assert_int_equals(0, fast_sequence_reserve(seq, 1));
+		assert_int_equals(0, field_set_string(fast_sequence_element(seq, 0), "x", 1));
+
+		put_encoded(buf, msg);
+
+		msg = enc->rx_messages + 1;
+		msg->fields[0].uint_value = 12 + i;
+		msg->fields[0].state = FAST_STATE_ASSIGNED;
+		put_encoded(buf, msg);
+	}
+
+	size = buffer_size(buf);
+
+	fast_packet_init(&packet, buffer_start(buf), size);
+
+	for (i = 0; i < 2; i++) {
+		assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+		assert_int_equals(1, msg->tid);
+		assert_int_equals(10 + i, msg->fields[0].uint_value);
+		assert_str_equals("AB", msg->fields[1].string_value, 3);
+		assert_int_equals(12345 + i, msg->fields[2].decimal_value.mnt);
+
+		seq = msg->fields[3].ptr_value;
+		assert_int_equals(1, seq->length.uint_value);
+		assert_str_equals("x", fast_sequence_element(seq, 0)->string_value, 2);
+
+		assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+		assert_int_equals(12 + i, msg->fields[0].uint_value);
+	}
+
+	assert_true(fast_packet_empty(&packet));
+
+	/* The templates are freed with the last session that uses them */
+	fast_session_free(enc);
+	fast_templates_put(shared);
+	assert_int_equals(1, shared->refcount);
+
+	fast_packet_init(&packet, buffer_start(buf), size);
+	fast_session_reset(dec);
+	assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+	assert_int_equals(10, msg->fields[0].uint_value);
+
+	buffer_delete(buf);
+	fast_session_free(dec);
+}
+
+static void put_string_delta(struct buffer *buf, struct fast_message *msg, const char **values)
+{
+	int i;
+
+	for (i = 0; i < msg->nr_fields; i++) {
+		if (values[i])
+			assert_int_equals(0, field_set_string(msg->fields + i, values[i], strlen(values[i])));
+		else
+			field_set_empty(msg->fields + i);
+	}
+
+	put_encoded(buf, msg);
+}
+
+static void check_string(struct fast_field *field, const char *value)
+{
+	if (!value) {
+		assert_true(field_state_empty(field));
+		return;
+	}
+
+	assert_false(field_state_empty(field));
+	assert_int_equals(strlen(value), field->string_len);
+	assert_int_equals(0, memcmp(value, field->string_value, field->string_len));
+}
+
+void test_fast_string_delta(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<string name=\"Symbol\"><delta/></string>"
+		"<string name=\"Text\" charset=\"unicode\" presence=\"optional\"><delta/></string>"
+		"<byteVector name=\"Data\"><delta/></byteVector>"
+		"<string name=\"Board\" presence=\"optional\"><tail/></string>"
+		"<string name=\"Code\" charset=\"unicode\"><tail value=\"ABCD\"/></string>"
+		"</template>\n";
+	static const char *values[][5] = {
+		{ "GAZP",	"SBER01",	"ab",	"TQBR",	"ABCD" },
+		/* Appends, NULLs and a one character tail */
+		{ "GAZP2",	NULL,		"xab",	NULL,	"ABCE" },
+		/* Prepends that change the length, and no tail */
+		{ "XGAZP2",	"SBER02",	"xabc",	"TQBS",	"ABCE" },
+		/* ...and that do not, and tails that are longer */
+		{ "YZAZP2",	"",		"c",	"TQBS",	"ABCEFG" },
+		{ "",		"ZSBER",	"cc",	"EQBS",	"ABCEFH" },
+	};
+	struct fast_session *enc;
+	struct fast_session *dec;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct buffer *buf;
+	unsigned long size;
+	int i, j;
+
+	enc = fast_session_templates(templates);
+	dec = fast_session_templates(templates);
+
+	buf = buffer_new(256);
+	msg = enc->rx_messages;
+
+	put_string_delta(buf, msg, values[0]);
+	size = buffer_size(buf);
+
+	/* pmap, template id, "2", a NULL, -1 "x", a NULL tail and "E" */
+	put_string_delta(buf, msg, values[1]);
+	assert_int_equals(11, buffer_size(buf) - size);
+
+	for (i = 2; i < ARRAY_SIZE(values); i++)
+		put_string_delta(buf, msg, values[i]);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+
+	for (i = 0; i < ARRAY_SIZE(values); i++) {
+		assert_int_equals(0, fast_packet_decode(&dec->rx_map, &packet, &msg));
+
+		for (j = 0; j < 5; j++)
+			check_string(msg->fields + j, values[i][j]);
+	}
+
+	assert_true(fast_packet_empty(&packet));
+
+	/* A tail cannot make the value shorter */
+	buffer_reset(buf);
+	msg = enc->rx_messages;
+	assert_int_equals(0, field_set_string(msg->fields + 4, "AB", 2));
+	assert_int_equals(-1, fast_message_encode(msg));
+
+	buffer_delete(buf);
+	fast_session_free(dec);
+	fast_session_free(enc);
+}
+
+/* Subtraction lengths and tails as another encoder would send them */
+void test_fast_string_delta_decode(void)
+{
+	struct fast_session *session;
+	struct fast_packet packet;
+	struct fast_message *msg;
+	struct buffer *buf;
+
+	session = fast_session_templates("<template id=\"1\"><string><delta/></string><string><tail/></string></template>\n");
+
+	buf = buffer_new(64);
+
+	buffer_put(buf, 0xe0);
+	put_uint(buf, 1);
+	put_int(buf, 0);
+	buffer_printf(buf, "AB%c", 'C' | 0x80);
+	buffer_printf(buf, "X%c", 'Y' | 0x80);
+
+	/* Removes one character from the back, the tail replaces one */
+	buffer_put(buf, 0xc0 | 0x20);
+	put_uint(buf, 1);
+	put_int(buf, 1);
+	buffer_printf(buf, "D%c", 'E' | 0x80);
+	buffer_put(buf, 'Z' | 0x80);
+
+	/* Removes two characters from the front, and no tail */
+	buffer_put(buf, 0xc0);
+	put_uint(buf, 1);
+	put_int(buf, -3);
+	buffer_put(buf, 'Q' | 0x80);
+
+	/* Removes more than there is */
+	buffer_put(buf, 0xc0);
+	put_uint(buf, 1);
+	put_int(buf, 5);
+	buffer_put(buf, 0x80);
+
+	fast_packet_init(&packet, buffer_start(buf), buffer_size(buf));
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+	assert_str_equals("ABC", msg->fields[0].string_value, 4);
+	assert_str_equals("XY", msg->fields[1].string_value, 3);
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+	assert_str_equals("ABDE", msg->fields[0].string_value, 5);
+	assert_str_equals("XZ", msg->fields[1].string_value, 3);
+
+	assert_int_equals(0, fast_packet_decode(&session->rx_map, &packet, &msg));
+	assert_str_equals("QDE", msg->fields[0].string_value, 4);
+	assert_str_equals("XZ", msg->fields[1].string_value, 3);
+
+	assert_int_equals(FAST_MSG_STATE_GARBLED, fast_packet_decode(&session->rx_map, &packet, &msg));
+
+	buffer_delete(buf);
+	fast_session_free(session);
+}
+
+static void put_rollback(struct buffer *buf, struct fast_message *msg, u64 seq, i64 price, const char *symbol)
+{
+	msg->fields[0].uint_value	= seq;
+	msg->fields[0].state		= FAST_STATE_ASSIGNED;
+	msg->fields[1].int_value	= price;
+	msg->fields[1].state		= FAST_STATE_ASSIGNED;
+
+	assert_int_equals(0, field_set_string(msg->fields + 2, symbol, strlen(symbol)));
+
+	put_encoded(buf, msg);
+}
+
+static void check_rollback(struct fast_message *msg, u64 seq, i64 price, const char *symbol)
+{
+	assert_true(msg != NULL);
+	assert_int_equals(seq, msg->fields[0].uint_value);
+	assert_int_equals(price, msg->fields[1].int_value);
+	assert_str_equals(symbol, msg->fields[2].string_value, strlen(symbol) + 1);
+}
+
+/*
+ * Decoding a message again after it failed must start from the values it
+ * failed with, or the deltas would be applied twice and the increment of
+ * the shared entry too.
+ */
+void test_fast_decode_rollback(void)
+{
+	static const char templates[] =
+		"<template id=\"1\">"
+		"<uInt32 name=\"Seq\"><increment/></uInt32>"
+		"<int64 name=\"Price\"><delta/></int64>"
+		"<string name=\"Symbol\"><delta/></string>"
+		"</template>"
+		"<template id=\"2\"><uInt32 name=\"Seq\"><increment/></uInt32></template>\n";
+	struct fast_session *enc;
+	struct fast_session *dec;
+	struct fast_message *msg;
+	unsigned long first, len;
+	struct buffer *stream;
+	struct buffer *buf;
+	unsigned long i;
+
+	enc = fast_session_templates(templates);
+	dec = fast_session_templates(templates);
+
+	assert_true(fast_tid_lookup(&dec->rx_map, 1)->fields[0].slot != 0);
+
+	buf = buffer_new(64);
+	stream = buffer_new(64);
+
+	msg = fast_tid_lookup(&enc->rx_map, 1);
+	put_rollback(buf, msg, 1, 100, "ABC");
+	first = buffer_size(buf);
+	put_rollback(buf, msg, 2, 103, "ABD");
+	len = buffer_size(buf) - first;
+
+	/* Cut short anywhere, the message is decoded once the rest arrives */
+	for (i = 0; i < len; i++) {
+		fast_session_reset(dec);
+		buffer_reset(stream);
+
+		memcpy(buffer_end(stream), buffer_start(buf), first + i);
+		stream->end += first + i;
+
+		check_rollback(fast_message_decode(&dec->rx_map, stream, 0), 1, 100, "ABC");
+
+		assert_true(fast_message_decode(&dec->rx_map, stream, 1) == NULL);
+		assert_int_equals(first, stream->start);
+
+		memcpy(buffer_end(stream), buffer_start(buf) + first + i, len - i);
+		stream->end += len - i;
+
+		check_rollback(fast_message_decode(&dec->rx_map, stream, 1), 2, 103, "ABD");
+		assert_int_equals(0, buffer_size(stream));
+	}
+
+	/* Garbled after the increment and a delta: 10 characters off "ABC" */
+	fast_session_reset(dec);
+	buffer_reset(stream);
+
+	memcpy(buffer_end(stream), buffer_start(buf), first);
+	stream->end += first;
+
+	check_rollback(fast_message_decode(&dec->rx_map, stream, 0), 1, 100, "ABC");
+
+	buffer_put(stream, 0xc0);
+	put_uint(stream, 1);
+	put_int(stream, 7);
+	put_int(stream, 10);
+	buffer_put(stream, 'X' | 0x80);
+
+	assert_true(fast_message_decode(&dec->rx_map, stream, 1) == NULL);
+	assert_int_equals(first, stream->start);
+
+	stream->start = stream->end;
+
+	memcpy(buffer_end(stream), buffer_start(buf) + first, len);
+	stream->end += len;
+
+	check_rollback(fast_message_decode(&dec->rx_map, stream, 1), 2, 103, "ABD");
+
+	buffer_delete(stream);
+	buffer_delete(buf);
+	fast_session_free(dec);
+	fast_session_free(enc);
+}
+
+#define	CODEGEN_XML		"tools/test/protocol/fast/codegen.xml"
+#define	CODEGEN_MESSAGES	500
+
+/* Generated from CODEGEN_XML by tools/fast/fast_codegen */
+extern const struct fast_template_codec codegen_codecs[];
+extern const unsigned long codegen_nr_codecs;
+
+static const char *codegen_strings[] = { "", "A", "SBER", "A VALUE LONGER THAN 16 BYTES" };
+
+/* A tail never makes a string shorter */
+static const char *codegen_tails[] = { "SBER", "SBEP", "GAZP" };
+
+static u64 codegen_rand(u64 *seed)
+{
+	*seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+	return *seed >> 33;
+}
+
+static struct fast_session *codegen_session(bool compiled)
+{
+	struct fast_session *session;
+
+	session = fast_session_new(-1);
+	assert_true(session != NULL);
+	assert_int_equals(0, fast_suite_template(session, CODEGEN_XML));
+
+	if (compiled)
+		assert_int_equals(session->nr_messages, fast_session_attach(session, codegen_codecs, codegen_nr_codecs));
+
+	return session;
+}
+
+/*
+ * Fills fields with values from a small set, so that copies and increments
+ * often find the value they have.
+ */
+static void codegen_fill(struct fast_field *fields, unsigned long nr_fields, u64 *seed)
+{
+	struct fast_sequence *seq;
+	struct fast_field *field;
+	const char *value;
+	unsigned long i, j;
+	u64 r;
+
+	for (i = 0; i < nr_fields; i++) {
+		field = fields + i;
+		r = codegen_rand(seed);
+
+		if (field->type == FAST_TYPE_SEQUENCE) {
+			seq = field->ptr_value;
+
+			assert_int_equals(0, fast_sequence_reserve(seq, r % 4));
+
+			seq->length.uint_value = r % 4;
+			seq->length.state = FAST_STATE_ASSIGNED;
+
+			for (j = 0; j < seq->length.uint_value; j++)
+				codegen_fill(fast_sequence_element(seq, j), seq->element.nr_fields, seed);
+
+			continue;
+		}
+
+		if (!field_is_mandatory(field) && !(r % 5)) {
+			field_set_empty(field);
+			continue;
+		}
+
+		r /= 5;
+
+		switch (field->type) {
+		case FAST_TYPE_INT:
+			if (field->op == FAST_OP_INCR && (r & 8))
+				field->int_value++;
+			else if (field->op != FAST_OP_CONSTANT)
+				field->int_value = (i64) (r % 7) - 3;
+			break;
+		case FAST_TYPE_UINT:
+			if (field->op == FAST_OP_INCR && (r & 8))
+				field->uint_value++;
+			else if (field->op != FAST_OP_CONSTANT)
+				field->uint_value = r % 7;
+			break;
+		case FAST_TYPE_STRING:
+			if (field->op == FAST_OP_CONSTANT)
+				break;
+
+			if (field->op == FAST_OP_TAIL)
+				value = codegen_tails[r % ARRAY_SIZE(codegen_tails)];
+			else
+				value = codegen_strings[r % ARRAY_SIZE(codegen_strings)];
+
+			assert_int_equals(0, field_set_string(field, value, strlen(value)));
+			break;
+		case FAST_TYPE_DECIMAL:
+			field->decimal_value.exp = (i64) (r % 3) - 2;
+			field->decimal_value.mnt = (i64) (r / 3 % 200) - 100;
+			break;
+		case FAST_TYPE_SEQUENCE:
+		default:
+			break;
+		}
+
+		field->state = FAST_STATE_ASSIGNED;
+	}
+}
+
+static void check_codegen_fields(struct fast_field *expected, struct fast_field *actual, unsigned long nr_fields)
+{
+	struct fast_sequence *expected_seq;
+	struct fast_sequence *actual_seq;
+	unsigned long i, j;
+
+	for (i = 0; i < nr_fields; i++) {
+		if (expected[i].type == FAST_TYPE_SEQUENCE) {
+			expected_seq = expected[i].ptr_value;
+			actual_seq = actual[i].ptr_value;
+
+			assert_int_equals(expected_seq->length.state, actual_seq->length.state);
+			assert_int_equals(expected_seq->length.uint_value, actual_seq->length.uint_value);
+
+			for (j = 0; j < expected_seq->length.uint_value; j++) {
+				check_codegen_fields(fast_sequence_element(expected_seq, j),
+						     fast_sequence_element(actual_seq, j),
+						     expected_seq->element.nr_fields);
+			}
+
+			continue;
+		}
+
+		assert_int_equals(expected[i].state, actual[i].state);
+
+		if (expected[i].state != FAST_STATE_ASSIGNED)
+			continue;
+
+		switch (expected[i].type) {
+		case FAST_TYPE_INT:
+			assert_int_equals(expected[i].int_value, actual[i].int_value);
+			break;
+		case FAST_TYPE_UINT:
+			assert_int_equals(expected[i].uint_value, actual[i].uint_value);
+			break;
+		case FAST_TYPE_STRING:
+			assert_int_equals(expected[i].string_len, actual[i].string_len);
+			assert_mem_equals(expected[i].string_value, actual[i].string_value, expected[i].string_len);
+			break;
+		case FAST_TYPE_DECIMAL:
+			assert_int_equals(expected[i].decimal_value.exp, actual[i].decimal_value.exp);
+			assert_int_equals(expected[i].decimal_value.mnt, actual[i].decimal_value.mnt);
+			break;
+		case FAST_TYPE_SEQUENCE:
+		default:
+			break;
+		}
+	}
+}
+
+static void codegen_set_visitor(struct fast_session *session, struct visit_log *log)
+{
+	int i;
+
+	for (i = 0; i < session->nr_messages; i++)
+		fast_session_set_visitor(session, session->rx_messages[i].tid, &visit_logger, log);
+}
+
+/*
+ * The codecs that fast_codegen generates must encode the bytes that the
+ * interpreter does, and decode and visit what it does.
+ */
+static struct buffer *codegen_copy(struct buffer *buf)
+{
+	struct buffer *copy;
+	unsigned long i;
+
+	copy = buffer_new(buffer_size(buf));
+	assert_true(copy != NULL);
+
+	for (i = 0; i < buffer_size(buf); i++)
+		buffer_put(copy, buffer_start(buf)[i]);
+
+	return copy;
+}
+
+void test_fast_generated_codecs(void)
+{
+	struct visit_log expected_log, actual_log;
+	struct fast_session *enc, *compiled_enc;
+	struct fast_session *visit_dec, *compiled_visit_dec;
+	struct buffer *visit_buf, *compiled_visit_buf;
+	struct fast_session *dec, *compiled_dec;
+	struct fast_message *expected, *actual;
+	struct buffer *buf, *compiled_buf;
+	u64 seed, last_tid;
+	unsigned long i;
+
+	enc = codegen_session(false);
+	dec = codegen_session(false);
+	compiled_enc = codegen_session(true);
+	compiled_dec = codegen_session(true);
+	visit_dec = codegen_session(false);
+	compiled_visit_dec = codegen_session(true);
+
+	buf = buffer_new(CODEGEN_MESSAGES * FAST_MESSAGE_MAX_SIZE);
+	compiled_buf = buffer_new(CODEGEN_MESSAGES * FAST_MESSAGE_MAX_SIZE);
+
+	for (i = 0, seed = 1; i < CODEGEN_MESSAGES; i++) {
+		u64 tid = 1 + codegen_rand(&seed) % 2;
+		u64 fill = seed;
+
+		expected = fast_tid_lookup(&enc->rx_map, tid);
+		codegen_fill(expected->fields, expected->nr_fields, &fill);
+		put_encoded(buf, expected);
+
+		fill = seed;
+
+		actual = fast_tid_lookup(&compiled_enc->rx_map, tid);
+		assert_true(actual->encode != NULL);
+		codegen_fill(actual->fields, actual->nr_fields, &fill);
+		put_encoded(compiled_buf, actual);
+
+		seed = fill;
+	}
+
+	assert_int_equals(buffer_size(buf), buffer_size(compiled_buf));
+	assert_mem_equals(buffer_start(buf), buffer_start(compiled_buf), buffer_size(buf));
+
+	/* Decoding compacts the buffers, so keep copies for the visitor pass. */
+	visit_buf = codegen_copy(buf);
+	compiled_visit_buf = codegen_copy(buf);
+
+	for (i = 0, last_tid = 0; i < CODEGEN_MESSAGES; i++) {
+		expected = fast_message_decode(&dec->rx_map, buf, last_tid);
+		actual = fast_message_decode(&compiled_dec->rx_map, compiled_buf, last_tid);
+
+		assert_true(expected != NULL);
+		assert_true(actual != NULL);
+		assert_true(actual->decode != NULL);
+		assert_int_equals(expected->tid, actual->tid);
+
+		check_codegen_fields(expected->fields, actual->fields, expected->nr_fields);
+
+		last_tid = expected->tid;
+	}
+
+	codegen_set_visitor(visit_dec, &expected_log);
+	codegen_set_visitor(compiled_visit_dec, &actual_log);
+
+	for (i = 0, last_tid = 0; i < CODEGEN_MESSAGES; i++) {
+		memset(&expected_log, 0, sizeof(expected_log));
+		memset(&actual_log, 0, sizeof(actual_log));
+
+		expected = fast_message_decode(&visit_dec->rx_map, visit_buf, last_tid);
+		actual = fast_message_decode(&compiled_visit_dec->rx_map, compiled_visit_buf, last_tid);
+
+		assert_true(expected != NULL);
+		assert_true(actual != NULL);
+		assert_int_equals(expected_log.len, actual_log.len);
+		assert_str_equals(expected_log.buf, actual_log.buf, expected_log.len);
+
+		last_tid = expected->tid;
+	}
+
+	buffer_delete(compiled_visit_buf);
+	buffer_delete(visit_buf);
+	buffer_delete(compiled_buf);
+	buffer_delete(buf);
+	fast_session_free(compiled_visit_dec);
+	fast_session_free(visit_dec);
+	fast_session_free(compiled_dec);
+	fast_session_free(compiled_enc);
+	fast_session_free(dec);
+	fast_session_free(enc);
+}
+
+/* A codec is only attached to the template that it was generated from */
+void test_fast_generated_codecs_stale(void)
+{
+	static const char templates[] =
+		"<template name=\"Scalars\" id=\"1\">"
+		"<string name=\"MessageType\" id=\"35\"><constant value=\"X\"/></string>"
+		"<uInt32 name=\"Version\" id=\"1\"><constant value=\"7\"/></uInt32>"
+		"<int32 name=\"Flags\" id=\"2\" presence=\"optional\"><constant value=\"-3\"/></int32>"
+		"<string name=\"Source\" id=\"3\" presence=\"optional\"><constant value=\"TEST\"/></string>"
+		"<uInt32 name=\"MsgSeqNum\" id=\"34\"><increment/></uInt32>"
+		"</template>\n";
+	const struct fast_template_codec *codec = NULL;
+	struct fast_session *session;
+	struct fast_message *msg;
+	unsigned long i;
+
+	for (i = 0; i < codegen_nr_codecs; i++) {
+		if (codegen_codecs[i].tid == 2)
+			codec = codegen_codecs + i;
+	}
+
+	assert_true(codec != NULL);
+
+	/* The template as it was generated from, but for its fifth field */
+	session = fast_session_templates(templates);
+	msg = fast_tid_lookup(&session->rx_map, 1);
+
+	assert_int_equals(0, fast_session_attach(session, codegen_codecs, codegen_nr_codecs));
+	assert_true(msg->decode == NULL);
+	assert_true(msg->encode == NULL);
+	assert_true(msg->visit == NULL);
+
+	fast_session_free(session);
+
+	/* Same fields, one of them with another presence */
+	session = codegen_session(false);
+	msg = fast_tid_lookup(&session->rx_map, 2);
+	msg->fields[1].presence = FAST_PRESENCE_OPTIONAL;
+
+	assert_int_equals(-1, fast_message_attach(msg, codec));
+	assert_true(msg->decode == NULL);
+
+	msg->fields[1].presence = FAST_PRESENCE_MANDATORY;
+
+	assert_int_equals(0, fast_message_attach(msg, codec));
+	assert_true(msg->decode != NULL);
+
+	fast_session_free(session);
+}
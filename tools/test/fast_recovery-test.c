@@ -0,0 +1,420 @@
+#include "test-suite.h"
+#include "harness.h"
+
+#include "libtrading/proto/fast_publisher.h"
+#include "libtrading/proto/fast_recovery.h"
+#include "libtrading/proto/fast_session.h"
+#include "libtrading/proto/fast_message.h"
+#include "libtrading/proto/fast_feed.h"
+
+#include <sys/socket.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define	RECOVERY_INCREMENTAL	1
+#define	RECOVERY_SNAPSHOT	2
+#define	RECOVERY_TRADE		3
+
+#define	RECOVERY_INSTRUMENTS	10000
+
+/* The application's books, by the number in the symbol */
+struct recovery_book {
+	u64			rpt_seq;
+	u64			px;
+	unsigned long		nr_snapshots;
+};
+
+static struct recovery_book books[RECOVERY_INSTRUMENTS];
+
+static struct fast_session *recovery_session(void)
+{
+	char xml[] = "/tmp/fast-templates-XXXXXX";
+	struct fast_session *session;
+	FILE *stream;
+	int fd;
+
+	fd = mkstemp(xml);
+	assert_true(fd >= 0);
+
+	stream = fdopen(fd, "w");
+	assert_true(stream != NULL);
+
+	fprintf(stream, "<templates>"
+		"<template id=\"1\"><uInt32 name=\"MsgSeqNum\"/>"
+		"<sequence name=\"Entries\"><length/>"
+		"<string name=\"Symbol\"/><uInt32 name=\"RptSeq\"/><uInt32 name=\"Px\"/>"
+		"</sequence></template>"
+		"<template id=\"2\"><uInt32 name=\"MsgSeqNum\"/>"
+		"<string name=\"Symbol\"/><uInt32 name=\"RptSeq\"/><uInt32 name=\"Px\"/>"
+		"</template>"
+		"<template id=\"3\"><string name=\"Symbol\"/><uInt32 name=\"RptSeq\"/><uInt32 name=\"Px\"/></template>"
+		"</templates>\n");
+	fclose(stream);
+
+	session = fast_session_new(-1);
+	assert_int_equals(0, fast_suite_template(session, xml));
+
+	unlink(xml);
+
+	return session;
+}
+
+static struct recovery_book *recovery_book(struct fast_instrument *instrument)
+{
+	unsigned long idx = strtoul(instrument->symbol + 1, NULL, 10);
+
+	assert_true(idx < RECOVERY_INSTRUMENTS);
+
+	return books + idx;
+}
+
+static int recovery_on_snapshot(struct fast_recovery *rec, struct fast_instrument *instrument, struct fast_message *msg)
+{
+	struct recovery_book *book = recovery_book(instrument);
+
+	book->rpt_seq	= msg->fields[2].uint_value;
+	book->px	= msg->fields[3].uint_value;
+
+	book->nr_snapshots++;
+
+	return 0;
+}
+
+/* Updates reach a book in RptSeq order and without gaps */
+static int recovery_on_update(struct fast_recovery *rec, struct fast_instrument *instrument, u64 tid, struct fast_field *fields)
+{
+	struct recovery_book *book = recovery_book(instrument);
+
+	assert_int_equals(book->rpt_seq + 1, fields[1].uint_value);
+
+	book->rpt_seq	= fields[1].uint_value;
+	book->px	= fields[2].uint_value;
+
+	return 0;
+}
+
+static struct fast_recovery *recovery_new(struct fast_session *session, unsigned long ring_size)
+{
+	struct fast_recovery *rec;
+
+	rec = fast_recovery_new(ring_size);
+	assert_true(rec != NULL);
+
+	rec->on_snapshot	= recovery_on_snapshot;
+	rec->on_update		= recovery_on_update;
+
+	assert_int_equals(0, fast_recovery_add_updates(rec, fast_tid_lookup(&session->rx_map, RECOVERY_INCREMENTAL), 1, 0, 1));
+	assert_int_equals(0, fast_recovery_add_snapshot(rec, fast_tid_lookup(&session->rx_map, RECOVERY_SNAPSHOT), 1, 2));
+	assert_int_equals(0, fast_recovery_add_updates(rec, fast_tid_lookup(&session->rx_map, RECOVERY_TRADE), -1, 0, 1));
+
+	/* The symbol has to be a string */
+	assert_int_equals(-1, fast_recovery_add_updates(rec, fast_tid_lookup(&session->rx_map, RECOVERY_TRADE), -1, 1, 2));
+
+	memset(books, 0, sizeof(books));
+
+	return rec;
+}
+
+static void set_uint(struct fast_field *field, u64 value)
+{
+	field->uint_value	= value;
+	field->state		= FAST_STATE_ASSIGNED;
+}
+
+static void set_update(struct fast_field *fields, unsigned long idx, u64 rpt_seq, u64 px)
+{
+	char symbol[16];
+
+	snprintf(symbol, sizeof(symbol), "S%05lu", idx);
+
+	assert_int_equals(0, field_set_string(fields + 0, symbol, strlen(symbol)));
+	set_uint(fields + 1, rpt_seq);
+	set_uint(fields + 2, px);
+}
+
+static void put_trade(struct fast_recovery *rec, struct fast_session *session, unsigned long idx, u64 rpt_seq, u64 px)
+{
+	struct fast_message *msg = fast_tid_lookup(&session->rx_map, RECOVERY_TRADE);
+
+	set_update(msg->fields, idx, rpt_seq, px);
+
+	assert_int_equals(0, fast_recovery_process(rec, msg));
+}
+
+static void put_snapshot(struct fast_recovery *rec, struct fast_session *session, unsigned long idx, u64 rpt_seq, u64 px)
+{
+	struct fast_message *msg = fast_tid_lookup(&session->rx_map, RECOVERY_SNAPSHOT);
+
+	set_uint(msg->fields + 0, 1);
+	set_update(msg->fields + 1, idx, rpt_seq, px);
+
+	assert_int_equals(0, fast_recovery_process(rec, msg));
+}
+
+static struct fast_instrument *instrument(struct fast_recovery *rec, unsigned long idx)
+{
+	char symbol[16];
+
+	snprintf(symbol, sizeof(symbol), "S%05lu", idx);
+
+	return fast_recovery_instrument(rec, symbol);
+}
+
+void test_fast_recovery_snapshot(void)
+{
+	struct fast_session *session;
+	struct fast_recovery *rec;
+	struct fast_message *msg;
+	struct fast_sequence *seq;
+
+	session = recovery_session();
+	rec = recovery_new(session, 64);
+
+	/* Two updates in one message, queued until there are snapshots */
+	msg = fast_tid_lookup(&session->rx_map, RECOVERY_INCREMENTAL);
+	set_uint(msg->fields + 0, 1);
+
+	seq = msg->fields[1].ptr_value;
+	assert_int_equals(0, fast_sequence_reserve(seq, 2));
+	set_uint(&seq->length, 2);
+	set_update(fast_sequence_element(seq, 0), 0, 1, 100);
+	set_update(fast_sequence_element(seq, 1), 1, 1, 200);
+	assert_int_equals(0, fast_recovery_process(rec, msg));
+
+	put_trade(rec, session, 0, 2, 101);
+
+	assert_int_equals(2, rec->nr_instruments);
+	assert_int_equals(0, rec->nr_live);
+	assert_int_equals(3, rec->stats.nr_queued);
+	assert_int_equals(2, instrument(rec, 0)->nr_queued);
+
+	/* The snapshot covers the first update, the second goes on top */
+	put_snapshot(rec, session, 0, 1, 100);
+
+	assert_true(fast_instrument_is_live(instrument(rec, 0)));
+	assert_int_equals(2, books[0].rpt_seq);
+	assert_int_equals(101, books[0].px);
+	assert_int_equals(0, instrument(rec, 0)->nr_queued);
+	assert_false(fast_recovery_is_done(rec));
+
+	/* A snapshot from before the queued update */
+	put_snapshot(rec, session, 1, 0, 190);
+
+	assert_true(fast_recovery_is_done(rec));
+	assert_int_equals(1, books[1].rpt_seq);
+	assert_int_equals(200, books[1].px);
+
+	/* Live updates go straight to the book, repeated ones nowhere */
+	put_trade(rec, session, 0, 3, 102);
+	put_trade(rec, session, 0, 3, 102);
+	put_trade(rec, session, 0, 2, 101);
+
+	assert_int_equals(102, books[0].px);
+	assert_int_equals(2, rec->stats.nr_duplicates);
+
+	/* A gap makes the instrument wait for a snapshot again */
+	put_trade(rec, session, 0, 5, 104);
+	put_trade(rec, session, 0, 6, 105);
+
+	assert_int_equals(FAST_INSTRUMENT_STALE, instrument(rec, 0)->state);
+	assert_int_equals(1, rec->stats.nr_gaps);
+	assert_int_equals(102, books[0].px);
+
+	/* Snapshots of live instruments are of no use */
+	put_snapshot(rec, session, 1, 1, 200);
+	assert_int_equals(1, books[1].nr_snapshots);
+
+	/* ...nor are ones that are no newer than the book */
+	put_snapshot(rec, session, 0, 3, 102);
+	assert_int_equals(1, books[0].nr_snapshots);
+	assert_int_equals(2, rec->stats.nr_ignored);
+
+	put_snapshot(rec, session, 0, 4, 103);
+
+	assert_true(fast_recovery_is_done(rec));
+	assert_int_equals(6, books[0].rpt_seq);
+	assert_int_equals(105, books[0].px);
+	assert_int_equals(3, rec->stats.nr_recovered);
+
+	fast_recovery_free(rec);
+	fast_session_free(session);
+}
+
+void test_fast_recovery_overrun(void)
+{
+	struct fast_session *session;
+	struct fast_recovery *rec;
+	int i;
+
+	session = recovery_session();
+	rec = recovery_new(session, 4);
+
+	for (i = 1; i <= 6; i++)
+		put_trade(rec, session, 7, i, 700 + i);
+
+	assert_int_equals(2, rec->stats.nr_overruns);
+	assert_int_equals(4, instrument(rec, 7)->nr_queued);
+
+	/* The updates right after the snapshot are gone */
+	put_snapshot(rec, session, 7, 1, 701);
+
+	assert_int_equals(FAST_INSTRUMENT_STALE, instrument(rec, 7)->state);
+	assert_int_equals(1, books[7].rpt_seq);
+	assert_int_equals(4, instrument(rec, 7)->nr_queued);
+
+	put_snapshot(rec, session, 7, 2, 702);
+
+	assert_true(fast_instrument_is_live(instrument(rec, 7)));
+	assert_int_equals(6, books[7].rpt_seq);
+	assert_int_equals(706, books[7].px);
+
+	/* Applied updates make room in the ring again */
+	put_trade(rec, session, 8, 1, 801);
+	put_trade(rec, session, 8, 2, 802);
+
+	assert_int_equals(2, rec->stats.nr_overruns);
+
+	fast_recovery_free(rec);
+	fast_session_free(session);
+}
+
+/* The publishers' side of the feed */
+struct recovery_channel {
+	struct fast_session	*session;
+	struct fast_session	*rx;
+	struct fast_publisher	*publisher;
+	struct fast_feed	*feed;
+	int			sv[2];
+};
+
+static int recovery_handler(struct fast_feed *feed, struct fast_message *msg)
+{
+	return fast_recovery_process(feed->data, msg);
+}
+
+static void channel_init(struct recovery_channel *channel, struct fast_recovery *rec)
+{
+	assert_int_equals(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, channel->sv));
+
+	channel->session = recovery_session();
+	channel->session->sockfd = channel->sv[0];
+
+	channel->publisher = fast_publisher_new(channel->session, 1400);
+	assert_true(channel->publisher != NULL);
+
+	channel->publisher->flags = FAST_PUBLISHER_FLAGS_SEQ;
+
+	channel->rx = recovery_session();
+
+	channel->feed = fast_feed_new(channel->rx);
+	assert_true(channel->feed != NULL);
+
+	channel->feed->handler	= recovery_handler;
+	channel->feed->data	= rec;
+}
+
+static void channel_exit(struct recovery_channel *channel)
+{
+	fast_feed_free(channel->feed);
+	fast_session_free(channel->rx);
+	fast_publisher_free(channel->publisher);
+	fast_session_free(channel->session);
+	close(channel->sv[0]);
+	close(channel->sv[1]);
+}
+
+/* Sends what has been published and hands it to the feed */
+static void channel_pump(struct recovery_channel *channel)
+{
+	char buf[FAST_FEED_PACKET_SIZE];
+	ssize_t len;
+
+	assert_int_equals(0, fast_publisher_flush(channel->publisher));
+
+	while ((len = recv(channel->sv[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+		assert_int_equals(0, fast_feed_process(channel->feed, FAST_FEED_LINE_A, buf, len));
+}
+
+/*
+ * A handler that joins late recovers 10000 instruments from a snapshot
+ * cycle while updates keep coming, over a socket pair per channel.
+ */
+void test_fast_recovery_loopback(void)
+{
+	static u64 rpt_seqs[RECOVERY_INSTRUMENTS];
+	static u64 prices[RECOVERY_INSTRUMENTS];
+	struct recovery_channel incremental;
+	struct recovery_channel snapshot;
+	struct fast_session *session;
+	struct fast_recovery *rec;
+	struct fast_message *msg;
+	struct fast_sequence *seq;
+	u64 seed = 0x9e3779b97f4a7c15ULL;
+	unsigned long i, j, idx;
+
+	session = recovery_session();
+	rec = recovery_new(session, 4 * RECOVERY_INSTRUMENTS);
+
+	channel_init(&incremental, rec);
+	channel_init(&snapshot, rec);
+
+	/* Updates that were sent before the handler joined */
+	for (i = 0; i < RECOVERY_INSTRUMENTS; i++) {
+		rpt_seqs[i] = i % 4;
+		prices[i] = 1000 + i;
+	}
+
+	for (i = 0; i < RECOVERY_INSTRUMENTS; i++) {
+		msg = fast_tid_lookup(&snapshot.session->rx_map, RECOVERY_SNAPSHOT);
+		set_uint(msg->fields + 0, i + 1);
+		set_update(msg->fields + 1, i, rpt_seqs[i], prices[i]);
+		assert_int_equals(0, fast_publisher_add(snapshot.publisher, msg));
+
+		msg = fast_tid_lookup(&incremental.session->rx_map, RECOVERY_INCREMENTAL);
+		set_uint(msg->fields + 0, i + 1);
+
+		seq = msg->fields[1].ptr_value;
+		assert_int_equals(0, fast_sequence_reserve(seq, 2));
+		set_uint(&seq->length, 2);
+
+		for (j = 0; j < 2; j++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+
+			idx = seed % RECOVERY_INSTRUMENTS;
+
+			prices[idx] += 1 + seed % 3;
+			set_update(fast_sequence_element(seq, j), idx, ++rpt_seqs[idx], prices[idx]);
+		}
+
+		assert_int_equals(0, fast_publisher_add(incremental.publisher, msg));
+
+		if (i % 16 == 15) {
+			channel_pump(&snapshot);
+			channel_pump(&incremental);
+		}
+	}
+
+	channel_pump(&snapshot);
+	channel_pump(&incremental);
+
+	assert_int_equals(RECOVERY_INSTRUMENTS, rec->nr_instruments);
+	assert_true(fast_recovery_is_done(rec));
+	assert_int_equals(RECOVERY_INSTRUMENTS, rec->stats.nr_snapshots);
+	assert_int_equals(0, rec->stats.nr_overruns);
+	assert_int_equals(0, rec->stats.nr_errors);
+	assert_int_equals(0, incremental.feed->stats.nr_gaps);
+
+	for (i = 0; i < RECOVERY_INSTRUMENTS; i++) {
+		assert_int_equals(rpt_seqs[i], books[i].rpt_seq);
+		assert_int_equals(prices[i], books[i].px);
+	}
+
+	channel_exit(&snapshot);
+	channel_exit(&incremental);
+	fast_recovery_free(rec);
+	fast_session_free(session);
+}
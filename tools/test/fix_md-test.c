@@ -0,0 +1,247 @@
+#include "test-suite.h"
+#include "harness.h"
+
+#include "libtrading/proto/fix_message.h"
+#include "libtrading/proto/fix_md.h"
+#include "libtrading/buffer.h"
+
+#include <string.h>
+#include <stdio.h>
+
+static void fix_md_feed(struct fix_md *md, struct fix_message *msg, const char *body)
+{
+	struct buffer *buf;
+
+	buf = buffer_new(1024);
+
+	buffer_printf(buf, "8=FIX.4.4\0019=%lu\001%s", strlen(body), body);
+	buffer_printf(buf, "10=%03u\001", buffer_sum(buf));
+
+	assert_int_equals(0, fix_message_parse(msg, buf));
+	assert_int_equals(0, fix_md_process(md, msg));
+
+	buffer_delete(buf);
+}
+
+void test_fix_md_snapshot(void)
+{
+	struct fix_price_level *level;
+	struct fix_message *msg;
+	struct fix_book *book;
+	struct fix_md *md;
+
+	md = fix_md_new(4);
+	msg = fix_message_new();
+
+	fix_md_feed(md, msg, "35=W\00134=1\00155=AAA\00183=10\001268=3\001"
+			"269=0\001270=10.5\001271=100\001"
+			"269=1\001270=10.75\001271=200\001"
+			"269=0\001270=10.25\001271=300\001");
+
+	book = fix_md_book(md, "AAA");
+	assert_true(book != NULL);
+	assert_true(fix_book_is_synced(book));
+	assert_int_equals(10, book->rpt_seq);
+
+	assert_int_equals(2, book->nr_levels[FIX_BOOK_BID]);
+	assert_int_equals(1, book->nr_levels[FIX_BOOK_OFFER]);
+
+	level = fix_book_level(book, FIX_BOOK_BID, 0);
+	assert_true(level->price == 10.5);
+	assert_true(level->size == 100);
+
+	level = fix_book_level(book, FIX_BOOK_BID, 1);
+	assert_true(level->price == 10.25);
+
+	level = fix_book_level(book, FIX_BOOK_OFFER, 0);
+	assert_true(level->price == 10.75);
+
+	assert_is_null(fix_md_book(md, "BBB"));
+
+	fix_message_free(msg);
+	fix_md_free(md);
+}
+
+void test_fix_md_incremental_price_level(void)
+{
+	struct fix_message *msg;
+	struct fix_book *book;
+	struct fix_md *md;
+
+	md = fix_md_new(2);
+	msg = fix_message_new();
+	fix_msg_add_flags(msg, FIX_MSG_FLAGS_SKIP_BODY);
+
+	fix_md_feed(md, msg, "35=W\00134=1\00155=AAA\001268=0\001");
+
+	fix_md_feed(md, msg, "35=X\00134=2\001268=4\001"
+			"279=0\001269=0\00155=AAA\00183=1\001270=10\001271=1\0011023=1\001"
+			"279=0\001269=0\00155=AAA\00183=2\001270=11\001271=2\0011023=1\001"
+			"279=0\001269=0\00155=AAA\00183=3\001270=12\001271=3\0011023=1\001"
+			"279=1\001269=0\00155=AAA\00183=4\001270=12\001271=5\0011023=1\001");
+
+	book = fix_md_book(md, "AAA");
+	assert_int_equals(4, book->rpt_seq);
+
+	/* The book is two levels deep, the first insert fell off */
+	assert_int_equals(2, book->nr_levels[FIX_BOOK_BID]);
+	assert_true(fix_book_level(book, FIX_BOOK_BID, 0)->size == 5);
+	assert_true(fix_book_level(book, FIX_BOOK_BID, 1)->price == 11);
+
+	fix_md_feed(md, msg, "35=X\00134=3\001268=1\001"
+			"279=2\001269=0\00155=AAA\00183=5\0011023=1\001");
+
+	assert_int_equals(1, book->nr_levels[FIX_BOOK_BID]);
+	assert_true(fix_book_level(book, FIX_BOOK_BID, 0)->price == 11);
+
+	fix_message_free(msg);
+	fix_md_free(md);
+}
+
+void test_fix_md_incremental_price(void)
+{
+	struct fix_message *msg;
+	struct fix_book *book;
+	struct fix_md *md;
+
+	md = fix_md_new(0);
+	msg = fix_message_new();
+
+	fix_md_feed(md, msg, "35=W\00134=1\00155=AAA\001268=1\001269=1\001270=10\001271=1\001");
+
+	fix_md_feed(md, msg, "35=X\00134=2\001268=3\001"
+			"279=0\001269=1\00155=AAA\001270=9.5\001271=2\001"
+			"279=0\001269=1\00155=AAA\001270=10.5\001271=3\001"
+			"279=2\001269=1\00155=AAA\001270=10\001");
+
+	book = fix_md_book(md, "AAA");
+
+	assert_int_equals(2, book->nr_levels[FIX_BOOK_OFFER]);
+	assert_true(fix_book_level(book, FIX_BOOK_OFFER, 0)->price == 9.5);
+	assert_true(fix_book_level(book, FIX_BOOK_OFFER, 1)->price == 10.5);
+	assert_is_null(fix_book_level(book, FIX_BOOK_OFFER, 2));
+
+	fix_message_free(msg);
+	fix_md_free(md);
+}
+
+void test_fix_md_sequencing(void)
+{
+	struct fix_message *msg;
+	struct fix_book *book;
+	struct fix_md *md;
+
+	md = fix_md_new(0);
+	msg = fix_message_new();
+
+	/* No snapshot yet */
+	fix_md_feed(md, msg, "35=X\00134=1\001268=1\001"
+			"279=0\001269=0\00155=AAA\00183=1\001270=10\001271=1\001");
+
+	book = fix_md_book(md, "AAA");
+	assert_int_equals(FIX_BOOK_STATE_EMPTY, book->state);
+	assert_int_equals(0, book->nr_levels[FIX_BOOK_BID]);
+	assert_int_equals(1, md->stats.nr_dropped);
+
+	fix_md_feed(md, msg, "35=W\00134=2\00155=AAA\00183=5\001268=0\001");
+	assert_true(fix_book_is_synced(book));
+
+	/* Already covered by the snapshot */
+	fix_md_feed(md, msg, "35=X\00134=3\001268=1\001"
+			"279=0\001269=0\00155=AAA\00183=5\001270=10\001271=1\001");
+	assert_int_equals(0, book->nr_levels[FIX_BOOK_BID]);
+	assert_int_equals(2, md->stats.nr_dropped);
+
+	fix_md_feed(md, msg, "35=X\00134=4\001268=1\001"
+			"279=0\001269=0\00155=AAA\00183=7\001270=10\001271=1\001");
+	assert_int_equals(FIX_BOOK_STATE_STALE, book->state);
+	assert_int_equals(1, md->stats.nr_gaps);
+
+	fix_md_feed(md, msg, "35=W\00134=5\00155=AAA\00183=7\001268=1\001269=0\001270=10\001271=1\001");
+	assert_true(fix_book_is_synced(book));
+	assert_int_equals(1, book->nr_levels[FIX_BOOK_BID]);
+
+	fix_message_free(msg);
+	fix_md_free(md);
+}
+
+void test_fix_md_many_symbols(void)
+{
+	struct fix_message *msg;
+	char body[256];
+	struct fix_md *md;
+	int i;
+
+	md = fix_md_new(0);
+	msg = fix_message_new();
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(body, sizeof body, "35=W\00134=%d\00155=SYM%d\001268=1\001269=0\001270=%d\001271=1\001", i + 1, i, i);
+		fix_md_feed(md, msg, body);
+	}
+
+	assert_int_equals(1000, md->nr_books);
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(body, sizeof body, "SYM%d", i);
+		assert_true(fix_book_level(fix_md_book(md, body), FIX_BOOK_BID, 0)->price == i);
+	}
+
+	fix_message_free(msg);
+	fix_md_free(md);
+}
+
+/* An entry that cannot have a book does not take the others with it */
+void test_fix_md_bad_symbol(void)
+{
+	struct fix_message *msg;
+	struct fix_md *md;
+
+	md = fix_md_new(4);
+	msg = fix_message_new();
+
+	fix_md_feed(md, msg, "35=W\00134=1\00155=AAA\00183=1\001268=1\001269=0\001270=10\001271=1\001");
+
+	fix_md_feed(md, msg, "35=X\00134=2\001268=2\001"
+			"279=0\001269=0\00155=SYMBOL-LONGER-THAN-THE-BOOK-KEY-BUFFER\001270=9\001271=1\001"
+			"279=0\001269=0\00155=AAA\00183=2\001270=11\001271=1\001");
+
+	assert_int_equals(1, md->stats.nr_bad_symbols);
+	assert_int_equals(2, fix_md_book(md, "AAA")->nr_levels[FIX_BOOK_BID]);
+	assert_true(fix_book_level(fix_md_book(md, "AAA"), FIX_BOOK_BID, 0)->price == 11);
+
+	/* A snapshot without a symbol */
+	fix_md_feed(md, msg, "35=W\00134=3\00183=1\001268=2\001269=0\001270=10\001271=1\001269=1\001270=12\001271=1\001");
+
+	assert_int_equals(3, md->stats.nr_bad_symbols);
+	assert_int_equals(1, md->nr_books);
+
+	fix_message_free(msg);
+	fix_md_free(md);
+}
+
+/* Bodies that are not parsed up front are checked for their tags */
+void test_fix_md_garbled_tag(void)
+{
+	struct fix_message *msg;
+	struct buffer *buf;
+	struct fix_md *md;
+	const char *body;
+
+	md = fix_md_new(4);
+	msg = fix_message_new();
+	fix_msg_add_flags(msg, FIX_MSG_FLAGS_SKIP_BODY);
+
+	body = "35=W\00134=1\00155=AAA\00183=1\001268=1\001269=0\0012x9=0\001270=10\001271=1\001";
+
+	buf = buffer_new(1024);
+	buffer_printf(buf, "8=FIX.4.4\0019=%lu\001%s", strlen(body), body);
+	buffer_printf(buf, "10=%03u\001", buffer_sum(buf));
+
+	assert_int_equals(0, fix_message_parse(msg, buf));
+	assert_int_equals(-1, fix_md_process(md, msg));
+
+	buffer_delete(buf);
+	fix_message_free(msg);
+	fix_md_free(md);
+}
@@ -0,0 +1,365 @@
+#include "test-suite.h"
+#include "harness.h"
+
+#include "libtrading/proto/fix_message.h"
+#include "libtrading/array.h"
+#include "libtrading/buffer.h"
+
+#include <string.h>
+#include <stdio.h>
+
+void test_fix_msg_type_parse_single(void)
+{
+	assert_int_equals(FIX_MSG_TYPE_HEARTBEAT, fix_msg_type_parse("0\x01"));
+	assert_int_equals(FIX_MSG_TYPE_NEW_ORDER_SINGLE, fix_msg_type_parse("D\x01"));
+	assert_int_equals(FIX_MSG_TYPE_ORDER_CANCEL_REQUEST, fix_msg_type_parse("F\x01"));
+	assert_int_equals(FIX_MSG_TYPE_MARKET_DATA_INCREMENTAL_REFRESH, fix_msg_type_parse("X\x01"));
+	assert_int_equals(FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST_REQUEST, fix_msg_type_parse("z\x01"));
+}
+
+void test_fix_msg_type_parse_double(void)
+{
+	assert_int_equals(FIX_MSG_TYPE_DERIVATIVE_SECURITY_LIST, fix_msg_type_parse("AA\x01"));
+	assert_int_equals(FIX_MSG_TYPE_TRADE_CAPTURE_REPORT, fix_msg_type_parse("AE\x01"));
+	assert_int_equals(FIX_MSG_TYPE_USER_REQUEST, fix_msg_type_parse("BE\x01"));
+	assert_int_equals(FIX_MSG_TYPE_SECURITY_DEFINITION_UPDATE_REPORT, fix_msg_type_parse("BP\x01"));
+}
+
+void test_fix_msg_type_parse_unknown(void)
+{
+	assert_true(fix_msg_type_parse("I\x01") == FIX_MSG_TYPE_UNKNOWN);
+	assert_true(fix_msg_type_parse("\xff\x01") == FIX_MSG_TYPE_UNKNOWN);
+	assert_true(fix_msg_type_parse("CZ\x01") == FIX_MSG_TYPE_UNKNOWN);
+	assert_true(fix_msg_type_parse("A0\x01") == FIX_MSG_TYPE_UNKNOWN);
+	assert_true(fix_msg_type_parse("ABC\x01") == FIX_MSG_TYPE_UNKNOWN);
+}
+
+static struct buffer *fix_message_build(const char *body)
+{
+	struct buffer *buf;
+	unsigned long len;
+
+	buf = buffer_new(1024);
+	len = strlen(body);
+
+	buffer_printf(buf, "8=FIX.4.4\0019=%lu\001%s", len, body);
+	buffer_printf(buf, "10=%03u\001", buffer_sum(buf));
+
+	return buf;
+}
+
+void test_fix_message_parse_group(void)
+{
+	struct fix_message *msg;
+	struct fix_group *group;
+	struct fix_field *fields;
+	struct fix_field *field;
+	struct buffer *buf;
+
+	buf = fix_message_build("35=X\00134=1\001262=REQ\001268=2\001"
+				"279=0\001269=0\00155=AAA\001270=10.5\001271=100\001"
+				"279=2\001269=1\00155=BBB\001"
+				"1=ACCOUNT\001");
+
+	msg = fix_message_new();
+
+	assert_int_equals(0, fix_message_parse(msg, buf));
+	assert_int_equals(FIX_MSG_TYPE_MARKET_DATA_INCREMENTAL_REFRESH, msg->type);
+
+	group = fix_get_group(msg, NoMDEntries);
+	assert_true(group != NULL);
+	assert_int_equals(2, fix_group_nr_entries(group));
+	assert_int_equals(MDUpdateAction, group->delim);
+
+	assert_int_equals(5, fix_group_entry(msg, group, 0, &fields));
+	assert_int_equals(MDUpdateAction, fields[0].tag);
+
+	field = fix_group_get_field(msg, group, 0, MDEntryPx);
+	assert_true(field != NULL);
+	assert_true(field->float_value == 10.5);
+
+	assert_int_equals(3, fix_group_entry(msg, group, 1, &fields));
+	assert_is_null(fix_group_get_field(msg, group, 1, MDEntryPx));
+
+	/* Fields of group entries are not visible at the top level */
+	assert_is_null(fix_get_field(msg, Symbol));
+
+	field = fix_get_field(msg, Account);
+	assert_true(field != NULL);
+	assert_str_equals("ACCOUNT", field->string_value, 7);
+
+	fix_message_free(msg);
+	buffer_delete(buf);
+}
+
+static void assert_garbled(const char *body)
+{
+	struct fix_message *msg;
+	struct buffer *buf;
+
+	buf = fix_message_build(body);
+
+	msg = fix_message_new();
+
+	assert_int_equals(-1, fix_message_parse(msg, buf));
+
+	fix_message_free(msg);
+	buffer_delete(buf);
+}
+
+void test_fix_message_parse_group_delim(void)
+{
+	/* Account is not a member of NoMDEntries */
+	assert_garbled("35=X\00134=1\001268=1\0011=ACCOUNT\001279=0\001269=0\001");
+
+	/* Neither is the checksum */
+	assert_garbled("35=X\00134=1\001268=1\001");
+}
+
+void test_fix_message_parse_group_count(void)
+{
+	/* Too many entries */
+	assert_garbled("35=X\00134=1\001268=1\001"
+		       "279=0\001269=0\001"
+		       "279=2\001269=1\001");
+
+	/* Too few entries */
+	assert_garbled("35=X\00134=1\001268=3\001"
+		       "279=0\001269=0\001"
+		       "279=2\001269=1\001"
+		       "1=ACCOUNT\001");
+
+	/* Too few entries before the end of the message */
+	assert_garbled("35=X\00134=1\001268=2\001"
+		       "279=0\001269=0\001");
+}
+
+void test_fix_message_parse_many_fields(void)
+{
+	struct fix_message *msg;
+	struct fix_group *group;
+	char body[2048];
+	struct buffer *buf;
+	int len, i;
+
+	len = sprintf(body, "35=X\00134=1\001268=64\001");
+
+	for (i = 0; i < 64; i++)
+		len += sprintf(body + len, "279=0\001270=%d\001", i);
+
+	buf = fix_message_build(body);
+
+	msg = fix_message_new();
+
+	assert_int_equals(0, fix_message_parse(msg, buf));
+
+	group = fix_get_group(msg, NoMDEntries);
+	assert_true(group != NULL);
+	assert_int_equals(64, fix_group_nr_entries(group));
+	assert_true(fix_group_get_field(msg, group, 63, MDEntryPx)->float_value == 63);
+
+	fix_message_free(msg);
+	buffer_delete(buf);
+}
+
+void test_fix_message_parse_lazy(void)
+{
+	struct fix_message *msg;
+	struct fix_field *field;
+	struct buffer *buf;
+	int64_t int_value;
+	double float_value;
+
+	buf = fix_message_build("35=D\00134=2\00111=ORDER\00138=100\00144=12.25\0015001=CUSTOM\001");
+
+	msg = fix_message_new();
+	fix_msg_add_flags(msg, FIX_MSG_FLAGS_LAZY);
+
+	assert_int_equals(0, fix_message_parse(msg, buf));
+	assert_int_equals(2, msg->msg_seq_num);
+	assert_int_equals(4, msg->nr_fields);
+	assert_int_equals(FIX_TYPE_RAW, msg->fields[2].type);
+
+	field = fix_get_field(msg, Price);
+	assert_true(field != NULL);
+	assert_int_equals(FIX_TYPE_FLOAT, field->type);
+	assert_true(field->float_value == 12.25);
+
+	assert_true(fix_get_int(msg, OrderQty, &int_value));
+	assert_int_equals(100, int_value);
+
+	assert_true(fix_get_float(msg, OrderQty, &float_value));
+	assert_true(float_value == 100.0);
+
+	/* Unknown tags stay accessible as strings */
+	field = fix_get_field(msg, 5001);
+	assert_true(field != NULL);
+	assert_str_equals("CUSTOM", field->string_value, 6);
+
+	fix_message_free(msg);
+	buffer_delete(buf);
+}
+
+void test_fix_message_lazy_mismatched_type(void)
+{
+	struct fix_message *msg;
+	struct fix_field *field;
+	struct buffer *buf;
+	int64_t int_value;
+	double float_value;
+
+	buf = fix_message_build("35=D\00134=2\00111=ORDER\00138=100\00144=12.25\001");
+
+	msg = fix_message_new();
+	fix_msg_add_flags(msg, FIX_MSG_FLAGS_LAZY);
+
+	assert_int_equals(0, fix_message_parse(msg, buf));
+
+	assert_true(fix_get_int(msg, Price, &int_value));
+	assert_int_equals(12, int_value);
+
+	field = fix_get_field(msg, Price);
+	assert_int_equals(FIX_TYPE_FLOAT, field->type);
+	assert_true(field->float_value == 12.25);
+
+	assert_true(fix_get_int(msg, ClOrdID, &int_value));
+	assert_int_equals(0, int_value);
+
+	field = fix_get_field(msg, ClOrdID);
+	assert_int_equals(FIX_TYPE_STRING, field->type);
+	assert_str_equals("ORDER", field->string_value, 5);
+
+	assert_true(fix_get_float(msg, OrderQty, &float_value));
+	assert_true(float_value == 100.0);
+
+	field = fix_get_field(msg, OrderQty);
+	assert_int_equals(FIX_TYPE_FLOAT, field->type);
+	assert_true(field->float_value == 100.0);
+
+	fix_message_free(msg);
+	buffer_delete(buf);
+}
+
+void test_fix_message_parse_tag_overflow(void)
+{
+	struct fix_message *msg;
+	struct buffer *buf;
+
+	/* 2^32 + 44 must not wrap around to Price */
+	buf = fix_message_build("35=D\00134=2\0014294967340=1\001");
+
+	msg = fix_message_new();
+
+	fix_message_parse(msg, buf);
+	assert_true(fix_get_field(msg, Price) == NULL);
+
+	fix_message_free(msg);
+	buffer_delete(buf);
+}
+
+static bool timestamp_parse(const char *s, int64_t *value)
+{
+	return fix_utc_timestamp_parse(s, strlen(s), value);
+}
+
+void test_timestamp_parse(void)
+{
+	int64_t value;
+
+	assert_true(timestamp_parse("20131028-10:00:00", &value));
+	assert_true(value == 1382954400LL * 1000000000LL);
+
+	assert_true(timestamp_parse("20000229-23:59:59.123", &value));
+	assert_true(value == 951868799LL * 1000000000LL + 123000000LL);
+
+	assert_true(timestamp_parse("20000229-23:59:59.123456", &value));
+	assert_true(value == 951868799LL * 1000000000LL + 123456000LL);
+
+	assert_true(timestamp_parse("20000229-23:59:59.123456789", &value));
+	assert_true(value == 951868799LL * 1000000000LL + 123456789LL);
+
+	assert_true(timestamp_parse("19691231-00:00:00", &value));
+	assert_true(value == -86400LL * 1000000000LL);
+}
+
+void test_fix_utc_timestamp_parse_invalid(void)
+{
+	int64_t value;
+
+	assert_false(timestamp_parse("2013102-10:00:00", &value));
+	assert_false(timestamp_parse("20131328-10:00:00", &value));
+	assert_false(timestamp_parse("20131028 10:00:00", &value));
+	assert_false(timestamp_parse("20131028-24:00:00", &value));
+	assert_false(timestamp_parse("20131028-10:0a:00", &value));
+	assert_false(timestamp_parse("20131028-10:00:00.", &value));
+	assert_false(timestamp_parse("20131028-10:00:00.1234567890", &value));
+	assert_false(timestamp_parse("20131028-10:00:00x", &value));
+	assert_false(timestamp_parse("20130229-10:00:00", &value));
+	assert_false(timestamp_parse("20130431-10:00:00", &value));
+	assert_false(timestamp_parse("19000229-10:00:00", &value));
+
+	/* Short values are not read past their end */
+	assert_false(fix_utc_timestamp_parse("2013", 4, &value));
+	assert_false(fix_utc_timestamp_parse("20131028-10:00:00", 16, &value));
+}
+
+void test_fix_utc_timestamp_format(void)
+{
+	char buf[64];
+
+	assert_int_equals(21, fix_utc_timestamp_format(951868799LL * 1000000000LL + 123000000LL, buf, sizeof buf));
+	assert_str_equals("20000229-23:59:59.123", buf, 22);
+
+	assert_int_equals(24, fix_utc_timestamp_format(951868799LL * 1000000000LL + 123456000LL, buf, sizeof buf));
+	assert_str_equals("20000229-23:59:59.123456", buf, 25);
+
+	assert_int_equals(27, fix_utc_timestamp_format(951868799LL * 1000000000LL + 123456789LL, buf, sizeof buf));
+	assert_str_equals("20000229-23:59:59.123456789", buf, 28);
+}
+
+/* Whatever precision a timestamp is parsed with, formatting keeps it */
+void test_fix_utc_timestamp_roundtrip(void)
+{
+	static const char *timestamps[] = {
+		"20131028-10:00:00.000",
+		"20000229-23:59:59.123",
+		"20000229-23:59:59.123456",
+		"20000229-23:59:59.000001",
+		"20000229-23:59:59.123456789",
+		"19691231-23:59:59.999999999",
+	};
+	unsigned long i;
+	int64_t value;
+	char buf[64];
+
+	for (i = 0; i < ARRAY_SIZE(timestamps); i++) {
+		assert_true(timestamp_parse(timestamps[i], &value));
+		assert_int_equals(strlen(timestamps[i]), fix_utc_timestamp_format(value, buf, sizeof buf));
+		assert_str_equals(timestamps[i], buf, strlen(timestamps[i]) + 1);
+	}
+}
+
+void test_fix_message_parse_timestamps(void)
+{
+	struct fix_message *msg;
+	struct fix_field *field;
+	struct buffer *buf;
+	int64_t value;
+
+	buf = fix_message_build("35=8\00134=2\00152=20131028-10:00:00.250\00111=ORDER\00160=20131028-09:59:59.750\001");
+
+	msg = fix_message_new();
+
+	assert_int_equals(0, fix_message_parse(msg, buf));
+	assert_true(msg->sending_time == 1382954400LL * 1000000000LL + 250000000LL);
+
+	field = fix_get_field(msg, TransactTime);
+	assert_true(field != NULL);
+	assert_int_equals(FIX_TYPE_UTC_TIMESTAMP, field->type);
+
+	assert_true(fix_get_timestamp(msg, TransactTime, &value));
+	assert_true(msg->sending_time - value == 500000000LL);
+
+	fix_message_free(msg);
+	buffer_delete(buf);
+}
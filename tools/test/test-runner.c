@@ -0,0 +1,79 @@
+#include "test-suite.h"
+
+int main(int argc, char *argv[])
+{
+test_boe_login_request();
+test_boe_login_response();
+test_boe_logout_request();
+test_boe_client_heartbeat();
+test_boe_logout();
+test_boe_server_heartbeat();
+test_boe_replay_complete();
+test_fast_decimal_to_fixed();
+test_fast_decimal_to_double();
+test_fast_feed_arbitration();
+test_fast_feed_resync();
+test_fast_feed_visitor_stop();
+test_fast_feed_restart();
+test_fast_feed_loopback();
+test_fast_feed_poll_restart();
+test_fast_feed_oversized();
+test_fast_publisher_packets();
+test_fast_publisher_packet_reset();
+test_fast_publisher_reset_message();
+test_fast_publisher_encode_failure();
+test_fast_get_uint();
+test_fast_get_int();
+test_fast_transfer_int();
+test_fast_get_string();
+test_fast_get_pmap();
+test_fast_tid_map_dense();
+test_fast_tid_map_sparse();
+test_fast_session_many_templates();
+test_fast_string_max_length();
+test_fast_packet_decode();
+test_fast_string_views();
+test_fast_visitor();
+test_fast_sequence_roundtrip();
+test_fast_template_cache();
+test_fast_session_reset();
+test_fast_dictionary_scopes();
+test_fast_dictionary_type_mismatch();
+test_fast_decimal_parts();
+test_fast_templates_shared();
+test_fast_string_delta();
+test_fast_string_delta_decode();
+test_fast_decode_rollback();
+test_fast_generated_codecs();
+test_fast_generated_codecs_stale();
+test_fast_recovery_snapshot();
+test_fast_recovery_overrun();
+test_fast_recovery_loopback();
+test_fix_md_snapshot();
+test_fix_md_incremental_price_level();
+test_fix_md_incremental_price();
+test_fix_md_sequencing();
+test_fix_md_many_symbols();
+test_fix_md_bad_symbol();
+test_fix_md_garbled_tag();
+test_fix_msg_type_parse_single();
+test_fix_msg_type_parse_double();
+test_fix_msg_type_parse_unknown();
+test_fix_message_parse_group();
+test_fix_message_parse_group_delim();
+test_fix_message_parse_group_count();
+test_fix_message_parse_many_fields();
+test_fix_message_parse_lazy();
+test_fix_message_lazy_mismatched_type();
+test_fix_message_parse_tag_overflow();
+test_timestamp_parse();
+test_fix_utc_timestamp_parse_invalid();
+test_fix_utc_timestamp_format();
+test_fix_utc_timestamp_roundtrip();
+test_fix_message_parse_timestamps();
+test_mbt_quote_decode_logging_on();
+test_fix_field_unparse_str();
+test_fix_field_unparse_checksum();
+
+	return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef TEST_SUITE_H
+#define TEST_SUITE_H
+extern void test_boe_login_request(void);
+extern void test_boe_login_response(void);
+extern void test_boe_logout_request(void);
+extern void test_boe_client_heartbeat(void);
+extern void test_boe_logout(void);
+extern void test_boe_server_heartbeat(void);
+extern void test_boe_replay_complete(void);
+extern void test_fast_decimal_to_fixed(void);
+extern void test_fast_decimal_to_double(void);
+extern void test_fast_feed_arbitration(void);
+extern void test_fast_feed_resync(void);
+extern void test_fast_feed_visitor_stop(void);
+extern void test_fast_feed_restart(void);
+extern void test_fast_feed_loopback(void);
+extern void test_fast_feed_poll_restart(void);
+extern void test_fast_feed_oversized(void);
+extern void test_fast_publisher_packets(void);
+extern void test_fast_publisher_packet_reset(void);
+extern void test_fast_publisher_reset_message(void);
+extern void test_fast_publisher_encode_failure(void);
+extern void test_fast_get_uint(void);
+extern void test_fast_get_int(void);
+extern void test_fast_transfer_int(void);
+extern void test_fast_get_string(void);
+extern void test_fast_get_pmap(void);
+extern void test_fast_tid_map_dense(void);
+extern void test_fast_tid_map_sparse(void);
+extern void test_fast_session_many_templates(void);
+extern void test_fast_string_max_length(void);
+extern void test_fast_packet_decode(void);
+extern void test_fast_string_views(void);
+extern void test_fast_visitor(void);
+extern void test_fast_sequence_roundtrip(void);
+extern void test_fast_template_cache(void);
+extern void test_fast_session_reset(void);
+extern void test_fast_dictionary_scopes(void);
+extern void test_fast_dictionary_type_mismatch(void);
+extern void test_fast_decimal_parts(void);
+extern void test_fast_templates_shared(void);
+extern void test_fast_string_delta(void);
+extern void test_fast_string_delta_decode(void);
+extern void test_fast_decode_rollback(void);
+extern void test_fast_generated_codecs(void);
+extern void test_fast_generated_codecs_stale(void);
+extern void test_fast_recovery_snapshot(void);
+extern void test_fast_recovery_overrun(void);
+extern void test_fast_recovery_loopback(void);
+extern void test_fix_md_snapshot(void);
+extern void test_fix_md_incremental_price_level(void);
+extern void test_fix_md_incremental_price(void);
+extern void test_fix_md_sequencing(void);
+extern void test_fix_md_many_symbols(void);
+extern void test_fix_md_bad_symbol(void);
+extern void test_fix_md_garbled_tag(void);
+extern void test_fix_msg_type_parse_single(void);
+extern void test_fix_msg_type_parse_double(void);
+extern void test_fix_msg_type_parse_unknown(void);
+extern void test_fix_message_parse_group(void);
+extern void test_fix_message_parse_group_delim(void);
+extern void test_fix_message_parse_group_count(void);
+extern void test_fix_message_parse_many_fields(void);
+extern void test_fix_message_parse_lazy(void);
+extern void test_fix_message_lazy_mismatched_type(void);
+extern void test_fix_message_parse_tag_overflow(void);
+extern void test_timestamp_parse(void);
+extern void test_fix_utc_timestamp_parse_invalid(void);
+extern void test_fix_utc_timestamp_format(void);
+extern void test_fix_utc_timestamp_roundtrip(void);
+extern void test_fix_message_parse_timestamps(void);
+extern void test_mbt_quote_decode_logging_on(void);
+extern void test_fix_field_unparse_str(void);
+extern void test_fix_field_unparse_checksum(void);
+#endif